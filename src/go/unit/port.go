@@ -17,6 +17,7 @@ import (
 	"net/http"
 	"os"
 	"sync"
+	"sync/atomic"
 	"unsafe"
 )
 
@@ -32,55 +33,83 @@ type port struct {
 	snd *net.UnixConn
 }
 
-type port_registry struct {
-	sync.RWMutex
+/*
+ * Ports are added and removed rarely, while every outgoing message looks
+ * a port up.  Readers use an immutable snapshot loaded atomically, writers
+ * are serialized by the mutex and publish a modified copy.
+ */
+type port_snapshot struct {
 	m map[port_key]*port
 	t [C.NXT_PROCESS_MAX]*port
 }
 
+type port_registry struct {
+	sync.Mutex
+	v atomic.Value
+}
+
 var port_registry_ port_registry
 
-func find_port(key port_key) *port {
-	port_registry_.RLock()
-	res := port_registry_.m[key]
-	port_registry_.RUnlock()
+func init() {
+	port_registry_.v.Store(&port_snapshot{m: make(map[port_key]*port)})
+}
+
+func (r *port_registry) load() *port_snapshot {
+	return r.v.Load().(*port_snapshot)
+}
+
+func (r *port_registry) copy() *port_snapshot {
+	old := r.load()
 
-	return res
+	n := &port_snapshot{
+		m: make(map[port_key]*port, len(old.m)+1),
+		t: old.t,
+	}
+
+	for k, p := range old.m {
+		n.m[k] = p
+	}
+
+	return n
+}
+
+func find_port(key port_key) *port {
+	return port_registry_.load().m[key]
 }
 
 func remove_by_pid(pid int) {
 	port_registry_.Lock()
-	if port_registry_.m != nil {
-		for k, p := range port_registry_.m {
-			if k.pid == pid {
-				if port_registry_.t[p.t] == p {
-					port_registry_.t[p.t] = nil
-				}
-
-				delete(port_registry_.m, k)
+
+	n := port_registry_.copy()
+
+	for k, p := range n.m {
+		if k.pid == pid {
+			if n.t[p.t] == p {
+				n.t[p.t] = nil
 			}
+
+			delete(n.m, k)
 		}
 	}
 
+	port_registry_.v.Store(n)
+
 	port_registry_.Unlock()
 }
 
 func main_port() *port {
-	port_registry_.RLock()
-	res := port_registry_.t[C.NXT_PROCESS_MAIN]
-	port_registry_.RUnlock()
-
-	return res
+	return port_registry_.load().t[C.NXT_PROCESS_MAIN]
 }
 
 func add_port(p *port) {
 	port_registry_.Lock()
-	if port_registry_.m == nil {
-		port_registry_.m = make(map[port_key]*port)
-	}
 
-	port_registry_.m[p.key] = p
-	port_registry_.t[p.t] = p
+	n := port_registry_.copy()
+
+	n.m[p.key] = p
+	n.t[p.t] = p
+
+	port_registry_.v.Store(n)
 
 	port_registry_.Unlock()
 }
@@ -184,42 +213,59 @@ func new_port(pid int, id int, t int, rcv int, snd int) *port {
 	return p
 }
 
-func (p *port) read(handler http.Handler) error {
+/*
+ * The receive loop reuses its buffers and dispatches each message to the
+ * request it belongs to: the first message of a request starts a handler
+ * goroutine, the following ones are queued to the request channel.
+ */
+func (p *port) read_loop(handler http.Handler) error {
 	var buf [16384]byte
 	var oob [1024]byte
 
-	n, oobn, _, _, err := p.rcv.ReadMsgUnix(buf[:], oob[:])
-
-	if err != nil {
-		return err
+	if handler == nil {
+		handler = http.DefaultServeMux
 	}
 
-	m := new_cmsg(buf[:n], oob[:oobn])
+	for !nxt_go_quit {
+		n, oobn, _, _, err := p.rcv.ReadMsgUnix(buf[:], oob[:])
 
-	c_req := C.nxt_go_process_port_msg(m.buf.b, m.buf.s, m.oob.b, m.oob.s)
+		if err != nil {
+			return err
+		}
 
-	if c_req == 0 {
-		m.Close()
-	} else {
-		r := find_request(c_req)
+		m := new_cmsg(buf[:n], oob[:oobn])
 
-		go func(r *request) {
-			if handler == nil {
-				handler = http.DefaultServeMux
-			}
+		c_req := C.nxt_go_process_port_msg(m.buf.b, m.buf.s, m.oob.b,
+			m.oob.s)
+
+		if c_req == 0 {
+			m.Close()
+			continue
+		}
 
-			handler.ServeHTTP(r.response(), &r.req)
-			r.done()
-		}(r)
+		r := find_request(c_req)
 
-		if len(r.msgs) == 0 {
+		if r == nil {
+			m.Close()
+			continue
+		}
+
+		if r.serve {
+			r.serve = false
 			r.push(m)
+
+			go func(r *request) {
+				handler.ServeHTTP(r.response(), &r.req)
+				r.done()
+			}(r)
+
 		} else if r.ch != nil {
 			r.ch <- m
+
 		} else {
 			m.Close()
 		}
 	}
 
-	return err
+	return nil
 }
@@ -23,6 +23,7 @@ type request struct {
 	id    C.uint32_t
 	msgs  []*cmsg
 	ch    chan *cmsg
+	serve bool
 }
 
 func (r *request) Read(p []byte) (n int, err error) {
@@ -51,51 +52,98 @@ func (r *request) Close() error {
 	return nil
 }
 
-type request_registry struct {
+/*
+ * The registry is split into shards, so concurrent requests served by
+ * different goroutines rarely contend for the same lock.  The number of
+ * shards must be a power of two.
+ */
+const request_shards = 64
+
+/*
+ * Body messages are queued to the request goroutine, so the port receive
+ * loop does not stall while the handler is busy.
+ */
+const request_ch_size = 16
+
+type request_shard struct {
 	sync.RWMutex
 	m  map[C.nxt_go_request_t]*request
 	id map[C.uint32_t]*request
 }
 
+type request_registry struct {
+	s [request_shards]request_shard
+}
+
 var request_registry_ request_registry
 
+func init() {
+	for i := range request_registry_.s {
+		request_registry_.s[i].m = make(map[C.nxt_go_request_t]*request)
+		request_registry_.s[i].id = make(map[C.uint32_t]*request)
+	}
+}
+
+func request_shard_by_req(c_req C.nxt_go_request_t) *request_shard {
+	/* c_req is a malloc()ed pointer, skip the alignment bits. */
+	h := uintptr(c_req) >> 4
+	h ^= h >> 12
+
+	return &request_registry_.s[h&(request_shards-1)]
+}
+
+func request_shard_by_id(id C.uint32_t) *request_shard {
+	return &request_registry_.s[uint32(id)&(request_shards-1)]
+}
+
 func find_request(c_req C.nxt_go_request_t) *request {
-	request_registry_.RLock()
-	res := request_registry_.m[c_req]
-	request_registry_.RUnlock()
+	s := request_shard_by_req(c_req)
+
+	s.RLock()
+	res := s.m[c_req]
+	s.RUnlock()
 
 	return res
 }
 
 func find_request_by_id(id C.uint32_t) *request {
-	request_registry_.RLock()
-	res := request_registry_.id[id]
-	request_registry_.RUnlock()
+	s := request_shard_by_id(id)
+
+	s.RLock()
+	res := s.id[id]
+	s.RUnlock()
 
 	return res
 }
 
 func add_request(r *request) {
-	request_registry_.Lock()
-	if request_registry_.m == nil {
-		request_registry_.m = make(map[C.nxt_go_request_t]*request)
-		request_registry_.id = make(map[C.uint32_t]*request)
-	}
+	s := request_shard_by_req(r.c_req)
+
+	s.Lock()
+	s.m[r.c_req] = r
+	s.Unlock()
 
-	request_registry_.m[r.c_req] = r
-	request_registry_.id[r.id] = r
+	s = request_shard_by_id(r.id)
 
-	request_registry_.Unlock()
+	s.Lock()
+	s.id[r.id] = r
+	s.Unlock()
 }
 
 func remove_request(r *request) {
-	request_registry_.Lock()
-	if request_registry_.m != nil {
-		delete(request_registry_.m, r.c_req)
-		delete(request_registry_.id, r.id)
-	}
+	s := request_shard_by_req(r.c_req)
 
-	request_registry_.Unlock()
+	s.Lock()
+	delete(s.m, r.c_req)
+	s.Unlock()
+
+	s = request_shard_by_id(r.id)
+
+	s.Lock()
+	if s.id[r.id] == r {
+		delete(s.id, r.id)
+	}
+	s.Unlock()
 }
 
 func (r *request) response() *response {
@@ -147,6 +195,7 @@ func nxt_go_new_request(c_req C.nxt_go_request_t, id C.uint32_t,
 		c_req: c_req,
 		id:    id,
 		msgs:  make([]*cmsg, 0, 1),
+		serve: true,
 	}
 	r.req.Body = r
 
@@ -190,7 +239,7 @@ func nxt_go_request_set_content_length(c_req C.nxt_go_request_t, l C.int64_t) {
 
 //export nxt_go_request_create_channel
 func nxt_go_request_create_channel(c_req C.nxt_go_request_t) {
-	find_request(c_req).ch = make(chan *cmsg)
+	find_request(c_req).ch = make(chan *cmsg, request_ch_size)
 }
 
 //export nxt_go_request_set_host
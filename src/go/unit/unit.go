@@ -120,15 +120,8 @@ func ListenAndServe(addr string, handler http.Handler) error {
 	if read_port != nil {
 		C.nxt_go_ready()
 
-		for !nxt_go_quit {
-			err := read_port.read(handler)
-			if err != nil {
-				return err
-			}
-		}
-	} else {
-		return http.ListenAndServe(addr, handler)
+		return read_port.read_loop(handler)
 	}
 
-	return nil
+	return http.ListenAndServe(addr, handler)
 }
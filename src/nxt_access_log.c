@@ -0,0 +1,418 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+
+
+#define NXT_ACCESS_LOG_RING_SIZE  8192
+#define NXT_ACCESS_LOG_NAMES      1024
+#define NXT_ACCESS_LOG_NAME_LEN   255
+#define NXT_ACCESS_LOG_BUF_SIZE   (64 * 1024)
+
+/* The maximum size of a rendered record. */
+#define NXT_ACCESS_LOG_LINE_SIZE  (NXT_ACCESS_LOG_NAME_LEN * 6 + 256)
+
+
+/*
+ * The ring is a bounded multi-producer queue: a slot is free for
+ * the producer which has taken position "pos" if the slot sequence is
+ * equal to "pos", and the slot has a record for the consumer if its
+ * sequence is equal to "pos + 1".
+ */
+
+typedef struct {
+    nxt_atomic_t             seq;
+    nxt_access_log_record_t  record;
+} nxt_access_log_slot_t;
+
+
+typedef struct {
+    nxt_atomic_t             tail;
+    nxt_access_log_slot_t    *slots;
+    nxt_log_overflow_t       overflow;
+    nxt_atomic_t             dropped;
+
+    /* The fields below are used by the log writer thread only. */
+    nxt_atomic_t             head;
+    nxt_uint_t               reported;
+    nxt_fd_t                 fd;
+    nxt_access_log_format_t  format;
+    nxt_time_t               last_sec;
+    u_char                   *buf;
+    u_char                   date[32];
+
+    /* The spinlock protects the names table. */
+    nxt_thread_spinlock_t    lock;
+    nxt_uint_t               nnames;
+    nxt_str_t                names[NXT_ACCESS_LOG_NAMES];
+} nxt_access_log_t;
+
+
+static u_char *nxt_access_log_render(u_char *p, u_char *end,
+    nxt_access_log_record_t *record);
+static u_char *nxt_access_log_addr(u_char *p, u_char *end,
+    nxt_access_log_record_t *record);
+static u_char *nxt_access_log_date(u_char *p, u_char *end, uint64_t time);
+static u_char *nxt_access_log_escape(u_char *p, u_char *end, nxt_str_t *str);
+
+
+nxt_bool_t  nxt_access_log_enabled;
+
+static nxt_access_log_t  nxt_access_log;
+
+
+nxt_int_t
+nxt_access_log_init(nxt_fd_t fd, nxt_access_log_format_t format,
+    nxt_log_overflow_t overflow)
+{
+    nxt_uint_t             i;
+    nxt_access_log_slot_t  *slots;
+
+    slots = nxt_malloc(NXT_ACCESS_LOG_RING_SIZE
+                       * sizeof(nxt_access_log_slot_t));
+    if (nxt_slow_path(slots == NULL)) {
+        return NXT_ERROR;
+    }
+
+    nxt_access_log.buf = nxt_malloc(NXT_ACCESS_LOG_BUF_SIZE);
+    if (nxt_slow_path(nxt_access_log.buf == NULL)) {
+        nxt_free(slots);
+        return NXT_ERROR;
+    }
+
+    for (i = 0; i < NXT_ACCESS_LOG_RING_SIZE; i++) {
+        slots[i].seq = i;
+    }
+
+    nxt_access_log.slots = slots;
+    nxt_access_log.fd = fd;
+    nxt_access_log.format = format;
+    nxt_access_log.overflow = overflow;
+    nxt_access_log.last_sec = -1;
+
+    nxt_access_log_enabled = 1;
+
+    return NXT_OK;
+}
+
+
+/*
+ * Names are added once per configuration and are never freed, so
+ * records keep referring to a valid name after reconfiguration.
+ */
+
+nxt_uint_t
+nxt_access_log_name(nxt_str_t *name)
+{
+    u_char      *p;
+    nxt_str_t   str;
+    nxt_uint_t  i, n;
+
+    if (!nxt_access_log_enabled) {
+        return NXT_ACCESS_LOG_NO_NAME;
+    }
+
+    str.length = nxt_min(name->length, NXT_ACCESS_LOG_NAME_LEN);
+    str.start = name->start;
+
+    nxt_thread_spin_lock(&nxt_access_log.lock);
+
+    n = nxt_access_log.nnames;
+
+    for (i = 0; i < n; i++) {
+        if (nxt_strstr_eq(&nxt_access_log.names[i], &str)) {
+            goto done;
+        }
+    }
+
+    if (n == NXT_ACCESS_LOG_NAMES) {
+        i = NXT_ACCESS_LOG_NO_NAME;
+        goto done;
+    }
+
+    p = nxt_malloc(str.length);
+    if (nxt_slow_path(p == NULL)) {
+        i = NXT_ACCESS_LOG_NO_NAME;
+        goto done;
+    }
+
+    nxt_memcpy(p, str.start, str.length);
+
+    nxt_access_log.names[n].length = str.length;
+    nxt_access_log.names[n].start = p;
+    nxt_access_log.nnames = n + 1;
+
+done:
+
+    nxt_thread_spin_unlock(&nxt_access_log.lock);
+
+    return i;
+}
+
+
+void
+nxt_access_log_write(nxt_access_log_record_t *record)
+{
+    nxt_atomic_uint_t      pos, seq;
+    nxt_access_log_slot_t  *slot;
+
+    for ( ;; ) {
+        pos = nxt_access_log.tail;
+        slot = &nxt_access_log.slots[pos & (NXT_ACCESS_LOG_RING_SIZE - 1)];
+        seq = slot->seq;
+
+        if (seq == pos) {
+            if (nxt_atomic_cmp_set(&nxt_access_log.tail, pos, pos + 1)) {
+                break;
+            }
+
+            continue;
+        }
+
+        if ((nxt_atomic_int_t) (seq - pos) < 0) {
+            /* The ring is full. */
+
+            if (nxt_access_log.overflow == NXT_LOG_OVERFLOW_DROP) {
+                (void) nxt_atomic_fetch_add(&nxt_access_log.dropped, 1);
+                return;
+            }
+
+            nxt_log_writer_wakeup();
+            nxt_nanosleep(1000000);
+        }
+    }
+
+    slot->record = *record;
+
+    /* The full barrier makes the record visible before the sequence. */
+    (void) nxt_atomic_cmp_set(&slot->seq, pos, pos + 1);
+
+    /* The writer is woken up early only if the ring is half full. */
+
+    if (pos - nxt_access_log.head >= NXT_ACCESS_LOG_RING_SIZE / 2) {
+        nxt_log_writer_wakeup();
+    }
+}
+
+
+/* nxt_access_log_flush() is called by the log writer thread. */
+
+nxt_bool_t
+nxt_access_log_flush(void)
+{
+    u_char                 *p, *end;
+    nxt_bool_t             done;
+    nxt_uint_t             dropped;
+    nxt_atomic_uint_t      head;
+    nxt_access_log_slot_t  *slot;
+
+    if (!nxt_access_log_enabled) {
+        return 0;
+    }
+
+    done = 0;
+    p = nxt_access_log.buf;
+    end = p + NXT_ACCESS_LOG_BUF_SIZE;
+
+    head = nxt_access_log.head;
+
+    nxt_thread_spin_lock(&nxt_access_log.lock);
+
+    for ( ;; ) {
+        slot = &nxt_access_log.slots[head & (NXT_ACCESS_LOG_RING_SIZE - 1)];
+
+        if (nxt_atomic_fetch_add(&slot->seq, 0) != head + 1) {
+            break;
+        }
+
+        p = nxt_access_log_render(p, end, &slot->record);
+
+        (void) nxt_atomic_cmp_set(&slot->seq, head + 1,
+                                  head + NXT_ACCESS_LOG_RING_SIZE);
+        head++;
+
+        if (end - p < NXT_ACCESS_LOG_LINE_SIZE) {
+            break;
+        }
+    }
+
+    nxt_thread_spin_unlock(&nxt_access_log.lock);
+
+    nxt_access_log.head = head;
+
+    if (p != nxt_access_log.buf) {
+        (void) write(nxt_access_log.fd, nxt_access_log.buf,
+                     p - nxt_access_log.buf);
+        done = 1;
+    }
+
+    dropped = nxt_access_log.dropped;
+
+    if (dropped != nxt_access_log.reported) {
+        nxt_thread_log_error(NXT_LOG_WARN, "%ui access log records "
+                             "have been dropped",
+                             dropped - nxt_access_log.reported);
+
+        nxt_access_log.reported = dropped;
+    }
+
+    return done;
+}
+
+
+nxt_uint_t
+nxt_access_log_dropped(void)
+{
+    return nxt_access_log.dropped;
+}
+
+
+static u_char *
+nxt_access_log_render(u_char *p, u_char *end, nxt_access_log_record_t *record)
+{
+    nxt_str_t  *name, none;
+
+    if (record->name < nxt_access_log.nnames) {
+        name = &nxt_access_log.names[record->name];
+
+    } else {
+        nxt_str_set(&none, "-");
+        name = &none;
+    }
+
+    if (nxt_access_log.format == NXT_ACCESS_LOG_JSON) {
+        p = nxt_cpymem(p, "{\"time\":", 8);
+        p = nxt_sprintf(p, end, "%uL.%03uL", record->time / 1000,
+                        record->time % 1000);
+
+        p = nxt_cpymem(p, ",\"remote\":\"", 11);
+        p = nxt_access_log_addr(p, end, record);
+
+        p = nxt_sprintf(p, end, "\",\"status\":%ui,\"bytes_in\":%uL,"
+                        "\"bytes_out\":%uL,\"request_time\":%.3f,"
+                        "\"upstream_time\":%.3f,\"name\":\"",
+                        (nxt_uint_t) record->status, record->bytes_in,
+                        record->bytes_out,
+                        (double) record->request_time / 1000000,
+                        (double) record->upstream_time / 1000000);
+
+        p = nxt_access_log_escape(p, end, name);
+
+        return nxt_cpymem(p, "\"}\n", 3);
+    }
+
+    p = nxt_access_log_addr(p, end, record);
+
+    *p++ = ' ';
+    *p++ = '[';
+    p = nxt_access_log_date(p, end, record->time);
+
+    p = nxt_sprintf(p, end, "] %ui %uL %uL %.3f %.3f \"",
+                    (nxt_uint_t) record->status, record->bytes_in,
+                    record->bytes_out,
+                    (double) record->request_time / 1000000,
+                    (double) record->upstream_time / 1000000);
+
+    p = nxt_access_log_escape(p, end, name);
+
+    return nxt_cpymem(p, "\"\n", 2);
+}
+
+
+static u_char *
+nxt_access_log_addr(u_char *p, u_char *end, nxt_access_log_record_t *record)
+{
+    nxt_sockaddr_t  sa;
+
+    switch (record->family) {
+
+    case AF_INET:
+        sa.u.sockaddr_in.sin_family = AF_INET;
+        nxt_memcpy(&sa.u.sockaddr_in.sin_addr, record->addr,
+                   sizeof(struct in_addr));
+        break;
+
+#if (NXT_INET6)
+    case AF_INET6:
+        sa.u.sockaddr_in6.sin6_family = AF_INET6;
+        nxt_memcpy(&sa.u.sockaddr_in6.sin6_addr, record->addr,
+                   sizeof(struct in6_addr));
+        break;
+#endif
+
+    case AF_UNIX:
+        return nxt_cpymem(p, "unix:", 5);
+
+    default:
+        *p++ = '-';
+        return p;
+    }
+
+    return p + nxt_sockaddr_ntop(&sa, p, end, 0);
+}
+
+
+/* The date is rendered once per second, e.g. "18/Oct/2026:16:22:16 +0000". */
+
+static u_char *
+nxt_access_log_date(u_char *p, u_char *end, uint64_t time)
+{
+    u_char      *last;
+    struct tm   tm;
+    nxt_time_t  sec;
+
+    static const char  *month[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    sec = time / 1000;
+
+    if (sec != nxt_access_log.last_sec) {
+        nxt_gmtime(sec, &tm);
+
+        last = nxt_sprintf(nxt_access_log.date,
+                           nxt_access_log.date + sizeof(nxt_access_log.date),
+                           "%02d/%s/%4d:%02d:%02d:%02d +0000%Z",
+                           tm.tm_mday, month[tm.tm_mon], tm.tm_year + 1900,
+                           tm.tm_hour, tm.tm_min, tm.tm_sec);
+
+        nxt_access_log.last_sec = (last != NULL) ? sec : -1;
+    }
+
+    return nxt_cpystrn(p, nxt_access_log.date, end - p);
+}
+
+
+static u_char *
+nxt_access_log_escape(u_char *p, u_char *end, nxt_str_t *str)
+{
+    u_char  ch, *s, *last;
+
+    static const u_char  hex[] = "0123456789abcdef";
+
+    s = str->start;
+    last = s + str->length;
+
+    while (s < last && end - p > 6) {
+        ch = *s++;
+
+        if (ch == '"' || ch == '\\') {
+            *p++ = '\\';
+            *p++ = ch;
+
+        } else if (ch < 0x20 || ch == 0x7f) {
+            *p++ = '\\';
+            *p++ = 'u';
+            *p++ = '0';
+            *p++ = '0';
+            *p++ = hex[ch >> 4];
+            *p++ = hex[ch & 0xf];
+
+        } else {
+            *p++ = ch;
+        }
+    }
+
+    return p;
+}
@@ -0,0 +1,70 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NXT_ACCESS_LOG_H_INCLUDED_
+#define _NXT_ACCESS_LOG_H_INCLUDED_
+
+
+/*
+ * Access log records are fixed-size binary structures added to a shared
+ * ring by any thread.  The log writer thread renders them to text or JSON
+ * and writes them to the access log file, so formatting costs nothing on
+ * the threads serving requests.
+ */
+
+typedef enum {
+    NXT_ACCESS_LOG_TEXT = 0,
+    NXT_ACCESS_LOG_JSON
+} nxt_access_log_format_t;
+
+
+#define NXT_ACCESS_LOG_NO_NAME  0xffff
+
+
+typedef struct {
+    /* The request start time in milliseconds since the Epoch. */
+    uint64_t                 time;
+
+    /* The request processing and upstream response times in microseconds. */
+    uint32_t                 request_time;
+    uint32_t                 upstream_time;
+
+    uint64_t                 bytes_in;
+    uint64_t                 bytes_out;
+
+    uint16_t                 status;
+    /* An index returned by nxt_access_log_name(). */
+    uint16_t                 name;
+
+    /* The remote address in network byte order. */
+    uint16_t                 family;
+    uint16_t                 port;
+    u_char                   addr[16];
+} nxt_access_log_record_t;
+
+
+/* The state of a request collected while it is processed. */
+
+typedef struct {
+    nxt_nsec_t               start;
+    nxt_nsec_t               pass;
+    nxt_nsec_t               response;
+    uint16_t                 status;
+    uint16_t                 name;
+} nxt_access_log_ctx_t;
+
+
+NXT_EXPORT nxt_int_t nxt_access_log_init(nxt_fd_t fd,
+    nxt_access_log_format_t format, nxt_log_overflow_t overflow);
+NXT_EXPORT nxt_uint_t nxt_access_log_name(nxt_str_t *name);
+NXT_EXPORT void nxt_access_log_write(nxt_access_log_record_t *record);
+NXT_EXPORT nxt_bool_t nxt_access_log_flush(void);
+NXT_EXPORT nxt_uint_t nxt_access_log_dropped(void);
+
+
+extern nxt_bool_t  nxt_access_log_enabled;
+
+
+#endif /* _NXT_ACCESS_LOG_H_INCLUDED_ */
@@ -26,6 +26,8 @@ static nxt_int_t nxt_discovery_module(nxt_task_t *task, nxt_mp_t *mp,
     nxt_array_t *modules, const char *name);
 static nxt_app_module_t *nxt_app_module_load(nxt_task_t *task,
     const char *name);
+static nxt_int_t nxt_app_http_req_chunked_read(nxt_task_t *task,
+    nxt_app_parse_ctx_t *ctx, nxt_buf_t *buf);
 
 
 static nxt_thread_mutex_t        nxt_app_mutex;
@@ -331,6 +333,30 @@ nxt_app_start(nxt_task_t *task, void *data)
 }
 
 
+/*
+ * The language module is loaded once in the main process before the first
+ * worker is forked, so all workers share its relocated pages copy-on-write
+ * and skip dlopen() and symbol resolution on start.
+ */
+
+void
+nxt_app_module_preload(nxt_task_t *task, nxt_str_t *type)
+{
+    nxt_app_lang_module_t  *lang;
+
+    lang = nxt_app_lang_module(task->thread->runtime, type);
+
+    if (lang == NULL || lang->module != NULL) {
+        return;
+    }
+
+    nxt_debug(task, "application language module preload: %V \"%s\"",
+              &lang->version, lang->file);
+
+    lang->module = nxt_app_module_load(task, lang->file);
+}
+
+
 static nxt_app_module_t *
 nxt_app_module_load(nxt_task_t *task, const char *name)
 {
@@ -714,6 +740,31 @@ nxt_app_request_content_length(void *ctx, nxt_http_field_t *field,
 }
 
 
+static nxt_int_t
+nxt_app_request_transfer_encoding(void *ctx, nxt_http_field_t *field,
+    nxt_log_t *log)
+{
+    nxt_app_parse_ctx_t       *c;
+    nxt_app_request_header_t  *h;
+
+    static const nxt_str_t  chunked = nxt_string("chunked");
+
+    c = ctx;
+    h = &c->r.header;
+
+    if (nxt_strcasestr_eq(&field->value, &chunked)) {
+        h->chunked = 1;
+
+        return NXT_OK;
+    }
+
+    nxt_log_error(NXT_LOG_INFO, log, "unsupported transfer encoding: \"%V\"",
+                  &field->value);
+
+    return NXT_ERROR;
+}
+
+
 static nxt_int_t
 nxt_app_request_content_type(void *ctx, nxt_http_field_t *field,
     nxt_log_t *log)
@@ -762,11 +813,46 @@ nxt_app_request_host(void *ctx, nxt_http_field_t *field,
 }
 
 
+static nxt_int_t
+nxt_app_request_if_modified_since(void *ctx, nxt_http_field_t *field,
+    nxt_log_t *log)
+{
+    nxt_app_parse_ctx_t       *c;
+    nxt_app_request_header_t  *h;
+
+    c = ctx;
+    h = &c->r.header;
+
+    h->if_modified_since = field->value;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_app_request_range(void *ctx, nxt_http_field_t *field,
+    nxt_log_t *log)
+{
+    nxt_app_parse_ctx_t       *c;
+    nxt_app_request_header_t  *h;
+
+    c = ctx;
+    h = &c->r.header;
+
+    h->range = field->value;
+
+    return NXT_OK;
+}
+
+
 static nxt_http_fields_hash_entry_t  nxt_app_request_fields[] = {
     { nxt_string("Content-Length"), &nxt_app_request_content_length, 0 },
     { nxt_string("Content-Type"), &nxt_app_request_content_type, 0 },
     { nxt_string("Cookie"), &nxt_app_request_cookie, 0 },
     { nxt_string("Host"), &nxt_app_request_host, 0 },
+    { nxt_string("If-Modified-Since"), &nxt_app_request_if_modified_since, 0 },
+    { nxt_string("Range"), &nxt_app_request_range, 0 },
+    { nxt_string("Transfer-Encoding"), &nxt_app_request_transfer_encoding, 0 },
 
     { nxt_null_string, NULL, 0 }
 };
@@ -831,6 +917,19 @@ nxt_app_http_req_header_parse(nxt_task_t *task, nxt_app_parse_ctx_t *ctx,
     h->path = p->path;
     h->query = p->args;
 
+    if (h->chunked) {
+        /* Transfer-Encoding overrides Content-Length. */
+        h->parsed_content_length = 0;
+
+        b->buf = buf;
+
+        ctx->chunk_parser.pos = buf->mem.pos;
+
+        rc = nxt_app_http_req_chunked_read(task, ctx, buf);
+
+        return (rc == NXT_ERROR) ? NXT_ERROR : NXT_DONE;
+    }
+
     if (h->parsed_content_length == 0) {
         b->done = 1;
 
@@ -865,6 +964,10 @@ nxt_app_http_req_body_read(nxt_task_t *task, nxt_app_parse_ctx_t *ctx,
     nxt_assert(h->done == 1);
     nxt_assert(b->done == 0);
 
+    if (h->chunked) {
+        return nxt_app_http_req_chunked_read(task, ctx, buf);
+    }
+
     b->done = nxt_buf_mem_used_size(&buf->mem) + b->preread_size >=
               (size_t) h->parsed_content_length;
 
@@ -876,6 +979,59 @@ nxt_app_http_req_body_read(nxt_task_t *task, nxt_app_parse_ctx_t *ctx,
 }
 
 
+/*
+ * A chunked body is decoded in place as it is read.  When the last chunk
+ * is read, the decoded length is passed to the application as
+ * Content-Length, so the application protocol does not change.
+ *
+ * The decoded body is buffered in the router as a whole and is limited by
+ * "max_body_size" only: the application protocol passes the body size
+ * ahead of the body and none of the language modules reads a body of
+ * unknown size, so the chunks are not streamed to applications.
+ */
+
+static nxt_int_t
+nxt_app_http_req_chunked_read(nxt_task_t *task, nxt_app_parse_ctx_t *ctx,
+    nxt_buf_t *buf)
+{
+    u_char                    *p;
+    nxt_int_t                 rc;
+    nxt_app_request_body_t    *b;
+    nxt_app_request_header_t  *h;
+
+    b = &ctx->r.body;
+    h = &ctx->r.header;
+
+    rc = nxt_http_chunk_parse(task, &ctx->chunk_parser, &buf->mem);
+
+    if (rc != NXT_DONE) {
+        return rc;
+    }
+
+    /*
+     * The application requests are not pipelined, so the data
+     * after the body are dropped as with a Content-Length body.
+     */
+    buf->mem.free = ctx->chunk_parser.pos;
+
+    b->done = 1;
+    b->preread_size += nxt_buf_mem_used_size(&buf->mem);
+
+    p = nxt_mp_nget(ctx->mem_pool, NXT_OFF_T_LEN);
+    if (nxt_slow_path(p == NULL)) {
+        return NXT_ERROR;
+    }
+
+    h->parsed_content_length = b->preread_size;
+
+    h->content_length.start = p;
+    h->content_length.length = nxt_sprintf(p, p + NXT_OFF_T_LEN, "%O",
+                                           h->parsed_content_length) - p;
+
+    return NXT_DONE;
+}
+
+
 nxt_int_t
 nxt_app_http_req_done(nxt_task_t *task, nxt_app_parse_ctx_t *ctx)
 {
@@ -1029,6 +1185,8 @@ nxt_app_parse_type(nxt_str_t *str)
     } else if (nxt_str_eq(str, "go", 2)) {
         return NXT_APP_GO;
 
+    } else if (nxt_str_eq(str, "fastcgi", 7)) {
+        return NXT_APP_FASTCGI;
     }
 
     return NXT_APP_UNKNOWN;
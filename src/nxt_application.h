@@ -13,6 +13,7 @@ typedef enum {
     NXT_APP_PYTHON,
     NXT_APP_PHP,
     NXT_APP_GO,
+    NXT_APP_FASTCGI,
 
     NXT_APP_UNKNOWN,
 } nxt_app_type_t;
@@ -43,6 +44,8 @@ typedef struct {
     nxt_str_t  root;
     nxt_str_t  script;
     nxt_str_t  index;
+    int32_t    stat_interval;
+    uint32_t   threads;
 } nxt_php_app_conf_t;
 
 
@@ -88,9 +91,12 @@ typedef struct {
     nxt_str_t                  content_length;
     nxt_str_t                  content_type;
     nxt_str_t                  host;
+    nxt_str_t                  if_modified_since;
+    nxt_str_t                  range;
 
     off_t                      parsed_content_length;
     nxt_bool_t                 done;
+    nxt_bool_t                 chunked;
 
     size_t                     bufs;
     nxt_buf_t                  *buf;
@@ -119,6 +125,7 @@ typedef struct nxt_app_parse_ctx_s nxt_app_parse_ctx_t;
 struct nxt_app_parse_ctx_s {
     nxt_app_request_t         r;
     nxt_http_request_parse_t  parser;
+    nxt_http_chunk_parse_t    chunk_parser;
     nxt_mp_t                  *mem_pool;
 };
 
@@ -298,6 +305,7 @@ nxt_app_msg_read_length(u_char *src, size_t *length)
 
 nxt_app_lang_module_t *nxt_app_lang_module(nxt_runtime_t *rt, nxt_str_t *name);
 nxt_app_type_t nxt_app_parse_type(nxt_str_t *str);
+void nxt_app_module_preload(nxt_task_t *task, nxt_str_t *type);
 
 
 extern nxt_application_module_t  nxt_go_module;
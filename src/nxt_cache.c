@@ -7,90 +7,93 @@
 #include <nxt_main.h>
 
 
-/* A cache time resolution is 10ms. */
-#define                                                                       \
-nxt_cache_time(thr)                                                           \
-    (uint64_t) (nxt_thread_time(thr) * 100)
+/*
+ * The cache index, nodes, and data reside in an anonymous shared memory
+ * zone, so a cache node found by any thread can be referenced by buffers
+ * without copying.  The cache is protected by a spinlock; the zone has
+ * its own lock.
+ *
+ * A missing key is held by an empty sentinel node in updating state.
+ * The first query inserts the sentinel and calls update_handler, the
+ * following queries for the same key wait until the sentinel is updated
+ * or cancelled, or until their timeout expires.  The waiting queries are
+ * woken up via their own event engines and repeat the query.
+ */
 
 
 static nxt_int_t nxt_cache_lvlhsh_test(nxt_lvlhsh_query_t *lhq, void *data);
+static void *nxt_cache_lvlhsh_alloc(void *data, size_t size);
+static void nxt_cache_lvlhsh_free(void *data, void *p);
 static nxt_work_handler_t nxt_cache_query_locked(nxt_cache_t *cache,
-    nxt_cache_query_t *q, nxt_lvlhsh_query_t *lhq);
-static nxt_work_handler_t nxt_cache_node_hold(nxt_cache_t *cache,
-    nxt_cache_query_t *q, nxt_lvlhsh_query_t *lhq);
-static nxt_work_handler_t nxt_cache_node_test(nxt_cache_t *cache,
-    nxt_cache_query_t *q);
-
-static void nxt_cache_wait_handler(nxt_thread_t *thr, void *obj, void *data);
-static void nxt_cache_timeout_handler(nxt_thread_t *thr, void *obj, void *data);
-static void nxt_cache_wake_handler(nxt_thread_t *thr, void *obj, void *data);
-static ssize_t nxt_cache_release_locked(nxt_cache_t *cache,
-    nxt_cache_query_t *q, u_char *buf, size_t size);
-
-static nxt_cache_node_t *nxt_cache_node_alloc(nxt_cache_t *cache);
-static void nxt_cache_node_free(nxt_cache_t *cache, nxt_cache_node_t *node,
-    nxt_bool_t fast);
-static nxt_cache_query_wait_t *nxt_cache_query_wait_alloc(nxt_cache_t *cache,
-    nxt_bool_t *slow);
-static void nxt_cache_query_wait_free(nxt_cache_t *cache,
-    nxt_cache_query_wait_t *qw);
-
-
-/* STUB */
-nxt_int_t nxt_cache_shm_create(nxt_mem_zone_t *pool);
-static void *nxt_cache_shm_alloc(void *data, size_t size, nxt_uint_t nalloc);
-/**/
+    nxt_cache_query_t *q, nxt_lvlhsh_query_t *lhq, nxt_time_t now);
+static void nxt_cache_wait(nxt_task_t *task, nxt_cache_query_t *q);
+static void nxt_cache_timeout_handler(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_cache_wake_handler(nxt_task_t *task, void *obj, void *data);
+static void nxt_cache_wake(nxt_cache_query_t *waiting);
+static void *nxt_cache_alloc(nxt_cache_t *cache, size_t size);
+static nxt_int_t nxt_cache_evict(nxt_cache_t *cache);
+static void nxt_cache_node_delete(nxt_cache_t *cache, nxt_cache_node_t *node);
+static void nxt_cache_node_free(nxt_cache_t *cache, nxt_cache_node_t *node);
+
+
+static const nxt_lvlhsh_proto_t  nxt_cache_proto  nxt_aligned(64) = {
+    NXT_LVLHSH_DEFAULT,
+    nxt_cache_lvlhsh_test,
+    nxt_cache_lvlhsh_alloc,
+    nxt_cache_lvlhsh_free,
+};
+
+
+nxt_cache_t *
+nxt_cache_create(size_t size)
+{
+    u_char          *start;
+    nxt_cache_t     *cache;
+    nxt_mem_zone_t  *zone;
 
+    size = nxt_align_size(size, nxt_pagesize);
 
-nxt_int_t
-nxt_cache_shm_create(nxt_mem_zone_t *mz)
-{
-    nxt_cache_t  *cache;
+    start = nxt_mem_mmap_huge(size, NXT_MEM_MAP_READ | NXT_MEM_MAP_WRITE,
+                              NXT_MEM_MAP_SHARED);
+    if (nxt_slow_path(start == NXT_MEM_MAP_FAILED)) {
+        return NULL;
+    }
 
-    static const nxt_lvlhsh_proto_t  proto  nxt_aligned(64) = {
-        NXT_LVLHSH_LARGE_SLAB,
-        0,
-        nxt_cache_lvlhsh_test,
-        (nxt_lvlhsh_alloc_t) nxt_cache_shm_alloc,
-        (nxt_lvlhsh_free_t) nxt_mem_zone_free,
-    };
+    zone = nxt_mem_zone_init(start, size, nxt_pagesize);
+    if (nxt_slow_path(zone == NULL)) {
+        goto fail;
+    }
 
-    cache = nxt_mem_zone_zalloc(mz, sizeof(nxt_cache_t));
+    /* The zone is expected to be full, nodes are evicted on demand. */
+    nxt_mem_zone_log_nomem(zone, 0);
 
-    if (cache == NULL) {
-        return NXT_ERROR;
+    cache = nxt_mem_zone_zalloc(zone, sizeof(nxt_cache_t));
+    if (nxt_slow_path(cache == NULL)) {
+        goto fail;
     }
 
-    cache->proto = &proto;
-    cache->pool = mz;
+    cache->pool = zone;
+    cache->start = start;
+    cache->size = size;
 
-    cache->start_time = nxt_cache_time(nxt_thread());
+    nxt_queue_init(&cache->expiry_queue);
 
-    return NXT_OK;
-}
+    return cache;
 
+fail:
 
-static void *
-nxt_cache_shm_alloc(void *data, size_t size, nxt_uint_t nalloc)
-{
-    return nxt_mem_zone_align(data, size, size);
+    nxt_mem_munmap(start, size);
+
+    return NULL;
 }
 
 
 void
-nxt_cache_init(nxt_cache_t *cache)
+nxt_cache_destroy(nxt_cache_t *cache)
 {
-    static const nxt_lvlhsh_proto_t  proto  nxt_aligned(64) = {
-        NXT_LVLHSH_LARGE_MEMALIGN,
-        0,
-        nxt_cache_lvlhsh_test,
-        nxt_lvlhsh_alloc,
-        nxt_lvlhsh_free,
-    };
-
-    cache->proto = &proto;
-
-    cache->start_time = nxt_cache_time(nxt_thread());
+    /* The cache structure itself resides in the zone. */
+    nxt_mem_munmap(cache->start, cache->size);
 }
 
 
@@ -109,535 +112,437 @@ nxt_cache_lvlhsh_test(nxt_lvlhsh_query_t *lhq, void *data)
 }
 
 
-nxt_inline void
-nxt_cache_lock(nxt_cache_t *cache)
+static void *
+nxt_cache_lvlhsh_alloc(void *data, size_t size)
 {
-    if (cache->shared) {
-        nxt_thread_spin_lock(&cache->lock);
-    }
+    return nxt_mem_zone_align(data, size, size);
+}
+
+
+static void
+nxt_cache_lvlhsh_free(void *data, void *p)
+{
+    nxt_mem_zone_free(data, p);
 }
 
 
 nxt_inline void
-nxt_cache_unlock(nxt_cache_t *cache)
+nxt_cache_lhq(nxt_cache_t *cache, nxt_lvlhsh_query_t *lhq, u_char *key,
+    size_t len)
 {
-    if (cache->shared) {
-        nxt_thread_spin_unlock(&cache->lock);
-    }
+    lhq->key_hash = nxt_murmur_hash2(key, len);
+    lhq->replace = 0;
+    lhq->key.length = len;
+    lhq->key.start = key;
+    lhq->proto = &nxt_cache_proto;
+    lhq->pool = cache->pool;
 }
 
 
 void
-nxt_cache_query(nxt_cache_t *cache, nxt_cache_query_t *q)
+nxt_cache_query(nxt_task_t *task, nxt_cache_t *cache, nxt_cache_query_t *q)
 {
-    nxt_thread_t        *thr;
     nxt_lvlhsh_query_t  lhq;
     nxt_work_handler_t  handler;
 
-    thr = nxt_thread();
+    q->cache = cache;
+    q->node = NULL;
 
-    if (cache != NULL) {
-        lhq.key_hash = nxt_murmur_hash2(q->key_data, q->key_len);
-        lhq.replace = 0;
-        lhq.key.len = q->key_len;
-        lhq.key.data = q->key_data;
-        lhq.proto = cache->proto;
-        lhq.pool = cache->pool;
+    nxt_cache_lhq(cache, &lhq, q->key_data, q->key_len);
 
-        q->now = nxt_cache_time(thr);
+    nxt_thread_spin_lock(&cache->lock);
 
-        nxt_cache_lock(cache);
+    handler = nxt_cache_query_locked(cache, q, &lhq,
+                                     nxt_thread_time(task->thread));
 
-        handler = nxt_cache_query_locked(cache, q, &lhq);
+    nxt_thread_spin_unlock(&cache->lock);
 
-        nxt_cache_unlock(cache);
-
-    } else {
-        handler = q->state->nocache_handler;
+    if (handler != NULL) {
+        handler(task, q, q->data);
+        return;
     }
 
-    handler(thr, q, NULL);
+    nxt_cache_wait(task, q);
 }
 
 
 static nxt_work_handler_t
 nxt_cache_query_locked(nxt_cache_t *cache, nxt_cache_query_t *q,
-    nxt_lvlhsh_query_t *lhq)
+    nxt_lvlhsh_query_t *lhq, nxt_time_t now)
 {
-    nxt_int_t                ret;
-    nxt_time_t               expiry;
-    nxt_cache_node_t         *node;
-    nxt_cache_query_state_t  *state;
-
-    if (q->hold) {
-        return nxt_cache_node_hold(cache, q, lhq);
-    }
-
-    ret = nxt_lvlhsh_find(&cache->lvlhsh, lhq);
+    nxt_int_t                      ret;
+    nxt_cache_node_t               *node;
+    const nxt_cache_query_state_t  *state;
 
     state = q->state;
 
-    if (ret != NXT_OK) {
-        /* NXT_DECLINED */
-        return state->nocache_handler;
-    }
+    ret = nxt_lvlhsh_find(&cache->lvlhsh, lhq);
 
-    node = lhq->value;
-    node->count++;
-    q->node = node;
+    if (ret == NXT_OK) {
+        node = lhq->value;
 
-    expiry = cache->start_time + node->expiry;
+        if (node->updating) {
+            q->node = node;
+            q->waiting = 1;
+            q->next = node->waiting;
+            node->waiting = q;
 
-    if (q->now < expiry) {
-        return state->ready_handler;
-    }
+            return NULL;
+        }
 
-    q->stale = 1;
+        if (now < node->expiry) {
 
-    return state->stale_handler;
-}
+            if (node->data == NULL) {
+                return state->nocache_handler;
+            }
 
+            node->count++;
+            q->node = node;
 
-static nxt_work_handler_t
-nxt_cache_node_hold(nxt_cache_t *cache, nxt_cache_query_t *q,
-    nxt_lvlhsh_query_t *lhq)
-{
-    nxt_int_t                ret;
-    nxt_bool_t               slow;
-    nxt_cache_node_t         *node, *sentinel;
-    nxt_work_handler_t       handler;
-    nxt_cache_query_wait_t   *qw;
-    nxt_cache_query_state_t  *state;
+            nxt_queue_remove(&node->link);
+            nxt_queue_insert_head(&cache->expiry_queue, &node->link);
 
-    state = q->state;
-    sentinel = nxt_cache_node_alloc(cache);
+            return state->ready_handler;
+        }
 
-    if (nxt_slow_path(sentinel == NULL)) {
-        return state->error_handler;
+        nxt_cache_node_delete(cache, node);
     }
 
-    sentinel->key_data = q->key_data;
-    sentinel->key_len = q->key_len;
-    lhq->value = sentinel;
-
     /*
-     * Try to insert an empty sentinel node to hold updating
-     * process if there is no existent cache node in cache.
+     * Insert an empty sentinel node to hold the following
+     * queries for the same key until the node is updated.
      */
-    ret = nxt_lvlhsh_insert(&cache->lvlhsh, lhq);
-
-    if (ret == NXT_OK) {
-        /* The sentinel node was successully added. */
-
-        q->node = sentinel;
-        sentinel->updating = 1;
-        return state->update_handler;
-    }
 
-    nxt_cache_node_free(cache, sentinel, 1);
-
-    if (ret == NXT_ERROR) {
+    node = nxt_cache_alloc(cache, sizeof(nxt_cache_node_t) + q->key_len);
+    if (nxt_slow_path(node == NULL)) {
         return state->error_handler;
     }
 
-    /* NXT_DECLINED: a cache node exists. */
+    nxt_memzero(node, sizeof(nxt_cache_node_t));
 
-    node = lhq->value;
-    node->count++;
-    q->node = node;
+    node->key_data = (u_char *) node + sizeof(nxt_cache_node_t);
+    node->key_len = q->key_len;
+    node->updating = 1;
 
-    handler = nxt_cache_node_test(cache, q);
-    if (handler != NULL) {
-        return handler;
-    }
+    nxt_memcpy(node->key_data, q->key_data, q->key_len);
 
-    /* Add the node to a wait queue. */
+    for ( ;; ) {
+        lhq->value = node;
 
-    qw = nxt_cache_query_wait_alloc(cache, &slow);
-    if (nxt_slow_path(qw == NULL)) {
-        return state->error_handler;
-    }
+        ret = nxt_lvlhsh_insert(&cache->lvlhsh, lhq);
 
-    if (slow) {
-        /* The node state may have been changed during slow allocation. */
+        if (nxt_fast_path(ret == NXT_OK)) {
+            break;
+        }
+
+        /* The lvlhsh bucket or level allocation has failed. */
 
-        handler = nxt_cache_node_test(cache, q);
-        if (handler != NULL) {
-            nxt_cache_query_wait_free(cache, qw);
-            return handler;
+        if (nxt_cache_evict(cache) != NXT_OK) {
+            nxt_mem_zone_free(cache->pool, node);
+            return state->error_handler;
         }
     }
 
-    qw->query = q;
-    qw->next = node->waiting;
-    qw->busy = 0;
-    qw->deleted = 0;
-    qw->pid = nxt_pid;
-    qw->engine = nxt_thread_event_engine();
-    qw->handler = nxt_cache_wake_handler;
-    qw->cache = cache;
-
-    node->waiting = qw;
+    q->node = node;
 
-    return nxt_cache_wait_handler;
+    return state->update_handler;
 }
 
 
-static nxt_work_handler_t
-nxt_cache_node_test(nxt_cache_t *cache, nxt_cache_query_t *q)
+static void
+nxt_cache_wait(nxt_task_t *task, nxt_cache_query_t *q)
 {
-    nxt_time_t               expiry;
-    nxt_cache_node_t         *node;
-    nxt_cache_query_state_t  *state;
+    nxt_event_engine_t  *engine;
 
-    q->stale = 0;
-    state = q->state;
-    node = q->node;
+    nxt_debug(task, "cache query wait");
 
-    expiry = cache->start_time + node->expiry;
+    engine = task->thread->engine;
+    q->engine = engine;
 
-    if (q->now < expiry) {
-        return state->ready_handler;
+    if (q->timeout != 0) {
+        q->timer.task = &engine->task;
+        q->timer.work_queue = &engine->fast_work_queue;
+        q->timer.handler = nxt_cache_timeout_handler;
+        q->timer.log = engine->task.log;
+
+        nxt_timer_add(engine, &q->timer, q->timeout);
     }
+}
 
-    /*
-     * A valid stale or empty sentinel cache node.
-     * The sentinel node can be only in updating state.
-     */
 
-    if (node->updating) {
+static void
+nxt_cache_timeout_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_bool_t         waiting;
+    nxt_timer_t        *timer;
+    nxt_cache_t        *cache;
+    nxt_cache_query_t  *q, **prev;
+
+    timer = obj;
 
-        if (node->expiry != 0) {
-            /* A valid stale cache node. */
+    q = nxt_timer_data(timer, nxt_cache_query_t, timer);
+    cache = q->cache;
 
-            q->stale = 1;
+    nxt_thread_spin_lock(&cache->lock);
 
-            if (q->use_stale) {
-                return state->stale_handler;
-            }
+    waiting = q->waiting;
+
+    if (waiting) {
+        /* The sentinel node cannot be freed while it has waiting queries. */
+
+        for (prev = &q->node->waiting; *prev != q; prev = &(*prev)->next) {
+            /* void */
         }
 
-        /* A sentinel node. */
-        return NULL;
+        *prev = q->next;
+        q->waiting = 0;
     }
 
-    /* A valid stale cache node is not being updated now. */
+    nxt_thread_spin_unlock(&cache->lock);
 
-    q->stale = 1;
+    /* Otherwise the query has been already woken up. */
 
-    if (q->use_stale) {
-
-        if (q->update_stale) {
-            node->updating = 1;
-            return state->update_stale_handler;
-        }
+    if (waiting) {
+        nxt_debug(task, "cache query wait timed out");
 
-        return state->stale_handler;
+        q->node = NULL;
+        q->state->timeout_handler(task, q, q->data);
     }
-
-    node->updating = 1;
-    return state->update_handler;
 }
 
 
 static void
-nxt_cache_wait_handler(nxt_thread_t *thr, void *obj, void *data)
+nxt_cache_wake_handler(nxt_task_t *task, void *obj, void *data)
 {
-    nxt_event_timer_t  *ev;
-    nxt_cache_query_t  *cq;
+    nxt_cache_query_t  *q;
 
-    cq = obj;
+    q = obj;
 
-    if (cq->timeout != 0) {
+    nxt_debug(task, "cache query wake up");
 
-        ev = &cq->timer;
+    nxt_timer_delete(task->thread->engine, &q->timer);
 
-        if (ev->state == NXT_EVENT_TIMER_DISABLED) {
-            ev->handler = nxt_cache_timeout_handler;
-            nxt_event_timer_ident(ev, -1);
-
-            nxt_event_timer_add(thr->engine, ev, cq->timeout);
-        }
-    }
+    nxt_cache_query(task, q->cache, q);
 }
 
 
+/* The waiting list must be detached under the cache lock. */
+
 static void
-nxt_cache_timeout_handler(nxt_thread_t *thr, void *obj, void *data)
+nxt_cache_wake(nxt_cache_query_t *waiting)
 {
-    nxt_cache_query_t  *cq;
-    nxt_event_timer_t  *ev;
+    nxt_cache_query_t  *q, *next;
 
-    ev = obj;
+    for (q = waiting; q != NULL; q = next) {
+        next = q->next;
 
-    cq = nxt_event_timer_data(ev, nxt_cache_query_t, timer);
+        q->work.next = NULL;
+        q->work.handler = nxt_cache_wake_handler;
+        q->work.task = &q->engine->task;
+        q->work.obj = q;
+        q->work.data = q->data;
 
-    cq->state->timeout_handler(thr, cq, NULL);
+        nxt_event_engine_post(q->engine, &q->work);
+    }
 }
 
 
-static void
-nxt_cache_wake_handler(nxt_thread_t *thr, void *obj, void *data)
+nxt_inline nxt_cache_query_t *
+nxt_cache_waiting_detach(nxt_cache_node_t *node)
 {
-    nxt_cache_t             *cache;
-    nxt_work_handler_t      handler;
-    nxt_cache_query_t       *q;
-    nxt_cache_query_wait_t  *qw;
-
-    qw = obj;
-    q = qw->query;
-    cache = qw->cache;
-
-    nxt_cache_lock(cache);
+    nxt_cache_query_t  *q, *waiting;
 
-    handler = nxt_cache_node_test(cache, q);
+    waiting = node->waiting;
+    node->waiting = NULL;
 
-    if (handler != NULL) {
-        nxt_cache_query_wait_free(cache, qw);
-
-    } else {
-        /* Wait again. */
-        qw->next = q->node->waiting;
-        q->node->waiting = qw;
+    for (q = waiting; q != NULL; q = q->next) {
+        q->waiting = 0;
     }
 
-    nxt_cache_unlock(cache);
-
-    handler(thr, q, NULL);
+    return waiting;
 }
 
 
+/*
+ * nxt_cache_update() completes the sentinel node held by the query.
+ * The data is copied to the cache zone, NULL data creates a negative node
+ * which directs the queries to nocache_handler until it expires.
+ */
+
 nxt_int_t
-nxt_cache_update(nxt_cache_t *cache, nxt_cache_query_t *q)
+nxt_cache_update(nxt_task_t *task, nxt_cache_query_t *q, u_char *data,
+    size_t size, nxt_time_t valid)
 {
-    nxt_int_t           ret;
-    nxt_cache_node_t    *node;
-    nxt_lvlhsh_query_t  lhq;
+    u_char             *p;
+    nxt_int_t          ret;
+    nxt_cache_t        *cache;
+    nxt_cache_node_t   *node;
+    nxt_cache_query_t  *waiting;
 
+    cache = q->cache;
     node = q->node;
+    q->node = NULL;
 
-    node->accessed = nxt_cache_time(nxt_thread()) - cache->start_time;
+    ret = NXT_OK;
+    p = NULL;
 
-    node->updating = 0;
-    node->count = 1;
+    if (data != NULL) {
+        nxt_thread_spin_lock(&cache->lock);
 
-    lhq.key_hash = nxt_murmur_hash2(node->key_data, node->key_len);
-    lhq.replace = 1;
-    lhq.key.len = node->key_len;
-    lhq.key.data = node->key_data;
-    lhq.value = node;
-    lhq.proto = cache->proto;
-    lhq.pool = cache->pool;
+        p = nxt_cache_alloc(cache, size);
 
-    nxt_cache_lock(cache);
+        nxt_thread_spin_unlock(&cache->lock);
 
-    ret = nxt_lvlhsh_insert(&cache->lvlhsh, &lhq);
+        if (nxt_fast_path(p != NULL)) {
+            /* The node is not accessible until the update completes. */
+            nxt_memcpy(p, data, size);
 
-    if (nxt_fast_path(ret != NXT_OK)) {
+        } else {
+            ret = NXT_ERROR;
+        }
+    }
 
-        nxt_queue_insert_head(&cache->expiry_queue, &node->link);
+    nxt_debug(task, "cache update: %uz valid: %T", size, valid);
 
-        node = lhq.value;
+    nxt_thread_spin_lock(&cache->lock);
 
-        if (node != NULL) {
-            /* A replaced node. */
+    node->data = p;
+    node->size = (p != NULL) ? size : 0;
+    node->updated = nxt_thread_time(task->thread);
+    node->expiry = node->updated + valid;
+    node->updating = 0;
 
-            nxt_queue_remove(&node->link);
+    nxt_queue_insert_head(&cache->expiry_queue, &node->link);
 
-            if (node->count != 0) {
-                node->deleted = 1;
+    waiting = nxt_cache_waiting_detach(node);
 
-            } else {
-                // delete cache node
-            }
-        }
-    }
+    nxt_thread_spin_unlock(&cache->lock);
 
-    nxt_cache_unlock(cache);
+    nxt_cache_wake(waiting);
 
     return ret;
 }
 
 
+/*
+ * nxt_cache_cancel() removes the sentinel node held by the query,
+ * so one of the waiting queries will try to update the node.
+ */
+
 void
-nxt_cache_release(nxt_cache_t *cache, nxt_cache_query_t *q)
+nxt_cache_cancel(nxt_task_t *task, nxt_cache_query_t *q)
 {
-    u_char        *p, *data;
-    size_t        size;
-    ssize_t       ret;
-    nxt_thread_t  *thr;
-    u_char        buf[1024];
-
-    thr = nxt_thread();
-    q->now = nxt_cache_time(thr);
+    nxt_cache_t        *cache;
+    nxt_cache_node_t   *node;
+    nxt_cache_query_t  *waiting;
 
-    p = buf;
-    size = sizeof(buf);
-
-    for ( ;; ) {
-        nxt_cache_lock(cache);
-
-        ret = nxt_cache_release_locked(cache, q, p, size);
-
-        nxt_cache_unlock(cache);
-
-        if (ret == 0) {
-            return;
-        }
+    cache = q->cache;
+    node = q->node;
+    q->node = NULL;
 
-        size = nxt_abs(ret);
+    nxt_debug(task, "cache update cancel");
 
-        data = nxt_malloc(size);
+    nxt_thread_spin_lock(&cache->lock);
 
-        if (data == NULL) {
-            /* TODO: retry */
-            return;
-        }
+    waiting = nxt_cache_waiting_detach(node);
 
-        if (ret < 0) {
-            p = data;
-            continue;
-        }
+    nxt_cache_node_delete(cache, node);
 
-        if (p != data) {
-            nxt_memcpy(data, p, size);
-        }
+    nxt_thread_spin_unlock(&cache->lock);
 
-        nxt_thread_work_queue_add(thr, &thr->work_queue.main,
-                                  cache->delete_handler, data, NULL, thr->log);
-    }
+    nxt_cache_wake(waiting);
 }
 
 
-static ssize_t
-nxt_cache_release_locked(nxt_cache_t *cache, nxt_cache_query_t *q,
-    u_char *buf, size_t size)
+void
+nxt_cache_release(nxt_cache_t *cache, nxt_cache_node_t *node)
 {
-    ssize_t           ret;
-    nxt_cache_node_t  *node;
+    nxt_thread_spin_lock(&cache->lock);
 
-    node = q->node;
     node->count--;
 
-    if (node->count != 0) {
-        return 0;
+    if (node->count == 0 && node->deleted) {
+        nxt_cache_node_free(cache, node);
     }
 
-    if (!node->deleted) {
-        /*
-         * A cache node is locked whilst its count is non zero.
-         * To minimize number of operations the node's place in expiry
-         * queue can be updated only if the node is not currently used.
-         */
-        node->accessed = q->now - cache->start_time;
-
-        nxt_queue_remove(&node->link);
-        nxt_queue_insert_head(&cache->expiry_queue, &node->link);
-
-        return 0;
-    }
+    nxt_thread_spin_unlock(&cache->lock);
+}
 
-    ret = 0;
-#if 0
 
-    ret = cache->delete_copy(cache, node, buf, size);
+/*
+ * nxt_cache_alloc() evicts the least recently used unreferenced nodes
+ * until the allocation succeeds.  The cache must be locked.
+ */
 
-    if (ret < 0) {
-        return ret;
-    }
+static void *
+nxt_cache_alloc(nxt_cache_t *cache, size_t size)
+{
+    void  *p;
 
-#endif
+    for ( ;; ) {
+        p = nxt_mem_zone_alloc(cache->pool, size);
 
-    nxt_cache_node_free(cache, node, 0);
+        if (nxt_fast_path(p != NULL)) {
+            return p;
+        }
 
-    return ret;
+        if (nxt_cache_evict(cache) != NXT_OK) {
+            return NULL;
+        }
+    }
 }
 
 
-static nxt_cache_node_t *
-nxt_cache_node_alloc(nxt_cache_t *cache)
+static nxt_int_t
+nxt_cache_evict(nxt_cache_t *cache)
 {
     nxt_queue_link_t  *link;
     nxt_cache_node_t  *node;
 
-    link = nxt_queue_first(&cache->free_nodes);
-
-    if (nxt_fast_path(link != nxt_queue_tail(&cache->free_nodes))) {
-        cache->nfree_nodes--;
-        nxt_queue_remove(link);
-
+    for (link = nxt_queue_last(&cache->expiry_queue);
+         link != nxt_queue_head(&cache->expiry_queue);
+         link = nxt_queue_prev(link))
+    {
         node = nxt_queue_link_data(link, nxt_cache_node_t, link);
-        nxt_memzero(node, sizeof(nxt_cache_node_t));
 
-        return node;
+        if (node->count == 0) {
+            nxt_cache_node_delete(cache, node);
+            return NXT_OK;
+        }
     }
 
-    nxt_cache_unlock(cache);
-
-    node = cache->alloc(cache->data, sizeof(nxt_cache_node_t));
-
-    nxt_cache_lock(cache);
-
-    return node;
+    return NXT_DECLINED;
 }
 
 
 static void
-nxt_cache_node_free(nxt_cache_t *cache, nxt_cache_node_t *node, nxt_bool_t fast)
-{
-    if (fast || cache->nfree_nodes < 32) {
-        nxt_queue_insert_head(&cache->free_nodes, &node->link);
-        cache->nfree_nodes++;
-        return;
-    }
-
-    nxt_cache_unlock(cache);
-
-    cache->free(cache->data, node);
-
-    nxt_cache_lock(cache);
-}
-
-
-static nxt_cache_query_wait_t *
-nxt_cache_query_wait_alloc(nxt_cache_t *cache, nxt_bool_t *slow)
+nxt_cache_node_delete(nxt_cache_t *cache, nxt_cache_node_t *node)
 {
-    nxt_cache_query_wait_t  *qw;
+    nxt_lvlhsh_query_t  lhq;
 
-    qw = cache->free_query_wait;
+    nxt_cache_lhq(cache, &lhq, node->key_data, node->key_len);
 
-    if (nxt_fast_path(qw != NULL)) {
-        cache->free_query_wait = qw->next;
-        cache->nfree_query_wait--;
+    (void) nxt_lvlhsh_delete(&cache->lvlhsh, &lhq);
 
-        *slow = 0;
-        return qw;
+    if (!node->updating) {
+        nxt_queue_remove(&node->link);
     }
 
-    nxt_cache_unlock(cache);
-
-    qw = cache->alloc(cache->data, sizeof(nxt_cache_query_wait_t));
-    *slow = 1;
-
-    nxt_cache_lock(cache);
+    if (node->count == 0) {
+        nxt_cache_node_free(cache, node);
 
-    return qw;
+    } else {
+        node->deleted = 1;
+    }
 }
 
 
 static void
-nxt_cache_query_wait_free(nxt_cache_t *cache, nxt_cache_query_wait_t *qw)
+nxt_cache_node_free(nxt_cache_t *cache, nxt_cache_node_t *node)
 {
-    if (cache->nfree_query_wait < 32) {
-        qw->next = cache->free_query_wait;
-        cache->free_query_wait = qw;
-        cache->nfree_query_wait++;
-        return;
+    if (node->data != NULL) {
+        nxt_mem_zone_free(cache->pool, node->data);
     }
 
-    nxt_cache_unlock(cache);
-
-    cache->free(cache->data, qw);
-
-    nxt_cache_lock(cache);
+    nxt_mem_zone_free(cache->pool, node);
 }
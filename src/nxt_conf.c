@@ -12,6 +12,18 @@
 #include <float.h>
 #endif
 
+#if (NXT_HAVE_BUILTIN_CPU_SUPPORTS && NXT_HAVE_SSE42)
+
+#define NXT_CONF_JSON_SIMD  1
+
+#include <nmmintrin.h>
+
+#if (NXT_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+#endif
+
 
 #define NXT_CONF_MAX_SHORT_STRING  14
 #define NXT_CONF_MAX_STRING        NXT_INT32_T_MAX
@@ -91,7 +103,62 @@ struct nxt_conf_op_s {
 };
 
 
+typedef struct {
+    nxt_mp_t                  *mp;
+    nxt_buf_mem_t             *mem;
+    size_t                    reserve;
+    nxt_conf_json_pretty_t    *pretty;
+} nxt_conf_json_out_t;
+
+
+#if (NXT_CONF_JSON_SIMD)
+
+/*
+ * The SIMD handlers only skip over runs of bytes which need no attention
+ * and stop at the first byte which does, or when less than a vector
+ * remains.  The scalar code always continues from there.  Most strings
+ * in configuration are keys and short values, which are scanned faster
+ * by the scalar code, so a string is passed to the SIMD handlers only
+ * after its first NXT_CONF_JSON_SIMD_MIN bytes.
+ */
+
+#define NXT_CONF_JSON_SIMD_MIN  16
+
+typedef struct {
+    u_char  *(*skip_space)(u_char *p, u_char *end);
+    u_char  *(*string)(u_char *p, u_char *end);
+} nxt_conf_json_simd_t;
+
+
+static u_char *nxt_conf_json_skip_space_sse42(u_char *p, u_char *end);
+static u_char *nxt_conf_json_string_sse42(u_char *p, u_char *end);
+
+#if (NXT_HAVE_AVX2)
+static u_char *nxt_conf_json_skip_space_avx2(u_char *p, u_char *end);
+static u_char *nxt_conf_json_string_avx2(u_char *p, u_char *end);
+#endif
+
+
+static const nxt_conf_json_simd_t  nxt_conf_json_sse42 = {
+    nxt_conf_json_skip_space_sse42,
+    nxt_conf_json_string_sse42,
+};
+
+#if (NXT_HAVE_AVX2)
+static const nxt_conf_json_simd_t  nxt_conf_json_avx2 = {
+    nxt_conf_json_skip_space_avx2,
+    nxt_conf_json_string_avx2,
+};
+#endif
+
+
+static const nxt_conf_json_simd_t  *nxt_conf_json_simd;
+
+#endif
+
+
 static u_char *nxt_conf_json_skip_space(u_char *start, u_char *end);
+static u_char *nxt_conf_json_string_plain(u_char *p, u_char *end);
 static u_char *nxt_conf_json_parse_value(nxt_mp_t *mp, nxt_conf_value_t *value,
     u_char *start, u_char *end, nxt_conf_json_error_t *error);
 static u_char *nxt_conf_json_parse_object(nxt_mp_t *mp, nxt_conf_value_t *value,
@@ -116,37 +183,40 @@ static nxt_int_t nxt_conf_copy_value(nxt_mp_t *mp, nxt_conf_op_t *op,
 static nxt_int_t nxt_conf_copy_object(nxt_mp_t *mp, nxt_conf_op_t *op,
     nxt_conf_value_t *dst, nxt_conf_value_t *src);
 
+static nxt_int_t nxt_conf_json_print_value(nxt_conf_json_out_t *out,
+    nxt_conf_value_t *value);
 static size_t nxt_conf_json_integer_length(nxt_conf_value_t *value);
-static u_char *nxt_conf_json_print_integer(u_char *p, nxt_conf_value_t *value);
+static nxt_int_t nxt_conf_json_print_integer(nxt_conf_json_out_t *out,
+    nxt_conf_value_t *value);
 static size_t nxt_conf_json_string_length(nxt_conf_value_t *value);
-static u_char *nxt_conf_json_print_string(u_char *p, nxt_conf_value_t *value);
+static nxt_int_t nxt_conf_json_print_string(nxt_conf_json_out_t *out,
+    nxt_conf_value_t *value);
 static size_t nxt_conf_json_array_length(nxt_conf_value_t *value,
     nxt_conf_json_pretty_t *pretty);
-static u_char *nxt_conf_json_print_array(u_char *p, nxt_conf_value_t *value,
-    nxt_conf_json_pretty_t *pretty);
+static nxt_int_t nxt_conf_json_print_array(nxt_conf_json_out_t *out,
+    nxt_conf_value_t *value);
 static size_t nxt_conf_json_object_length(nxt_conf_value_t *value,
     nxt_conf_json_pretty_t *pretty);
-static u_char *nxt_conf_json_print_object(u_char *p, nxt_conf_value_t *value,
-    nxt_conf_json_pretty_t *pretty);
+static nxt_int_t nxt_conf_json_print_object(nxt_conf_json_out_t *out,
+    nxt_conf_value_t *value);
+static nxt_int_t nxt_conf_json_print_newline(nxt_conf_json_out_t *out,
+    nxt_uint_t n);
+static nxt_int_t nxt_conf_json_grow(nxt_conf_json_out_t *out, size_t size);
 
 static size_t nxt_conf_json_escape_length(u_char *p, size_t size);
-static u_char *nxt_conf_json_escape(u_char *dst, u_char *src, size_t size);
-
-
-#define nxt_conf_json_newline(p)                                              \
-    ((p)[0] = '\r', (p)[1] = '\n', (p) + 2)
+static nxt_int_t nxt_conf_json_escape(nxt_conf_json_out_t *out, u_char *src,
+    size_t size);
 
 
-nxt_inline u_char *
-nxt_conf_json_indentation(u_char *p, uint32_t level)
-{
-    while (level) {
-        *p++ = '\t';
-        level--;
-    }
+/*
+ * The output buffer grows only if it belongs to a memory pool, otherwise
+ * it must be sized by nxt_conf_json_length() beforehand.
+ */
 
-    return p;
-}
+#define nxt_conf_json_reserve(out, size)                                      \
+    (((out)->mp == NULL                                                       \
+      || (size_t) ((out)->mem->end - (out)->mem->free) >= (size))             \
+     ? NXT_OK : nxt_conf_json_grow(out, size))
 
 
 void
@@ -163,6 +233,13 @@ nxt_conf_get_string(nxt_conf_value_t *value, nxt_str_t *str)
 }
 
 
+int64_t
+nxt_conf_get_integer(nxt_conf_value_t *value)
+{
+    return value->u.integer;
+}
+
+
 nxt_uint_t
 nxt_conf_object_members_count(nxt_conf_value_t *value)
 {
@@ -971,7 +1048,19 @@ nxt_conf_json_skip_space(u_char *start, u_char *end)
 {
     u_char  *p;
 
-    for (p = start; nxt_fast_path(p != end); p++) {
+    p = start;
+
+#if (NXT_CONF_JSON_SIMD)
+    /* Single spaces between tokens are not worth a vector load. */
+
+    if (nxt_conf_json_simd != NULL
+        && end - p > 1 && p[0] <= ' ' && p[1] <= ' ')
+    {
+        p = nxt_conf_json_simd->skip_space(p, end);
+    }
+#endif
+
+    for ( /* void */ ; nxt_fast_path(p != end); p++) {
 
         switch (*p) {
         case ' ':
@@ -1468,6 +1557,14 @@ nxt_conf_json_parse_string(nxt_mp_t *mp, nxt_conf_value_t *value, u_char *start,
             }
 
             if (nxt_fast_path(ch >= ' ')) {
+#if (NXT_CONF_JSON_SIMD)
+                if (nxt_conf_json_simd != NULL
+                    && p - start >= NXT_CONF_JSON_SIMD_MIN)
+                {
+                    /* Points to the last ordinary byte of the run. */
+                    p = nxt_conf_json_simd->string(p + 1, end) - 1;
+                }
+#endif
                 continue;
             }
 
@@ -1902,36 +1999,101 @@ u_char *
 nxt_conf_json_print(u_char *p, nxt_conf_value_t *value,
     nxt_conf_json_pretty_t *pretty)
 {
+    nxt_buf_mem_t        mem;
+    nxt_conf_json_out_t  out;
+
+    mem.start = p;
+    mem.pos = p;
+    mem.free = p;
+    mem.end = NULL;
+
+    out.mp = NULL;
+    out.mem = &mem;
+    out.reserve = 0;
+    out.pretty = pretty;
+
+    (void) nxt_conf_json_print_value(&out, value);
+
+    return mem.free;
+}
+
+
+/*
+ * Appends JSON to the buffer in a single pass, growing the buffer from
+ * the memory pool as needed.  The buffer must be either empty or
+ * allocated by a previous call with the same pool.  At least "reserve"
+ * bytes remain free after the JSON on success.
+ */
+
+nxt_int_t
+nxt_conf_json_dump(nxt_mp_t *mp, nxt_buf_mem_t *mem, nxt_conf_value_t *value,
+    nxt_conf_json_pretty_t *pretty, size_t reserve)
+{
+    nxt_conf_json_out_t  out;
+
+    out.mp = mp;
+    out.mem = mem;
+    out.reserve = reserve;
+    out.pretty = pretty;
+
+    if (nxt_slow_path(nxt_conf_json_print_value(&out, value) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    return nxt_conf_json_reserve(&out, reserve);
+}
+
+
+static nxt_int_t
+nxt_conf_json_print_value(nxt_conf_json_out_t *out, nxt_conf_value_t *value)
+{
+    nxt_str_t  str;
+
     switch (value->type) {
 
     case NXT_CONF_VALUE_NULL:
-        return nxt_cpymem(p, "null", 4);
+        nxt_str_set(&str, "null");
+        break;
 
     case NXT_CONF_VALUE_BOOLEAN:
-        return value->u.boolean ? nxt_cpymem(p, "true", 4)
-                                : nxt_cpymem(p, "false", 5);
+        if (value->u.boolean) {
+            nxt_str_set(&str, "true");
+
+        } else {
+            nxt_str_set(&str, "false");
+        }
+
+        break;
 
     case NXT_CONF_VALUE_INTEGER:
-        return nxt_conf_json_print_integer(p, value);
+        return nxt_conf_json_print_integer(out, value);
 
     case NXT_CONF_VALUE_NUMBER:
         /* TODO */
-        return p;
+        return NXT_OK;
 
     case NXT_CONF_VALUE_SHORT_STRING:
     case NXT_CONF_VALUE_STRING:
-        return nxt_conf_json_print_string(p, value);
+        return nxt_conf_json_print_string(out, value);
 
     case NXT_CONF_VALUE_ARRAY:
-        return nxt_conf_json_print_array(p, value, pretty);
+        return nxt_conf_json_print_array(out, value);
 
     case NXT_CONF_VALUE_OBJECT:
-        return nxt_conf_json_print_object(p, value, pretty);
+        return nxt_conf_json_print_object(out, value);
+
+    default:
+        nxt_unreachable();
+        return NXT_ERROR;
     }
 
-    nxt_unreachable();
+    if (nxt_slow_path(nxt_conf_json_reserve(out, str.length) != NXT_OK)) {
+        return NXT_ERROR;
+    }
 
-    return p;
+    out->mem->free = nxt_cpymem(out->mem->free, str.start, str.length);
+
+    return NXT_OK;
 }
 
 
@@ -1954,10 +2116,21 @@ nxt_conf_json_integer_length(nxt_conf_value_t *value)
 }
 
 
-static u_char *
-nxt_conf_json_print_integer(u_char *p, nxt_conf_value_t *value)
+static nxt_int_t
+nxt_conf_json_print_integer(nxt_conf_json_out_t *out, nxt_conf_value_t *value)
 {
-    return nxt_sprintf(p, p + NXT_INT64_T_LEN, "%L", value->u.integer);
+    u_char  *p;
+
+    if (nxt_slow_path(nxt_conf_json_reserve(out, NXT_INT64_T_LEN) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    p = out->mem->free;
+
+    out->mem->free = nxt_sprintf(p, p + NXT_INT64_T_LEN, "%L",
+                                 value->u.integer);
+
+    return NXT_OK;
 }
 
 
@@ -1972,20 +2145,32 @@ nxt_conf_json_string_length(nxt_conf_value_t *value)
 }
 
 
-static u_char *
-nxt_conf_json_print_string(u_char *p, nxt_conf_value_t *value)
+static nxt_int_t
+nxt_conf_json_print_string(nxt_conf_json_out_t *out, nxt_conf_value_t *value)
 {
     nxt_str_t  str;
 
     nxt_conf_get_string(value, &str);
 
-    *p++ = '"';
+    if (nxt_slow_path(nxt_conf_json_reserve(out, 1) != NXT_OK)) {
+        return NXT_ERROR;
+    }
 
-    p = nxt_conf_json_escape(p, str.start, str.length);
+    *out->mem->free++ = '"';
 
-    *p++ = '"';
+    if (nxt_slow_path(nxt_conf_json_escape(out, str.start, str.length)
+                      != NXT_OK))
+    {
+        return NXT_ERROR;
+    }
 
-    return p;
+    if (nxt_slow_path(nxt_conf_json_reserve(out, 1) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    *out->mem->free++ = '"';
+
+    return NXT_OK;
 }
 
 
@@ -2031,55 +2216,84 @@ nxt_conf_json_array_length(nxt_conf_value_t *value,
 }
 
 
-static u_char *
-nxt_conf_json_print_array(u_char *p, nxt_conf_value_t *value,
-    nxt_conf_json_pretty_t *pretty)
+static nxt_int_t
+nxt_conf_json_print_array(nxt_conf_json_out_t *out, nxt_conf_value_t *value)
 {
-    nxt_uint_t        n;
-    nxt_conf_array_t  *array;
+    nxt_uint_t              n;
+    nxt_conf_array_t        *array;
+    nxt_conf_json_pretty_t  *pretty;
 
     array = value->u.array;
+    pretty = out->pretty;
+
+    if (nxt_slow_path(nxt_conf_json_reserve(out, 1) != NXT_OK)) {
+        return NXT_ERROR;
+    }
 
-    *p++ = '[';
+    *out->mem->free++ = '[';
 
     if (array->count != 0) {
         value = array->elements;
 
         if (pretty != NULL) {
-            p = nxt_conf_json_newline(p);
-
             pretty->level++;
-            p = nxt_conf_json_indentation(p, pretty->level);
+
+            if (nxt_slow_path(nxt_conf_json_print_newline(out, pretty->level)
+                              != NXT_OK))
+            {
+                return NXT_ERROR;
+            }
         }
 
-        p = nxt_conf_json_print(p, &value[0], pretty);
+        for (n = 0; /* void */; n++) {
+            if (nxt_slow_path(nxt_conf_json_print_value(out, &value[n])
+                              != NXT_OK))
+            {
+                return NXT_ERROR;
+            }
 
-        for (n = 1; n < array->count; n++) {
-            *p++ = ',';
+            if (n + 1 == array->count) {
+                break;
+            }
+
+            if (nxt_slow_path(nxt_conf_json_reserve(out, 1) != NXT_OK)) {
+                return NXT_ERROR;
+            }
+
+            *out->mem->free++ = ',';
 
             if (pretty != NULL) {
-                p = nxt_conf_json_newline(p);
-                p = nxt_conf_json_indentation(p, pretty->level);
+                if (nxt_slow_path(nxt_conf_json_print_newline(out,
+                                                              pretty->level)
+                                  != NXT_OK))
+                {
+                    return NXT_ERROR;
+                }
 
                 pretty->more_space = 0;
             }
-
-            p = nxt_conf_json_print(p, &value[n], pretty);
         }
 
         if (pretty != NULL) {
-            p = nxt_conf_json_newline(p);
-
             pretty->level--;
-            p = nxt_conf_json_indentation(p, pretty->level);
+
+            if (nxt_slow_path(nxt_conf_json_print_newline(out, pretty->level)
+                              != NXT_OK))
+            {
+                return NXT_ERROR;
+            }
 
             pretty->more_space = 1;
         }
     }
 
-    *p++ = ']';
+    if (nxt_slow_path(nxt_conf_json_reserve(out, 1) != NXT_OK)) {
+        return NXT_ERROR;
+    }
 
-    return p;
+    *out->mem->free++ = ']';
+
+    return NXT_OK;
 }
 
 
@@ -2127,23 +2341,33 @@ nxt_conf_json_object_length(nxt_conf_value_t *value,
 }
 
 
-static u_char *
-nxt_conf_json_print_object(u_char *p, nxt_conf_value_t *value,
-    nxt_conf_json_pretty_t *pretty)
+static nxt_int_t
+nxt_conf_json_print_object(nxt_conf_json_out_t *out, nxt_conf_value_t *value)
 {
     nxt_uint_t                n;
     nxt_conf_object_t         *object;
+    nxt_conf_json_pretty_t    *pretty;
     nxt_conf_object_member_t  *member;
 
     object = value->u.object;
+    pretty = out->pretty;
 
-    *p++ = '{';
+    if (nxt_slow_path(nxt_conf_json_reserve(out, 1) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    *out->mem->free++ = '{';
 
     if (object->count != 0) {
 
         if (pretty != NULL) {
-            p = nxt_conf_json_newline(p);
             pretty->level++;
+
+            if (nxt_slow_path(nxt_conf_json_print_newline(out, pretty->level)
+                              != NXT_OK))
+            {
+                return NXT_ERROR;
+            }
         }
 
         member = object->members;
@@ -2151,19 +2375,27 @@ nxt_conf_json_print_object(u_char *p, nxt_conf_value_t *value,
         n = 0;
 
         for ( ;; ) {
-            if (pretty != NULL) {
-                p = nxt_conf_json_indentation(p, pretty->level);
+            if (nxt_slow_path(nxt_conf_json_print_string(out, &member[n].name)
+                              != NXT_OK))
+            {
+                return NXT_ERROR;
             }
 
-            p = nxt_conf_json_print_string(p, &member[n].name);
+            if (nxt_slow_path(nxt_conf_json_reserve(out, 2) != NXT_OK)) {
+                return NXT_ERROR;
+            }
 
-            *p++ = ':';
+            *out->mem->free++ = ':';
 
             if (pretty != NULL) {
-                *p++ = ' ';
+                *out->mem->free++ = ' ';
             }
 
-            p = nxt_conf_json_print(p, &member[n].value, pretty);
+            if (nxt_slow_path(nxt_conf_json_print_value(out, &member[n].value)
+                              != NXT_OK))
+            {
+                return NXT_ERROR;
+            }
 
             n++;
 
@@ -2171,29 +2403,139 @@ nxt_conf_json_print_object(u_char *p, nxt_conf_value_t *value,
                 break;
             }
 
-            *p++ = ',';
+            if (nxt_slow_path(nxt_conf_json_reserve(out, 1) != NXT_OK)) {
+                return NXT_ERROR;
+            }
+
+            *out->mem->free++ = ',';
 
             if (pretty != NULL) {
-                p = nxt_conf_json_newline(p);
 
                 if (pretty->more_space) {
                     pretty->more_space = 0;
-                    p = nxt_conf_json_newline(p);
+
+                    if (nxt_slow_path(nxt_conf_json_print_newline(out, 0)
+                                      != NXT_OK))
+                    {
+                        return NXT_ERROR;
+                    }
+                }
+
+                if (nxt_slow_path(nxt_conf_json_print_newline(out,
+                                                              pretty->level)
+                                  != NXT_OK))
+                {
+                    return NXT_ERROR;
                 }
             }
         }
 
         if (pretty != NULL) {
-            p = nxt_conf_json_newline(p);
-
             pretty->level--;
-            p = nxt_conf_json_indentation(p, pretty->level);
+
+            if (nxt_slow_path(nxt_conf_json_print_newline(out, pretty->level)
+                              != NXT_OK))
+            {
+                return NXT_ERROR;
+            }
 
             pretty->more_space = 1;
         }
     }
 
-    *p++ = '}';
+    if (nxt_slow_path(nxt_conf_json_reserve(out, 1) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    *out->mem->free++ = '}';
+
+    return NXT_OK;
+}
+
+
+/* A new line followed by indentation of the specified level. */
+
+static nxt_int_t
+nxt_conf_json_print_newline(nxt_conf_json_out_t *out, nxt_uint_t level)
+{
+    u_char  *p;
+
+    if (nxt_slow_path(nxt_conf_json_reserve(out, 2 + level) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    p = out->mem->free;
+
+    *p++ = '\r';
+    *p++ = '\n';
+
+    while (level) {
+        *p++ = '\t';
+        level--;
+    }
+
+    out->mem->free = p;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_conf_json_grow(nxt_conf_json_out_t *out, size_t size)
+{
+    u_char         *p;
+    size_t         used, capacity;
+    nxt_buf_mem_t  *mem;
+
+    mem = out->mem;
+
+    used = mem->free - mem->start;
+    capacity = nxt_max(2 * (size_t) (mem->end - mem->start), 1024);
+    capacity = nxt_max(capacity, used + size + out->reserve);
+
+    p = nxt_mp_alloc(out->mp, capacity);
+    if (nxt_slow_path(p == NULL)) {
+        return NXT_ERROR;
+    }
+
+    if (mem->start != NULL) {
+        nxt_memcpy(p, mem->start, used);
+        nxt_mp_free(out->mp, mem->start);
+    }
+
+    mem->pos = p + (mem->pos - mem->start);
+    mem->start = p;
+    mem->free = p + used;
+    mem->end = p + capacity;
+
+    return NXT_OK;
+}
+
+
+static u_char *
+nxt_conf_json_string_plain(u_char *p, u_char *end)
+{
+#if (NXT_CONF_JSON_SIMD)
+    u_char  *last;
+
+    if (nxt_conf_json_simd != NULL && end - p > NXT_CONF_JSON_SIMD_MIN) {
+        last = p + NXT_CONF_JSON_SIMD_MIN;
+
+        while (p != last && *p >= ' ' && *p != '"' && *p != '\\') {
+            p++;
+        }
+
+        if (p != last) {
+            return p;
+        }
+
+        p = nxt_conf_json_simd->string(p, end);
+    }
+#endif
+
+    while (p != end && *p >= ' ' && *p != '"' && *p != '\\') {
+        p++;
+    }
 
     return p;
 }
@@ -2202,60 +2544,74 @@ nxt_conf_json_print_object(u_char *p, nxt_conf_value_t *value,
 static size_t
 nxt_conf_json_escape_length(u_char *p, size_t size)
 {
-    u_char  ch;
+    u_char  ch, *end;
     size_t  len;
 
     len = size;
+    end = p + size;
+
+    for ( ;; ) {
+        p = nxt_conf_json_string_plain(p, end);
+
+        if (p == end) {
+            return len;
+        }
 
-    while (size) {
         ch = *p++;
 
         if (ch == '\\' || ch == '"') {
             len++;
+            continue;
+        }
 
-        } else if (ch <= 0x1f) {
-
-            switch (ch) {
-            case '\n':
-            case '\r':
-            case '\t':
-            case '\b':
-            case '\f':
-                len++;
-                break;
+        switch (ch) {
+        case '\n':
+        case '\r':
+        case '\t':
+        case '\b':
+        case '\f':
+            len++;
+            break;
 
-            default:
-                len += sizeof("\\u001F") - 2;
-            }
+        default:
+            len += sizeof("\\u001F") - 2;
         }
-
-        size--;
     }
-
-    return len;
 }
 
 
-static u_char *
-nxt_conf_json_escape(u_char *dst, u_char *src, size_t size)
+static nxt_int_t
+nxt_conf_json_escape(nxt_conf_json_out_t *out, u_char *src, size_t size)
 {
-    u_char  ch;
+    u_char  ch, *dst, *end, *plain;
 
-    while (size) {
-        ch = *src++;
+    end = src + size;
 
-        if (ch > 0x1f) {
+    while (src != end) {
+        plain = nxt_conf_json_string_plain(src, end);
+        size = plain - src;
 
-            if (ch == '\\' || ch == '"') {
-                *dst++ = '\\';
-            }
+        /* The plain run and the longest escape sequence "\u001F". */
 
-            *dst++ = ch;
+        if (nxt_slow_path(nxt_conf_json_reserve(out, size + 6) != NXT_OK)) {
+            return NXT_ERROR;
+        }
+
+        dst = nxt_cpymem(out->mem->free, src, size);
+
+        src = plain;
+
+        if (src != end) {
+            ch = *src++;
 
-        } else {
             *dst++ = '\\';
 
             switch (ch) {
+            case '\\':
+            case '"':
+                *dst++ = ch;
+                break;
+
             case '\n':
                 *dst++ = 'n';
                 break;
@@ -2286,10 +2642,10 @@ nxt_conf_json_escape(u_char *dst, u_char *src, size_t size)
             }
         }
 
-        size--;
+        out->mem->free = dst;
     }
 
-    return dst;
+    return NXT_OK;
 }
 
 
@@ -2320,3 +2676,171 @@ nxt_conf_json_position(u_char *start, u_char *pos, nxt_uint_t *line,
         *column = 1 + symbols;
     }
 }
+
+
+nxt_uint_t
+nxt_conf_json_simd_init(nxt_uint_t level)
+{
+#if (NXT_CONF_JSON_SIMD)
+
+    __builtin_cpu_init();
+
+#if (NXT_HAVE_AVX2)
+
+    if (level >= NXT_CONF_JSON_AVX2
+        && __builtin_cpu_supports("avx2")
+        && __builtin_cpu_supports("sse4.2"))
+    {
+        nxt_conf_json_simd = &nxt_conf_json_avx2;
+        return NXT_CONF_JSON_AVX2;
+    }
+
+#endif
+
+    if (level >= NXT_CONF_JSON_SSE42 && __builtin_cpu_supports("sse4.2")) {
+        nxt_conf_json_simd = &nxt_conf_json_sse42;
+        return NXT_CONF_JSON_SSE42;
+    }
+
+    nxt_conf_json_simd = NULL;
+
+#endif
+
+    return NXT_CONF_JSON_SCALAR;
+}
+
+
+#if (NXT_CONF_JSON_SIMD)
+
+__attribute__((target("sse4.2")))
+static u_char *
+nxt_conf_json_skip_space_sse42(u_char *p, u_char *end)
+{
+    int      n;
+    __m128i  space, data;
+
+    space = _mm_setr_epi8(' ', '\t', '\r', '\n', 0, 0, 0, 0,
+                          0, 0, 0, 0, 0, 0, 0, 0);
+
+    while (end - p >= 16) {
+        data = _mm_loadu_si128((const __m128i *) p);
+
+        n = _mm_cmpestri(space, 4, data, 16,
+                         _SIDD_UBYTE_OPS|_SIDD_CMP_EQUAL_ANY
+                         |_SIDD_NEGATIVE_POLARITY);
+
+        if (n != 16) {
+            return p + n;
+        }
+
+        p += 16;
+    }
+
+    return p;
+}
+
+
+__attribute__((target("sse4.2")))
+static u_char *
+nxt_conf_json_string_sse42(u_char *p, u_char *end)
+{
+    int      n;
+    __m128i  ranges, data;
+
+    ranges = _mm_setr_epi8(0x00, 0x1f, '"', '"', '\\', '\\', 0, 0,
+                           0, 0, 0, 0, 0, 0, 0, 0);
+
+    while (end - p >= 16) {
+        data = _mm_loadu_si128((const __m128i *) p);
+
+        n = _mm_cmpestri(ranges, 6, data, 16,
+                         _SIDD_UBYTE_OPS|_SIDD_CMP_RANGES);
+
+        if (n != 16) {
+            return p + n;
+        }
+
+        p += 16;
+    }
+
+    return p;
+}
+
+
+#if (NXT_HAVE_AVX2)
+
+/*
+ * The AVX2 handlers clear the upper halves of the ymm registers on return
+ * to avoid the AVX-SSE transition penalty in the surrounding SSE code.
+ */
+
+__attribute__((target("avx2")))
+static u_char *
+nxt_conf_json_skip_space_avx2(u_char *p, u_char *end)
+{
+    uint32_t  mask;
+    __m256i   data, space;
+
+    while (end - p >= 32) {
+        data = _mm256_loadu_si256((const __m256i *) p);
+
+        space = _mm256_or_si256(
+                    _mm256_cmpeq_epi8(data, _mm256_set1_epi8(' ')),
+                    _mm256_cmpeq_epi8(data, _mm256_set1_epi8('\t')));
+        space = _mm256_or_si256(space,
+                    _mm256_cmpeq_epi8(data, _mm256_set1_epi8('\r')));
+        space = _mm256_or_si256(space,
+                    _mm256_cmpeq_epi8(data, _mm256_set1_epi8('\n')));
+
+        mask = ~(uint32_t) _mm256_movemask_epi8(space);
+
+        if (mask != 0) {
+            p += __builtin_ctz(mask);
+            break;
+        }
+
+        p += 32;
+    }
+
+    _mm256_zeroupper();
+
+    return p;
+}
+
+
+__attribute__((target("avx2")))
+static u_char *
+nxt_conf_json_string_avx2(u_char *p, u_char *end)
+{
+    uint32_t  mask;
+    __m256i   data, stop, max;
+
+    max = _mm256_set1_epi8(0x1f);
+
+    while (end - p >= 32) {
+        data = _mm256_loadu_si256((const __m256i *) p);
+
+        stop = _mm256_cmpeq_epi8(_mm256_min_epu8(data, max), data);
+        stop = _mm256_or_si256(stop,
+                   _mm256_cmpeq_epi8(data, _mm256_set1_epi8('"')));
+        stop = _mm256_or_si256(stop,
+                   _mm256_cmpeq_epi8(data, _mm256_set1_epi8('\\')));
+
+        mask = _mm256_movemask_epi8(stop);
+
+        if (mask != 0) {
+            p += __builtin_ctz(mask);
+            break;
+        }
+
+        p += 32;
+    }
+
+    _mm256_zeroupper();
+
+    return p;
+}
+
+#endif
+
+#endif
@@ -75,6 +75,19 @@ nxt_int_t nxt_conf_op_compile(nxt_mp_t *mp, nxt_conf_op_t **ops,
 nxt_conf_value_t *nxt_conf_clone(nxt_mp_t *mp, nxt_conf_op_t *op,
     nxt_conf_value_t *value);
 
+/*
+ * The scanner is selected once in nxt_lib_start(): SSE4.2 is preferred,
+ * it is faster than the scalar one on long configuration strings and
+ * keeps the AVX2 frequency penalty off the control path.
+ */
+
+#define NXT_CONF_JSON_SCALAR  0
+#define NXT_CONF_JSON_SSE42   1
+#define NXT_CONF_JSON_AVX2    2
+
+
+NXT_EXPORT nxt_uint_t nxt_conf_json_simd_init(nxt_uint_t level);
+
 nxt_conf_value_t *nxt_conf_json_parse(nxt_mp_t *mp, u_char *start, u_char *end,
     nxt_conf_json_error_t *error);
 
@@ -85,12 +98,15 @@ size_t nxt_conf_json_length(nxt_conf_value_t *value,
     nxt_conf_json_pretty_t *pretty);
 u_char *nxt_conf_json_print(u_char *p, nxt_conf_value_t *value,
     nxt_conf_json_pretty_t *pretty);
+nxt_int_t nxt_conf_json_dump(nxt_mp_t *mp, nxt_buf_mem_t *mem,
+    nxt_conf_value_t *value, nxt_conf_json_pretty_t *pretty, size_t reserve);
 void nxt_conf_json_position(u_char *start, u_char *pos, nxt_uint_t *line,
     nxt_uint_t *column);
 
 nxt_int_t nxt_conf_validate(nxt_conf_value_t *value);
 
 void nxt_conf_get_string(nxt_conf_value_t *value, nxt_str_t *str);
+int64_t nxt_conf_get_integer(nxt_conf_value_t *value);
 
 // FIXME reimplement and reorder functions below
 nxt_uint_t nxt_conf_object_members_count(nxt_conf_value_t *value);
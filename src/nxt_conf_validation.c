@@ -18,6 +18,12 @@ typedef struct {
 } nxt_conf_vldt_object_t;
 
 
+typedef struct {
+    int64_t     min;
+    int64_t     max;
+} nxt_conf_vldt_range_t;
+
+
 typedef nxt_int_t (*nxt_conf_vldt_member_t)(nxt_conf_value_t *conf,
                                             nxt_str_t *name,
                                             nxt_conf_value_t *value);
@@ -31,6 +37,27 @@ static nxt_int_t nxt_conf_vldt_app_name(nxt_conf_value_t *conf,
     nxt_conf_value_t *value, void *data);
 static nxt_int_t nxt_conf_vldt_app(nxt_conf_value_t *conf, nxt_str_t *name,
     nxt_conf_value_t *value);
+static nxt_int_t nxt_conf_vldt_certificate(nxt_conf_value_t *conf,
+    nxt_str_t *name, nxt_conf_value_t *value);
+#if (NXT_SSLTLS)
+static nxt_int_t nxt_conf_vldt_tls(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data);
+static nxt_int_t nxt_conf_vldt_certificate_name(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data);
+#endif
+static nxt_int_t nxt_conf_vldt_proxy(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data);
+static nxt_int_t nxt_conf_vldt_proxy_servers(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data);
+static nxt_int_t nxt_conf_vldt_proxy_balance(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data);
+static nxt_int_t nxt_conf_vldt_cache_key_headers(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data);
+static nxt_int_t nxt_conf_vldt_processes(nxt_conf_value_t *value);
+static nxt_int_t nxt_conf_vldt_fastcgi(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value);
+static nxt_int_t nxt_conf_vldt_range(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data);
 static nxt_int_t nxt_conf_vldt_object(nxt_conf_value_t *conf,
     nxt_conf_value_t *value, void *data);
 static nxt_int_t nxt_conf_vldt_object_iterator(nxt_conf_value_t *conf,
@@ -41,6 +68,30 @@ static nxt_int_t nxt_conf_vldt_user(nxt_conf_value_t *conf, char *name);
 static nxt_int_t nxt_conf_vldt_group(nxt_conf_value_t *conf, char *name);
 
 
+static const nxt_conf_vldt_range_t  nxt_conf_vldt_non_negative = {
+    0, NXT_INT32_T_MAX
+};
+
+
+static const nxt_conf_vldt_range_t  nxt_conf_vldt_positive = {
+    1, NXT_INT32_T_MAX
+};
+
+
+/* The timeout in seconds is converted to a timer value in milliseconds. */
+
+static const nxt_conf_vldt_range_t  nxt_conf_vldt_idle_timeout = {
+    0, NXT_INT32_T_MAX / 1000
+};
+
+
+/* Each PHP thread keeps its own interpreter context. */
+
+static const nxt_conf_vldt_range_t  nxt_conf_vldt_threads = {
+    1, 256
+};
+
+
 static nxt_conf_vldt_object_t  nxt_conf_vldt_root_members[] = {
     { nxt_string("listeners"),
       NXT_CONF_OBJECT,
@@ -52,6 +103,41 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_root_members[] = {
       &nxt_conf_vldt_object_iterator,
       (void *) &nxt_conf_vldt_app },
 
+    { nxt_string("certificates"),
+      NXT_CONF_OBJECT,
+      &nxt_conf_vldt_object_iterator,
+      (void *) &nxt_conf_vldt_certificate },
+
+    { nxt_null_string, 0, NULL, NULL }
+};
+
+
+static nxt_conf_vldt_object_t  nxt_conf_vldt_cache_members[] = {
+    { nxt_string("size"),
+      NXT_CONF_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("max_response_size"),
+      NXT_CONF_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("valid"),
+      NXT_CONF_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("lock_timeout"),
+      NXT_CONF_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("key_headers"),
+      NXT_CONF_ARRAY,
+      &nxt_conf_vldt_cache_key_headers,
+      NULL },
+
     { nxt_null_string, 0, NULL, NULL }
 };
 
@@ -62,6 +148,102 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_listener_members[] = {
       &nxt_conf_vldt_app_name,
       NULL },
 
+    { nxt_string("share"),
+      NXT_CONF_STRING,
+      NULL,
+      NULL },
+
+    { nxt_string("proxy"),
+      NXT_CONF_OBJECT,
+      &nxt_conf_vldt_proxy,
+      NULL },
+
+    { nxt_string("cache"),
+      NXT_CONF_OBJECT,
+      &nxt_conf_vldt_object,
+      (void *) &nxt_conf_vldt_cache_members },
+
+#if (NXT_SSLTLS)
+    { nxt_string("tls"),
+      NXT_CONF_OBJECT,
+      &nxt_conf_vldt_tls,
+      NULL },
+#endif
+
+    { nxt_null_string, 0, NULL, NULL }
+};
+
+
+#if (NXT_SSLTLS)
+
+static nxt_conf_vldt_object_t  nxt_conf_vldt_tls_members[] = {
+    { nxt_string("certificate"),
+      NXT_CONF_STRING,
+      &nxt_conf_vldt_certificate_name,
+      NULL },
+
+    { nxt_string("ciphers"),
+      NXT_CONF_STRING,
+      NULL,
+      NULL },
+
+    { nxt_string("session_cache"),
+      NXT_CONF_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("session_timeout"),
+      NXT_CONF_INTEGER,
+      NULL,
+      NULL },
+
+    { nxt_string("session_tickets"),
+      NXT_CONF_BOOLEAN,
+      NULL,
+      NULL },
+
+    { nxt_null_string, 0, NULL, NULL }
+};
+
+#endif
+
+
+static nxt_conf_vldt_object_t  nxt_conf_vldt_proxy_members[] = {
+    { nxt_string("servers"),
+      NXT_CONF_ARRAY,
+      &nxt_conf_vldt_proxy_servers,
+      NULL },
+
+    { nxt_string("balance"),
+      NXT_CONF_STRING,
+      &nxt_conf_vldt_proxy_balance,
+      NULL },
+
+    { nxt_string("keepalive"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_non_negative },
+
+    { nxt_null_string, 0, NULL, NULL }
+};
+
+
+static nxt_conf_vldt_object_t  nxt_conf_vldt_app_processes_members[] = {
+    { nxt_string("max"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_positive },
+
+    { nxt_string("spare"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_non_negative },
+
+    { nxt_string("idle_timeout"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_idle_timeout },
+
     { nxt_null_string, 0, NULL, NULL }
 };
 
@@ -74,8 +256,18 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_python_members[] = {
 
     { nxt_string("workers"),
       NXT_CONF_INTEGER,
-      NULL,
-      NULL },
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_positive },
+
+    { nxt_string("spare_workers"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_non_negative },
+
+    { nxt_string("processes"),
+      NXT_CONF_OBJECT,
+      &nxt_conf_vldt_object,
+      (void *) &nxt_conf_vldt_app_processes_members },
 
     { nxt_string("user"),
       NXT_CONF_STRING,
@@ -114,8 +306,18 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_php_members[] = {
 
     { nxt_string("workers"),
       NXT_CONF_INTEGER,
-      NULL,
-      NULL },
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_positive },
+
+    { nxt_string("spare_workers"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_non_negative },
+
+    { nxt_string("processes"),
+      NXT_CONF_OBJECT,
+      &nxt_conf_vldt_object,
+      (void *) &nxt_conf_vldt_app_processes_members },
 
     { nxt_string("user"),
       NXT_CONF_STRING,
@@ -147,6 +349,56 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_php_members[] = {
       NULL,
       NULL },
 
+    { nxt_string("stat_interval"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_non_negative },
+
+    { nxt_string("threads"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_threads },
+
+    { nxt_null_string, 0, NULL, NULL }
+};
+
+
+static nxt_conf_vldt_object_t  nxt_conf_vldt_fastcgi_members[] = {
+    { nxt_string("type"),
+      NXT_CONF_STRING,
+      NULL,
+      NULL },
+
+    { nxt_string("servers"),
+      NXT_CONF_ARRAY,
+      &nxt_conf_vldt_proxy_servers,
+      NULL },
+
+    { nxt_string("balance"),
+      NXT_CONF_STRING,
+      &nxt_conf_vldt_proxy_balance,
+      NULL },
+
+    { nxt_string("keepalive"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_non_negative },
+
+    { nxt_string("root"),
+      NXT_CONF_STRING,
+      NULL,
+      NULL },
+
+    { nxt_string("script"),
+      NXT_CONF_STRING,
+      NULL,
+      NULL },
+
+    { nxt_string("index"),
+      NXT_CONF_STRING,
+      NULL,
+      NULL },
+
     { nxt_null_string, 0, NULL, NULL }
 };
 
@@ -159,8 +411,18 @@ static nxt_conf_vldt_object_t  nxt_conf_vldt_go_members[] = {
 
     { nxt_string("workers"),
       NXT_CONF_INTEGER,
-      NULL,
-      NULL },
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_positive },
+
+    { nxt_string("spare_workers"),
+      NXT_CONF_INTEGER,
+      &nxt_conf_vldt_range,
+      (void *) &nxt_conf_vldt_non_negative },
+
+    { nxt_string("processes"),
+      NXT_CONF_OBJECT,
+      &nxt_conf_vldt_object,
+      (void *) &nxt_conf_vldt_app_processes_members },
 
     { nxt_string("user"),
       NXT_CONF_STRING,
@@ -201,6 +463,17 @@ static nxt_int_t
 nxt_conf_vldt_listener(nxt_conf_value_t *conf, nxt_str_t *name,
     nxt_conf_value_t *value)
 {
+    static nxt_str_t  application_str = nxt_string("application");
+    static nxt_str_t  proxy_str = nxt_string("proxy");
+
+    /* A listener passes requests either to an application or to a proxy. */
+
+    if (nxt_conf_get_object_member(value, &application_str, NULL) != NULL
+        && nxt_conf_get_object_member(value, &proxy_str, NULL) != NULL)
+    {
+        return NXT_ERROR;
+    }
+
     return nxt_conf_vldt_object(conf, value, nxt_conf_vldt_listener_members);
 }
 
@@ -232,6 +505,168 @@ nxt_conf_vldt_app_name(nxt_conf_value_t *conf, nxt_conf_value_t *value,
 }
 
 
+static nxt_int_t
+nxt_conf_vldt_certificate(nxt_conf_value_t *conf, nxt_str_t *name,
+    nxt_conf_value_t *value)
+{
+    nxt_str_t  pem;
+
+    static const char  certificate[] = "-----BEGIN CERTIFICATE-----";
+    static const char  key[] = "PRIVATE KEY-----";
+
+    if (nxt_conf_type(value) != NXT_CONF_STRING) {
+        return NXT_ERROR;
+    }
+
+    nxt_conf_get_string(value, &pem);
+
+    if (nxt_memstrn(pem.start, pem.start + pem.length, certificate,
+                    sizeof(certificate) - 1)
+        == NULL
+        || nxt_memstrn(pem.start, pem.start + pem.length, key,
+                       sizeof(key) - 1)
+        == NULL)
+    {
+        return NXT_ERROR;
+    }
+
+    return NXT_OK;
+}
+
+
+#if (NXT_SSLTLS)
+
+static nxt_int_t
+nxt_conf_vldt_tls(nxt_conf_value_t *conf, nxt_conf_value_t *value,
+    void *data)
+{
+    static nxt_str_t  certificate_str = nxt_string("certificate");
+
+    if (nxt_conf_get_object_member(value, &certificate_str, NULL) == NULL) {
+        return NXT_ERROR;
+    }
+
+    return nxt_conf_vldt_object(conf, value, nxt_conf_vldt_tls_members);
+}
+
+
+static nxt_int_t
+nxt_conf_vldt_certificate_name(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data)
+{
+    nxt_str_t         name;
+    nxt_conf_value_t  *certificates;
+
+    static nxt_str_t  certificates_str = nxt_string("certificates");
+
+    certificates = nxt_conf_get_object_member(conf, &certificates_str, NULL);
+
+    if (certificates == NULL) {
+        return NXT_ERROR;
+    }
+
+    nxt_conf_get_string(value, &name);
+
+    if (nxt_conf_get_object_member(certificates, &name, NULL) == NULL) {
+        return NXT_ERROR;
+    }
+
+    return NXT_OK;
+}
+
+#endif
+
+
+static nxt_int_t
+nxt_conf_vldt_proxy(nxt_conf_value_t *conf, nxt_conf_value_t *value,
+    void *data)
+{
+    static nxt_str_t  servers_str = nxt_string("servers");
+
+    if (nxt_conf_get_object_member(value, &servers_str, NULL) == NULL) {
+        return NXT_ERROR;
+    }
+
+    return nxt_conf_vldt_object(conf, value, nxt_conf_vldt_proxy_members);
+}
+
+
+static nxt_int_t
+nxt_conf_vldt_proxy_servers(nxt_conf_value_t *conf, nxt_conf_value_t *value,
+    void *data)
+{
+    uint32_t          i;
+    nxt_str_t         name;
+    nxt_conf_value_t  *server;
+
+    for (i = 0; ; i++) {
+        server = nxt_conf_get_array_element(value, i);
+
+        if (server == NULL) {
+            break;
+        }
+
+        if (nxt_conf_type(server) != NXT_CONF_STRING) {
+            return NXT_ERROR;
+        }
+
+        nxt_conf_get_string(server, &name);
+
+        if (name.length == 0) {
+            return NXT_ERROR;
+        }
+    }
+
+    return (i != 0) ? NXT_OK : NXT_ERROR;
+}
+
+
+static nxt_int_t
+nxt_conf_vldt_proxy_balance(nxt_conf_value_t *conf, nxt_conf_value_t *value,
+    void *data)
+{
+    nxt_str_t  balance;
+
+    nxt_conf_get_string(value, &balance);
+
+    if (nxt_str_eq(&balance, "round_robin", 11)
+        || nxt_str_eq(&balance, "least_conn", 10))
+    {
+        return NXT_OK;
+    }
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+nxt_conf_vldt_cache_key_headers(nxt_conf_value_t *conf,
+    nxt_conf_value_t *value, void *data)
+{
+    uint32_t          i;
+    nxt_str_t         name;
+    nxt_conf_value_t  *header;
+
+    for (i = 0; ; i++) {
+        header = nxt_conf_get_array_element(value, i);
+
+        if (header == NULL) {
+            return NXT_OK;
+        }
+
+        if (nxt_conf_type(header) != NXT_CONF_STRING) {
+            return NXT_ERROR;
+        }
+
+        nxt_conf_get_string(header, &name);
+
+        if (name.length == 0) {
+            return NXT_ERROR;
+        }
+    }
+}
+
+
 static nxt_int_t
 nxt_conf_vldt_app(nxt_conf_value_t *conf, nxt_str_t *name,
     nxt_conf_value_t *value)
@@ -262,6 +697,10 @@ nxt_conf_vldt_app(nxt_conf_value_t *conf, nxt_str_t *name,
 
     nxt_conf_get_string(type_value, &type);
 
+    if (nxt_app_parse_type(&type) == NXT_APP_FASTCGI) {
+        return nxt_conf_vldt_fastcgi(conf, value);
+    }
+
     thread = nxt_thread();
 
     lang = nxt_app_lang_module(thread->runtime, &type);
@@ -270,11 +709,98 @@ nxt_conf_vldt_app(nxt_conf_value_t *conf, nxt_str_t *name,
     }
 
     n = nxt_app_parse_type(&lang->type);
-    if (n != NXT_APP_UNKNOWN) {
-        return nxt_conf_vldt_object(conf, value, members[n]);
+    if (n == NXT_APP_UNKNOWN) {
+        return NXT_ERROR;
     }
 
-    return NXT_ERROR;
+    if (nxt_conf_vldt_object(conf, value, members[n]) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    return nxt_conf_vldt_processes(value);
+}
+
+
+/*
+ * The "processes" object overrides the "workers" and "spare_workers"
+ * values.  The number of spare processes must not exceed the maximum.
+ */
+
+static nxt_int_t
+nxt_conf_vldt_processes(nxt_conf_value_t *value)
+{
+    int64_t           max, spare;
+    nxt_conf_value_t  *processes, *v;
+
+    static nxt_str_t  workers_str = nxt_string("workers");
+    static nxt_str_t  spare_workers_str = nxt_string("spare_workers");
+    static nxt_str_t  processes_str = nxt_string("processes");
+    static nxt_str_t  max_str = nxt_string("max");
+    static nxt_str_t  spare_str = nxt_string("spare");
+
+    max = 1;
+    spare = 0;
+
+    v = nxt_conf_get_object_member(value, &workers_str, NULL);
+    if (v != NULL) {
+        max = nxt_conf_get_integer(v);
+    }
+
+    v = nxt_conf_get_object_member(value, &spare_workers_str, NULL);
+    if (v != NULL) {
+        spare = nxt_conf_get_integer(v);
+    }
+
+    processes = nxt_conf_get_object_member(value, &processes_str, NULL);
+
+    if (processes != NULL) {
+        v = nxt_conf_get_object_member(processes, &max_str, NULL);
+        if (v != NULL) {
+            max = nxt_conf_get_integer(v);
+        }
+
+        v = nxt_conf_get_object_member(processes, &spare_str, NULL);
+        if (v != NULL) {
+            spare = nxt_conf_get_integer(v);
+        }
+    }
+
+    return (spare <= max) ? NXT_OK : NXT_ERROR;
+}
+
+
+static nxt_int_t
+nxt_conf_vldt_fastcgi(nxt_conf_value_t *conf, nxt_conf_value_t *value)
+{
+    static nxt_str_t  servers_str = nxt_string("servers");
+    static nxt_str_t  root_str = nxt_string("root");
+
+    if (nxt_conf_get_object_member(value, &servers_str, NULL) == NULL
+        || nxt_conf_get_object_member(value, &root_str, NULL) == NULL)
+    {
+        return NXT_ERROR;
+    }
+
+    return nxt_conf_vldt_object(conf, value, nxt_conf_vldt_fastcgi_members);
+}
+
+
+static nxt_int_t
+nxt_conf_vldt_range(nxt_conf_value_t *conf, nxt_conf_value_t *value,
+    void *data)
+{
+    int64_t                      n;
+    const nxt_conf_vldt_range_t  *range;
+
+    range = data;
+
+    n = nxt_conf_get_integer(value);
+
+    if (n < range->min || n > range->max) {
+        return NXT_ERROR;
+    }
+
+    return NXT_OK;
 }
 
 
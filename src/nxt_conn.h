@@ -136,6 +136,7 @@ struct nxt_conn_s {
     nxt_timer_t                   write_timer;
 
     nxt_off_t                     sent;
+    nxt_off_t                     received;
     uint32_t                      max_chunk;
     uint32_t                      nbytes;
 
@@ -171,6 +172,8 @@ struct nxt_conn_s {
     uint8_t                       sendfile;     /* 2 bits */
     uint8_t                       tcp_nodelay;  /* 1 bit */
 
+    nxt_access_log_ctx_t          access;
+
     nxt_queue_link_t              link;
 };
 
@@ -181,6 +184,8 @@ typedef struct {
     nxt_req_id_t         req_id;
     nxt_conn_t           *conn;
     nxt_port_t           *app_port;
+    void                 *cache;   /* response cache update */
+    uint8_t              header;   /* 1 bit, response header passed */
 
     nxt_queue_link_t     link;     /* for nxt_conn_t.requests */
 } nxt_req_conn_link_t;
@@ -353,8 +358,7 @@ NXT_EXPORT void nxt_conn_proxy(nxt_task_t *task, nxt_conn_proxy_t *p);
 #define nxt_event_conn_close     nxt_conn_close
 
 
-NXT_EXPORT nxt_req_conn_link_t *nxt_conn_request_add(nxt_conn_t *c,
-    nxt_req_id_t req_id);
+NXT_EXPORT nxt_req_conn_link_t *nxt_conn_request_add(nxt_conn_t *c);
 NXT_EXPORT void nxt_conn_request_remove(nxt_conn_t *c,
     nxt_req_conn_link_t *rc);
 
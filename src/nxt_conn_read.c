@@ -68,6 +68,10 @@ nxt_conn_io_read(nxt_task_t *task, void *obj, void *data)
         if (n > 0) {
             c->nbytes = n;
 
+            if (c->peek == 0) {
+                c->received += n;
+            }
+
             nxt_recvbuf_update(b, n);
 
             nxt_fd_event_block_read(engine, &c->socket);
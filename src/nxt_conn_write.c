@@ -9,6 +9,7 @@
 
 static void nxt_conn_write_timer_handler(nxt_task_t *task, void *obj,
     void *data);
+static ssize_t nxt_conn_io_sendfile(nxt_task_t *task, nxt_sendbuf_t *sb);
 
 
 void
@@ -153,14 +154,106 @@ nxt_conn_io_sendbuf(nxt_task_t *task, nxt_sendbuf_t *sb)
 
     niov = nxt_sendbuf_mem_coalesce0(task, sb, iov, NXT_IOBUF_MAX);
 
-    if (niov == 0 && sb->sync) {
-        return 0;
+    if (niov == 0) {
+        if (sb->buf != NULL && nxt_buf_is_file(sb->buf)) {
+            return nxt_conn_io_sendfile(task, sb);
+        }
+
+        if (sb->sync) {
+            return 0;
+        }
     }
 
     return nxt_conn_io_writev(task, sb, iov, niov);
 }
 
 
+/*
+ * A file buffer is sent only when it is at the head of the chain:
+ * preceding memory buffers are written by writev() first.
+ */
+
+static ssize_t
+nxt_conn_io_sendfile(nxt_task_t *task, nxt_sendbuf_t *sb)
+{
+    size_t     size;
+    ssize_t    n;
+    nxt_buf_t  *b;
+#if (NXT_HAVE_LINUX_SENDFILE)
+    nxt_err_t  err;
+    nxt_off_t  offset;
+#else
+    u_char     buf[16384];
+#endif
+
+    b = sb->buf;
+
+    size = nxt_min((nxt_off_t) sb->limit, b->file_end - b->file_pos);
+
+#if (NXT_HAVE_LINUX_SENDFILE)
+
+    for ( ;; ) {
+        offset = b->file_pos;
+
+        n = sendfile(sb->socket, b->file->fd, &offset, size);
+
+        err = (n == -1) ? nxt_errno : 0;
+
+        nxt_debug(task, "sendfile(%d, %FD, @%O, %uz): %z",
+                  sb->socket, b->file->fd, b->file_pos, size, n);
+
+        if (n > 0) {
+            return n;
+        }
+
+        if (n == 0) {
+            nxt_log(task, NXT_LOG_ERR, "file \"%FN\" was truncated",
+                    b->file->name);
+
+            return NXT_ERROR;
+        }
+
+        /* n == -1 */
+
+        switch (err) {
+
+        case NXT_EAGAIN:
+            sb->ready = 0;
+            nxt_debug(task, "sendfile() %E", err);
+
+            return NXT_AGAIN;
+
+        case NXT_EINTR:
+            nxt_debug(task, "sendfile() %E", err);
+            continue;
+
+        default:
+            sb->error = err;
+            nxt_log(task, nxt_socket_error_level(err),
+                    "sendfile(%d, %FD, @%O, %uz) failed %E \"%FN\"",
+                    sb->socket, b->file->fd, b->file_pos, size, err,
+                    b->file->name);
+
+            return NXT_ERROR;
+        }
+    }
+
+#else
+
+    size = nxt_min(size, sizeof(buf));
+
+    n = nxt_file_read(b->file, buf, size, b->file_pos);
+
+    if (nxt_slow_path(n <= 0)) {
+        return NXT_ERROR;
+    }
+
+    return nxt_conn_io_send(task, sb, buf, n);
+
+#endif
+}
+
+
 ssize_t
 nxt_conn_io_writev(nxt_task_t *task, nxt_sendbuf_t *sb, struct iovec *iov,
     nxt_uint_t niov)
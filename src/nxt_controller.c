@@ -69,12 +69,20 @@ static nxt_int_t nxt_controller_request_content_length(void *ctx,
 
 static void nxt_controller_process_request(nxt_task_t *task,
     nxt_controller_request_t *req);
+static nxt_bool_t nxt_controller_certificate_pem(nxt_str_t *path,
+    nxt_buf_mem_t *mbuf);
+static nxt_conf_value_t *nxt_controller_certificate_value(nxt_mp_t *mp,
+    nxt_buf_mem_t *mbuf);
+static nxt_conf_value_t *nxt_controller_certificates_hide(nxt_mp_t *mp,
+    nxt_str_t *path, nxt_conf_value_t *value);
+static nxt_conf_value_t *nxt_controller_certificates_info(nxt_mp_t *mp,
+    nxt_conf_value_t *certificates);
+static nxt_conf_value_t *nxt_controller_certificate_info(nxt_mp_t *mp,
+    nxt_conf_value_t *value);
 static void nxt_controller_conf_handler(nxt_task_t *task,
     nxt_port_recv_msg_t *msg, void *data);
 static void nxt_controller_response(nxt_task_t *task,
     nxt_controller_request_t *req, nxt_controller_response_t *resp);
-static u_char *nxt_controller_date(u_char *buf, nxt_realtime_t *now,
-    struct tm *tm, size_t size, const char *format);
 
 
 static nxt_http_fields_hash_entry_t  nxt_controller_request_fields[] = {
@@ -183,7 +191,8 @@ nxt_controller_conf_default(void)
     nxt_conf_value_t  *conf;
 
     static const nxt_str_t json
-        = nxt_string("{ \"listeners\": {}, \"applications\": {} }");
+        = nxt_string("{ \"listeners\": {}, \"applications\": {},"
+                     " \"certificates\": {} }");
 
     mp = nxt_mp_create(1024, 128, 256, 32);
 
@@ -697,6 +706,12 @@ nxt_controller_process_request(nxt_task_t *task, nxt_controller_request_t *req)
             goto not_found;
         }
 
+        value = nxt_controller_certificates_hide(c->mem_pool, &path, value);
+
+        if (nxt_slow_path(value == NULL)) {
+            goto alloc_fail;
+        }
+
         resp.status = 200;
         resp.conf = value;
 
@@ -719,27 +734,37 @@ nxt_controller_process_request(nxt_task_t *task, nxt_controller_request_t *req)
 
         mbuf = &c->read->mem;
 
-        nxt_memzero(&error, sizeof(nxt_conf_json_error_t));
-
-        value = nxt_conf_json_parse(mp, mbuf->pos, mbuf->free, &error);
-
-        if (value == NULL) {
-            nxt_mp_destroy(mp);
+        if (nxt_controller_certificate_pem(&path, mbuf)) {
+            value = nxt_controller_certificate_value(mp, mbuf);
 
-            if (error.pos == NULL) {
+            if (nxt_slow_path(value == NULL)) {
+                nxt_mp_destroy(mp);
                 goto alloc_fail;
             }
 
-            resp.status = 400;
-            resp.title = (u_char *) "Invalid JSON.";
-            resp.detail = error.detail;
-            resp.offset = error.pos - mbuf->pos;
+        } else {
+            nxt_memzero(&error, sizeof(nxt_conf_json_error_t));
 
-            nxt_conf_json_position(mbuf->pos, error.pos,
-                                   &resp.line, &resp.column);
+            value = nxt_conf_json_parse(mp, mbuf->pos, mbuf->free, &error);
 
-            nxt_controller_response(task, req, &resp);
-            return;
+            if (value == NULL) {
+                nxt_mp_destroy(mp);
+
+                if (error.pos == NULL) {
+                    goto alloc_fail;
+                }
+
+                resp.status = 400;
+                resp.title = (u_char *) "Invalid JSON.";
+                resp.detail = error.detail;
+                resp.offset = error.pos - mbuf->pos;
+
+                nxt_conf_json_position(mbuf->pos, error.pos,
+                                       &resp.line, &resp.column);
+
+                nxt_controller_response(task, req, &resp);
+                return;
+            }
         }
 
         if (path.length != 1) {
@@ -905,6 +930,219 @@ no_router:
 }
 
 
+/*
+ * A certificate bundle can be uploaded to "/certificates/<name>"
+ * as a raw PEM body instead of a JSON string.
+ */
+
+static nxt_bool_t
+nxt_controller_certificate_pem(nxt_str_t *path, nxt_buf_mem_t *mbuf)
+{
+    size_t  size;
+    u_char  *p;
+
+    static const char  certificates[] = "/certificates/";
+    static const char  begin[] = "-----BEGIN ";
+
+    size = sizeof(certificates) - 1;
+
+    if (path->length <= size
+        || nxt_memcmp(path->start, certificates, size) != 0
+        || nxt_memchr(path->start + size, '/', path->length - size) != NULL)
+    {
+        return 0;
+    }
+
+    for (p = mbuf->pos; p < mbuf->free; p++) {
+        if (*p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+            break;
+        }
+    }
+
+    return ((size_t) (mbuf->free - p) >= sizeof(begin) - 1
+            && nxt_memcmp(p, begin, sizeof(begin) - 1) == 0);
+}
+
+
+static nxt_conf_value_t *
+nxt_controller_certificate_value(nxt_mp_t *mp, nxt_buf_mem_t *mbuf)
+{
+    nxt_str_t         pem;
+    nxt_conf_value_t  *object;
+
+    static nxt_str_t  pem_str = nxt_string("pem");
+
+    pem.length = mbuf->free - mbuf->pos;
+
+    pem.start = nxt_mp_nget(mp, pem.length);
+    if (nxt_slow_path(pem.start == NULL)) {
+        return NULL;
+    }
+
+    nxt_memcpy(pem.start, mbuf->pos, pem.length);
+
+    object = nxt_conf_create_object(mp, 1);
+    if (nxt_slow_path(object == NULL)) {
+        return NULL;
+    }
+
+    nxt_conf_set_member_string(object, &pem_str, &pem, 0);
+
+    return nxt_conf_get_object_member(object, &pem_str, NULL);
+}
+
+
+/*
+ * Private keys are never returned, certificates
+ * are shown as a summary of their PEM blocks.
+ */
+
+static nxt_conf_value_t *
+nxt_controller_certificates_hide(nxt_mp_t *mp, nxt_str_t *path,
+    nxt_conf_value_t *value)
+{
+    nxt_int_t         rc;
+    nxt_conf_op_t     *ops;
+    nxt_conf_value_t  *certificates, *info;
+
+    static nxt_str_t  certificates_path = nxt_string("/certificates");
+
+    if (path->length == 1) {
+        certificates = nxt_conf_get_path(value, &certificates_path);
+
+        if (certificates == NULL) {
+            return value;
+        }
+
+        info = nxt_controller_certificates_info(mp, certificates);
+        if (nxt_slow_path(info == NULL)) {
+            return NULL;
+        }
+
+        rc = nxt_conf_op_compile(mp, &ops, value, &certificates_path, info);
+        if (nxt_slow_path(rc != NXT_OK)) {
+            return NULL;
+        }
+
+        return nxt_conf_clone(mp, ops, value);
+    }
+
+    if (path->length < certificates_path.length
+        || nxt_memcmp(path->start, certificates_path.start,
+                      certificates_path.length)
+           != 0)
+    {
+        return value;
+    }
+
+    if (path->length == certificates_path.length) {
+        return nxt_controller_certificates_info(mp, value);
+    }
+
+    if (path->start[certificates_path.length] == '/') {
+        return nxt_controller_certificate_info(mp, value);
+    }
+
+    return value;
+}
+
+
+static nxt_conf_value_t *
+nxt_controller_certificates_info(nxt_mp_t *mp, nxt_conf_value_t *certificates)
+{
+    uint32_t          i, next;
+    nxt_str_t         name;
+    nxt_conf_value_t  *object, *member, *info;
+
+    object = nxt_conf_create_object(mp,
+                                    nxt_conf_object_members_count(certificates));
+    if (nxt_slow_path(object == NULL)) {
+        return NULL;
+    }
+
+    next = 0;
+
+    for (i = 0; /* void */; i++) {
+        member = nxt_conf_next_object_member(certificates, &name, &next);
+
+        if (member == NULL) {
+            break;
+        }
+
+        info = nxt_controller_certificate_info(mp, member);
+        if (nxt_slow_path(info == NULL)) {
+            return NULL;
+        }
+
+        nxt_conf_set_member(object, &name, info, i);
+    }
+
+    return object;
+}
+
+
+static nxt_conf_value_t *
+nxt_controller_certificate_info(nxt_mp_t *mp, nxt_conf_value_t *value)
+{
+    u_char            *p, *end, *label;
+    int64_t           chain;
+    nxt_str_t         pem, key;
+    nxt_conf_value_t  *object;
+
+    static nxt_str_t  chain_str = nxt_string("chain");
+    static nxt_str_t  key_str = nxt_string("key");
+
+    if (nxt_conf_type(value) != NXT_CONF_STRING) {
+        return value;
+    }
+
+    nxt_conf_get_string(value, &pem);
+
+    chain = 0;
+    key.length = 0;
+    key.start = NULL;
+
+    p = pem.start;
+    end = pem.start + pem.length;
+
+    for ( ;; ) {
+        label = nxt_memstrn(p, end, "-----BEGIN ", 11);
+        if (label == NULL) {
+            break;
+        }
+
+        label += 11;
+
+        p = nxt_memstrn(label, end, "-----", 5);
+        if (p == NULL) {
+            break;
+        }
+
+        if (p - label == 11 && nxt_memcmp(label, "CERTIFICATE", 11) == 0) {
+            chain++;
+
+        } else if (p - label >= 11
+                   && nxt_memcmp(p - 11, "PRIVATE KEY", 11) == 0)
+        {
+            key.length = p - label;
+            key.start = label;
+        }
+
+        p += 5;
+    }
+
+    object = nxt_conf_create_object(mp, 2);
+    if (nxt_slow_path(object == NULL)) {
+        return NULL;
+    }
+
+    nxt_conf_set_member_integer(object, &chain_str, chain, 0);
+    nxt_conf_set_member_string(object, &key_str, &key, 1);
+
+    return object;
+}
+
+
 static void
 nxt_controller_conf_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg,
     void *data)
@@ -971,15 +1209,6 @@ nxt_controller_response(nxt_task_t *task, nxt_controller_request_t *req,
     static nxt_str_t  line_str = nxt_string("line");
     static nxt_str_t  column_str = nxt_string("column");
 
-    static nxt_time_string_t  date_cache = {
-        (nxt_atomic_uint_t) -1,
-        nxt_controller_date,
-        "%s, %02d %s %4d %02d:%02d:%02d GMT",
-        sizeof("Wed, 31 Dec 1986 16:40:00 GMT") - 1,
-        NXT_THREAD_TIME_GMT,
-        NXT_THREAD_TIME_SEC,
-    };
-
     switch (resp->status) {
 
     case 200:
@@ -1059,11 +1288,7 @@ nxt_controller_response(nxt_task_t *task, nxt_controller_request_t *req,
         }
     }
 
-    nxt_memzero(&pretty, sizeof(nxt_conf_json_pretty_t));
-
-    size = nxt_conf_json_length(value, &pretty) + 2;
-
-    body = nxt_buf_mem_alloc(c->mem_pool, size, 0);
+    body = nxt_buf_mem_alloc(c->mem_pool, 0, 0);
     if (nxt_slow_path(body == NULL)) {
         nxt_controller_conn_close(task, c, req);
         return;
@@ -1071,13 +1296,18 @@ nxt_controller_response(nxt_task_t *task, nxt_controller_request_t *req,
 
     nxt_memzero(&pretty, sizeof(nxt_conf_json_pretty_t));
 
-    body->mem.free = nxt_conf_json_print(body->mem.free, value, &pretty);
+    if (nxt_slow_path(nxt_conf_json_dump(c->mem_pool, &body->mem, value,
+                                         &pretty, 2)
+                      != NXT_OK))
+    {
+        nxt_controller_conn_close(task, c, req);
+        return;
+    }
 
     body->mem.free = nxt_cpymem(body->mem.free, "\r\n", 2);
 
     size = sizeof("HTTP/1.1 " "\r\n") - 1 + status_line.length
-           + sizeof("Server: unit/" NXT_VERSION "\r\n") - 1
-           + sizeof("Date: Wed, 31 Dec 1986 16:40:00 GMT\r\n") - 1
+           + NXT_HTTP_FIELDS_LEN
            + sizeof("Content-Type: application/json\r\n") - 1
            + sizeof("Content-Length: " "\r\n") - 1 + NXT_SIZE_T_LEN
            + sizeof("Connection: close\r\n") - 1
@@ -1097,17 +1327,11 @@ nxt_controller_response(nxt_task_t *task, nxt_controller_request_t *req,
     b->mem.free = nxt_cpymem(b->mem.free, status_line.start,
                              status_line.length);
 
-    nxt_str_set(&str, "\r\n"
-                      "Server: unit/" NXT_VERSION "\r\n"
-                      "Date: ");
-
-    b->mem.free = nxt_cpymem(b->mem.free, str.start, str.length);
+    b->mem.free = nxt_cpymem(b->mem.free, "\r\n", 2);
 
-    b->mem.free = nxt_thread_time_string(task->thread, &date_cache,
-                                         b->mem.free);
+    b->mem.free = nxt_http_fields_add(task, b->mem.free, NXT_HTTP_FIELDS);
 
-    nxt_str_set(&str, "\r\n"
-                      "Content-Type: application/json\r\n"
+    nxt_str_set(&str, "Content-Type: application/json\r\n"
                       "Content-Length: ");
 
     b->mem.free = nxt_cpymem(b->mem.free, str.start, str.length);
@@ -1126,20 +1350,3 @@ nxt_controller_response(nxt_task_t *task, nxt_controller_request_t *req,
 
     nxt_conn_write(task->thread->engine, c);
 }
-
-
-static u_char *
-nxt_controller_date(u_char *buf, nxt_realtime_t *now, struct tm *tm,
-    size_t size, const char *format)
-{
-    static const char  *week[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri",
-                                   "Sat" };
-
-    static const char  *month[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
-                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
-
-    return nxt_sprintf(buf, buf + size, format,
-                       week[tm->tm_wday], tm->tm_mday,
-                       month[tm->tm_mon], tm->tm_year + 1900,
-                       tm->tm_hour, tm->tm_min, tm->tm_sec);
-}
@@ -140,7 +140,7 @@ nxt_event_conn_job_sendfile_handler(nxt_task_t *task, void *obj, void *data)
 
     } while (c->socket.write_ready);
 
-    if (first && task->thread->thread_pool->work_queue.head != NULL) {
+    if (first && nxt_thread_pool_has_works(jbs->job.thread_pool)) {
         goto fast;
     }
 
@@ -154,7 +154,7 @@ fast:
     nxt_work_set(&jbs->job.work, nxt_event_conn_job_sendfile_handler,
                  jbs->job.task, jbs, c);
 
-    nxt_thread_pool_post(task->thread->thread_pool, &jbs->job.work);
+    nxt_thread_pool_post(jbs->job.thread_pool, &jbs->job.work);
 }
 
 
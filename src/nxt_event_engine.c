@@ -232,9 +232,38 @@ nxt_event_engine_post(nxt_event_engine_t *engine, nxt_work_t *work)
 {
     nxt_debug(&engine->task, "event engine post");
 
-    nxt_locked_work_queue_add(&engine->locked_work_queue, work);
+    /*
+     * The engine moves all posted works at once, so a wakeup is required
+     * only for the first work in the queue and only if the engine sleeps.
+     * The full barrier of the atomic add pairs with the one in
+     * nxt_event_engine_start(): either the engine sees the work before
+     * sleeping or the posting thread sees the sleeping flag.
+     */
 
-    nxt_event_engine_signal(engine, 0);
+    if (nxt_atomic_work_queue_add(&engine->post_work_queue, work)
+        && engine->sleeping)
+    {
+        nxt_event_engine_signal(engine, 0);
+    }
+}
+
+
+/*
+ * Post a list of works linked from the last work to the first one
+ * with a single atomic operation and at most one wakeup.
+ */
+
+void
+nxt_event_engine_post_list(nxt_event_engine_t *engine, nxt_work_t *head,
+    nxt_work_t *tail)
+{
+    nxt_debug(&engine->task, "event engine post list");
+
+    if (nxt_atomic_work_queue_add_list(&engine->post_work_queue, head, tail)
+        && engine->sleeping)
+    {
+        nxt_event_engine_signal(engine, 0);
+    }
 }
 
 
@@ -310,7 +339,7 @@ nxt_event_engine_post_handler(nxt_task_t *task, void *obj, void *data)
     thread = task->thread;
     engine = thread->engine;
 
-    nxt_locked_work_queue_move(thread, &engine->locked_work_queue,
+    nxt_atomic_work_queue_move(thread, &engine->post_work_queue,
                                &engine->fast_work_queue);
 }
 
@@ -431,6 +460,10 @@ nxt_event_engine_free(nxt_event_engine_t *engine)
 
     engine->event.free(engine);
 
+    if (engine->requests != NULL) {
+        nxt_free(engine->requests);
+    }
+
     /* TODO: free timers */
 
     nxt_free(engine);
@@ -517,12 +550,28 @@ nxt_event_engine_start(nxt_event_engine_t *engine)
             handler(task, obj, data);
         }
 
+        if (engine->thread_pool_batch.head != NULL) {
+            nxt_thread_pool_batch_post(&engine->thread_pool_batch);
+        }
+
         /* Attach some event engine work queues in preferred order. */
 
         timeout = nxt_timer_find(engine);
 
+        (void) nxt_atomic_cmp_set(&engine->sleeping, 0, 1);
+
+        if (!nxt_atomic_work_queue_is_empty(&engine->post_work_queue)) {
+            engine->sleeping = 0;
+
+            nxt_atomic_work_queue_move(thr, &engine->post_work_queue,
+                                       &engine->fast_work_queue);
+            timeout = 0;
+        }
+
         engine->event.poll(engine, timeout);
 
+        engine->sleeping = 0;
+
         now = nxt_thread_monotonic_time(thr) / 1000000;
 
         nxt_timer_expire(engine, now);
@@ -531,58 +580,97 @@ nxt_event_engine_start(nxt_event_engine_t *engine)
 
 
 static nxt_int_t
-nxt_req_conn_test(nxt_lvlhsh_query_t *lhq, void *data)
+nxt_event_engine_requests_grow(nxt_event_engine_t *engine)
 {
+    uint32_t        i, size;
+    nxt_req_slot_t  *slots;
+
+    size = (engine->requests_size != 0) ? engine->requests_size * 2 : 64;
+
+    if (nxt_slow_path(size > NXT_REQ_ID_INDEX_MASK + 1)) {
+        return NXT_ERROR;
+    }
+
+    slots = nxt_realloc(engine->requests, size * sizeof(nxt_req_slot_t));
+    if (nxt_slow_path(slots == NULL)) {
+        return NXT_ERROR;
+    }
+
+    /* The new slots are added to the free list in the index order. */
+
+    for (i = engine->requests_size; i < size; i++) {
+        slots[i].rc = NULL;
+        slots[i].generation = 1;
+        slots[i].next = i + 1;
+    }
+
+    if (engine->requests_free != 0) {
+        slots[engine->requests_tail].next = engine->requests_size;
+
+    } else {
+        engine->requests_head = engine->requests_size;
+    }
+
+    engine->requests_tail = size - 1;
+    engine->requests_free += size - engine->requests_size;
+
+    engine->requests = slots;
+    engine->requests_size = size;
+
     return NXT_OK;
 }
 
-static const nxt_lvlhsh_proto_t  lvlhsh_req_conn_proto  nxt_aligned(64) = {
-    NXT_LVLHSH_DEFAULT,
-    nxt_req_conn_test,
-    nxt_lvlhsh_alloc,
-    nxt_lvlhsh_free,
-};
 
+/*
+ * The request is given an id of the first free slot.  The freed slots
+ * are added to the tail of the free list, so a slot is reused as late
+ * as possible and its generation does not wrap around quickly.
+ */
 
-void
+nxt_int_t
 nxt_event_engine_request_add(nxt_event_engine_t *engine,
     nxt_req_conn_link_t *rc)
 {
-    nxt_lvlhsh_query_t  lhq;
+    uint32_t        i;
+    nxt_req_slot_t  *slot;
 
-    lhq.key_hash = nxt_murmur_hash2(&rc->req_id, sizeof(rc->req_id));
-    lhq.key.length = sizeof(rc->req_id);
-    lhq.key.start = (u_char *) &rc->req_id;
-    lhq.proto = &lvlhsh_req_conn_proto;
-    lhq.replace = 0;
-    lhq.value = rc;
-    lhq.pool = engine->mem_pool;
+    if (engine->requests_free == 0) {
+        if (nxt_slow_path(nxt_event_engine_requests_grow(engine) != NXT_OK)) {
+            nxt_thread_log_error(NXT_LOG_WARN, "req to conn add failed");
+            return NXT_ERROR;
+        }
+    }
 
-    switch (nxt_lvlhsh_insert(&engine->requests, &lhq)) {
+    i = engine->requests_head;
+    slot = &engine->requests[i];
 
-    case NXT_OK:
-        break;
+    engine->requests_head = slot->next;
+    engine->requests_free--;
 
-    default:
-        nxt_thread_log_error(NXT_LOG_WARN, "req %08uxD to conn add failed",
-                             rc->req_id);
-        break;
-    }
+    slot->rc = rc;
+    rc->req_id = (slot->generation << NXT_REQ_ID_GEN_SHIFT)
+                 | ((engine->id & NXT_REQ_ID_ENGINE_MASK)
+                    << NXT_REQ_ID_INDEX_BITS)
+                 | i;
+
+    return NXT_OK;
 }
 
 
 nxt_req_conn_link_t *
 nxt_event_engine_request_find(nxt_event_engine_t *engine, nxt_req_id_t req_id)
 {
-    nxt_lvlhsh_query_t  lhq;
+    uint32_t             i;
+    nxt_req_conn_link_t  *rc;
+
+    i = req_id & NXT_REQ_ID_INDEX_MASK;
 
-    lhq.key_hash = nxt_murmur_hash2(&req_id, sizeof(req_id));
-    lhq.key.length = sizeof(req_id);
-    lhq.key.start = (u_char *) &req_id;
-    lhq.proto = &lvlhsh_req_conn_proto;
+    if (nxt_fast_path(i < engine->requests_size)) {
+        rc = engine->requests[i].rc;
 
-    if (nxt_lvlhsh_find(&engine->requests, &lhq) == NXT_OK) {
-        return lhq.value;
+        if (rc != NULL && rc->req_id == req_id) {
+            return rc;
+        }
     }
 
     return NULL;
@@ -593,24 +681,38 @@ void
 nxt_event_engine_request_remove(nxt_event_engine_t *engine,
     nxt_req_conn_link_t *rc)
 {
-    nxt_lvlhsh_query_t  lhq;
-
-    lhq.key_hash = nxt_murmur_hash2(&rc->req_id, sizeof(rc->req_id));
-    lhq.key.length = sizeof(rc->req_id);
-    lhq.key.start = (u_char *) &rc->req_id;
-    lhq.proto = &lvlhsh_req_conn_proto;
-    lhq.pool = engine->mem_pool;
-
-    switch (nxt_lvlhsh_delete(&engine->requests, &lhq)) {
+    uint32_t        i, generation;
+    nxt_req_slot_t  *slot;
 
-    case NXT_OK:
-        break;
+    i = rc->req_id & NXT_REQ_ID_INDEX_MASK;
 
-    default:
+    if (nxt_slow_path(i >= engine->requests_size
+                      || engine->requests[i].rc != rc))
+    {
         nxt_thread_log_error(NXT_LOG_WARN, "req %08uxD to conn remove failed",
                              rc->req_id);
-        break;
+        return;
     }
+
+    slot = &engine->requests[i];
+    slot->rc = NULL;
+
+    /* The zero generation is skipped, so request ids are never zero. */
+
+    generation = (slot->generation + 1)
+                 & (0xFFFFFFFF >> NXT_REQ_ID_GEN_SHIFT);
+
+    slot->generation = (generation != 0) ? generation : 1;
+
+    if (engine->requests_free != 0) {
+        engine->requests[engine->requests_tail].next = i;
+
+    } else {
+        engine->requests_head = i;
+    }
+
+    engine->requests_tail = i;
+    engine->requests_free++;
 }
 
 
@@ -618,25 +720,18 @@ nxt_req_conn_link_t *
 nxt_event_engine_request_find_remove(nxt_event_engine_t *engine,
     nxt_req_id_t req_id)
 {
-    nxt_lvlhsh_query_t  lhq;
+    nxt_req_conn_link_t  *rc;
 
-    lhq.key_hash = nxt_murmur_hash2(&req_id, sizeof(req_id));
-    lhq.key.length = sizeof(req_id);
-    lhq.key.start = (u_char *) &req_id;
-    lhq.proto = &lvlhsh_req_conn_proto;
-    lhq.pool = engine->mem_pool;
+    rc = nxt_event_engine_request_find(engine, req_id);
 
-    switch (nxt_lvlhsh_delete(&engine->requests, &lhq)) {
-
-    case NXT_OK:
-        return lhq.value;
-
-    default:
-        nxt_thread_log_error(NXT_LOG_WARN, "req %08uxD to conn remove failed",
-                             req_id);
-        break;
+    if (nxt_fast_path(rc != NULL)) {
+        nxt_event_engine_request_remove(engine, rc);
+        return rc;
     }
 
+    nxt_thread_log_error(NXT_LOG_WARN, "req %08uxD to conn remove failed",
+                         req_id);
+
     return NULL;
 }
 
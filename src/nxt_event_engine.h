@@ -426,6 +426,30 @@ typedef struct {
 } nxt_event_engine_pipe_t;
 
 
+/*
+ * A request id is an index of a request table slot in the low
+ * NXT_REQ_ID_INDEX_BITS bits, the engine id in the next NXT_REQ_ID_ENGINE_BITS
+ * bits, and a generation of the slot in the high bits.  Application workers
+ * look up requests of all router threads by id alone, so ids of different
+ * engines must not overlap.  The generation is changed each time the slot
+ * is freed, so stale ids of completed requests do not match the slot.
+ */
+
+#define NXT_REQ_ID_INDEX_BITS   17
+#define NXT_REQ_ID_INDEX_MASK   ((1 << NXT_REQ_ID_INDEX_BITS) - 1)
+#define NXT_REQ_ID_ENGINE_BITS  6
+#define NXT_REQ_ID_ENGINE_MASK  ((1 << NXT_REQ_ID_ENGINE_BITS) - 1)
+#define NXT_REQ_ID_GEN_SHIFT    (NXT_REQ_ID_INDEX_BITS + NXT_REQ_ID_ENGINE_BITS)
+
+
+typedef struct {
+    nxt_req_conn_link_t        *rc;
+    uint32_t                   generation;
+    /* The next free slot index. */
+    uint32_t                   next;
+} nxt_req_slot_t;
+
+
 struct nxt_event_engine_s {
     nxt_task_t                 task;
 
@@ -463,7 +487,16 @@ struct nxt_event_engine_s {
     nxt_work_queue_t           shutdown_work_queue;
     nxt_work_queue_t           close_work_queue;
 
-    nxt_locked_work_queue_t    locked_work_queue;
+    nxt_atomic_work_queue_t    post_work_queue;
+
+    /*
+     * The flag is set while the engine may block in poll, only then
+     * posting threads have to wake it up.
+     */
+    nxt_atomic_t               sleeping;
+
+    /* Works posted to a thread pool when the engine runs out of works. */
+    nxt_thread_pool_batch_t    thread_pool_batch;
 
     nxt_event_interface_t      event;
 
@@ -491,7 +524,14 @@ struct nxt_event_engine_s {
     nxt_queue_t                joints;
     nxt_queue_t                listen_connections;
     nxt_queue_t                idle_connections;
-    nxt_lvlhsh_t               requests; /* req_id to nxt_req_conn_link_t */
+    /* req_id to nxt_req_conn_link_t */
+    nxt_req_slot_t             *requests;
+    uint32_t                   requests_size;
+    uint32_t                   requests_free;
+    uint32_t                   requests_head;
+    uint32_t                   requests_tail;
+
+    nxt_http_date_cache_t      http_date;
 
     nxt_queue_link_t           link;
     // STUB: router link
@@ -509,10 +549,12 @@ NXT_EXPORT void nxt_event_engine_start(nxt_event_engine_t *engine);
 
 NXT_EXPORT void nxt_event_engine_post(nxt_event_engine_t *engine,
     nxt_work_t *work);
+NXT_EXPORT void nxt_event_engine_post_list(nxt_event_engine_t *engine,
+    nxt_work_t *head, nxt_work_t *tail);
 NXT_EXPORT void nxt_event_engine_signal(nxt_event_engine_t *engine,
     nxt_uint_t signo);
 
-NXT_EXPORT void nxt_event_engine_request_add(nxt_event_engine_t *engine,
+NXT_EXPORT nxt_int_t nxt_event_engine_request_add(nxt_event_engine_t *engine,
     nxt_req_conn_link_t *rc);
 NXT_EXPORT nxt_req_conn_link_t *nxt_event_engine_request_find(
     nxt_event_engine_t *engine, nxt_req_id_t req_id);
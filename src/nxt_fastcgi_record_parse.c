@@ -208,9 +208,8 @@ nxt_fastcgi_record_parse(nxt_task_t *task, nxt_fastcgi_parse_t *fp,
 
         if (b->retain == 0) {
             /* No record data was found in a buffer. */
-            nxt_thread_current_work_queue_add(task->thread,
-                                              b->completion_handler,
-                                              task, b, b->parent);
+            nxt_work_queue_add(&task->thread->engine->fast_work_queue,
+                               b->completion_handler, task, b, b->parent);
         }
 
     next:
@@ -0,0 +1,415 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+
+#if (NXT_HAVE_SSE2)
+#include <emmintrin.h>
+#endif
+
+
+/*
+ * The flat hash consists of an array of control bytes and an array of
+ * entries, both have the same number of slots which is a power of 2.
+ * A control byte is either EMPTY, DELETED, or the low 7 bits of the key
+ * hash of the entry in the slot.  The slots are probed by groups of 16
+ * control bytes which are compared with the hash bits at once, so most
+ * lookups test only one entry and read two cache lines.  The high hash
+ * bits select the first group, the next groups are probed with triangular
+ * steps which visit all groups.  A probe stops at a group with an EMPTY
+ * control byte.
+ *
+ * An entry consists of a pointer to value data and the 32-bit key hash
+ * which is used to skip most of false control byte matches and to rehash
+ * entries without calling the test function.  At most 7/8 of slots may
+ * be used, so there are always EMPTY slots to stop a probe.
+ */
+
+#define NXT_FLATHSH_GROUP    16
+
+#define NXT_FLATHSH_EMPTY    0x80
+#define NXT_FLATHSH_DELETED  0xfe
+
+
+#define                                                                       \
+nxt_flathsh_h1(key_hash)                                                      \
+    ((key_hash) >> 7)
+
+
+#define                                                                       \
+nxt_flathsh_h2(key_hash)                                                      \
+    ((key_hash) & 0x7f)
+
+
+#define                                                                       \
+nxt_flathsh_is_full(c)                                                        \
+    ((c) < NXT_FLATHSH_EMPTY)
+
+
+#define                                                                       \
+nxt_flathsh_max_items(size)                                                   \
+    ((size) / 8 * 7)
+
+
+typedef struct {
+    void                      *value;
+    uint32_t                  key_hash;
+} nxt_flathsh_entry_t;
+
+
+static nxt_flathsh_entry_t *nxt_flathsh_lookup(nxt_flathsh_t *fh,
+    nxt_lvlhsh_query_t *lhq);
+static uint32_t nxt_flathsh_free_slot(nxt_flathsh_t *fh, uint32_t key_hash);
+static nxt_int_t nxt_flathsh_resize(nxt_flathsh_t *fh,
+    nxt_lvlhsh_query_t *lhq);
+
+
+#if (NXT_HAVE_SSE2)
+
+nxt_inline uint32_t
+nxt_flathsh_match(const uint8_t *ctrl, uint8_t c)
+{
+    __m128i  group;
+
+    group = _mm_loadu_si128((const __m128i *) ctrl);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char) c)));
+}
+
+
+/* EMPTY and DELETED control bytes have the high bit set. */
+
+nxt_inline uint32_t
+nxt_flathsh_match_free(const uint8_t *ctrl)
+{
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *) ctrl));
+}
+
+#else
+
+nxt_inline uint32_t
+nxt_flathsh_match(const uint8_t *ctrl, uint8_t c)
+{
+    uint32_t    match;
+    nxt_uint_t  i;
+
+    match = 0;
+
+    for (i = 0; i < NXT_FLATHSH_GROUP; i++) {
+        match |= (uint32_t) (ctrl[i] == c) << i;
+    }
+
+    return match;
+}
+
+
+nxt_inline uint32_t
+nxt_flathsh_match_free(const uint8_t *ctrl)
+{
+    uint32_t    match;
+    nxt_uint_t  i;
+
+    match = 0;
+
+    for (i = 0; i < NXT_FLATHSH_GROUP; i++) {
+        match |= (uint32_t) (ctrl[i] >> 7) << i;
+    }
+
+    return match;
+}
+
+#endif
+
+
+nxt_inline nxt_uint_t
+nxt_flathsh_first(uint32_t match)
+{
+#if (NXT_HAVE_BUILTIN_CTZ)
+
+    return __builtin_ctz(match);
+
+#else
+
+    nxt_uint_t  n;
+
+    for (n = 0; (match & 1) == 0; n++) {
+        match >>= 1;
+    }
+
+    return n;
+
+#endif
+}
+
+
+nxt_int_t
+nxt_flathsh_find(nxt_flathsh_t *fh, nxt_lvlhsh_query_t *lhq)
+{
+    nxt_flathsh_entry_t  *e;
+
+    e = nxt_flathsh_lookup(fh, lhq);
+
+    if (e != NULL) {
+        lhq->value = e->value;
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static nxt_flathsh_entry_t *
+nxt_flathsh_lookup(nxt_flathsh_t *fh, nxt_lvlhsh_query_t *lhq)
+{
+    uint8_t              *ctrl, h2;
+    uint32_t             pos, step, match;
+    nxt_flathsh_entry_t  *entries, *e;
+
+    ctrl = fh->ctrl;
+
+    if (ctrl == NULL) {
+        return NULL;
+    }
+
+    entries = fh->entries;
+    h2 = nxt_flathsh_h2(lhq->key_hash);
+
+    pos = (nxt_flathsh_h1(lhq->key_hash) * NXT_FLATHSH_GROUP) & fh->mask;
+    step = 0;
+
+    for ( ;; ) {
+        match = nxt_flathsh_match(&ctrl[pos], h2);
+
+        while (match != 0) {
+            e = &entries[pos + nxt_flathsh_first(match)];
+
+            if (e->key_hash == lhq->key_hash
+                && lhq->proto->test(lhq, e->value) == NXT_OK)
+            {
+                return e;
+            }
+
+            match &= match - 1;
+        }
+
+        if (nxt_flathsh_match(&ctrl[pos], NXT_FLATHSH_EMPTY) != 0) {
+            return NULL;
+        }
+
+        step += NXT_FLATHSH_GROUP;
+        pos = (pos + step) & fh->mask;
+    }
+}
+
+
+nxt_int_t
+nxt_flathsh_insert(nxt_flathsh_t *fh, nxt_lvlhsh_query_t *lhq)
+{
+    void                 *old;
+    uint32_t             i;
+    nxt_flathsh_entry_t  *e;
+
+    e = nxt_flathsh_lookup(fh, lhq);
+
+    if (e != NULL) {
+        old = e->value;
+
+        if (!lhq->replace) {
+            lhq->value = old;
+            return NXT_DECLINED;
+        }
+
+        e->value = lhq->value;
+        lhq->value = old;
+
+        return NXT_OK;
+    }
+
+    if (fh->growth == 0) {
+        if (nxt_slow_path(nxt_flathsh_resize(fh, lhq) != NXT_OK)) {
+            return NXT_ERROR;
+        }
+    }
+
+    i = nxt_flathsh_free_slot(fh, lhq->key_hash);
+
+    if (fh->ctrl[i] == NXT_FLATHSH_EMPTY) {
+        fh->growth--;
+    }
+
+    fh->ctrl[i] = nxt_flathsh_h2(lhq->key_hash);
+
+    e = &((nxt_flathsh_entry_t *) fh->entries)[i];
+    e->value = lhq->value;
+    e->key_hash = lhq->key_hash;
+
+    fh->items++;
+
+    return NXT_OK;
+}
+
+
+static uint32_t
+nxt_flathsh_free_slot(nxt_flathsh_t *fh, uint32_t key_hash)
+{
+    uint32_t  pos, step, match;
+
+    pos = (nxt_flathsh_h1(key_hash) * NXT_FLATHSH_GROUP) & fh->mask;
+    step = 0;
+
+    for ( ;; ) {
+        match = nxt_flathsh_match_free(&fh->ctrl[pos]);
+
+        if (match != 0) {
+            return pos + nxt_flathsh_first(match);
+        }
+
+        step += NXT_FLATHSH_GROUP;
+        pos = (pos + step) & fh->mask;
+    }
+}
+
+
+/*
+ * The table is doubled if more than half of the new table would be used,
+ * otherwise it is rehashed in place of the same size to drop DELETED slots.
+ */
+
+static nxt_int_t
+nxt_flathsh_resize(nxt_flathsh_t *fh, nxt_lvlhsh_query_t *lhq)
+{
+    uint8_t                   *ctrl;
+    uint32_t                  i, j, size;
+    nxt_flathsh_t             old;
+    nxt_flathsh_entry_t       *entries, *e;
+    const nxt_lvlhsh_proto_t  *proto;
+
+    proto = lhq->proto;
+
+    size = NXT_FLATHSH_GROUP;
+
+    while (nxt_flathsh_max_items(size) < 2 * fh->items) {
+        size *= 2;
+
+        if (nxt_slow_path(size == 0)) {
+            return NXT_ERROR;
+        }
+    }
+
+    ctrl = proto->alloc(lhq->pool, size);
+    if (nxt_slow_path(ctrl == NULL)) {
+        return NXT_ERROR;
+    }
+
+    entries = proto->alloc(lhq->pool, size * sizeof(nxt_flathsh_entry_t));
+    if (nxt_slow_path(entries == NULL)) {
+        proto->free(lhq->pool, ctrl);
+        return NXT_ERROR;
+    }
+
+    nxt_memset(ctrl, NXT_FLATHSH_EMPTY, size);
+
+    old = *fh;
+
+    fh->ctrl = ctrl;
+    fh->entries = entries;
+    fh->mask = size - 1;
+    fh->growth = nxt_flathsh_max_items(size) - old.items;
+
+    if (old.ctrl == NULL) {
+        return NXT_OK;
+    }
+
+    e = old.entries;
+
+    for (i = 0; i <= old.mask; i++) {
+
+        if (nxt_flathsh_is_full(old.ctrl[i])) {
+            j = nxt_flathsh_free_slot(fh, e[i].key_hash);
+
+            ctrl[j] = old.ctrl[i];
+            entries[j] = e[i];
+        }
+    }
+
+    proto->free(lhq->pool, old.entries);
+    proto->free(lhq->pool, old.ctrl);
+
+    return NXT_OK;
+}
+
+
+nxt_int_t
+nxt_flathsh_delete(nxt_flathsh_t *fh, nxt_lvlhsh_query_t *lhq)
+{
+    uint32_t                  i, group;
+    nxt_flathsh_entry_t       *e;
+    const nxt_lvlhsh_proto_t  *proto;
+
+    e = nxt_flathsh_lookup(fh, lhq);
+
+    if (e == NULL) {
+        return NXT_DECLINED;
+    }
+
+    lhq->value = e->value;
+
+    fh->items--;
+
+    if (fh->items == 0) {
+        proto = lhq->proto;
+
+        proto->free(lhq->pool, fh->entries);
+        proto->free(lhq->pool, fh->ctrl);
+
+        nxt_flathsh_init(fh);
+
+        return NXT_OK;
+    }
+
+    i = e - (nxt_flathsh_entry_t *) fh->entries;
+    group = i & ~(NXT_FLATHSH_GROUP - 1);
+
+    /*
+     * A probe has never passed a group which has an EMPTY slot,
+     * so the slot can be marked EMPTY instead of DELETED.
+     */
+
+    if (nxt_flathsh_match(&fh->ctrl[group], NXT_FLATHSH_EMPTY) != 0) {
+        fh->ctrl[i] = NXT_FLATHSH_EMPTY;
+        fh->growth++;
+
+    } else {
+        fh->ctrl[i] = NXT_FLATHSH_DELETED;
+    }
+
+    return NXT_OK;
+}
+
+
+void *
+nxt_flathsh_each(nxt_flathsh_t *fh, nxt_flathsh_each_t *fe)
+{
+    uint32_t             i;
+    nxt_flathsh_entry_t  *entries;
+
+    if (fh->ctrl == NULL) {
+        return NULL;
+    }
+
+    entries = fh->entries;
+
+    for (i = fe->current; i <= fh->mask; i++) {
+
+        if (nxt_flathsh_is_full(fh->ctrl[i])) {
+            fe->current = i + 1;
+            return entries[i].value;
+        }
+    }
+
+    fe->current = i;
+
+    return NULL;
+}
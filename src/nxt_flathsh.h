@@ -0,0 +1,64 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NXT_FLAT_HASH_H_INCLUDED_
+#define _NXT_FLAT_HASH_H_INCLUDED_
+
+
+/*
+ * The flat hash is an open addressing hash table with the same query
+ * and proto interface as lvlhsh, so a lvlhsh user can switch to it by
+ * changing the hash type and the function names.  The proto bucket size
+ * and level shifts are not used, the proto alloc() function is called with
+ * power of 2 sizes as for lvlhsh.
+ */
+
+typedef struct {
+    uint8_t                   *ctrl;
+    void                      *entries;
+
+    /* The number of slots minus one, the number of slots is a power of 2. */
+    uint32_t                  mask;
+    uint32_t                  items;
+    /* The number of empty slots which can be used without rehashing. */
+    uint32_t                  growth;
+} nxt_flathsh_t;
+
+
+typedef struct {
+    uint32_t                  current;
+} nxt_flathsh_each_t;
+
+
+#define                                                                       \
+nxt_flathsh_is_empty(fh)                                                      \
+    ((fh)->items == 0)
+
+
+#define                                                                       \
+nxt_flathsh_init(fh)                                                          \
+    nxt_memzero(fh, sizeof(nxt_flathsh_t))
+
+
+/*
+ * The functions have the same semantics and the required nxt_lvlhsh_query_t
+ * fields as nxt_lvlhsh_find(), nxt_lvlhsh_insert(), and nxt_lvlhsh_delete().
+ * The table memory is freed when the last element is deleted.
+ */
+NXT_EXPORT nxt_int_t nxt_flathsh_find(nxt_flathsh_t *fh,
+    nxt_lvlhsh_query_t *lhq);
+NXT_EXPORT nxt_int_t nxt_flathsh_insert(nxt_flathsh_t *fh,
+    nxt_lvlhsh_query_t *lhq);
+NXT_EXPORT nxt_int_t nxt_flathsh_delete(nxt_flathsh_t *fh,
+    nxt_lvlhsh_query_t *lhq);
+
+/*
+ * The each iterator must be zeroed before the first call,
+ * the hash must not be changed during iteration.
+ */
+NXT_EXPORT void *nxt_flathsh_each(nxt_flathsh_t *fh, nxt_flathsh_each_t *fe);
+
+
+#endif /* _NXT_FLAT_HASH_H_INCLUDED_ */
@@ -7,257 +7,242 @@
 #include <nxt_main.h>
 
 
-#define NXT_HTTP_CHUNK_MIDDLE         0
-#define NXT_HTTP_CHUNK_END_ON_BORDER  1
-#define NXT_HTTP_CHUNK_END            2
-
-
 #define                                                                       \
 nxt_size_is_sufficient(cs)                                                    \
     (cs < ((__typeof__(cs)) 1 << (sizeof(cs) * 8 - 4)))
 
 
-static nxt_int_t nxt_http_chunk_buffer(nxt_http_chunk_parse_t *hcp,
-    nxt_buf_t ***tail, nxt_buf_t *in);
+enum {
+    sw_start = 0,
+    sw_chunk_size,
+    sw_chunk_extension,
+    sw_chunk_size_linefeed,
+    sw_chunk_end_newline,
+    sw_chunk_end_linefeed,
+    sw_trailer_start,
+    sw_trailer,
+    sw_trailer_linefeed,
+    sw_chunk,
+};
+
 
+/*
+ * The chunked body is decoded in place: the data between hcp->pos and
+ * mem->free is the new input, the decoded chunk data are moved to
+ * hcp->pos and mem->free is set to the end of the decoded data.
+ * So the buffer always contains only decoded data, and the next read
+ * appends new input right after them.
+ *
+ * When the last chunk has been parsed, the decoded data end at hcp->pos
+ * and the data read after the body, e.g. a pipelined request, are moved
+ * right after them up to mem->free.  It is up to the caller to use or
+ * to drop them.
+ */
 
-nxt_buf_t *
+nxt_int_t
 nxt_http_chunk_parse(nxt_task_t *task, nxt_http_chunk_parse_t *hcp,
-    nxt_buf_t *in)
+    nxt_buf_mem_t *mem)
 {
-    u_char        c, ch;
-    nxt_int_t     ret;
-    nxt_buf_t     *b, *out, *nb, **tail;
-    enum {
-        sw_start = 0,
-        sw_chunk_size,
-        sw_chunk_size_linefeed,
-        sw_chunk_end_newline,
-        sw_chunk_end_linefeed,
-        sw_chunk,
-    } state;
-
-    out = NULL;
-    tail = &out;
+    u_char      c, ch, *p, *end, *out;
+    size_t      size;
+    nxt_uint_t  state;
 
-    state = hcp->state;
+    p = hcp->pos;
+    end = mem->free;
+    out = p;
 
-    for (b = in; b != NULL; b = b->next) {
+    state = hcp->state;
 
-        hcp->pos = b->mem.pos;
+    while (p < end) {
+        /*
+         * The sw_chunk state is tested outside the switch
+         * to copy the chunk data at once.
+         */
+        if (state == sw_chunk) {
+            size = nxt_min((uint64_t) (end - p), hcp->chunk_size);
 
-        while (hcp->pos < b->mem.free) {
-            /*
-             * The sw_chunk state is tested outside the switch
-             * to preserve hcp->pos and to not touch memory.
-             */
-            if (state == sw_chunk) {
-                ret = nxt_http_chunk_buffer(hcp, &tail, b);
+            if (out != p) {
+                nxt_memmove(out, p, size);
+            }
 
-                if (ret == NXT_HTTP_CHUNK_MIDDLE) {
-                    goto next;
-                }
+            out += size;
+            p += size;
 
-                if (nxt_slow_path(ret == NXT_ERROR)) {
-                    hcp->error = 1;
-                    goto done;
-                }
+            hcp->chunk_size -= size;
 
+            if (hcp->chunk_size == 0) {
                 state = sw_chunk_end_newline;
+            }
 
-                if (ret == NXT_HTTP_CHUNK_END_ON_BORDER) {
-                    goto next;
-                }
+            continue;
+        }
+
+        ch = *p++;
 
-                /* ret == NXT_HTTP_CHUNK_END_ON_BORDER */
+        switch (state) {
+
+        case sw_start:
+            state = sw_chunk_size;
+
+            c = ch - '0';
+
+            if (c <= 9) {
+                hcp->chunk_size = c;
+                continue;
             }
 
-            ch = *hcp->pos++;
+            c = (ch | 0x20) - 'a';
 
-            switch (state) {
+            if (c <= 5) {
+                hcp->chunk_size = 0x0a + c;
+                continue;
+            }
 
-            case sw_start:
-                state = sw_chunk_size;
+            goto chunk_error;
 
-                c = ch - '0';
+        case sw_chunk_size:
 
-                if (c <= 9) {
-                    hcp->chunk_size = c;
-                    continue;
-                }
+            c = ch - '0';
 
+            if (c > 9) {
                 c = (ch | 0x20) - 'a';
 
-                if (c <= 5) {
-                    hcp->chunk_size = 0x0a + c;
+                if (nxt_fast_path(c <= 5)) {
+                    c += 0x0a;
+
+                } else if (nxt_fast_path(ch == NXT_CR)) {
+                    state = sw_chunk_size_linefeed;
+                    continue;
+
+                } else if (ch == ';') {
+                    state = sw_chunk_extension;
                     continue;
+
+                } else {
+                    goto chunk_error;
                 }
+            }
 
-                goto chunk_error;
+            if (nxt_fast_path(nxt_size_is_sufficient(hcp->chunk_size))) {
+                hcp->chunk_size = (hcp->chunk_size << 4) + c;
+                continue;
+            }
 
-            case sw_chunk_size:
+            goto chunk_error;
 
-                c = ch - '0';
+        case sw_chunk_extension:
+            /* Chunk extensions are ignored. */
 
-                if (c > 9) {
-                    c = (ch | 0x20) - 'a';
+            if (ch == NXT_CR) {
+                state = sw_chunk_size_linefeed;
+                continue;
+            }
 
-                    if (nxt_fast_path(c <= 5)) {
-                        c += 0x0a;
+            if (nxt_slow_path(ch == NXT_LF)) {
+                goto chunk_error;
+            }
 
-                    } else if (nxt_fast_path(ch == NXT_CR)) {
-                        state = sw_chunk_size_linefeed;
-                        continue;
+            continue;
 
-                    } else {
-                        goto chunk_error;
-                    }
-                }
+        case sw_chunk_size_linefeed:
+            if (nxt_fast_path(ch == NXT_LF)) {
 
-                if (nxt_fast_path(nxt_size_is_sufficient(hcp->chunk_size))) {
-                    hcp->chunk_size = (hcp->chunk_size << 4) + c;
+                if (hcp->chunk_size != 0) {
+                    state = sw_chunk;
                     continue;
                 }
 
-                goto chunk_error;
+                hcp->last = 1;
+                state = sw_trailer_start;
+                continue;
+            }
 
-            case sw_chunk_size_linefeed:
-                if (nxt_fast_path(ch == NXT_LF)) {
+            goto chunk_error;
 
-                    if (hcp->chunk_size != 0) {
-                        state = sw_chunk;
-                        continue;
-                    }
+        case sw_chunk_end_newline:
+            if (nxt_fast_path(ch == NXT_CR)) {
+                state = sw_chunk_end_linefeed;
+                continue;
+            }
 
-                    hcp->last = 1;
-                    state = sw_chunk_end_newline;
-                    continue;
-                }
+            goto chunk_error;
 
-                goto chunk_error;
+        case sw_chunk_end_linefeed:
+            if (nxt_fast_path(ch == NXT_LF)) {
 
-            case sw_chunk_end_newline:
-                if (nxt_fast_path(ch == NXT_CR)) {
-                    state = sw_chunk_end_linefeed;
+                if (!hcp->last) {
+                    state = sw_start;
                     continue;
                 }
 
-                goto chunk_error;
+                goto done;
+            }
 
-            case sw_chunk_end_linefeed:
-                if (nxt_fast_path(ch == NXT_LF)) {
+            goto chunk_error;
 
-                    if (!hcp->last) {
-                        state = sw_start;
-                        continue;
-                    }
+        /*
+         * Trailer fields after the last chunk are skipped up to the empty
+         * line.  They are not copied, so the buffer does not grow.
+         */
 
-                    goto done;
-                }
+        case sw_trailer_start:
+            if (ch == NXT_CR) {
+                state = sw_chunk_end_linefeed;
+                continue;
+            }
 
+            if (nxt_slow_path(ch == NXT_LF)) {
                 goto chunk_error;
+            }
+
+            state = sw_trailer;
+            continue;
 
-            case sw_chunk:
-                /*
-                 * This state is processed before the switch.
-                 * It added here just to suppress a warning.
-                 */
+        case sw_trailer:
+            if (ch == NXT_CR) {
+                state = sw_trailer_linefeed;
                 continue;
             }
-        }
 
-        if (b->retain == 0) {
-            /* No chunk data was found in a buffer. */
-            nxt_thread_current_work_queue_add(task->thread,
-                                              b->completion_handler,
-                                              task, b, b->parent);
+            if (nxt_slow_path(ch == NXT_LF)) {
+                goto chunk_error;
+            }
 
-        }
+            continue;
 
-    next:
+        case sw_trailer_linefeed:
+            if (nxt_fast_path(ch == NXT_LF)) {
+                state = sw_trailer_start;
+                continue;
+            }
 
-        continue;
+            goto chunk_error;
+        }
     }
 
     hcp->state = state;
+    hcp->pos = out;
 
-    return out;
+    mem->free = out;
 
-chunk_error:
-
-    hcp->chunk_error = 1;
+    return NXT_AGAIN;
 
 done:
 
-    nb = nxt_buf_sync_alloc(hcp->mem_pool, NXT_BUF_SYNC_LAST);
-
-    if (nxt_fast_path(nb != NULL)) {
-        *tail = nb;
+    size = end - p;
 
-    } else {
-        hcp->error = 1;
+    if (size != 0 && out != p) {
+        nxt_memmove(out, p, size);
     }
 
-    // STUB: hcp->chunk_error = 1;
-    // STUB: hcp->error = 1;
+    hcp->pos = out;
+    mem->free = out + size;
 
-    return out;
-}
-
-
-static nxt_int_t
-nxt_http_chunk_buffer(nxt_http_chunk_parse_t *hcp, nxt_buf_t ***tail,
-    nxt_buf_t *in)
-{
-    u_char     *p;
-    size_t     size;
-    nxt_buf_t  *b;
-
-    p = hcp->pos;
-    size = in->mem.free - p;
-
-    if (hcp->chunk_size >= size && in->retain == 0) {
-        /*
-         * Use original buffer if the buffer is lesser than or equal
-         * to a chunk size and this is the first chunk in the buffer.
-         */
-        in->mem.pos = p;
-        **tail = in;
-        *tail = &in->next;
-
-    } else {
-        b = nxt_buf_mem_alloc(hcp->mem_pool, 0, 0);
-        if (nxt_slow_path(b == NULL)) {
-            return NXT_ERROR;
-        }
-
-        **tail = b;
-        *tail = &b->next;
+    return NXT_DONE;
 
-        b->parent = in;
-        in->retain++;
-        b->mem.pos = p;
-        b->mem.start = p;
-
-        if (hcp->chunk_size < size) {
-            p += hcp->chunk_size;
-            hcp->pos = p;
-
-            b->mem.free = p;
-            b->mem.end = p;
-
-            return NXT_HTTP_CHUNK_END;
-        }
-
-        b->mem.free = in->mem.free;
-        b->mem.end = in->mem.free;
-    }
-
-    hcp->chunk_size -= size;
+chunk_error:
 
-    if (hcp->chunk_size == 0) {
-        return NXT_HTTP_CHUNK_END_ON_BORDER;
-    }
+    hcp->chunk_error = 1;
 
-    return NXT_HTTP_CHUNK_MIDDLE;
+    return NXT_ERROR;
 }
@@ -0,0 +1,72 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+
+
+/* The RFC 1123 date, e.g. "Wed, 31 Dec 1986 16:40:00 GMT". */
+
+u_char *
+nxt_http_date(u_char *buf, nxt_time_t t)
+{
+    struct tm  tm;
+
+    static const char  *week[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri",
+                                   "Sat" };
+
+    static const char  *month[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+    nxt_gmtime(t, &tm);
+
+    return nxt_sprintf(buf, buf + NXT_HTTP_DATE_LEN,
+                       "%s, %02d %s %4d %02d:%02d:%02d GMT",
+                       week[tm.tm_wday], tm.tm_mday,
+                       month[tm.tm_mon], tm.tm_year + 1900,
+                       tm.tm_hour, tm.tm_min, tm.tm_sec);
+}
+
+
+/*
+ * The "Date" field follows the "Server" field in the engine cache,
+ * so any combination of them is copied at once.
+ */
+
+u_char *
+nxt_http_fields_add(nxt_task_t *task, u_char *p, nxt_uint_t fields)
+{
+    u_char                 *s;
+    nxt_time_t             now;
+    nxt_http_date_cache_t  *cache;
+
+    cache = &task->thread->engine->http_date;
+
+    now = nxt_thread_time(task->thread);
+
+    if (cache->time != now) {
+        cache->time = now;
+
+        s = nxt_cpymem(cache->fields, NXT_HTTP_SERVER_FIELD "Date: ",
+                       sizeof(NXT_HTTP_SERVER_FIELD "Date: ") - 1);
+        s = nxt_http_date(s, now);
+        *s++ = '\r'; *s = '\n';
+    }
+
+    switch (fields) {
+
+    case NXT_HTTP_FIELDS:
+        return nxt_cpymem(p, cache->fields, NXT_HTTP_FIELDS_LEN);
+
+    case NXT_HTTP_FIELD_SERVER:
+        return nxt_cpymem(p, cache->fields, NXT_HTTP_SERVER_LEN);
+
+    case NXT_HTTP_FIELD_DATE:
+        return nxt_cpymem(p, cache->fields + NXT_HTTP_SERVER_LEN,
+                          NXT_HTTP_DATE_FIELD_LEN);
+
+    default:
+        return p;
+    }
+}
@@ -0,0 +1,41 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NXT_HTTP_DATE_H_INCLUDED_
+#define _NXT_HTTP_DATE_H_INCLUDED_
+
+
+#define NXT_HTTP_DATE_LEN        (sizeof("Wed, 31 Dec 1986 16:40:00 GMT") - 1)
+
+#define NXT_HTTP_SERVER_FIELD    "Server: unit/" NXT_VERSION "\r\n"
+
+#define NXT_HTTP_SERVER_LEN      (sizeof(NXT_HTTP_SERVER_FIELD) - 1)
+#define NXT_HTTP_DATE_FIELD_LEN  (sizeof("Date: \r\n") - 1 + NXT_HTTP_DATE_LEN)
+#define NXT_HTTP_FIELDS_LEN      (NXT_HTTP_SERVER_LEN + NXT_HTTP_DATE_FIELD_LEN)
+
+
+/* The fields added by nxt_http_fields_add(). */
+#define NXT_HTTP_FIELD_SERVER    1
+#define NXT_HTTP_FIELD_DATE      2
+#define NXT_HTTP_FIELDS          (NXT_HTTP_FIELD_SERVER | NXT_HTTP_FIELD_DATE)
+
+
+/*
+ * Each engine keeps the "Server" and "Date" response header fields
+ * rendered together, the date is updated at most once per second.
+ */
+
+typedef struct {
+    nxt_time_t               time;
+    u_char                   fields[NXT_HTTP_FIELDS_LEN];
+} nxt_http_date_cache_t;
+
+
+NXT_EXPORT u_char *nxt_http_date(u_char *buf, nxt_time_t t);
+NXT_EXPORT u_char *nxt_http_fields_add(nxt_task_t *task, u_char *p,
+    nxt_uint_t fields);
+
+
+#endif /* _NXT_HTTP_DATE_H_INCLUDED_ */
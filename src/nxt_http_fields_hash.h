@@ -0,0 +1,78 @@
+
+/*
+ * The perfect hash of 59 well-known header field names,
+ * generated by nxt_http_fields_hash.pl.
+ */
+
+#define NXT_HTTP_FIELDS_HASH_MIX        0x9e3779b1
+#define NXT_HTTP_FIELDS_HASH_BITS       7
+#define NXT_HTTP_FIELDS_HASH_SIZE       128
+#define NXT_HTTP_FIELDS_HASH_DISP_BITS  2
+
+
+static const uint8_t  nxt_http_fields_hash_disp[] = {
+     73,   0, 180, 124,
+};
+
+
+/*
+ *   1: If-Range
+ *   2: Warning
+ *   3: TE
+ *   4: Upgrade-Insecure-Requests
+ *   7: Accept-Language
+ *  10: Content-Encoding
+ *  11: If-None-Match
+ *  13: If-Unmodified-Since
+ *  14: Sec-WebSocket-Key
+ *  15: If-Match
+ *  22: Access-Control-Request-Method
+ *  25: Access-Control-Request-Private-Network
+ *  26: Upgrade
+ *  27: X-Real-IP
+ *  29: If-Modified-Since
+ *  30: Accept-Encoding
+ *  31: Host
+ *  34: Range
+ *  35: Pragma
+ *  40: Sec-WebSocket-Version
+ *  42: Sec-Fetch-Dest
+ *  44: Content-Type
+ *  45: Proxy-Authorization
+ *  46: DNT
+ *  50: Connection
+ *  52: Keep-Alive
+ *  55: Sec-WebSocket-Extensions
+ *  56: Access-Control-Request-Headers
+ *  57: X-Forwarded-Proto
+ *  67: Proxy-Connection
+ *  69: Content-MD5
+ *  70: Referer
+ *  72: X-Forwarded-Host
+ *  74: Accept-Datetime
+ *  76: Authorization
+ *  77: X-Request-ID
+ *  80: Origin
+ *  81: X-Http-Method-Override
+ *  83: Accept-Charset
+ *  84: Cookie
+ *  86: Date
+ *  90: Max-Forwards
+ *  91: Via
+ *  92: Sec-Fetch-User
+ *  93: X-Forwarded-For
+ *  95: Transfer-Encoding
+ *  97: Accept
+ *  98: Cache-Control
+ * 100: Sec-Fetch-Mode
+ * 101: Trailer
+ * 102: User-Agent
+ * 103: Expect
+ * 109: Sec-WebSocket-Protocol
+ * 117: Forwarded
+ * 121: From
+ * 122: Sec-Fetch-Site
+ * 125: X-Requested-With
+ * 126: Content-Length
+ * 127: Early-Data
+ */
@@ -0,0 +1,202 @@
+#!/usr/bin/perl
+
+use warnings;
+use strict;
+
+# The script generates the nxt_http_fields_hash.h file, a perfect hash
+# over the well-known request header field names listed after __DATA__:
+#
+#   ./src/nxt_http_fields_hash.pl > src/nxt_http_fields_hash.h
+#
+# A field name is hashed by nxt_http_fields_hash_key() in nxt_http_parse.c,
+# the top bits of the key select a displacement, and the displaced key
+# is multiplied to get a slot.  Displacements are found for the largest
+# buckets first, as in the "hash, displace, and compress" scheme.
+
+use constant {
+    MIX     => 0x9e3779b1,
+    BITS    => 7,
+    MAX_LEN => 255,
+};
+
+my @names;
+
+while (<DATA>) {
+    chomp;
+    push @names, $_ if length;
+}
+
+die "too many names\n" if 2 * @names > 1 << BITS;
+
+
+sub hash_key {
+    my ($name) = @_;
+
+    use integer;
+
+    my @c = map { ord } split //, $name;
+    my $len = scalar @c;
+
+    die "too long name: $name\n" if $len > MAX_LEN;
+
+    my $h = ($c[0] | ($c[$len / 2] << 8) | ($c[$len - 2 + ($len == 1)] << 16)
+             | ($c[$len - 1] << 24)) | 0x20202020;
+
+    $h = ($h + $len) & 0xffffffff;
+
+    $h ^= $h >> 16;
+    $h = ($h * 0x85ebca6b) & 0xffffffff;
+    $h ^= $h >> 13;
+    $h = ($h * 0xc2b2ae35) & 0xffffffff;
+    $h ^= $h >> 16;
+
+    return $h;
+}
+
+
+sub hash_slot {
+    my ($h, $disp) = @_;
+
+    use integer;
+
+    return ((($h ^ $disp) * MIX) & 0xffffffff) >> (32 - BITS);
+}
+
+
+my (%keys, %slots, @disp, $disp_bits);
+
+for my $name (@names) {
+    my $h = hash_key(lc $name);
+
+    die "$name and $keys{$h} have the same key\n" if exists $keys{$h};
+
+    $keys{$h} = $name;
+}
+
+DISP_BITS: for my $bits (1 .. BITS - 1) {
+    my %buckets;
+
+    push @{$buckets{$_ >> (32 - $bits)}}, $_ for keys %keys;
+
+    %slots = ();
+    @disp = (0) x (1 << $bits);
+
+    my @order = sort { @{$buckets{$b}} <=> @{$buckets{$a}} or $a <=> $b }
+                keys %buckets;
+
+    BUCKET: for my $bucket (@order) {
+        DISP: for my $d (0 .. 255) {
+            my %try;
+
+            for my $h (@{$buckets{$bucket}}) {
+                my $slot = hash_slot($h, $d);
+
+                next DISP if exists $slots{$slot} || exists $try{$slot};
+
+                $try{$slot} = $keys{$h};
+            }
+
+            %slots = (%slots, %try);
+            $disp[$bucket] = $d;
+
+            next BUCKET;
+        }
+
+        next DISP_BITS;
+    }
+
+    $disp_bits = $bits;
+    last;
+}
+
+die "no perfect hash found\n" unless defined $disp_bits;
+
+
+printf("\n/*\n" .
+       " * The perfect hash of %d well-known header field names,\n" .
+       " * generated by nxt_http_fields_hash.pl.\n" .
+       " */\n\n", scalar @names);
+
+printf("#define NXT_HTTP_FIELDS_HASH_MIX        0x%08x\n", MIX);
+printf("#define NXT_HTTP_FIELDS_HASH_BITS       %d\n", BITS);
+printf("#define NXT_HTTP_FIELDS_HASH_SIZE       %d\n", 1 << BITS);
+printf("#define NXT_HTTP_FIELDS_HASH_DISP_BITS  %d\n\n\n", $disp_bits);
+
+print "static const uint8_t  nxt_http_fields_hash_disp[] = {";
+
+for my $i (0 .. $#disp) {
+    print "\n   " if $i % 8 == 0;
+    printf(" %3d,", $disp[$i]);
+}
+
+print "\n};\n\n\n";
+
+print "/*\n";
+
+for my $slot (sort { $a <=> $b } keys %slots) {
+    printf(" * %3d: %s\n", $slot, $slots{$slot});
+}
+
+print " */\n";
+
+
+__DATA__
+Accept
+Accept-Charset
+Accept-Datetime
+Accept-Encoding
+Accept-Language
+Access-Control-Request-Headers
+Access-Control-Request-Method
+Access-Control-Request-Private-Network
+Authorization
+Cache-Control
+Connection
+Content-Encoding
+Content-Length
+Content-MD5
+Content-Type
+Cookie
+Date
+DNT
+Early-Data
+Expect
+Forwarded
+From
+Host
+If-Match
+If-Modified-Since
+If-None-Match
+If-Range
+If-Unmodified-Since
+Keep-Alive
+Max-Forwards
+Origin
+Pragma
+Proxy-Authorization
+Proxy-Connection
+Range
+Referer
+Sec-Fetch-Dest
+Sec-Fetch-Mode
+Sec-Fetch-Site
+Sec-Fetch-User
+Sec-WebSocket-Extensions
+Sec-WebSocket-Key
+Sec-WebSocket-Protocol
+Sec-WebSocket-Version
+TE
+Trailer
+Transfer-Encoding
+Upgrade
+Upgrade-Insecure-Requests
+User-Agent
+Via
+Warning
+X-Forwarded-For
+X-Forwarded-Host
+X-Forwarded-Proto
+X-Http-Method-Override
+X-Real-IP
+X-Request-ID
+X-Requested-With
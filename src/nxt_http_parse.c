@@ -6,32 +6,55 @@
 
 #include <nxt_main.h>
 
+#if (NXT_HAVE_BUILTIN_CPU_SUPPORTS && NXT_HAVE_SSE42)
+
+#define NXT_HTTP_PARSE_SIMD  1
+
+#include <nmmintrin.h>
+
+#if (NXT_HAVE_AVX2)
+#include <immintrin.h>
+#endif
+
+#endif
+
+
+/*
+ * The nxt_http_fields_hash.h file is the auto-generated file with
+ * a perfect hash of the well-known request header field names:
+ *
+ *   ./src/nxt_http_fields_hash.pl > src/nxt_http_fields_hash.h
+ *
+ * Any field name can be added to a fields hash: an entry which is not
+ * well-known takes its slot if the slot is free, otherwise it is looked up
+ * in a short list of collided entries.
+ */
+
+#include <nxt_http_fields_hash.h>
+
 
 typedef struct {
     nxt_http_field_handler_t    handler;
     uintptr_t                   data;
 
+    /* A lowcase copy of names longer than 32 bytes. */
+    u_char                      *name;
+    size_t                      length;
+
     union {
-        uint8_t                 str[8];
-        uint64_t                ui64;
-    } key[];
+        uint8_t                 str[32];
+        uint64_t                ui64[4];
+    } key;
 } nxt_http_fields_hash_elt_t;
 
 
 struct nxt_http_fields_hash_s {
-    size_t                      min_length;
-    size_t                      max_length;
-    void                        *long_fields;
-    nxt_http_fields_hash_elt_t  *elts[];
+    nxt_uint_t                  ncollisions;
+    nxt_http_fields_hash_elt_t  *collisions;
+    nxt_http_fields_hash_elt_t  elts[NXT_HTTP_FIELDS_HASH_SIZE];
 };
 
 
-#define nxt_http_fields_hash_next_elt(elt, n)                                 \
-    ((nxt_http_fields_hash_elt_t *) ((u_char *) (elt)                         \
-                                     + sizeof(nxt_http_fields_hash_elt_t)     \
-                                     + n * 8))
-
-
 static nxt_int_t nxt_http_parse_unusual_target(nxt_http_request_parse_t *rp,
     u_char **pos, u_char *end);
 static nxt_int_t nxt_http_parse_request_line(nxt_http_request_parse_t *rp,
@@ -44,14 +67,61 @@ static u_char *nxt_http_lookup_field_end(u_char *p, u_char *end);
 static nxt_int_t nxt_http_parse_field_end(nxt_http_request_parse_t *rp,
     u_char **pos, u_char *end);
 
+static nxt_int_t nxt_http_fields_hash_elt_init(nxt_http_fields_hash_elt_t *elt,
+    nxt_http_fields_hash_entry_t *entry, nxt_mp_t *mp);
 static void nxt_http_fields_hash_lookup(nxt_http_fields_hash_t *hash,
     uint64_t key[4], nxt_http_field_t *field);
-static void nxt_http_fields_hash_lookup_long(nxt_http_fields_hash_t *hash,
-    nxt_http_field_t *field);
 
 static nxt_int_t nxt_http_parse_complex_target(nxt_http_request_parse_t *rp);
 
 
+#if (NXT_HTTP_PARSE_SIMD)
+
+/*
+ * The SIMD handlers only skip over runs of ordinary bytes and stop at
+ * the first byte that needs attention.  The scalar code continues from
+ * there, so it handles both short tails and parser state transitions.
+ */
+
+typedef struct {
+    u_char  *(*target)(u_char *p, u_char *end);
+    size_t  (*field_name)(u_char *p, size_t i, size_t size, uint8_t *key);
+    u_char  *(*field_end)(u_char *p, u_char *end);
+} nxt_http_parse_simd_t;
+
+
+static u_char *nxt_http_parse_target_sse42(u_char *p, u_char *end);
+static size_t nxt_http_parse_field_name_sse42(u_char *p, size_t i,
+    size_t size, uint8_t *key);
+static u_char *nxt_http_lookup_field_end_sse42(u_char *p, u_char *end);
+
+#if (NXT_HAVE_AVX2)
+static size_t nxt_http_parse_field_name_avx2(u_char *p, size_t i,
+    size_t size, uint8_t *key);
+static u_char *nxt_http_lookup_field_end_avx2(u_char *p, u_char *end);
+#endif
+
+
+static const nxt_http_parse_simd_t  nxt_http_parse_sse42 = {
+    nxt_http_parse_target_sse42,
+    nxt_http_parse_field_name_sse42,
+    nxt_http_lookup_field_end_sse42,
+};
+
+#if (NXT_HAVE_AVX2)
+static const nxt_http_parse_simd_t  nxt_http_parse_avx2 = {
+    nxt_http_parse_target_sse42,
+    nxt_http_parse_field_name_avx2,
+    nxt_http_lookup_field_end_avx2,
+};
+#endif
+
+
+static const nxt_http_parse_simd_t  *nxt_http_parse_simd;
+
+#endif
+
+
 typedef enum {
     NXT_HTTP_TARGET_SPACE = 1,   /* \s  */
     NXT_HTTP_TARGET_HASH,        /*  #  */
@@ -89,6 +159,12 @@ nxt_http_parse_target(u_char **pos, u_char *end)
 
     p = *pos;
 
+#if (NXT_HTTP_PARSE_SIMD)
+    if (nxt_http_parse_simd != NULL) {
+        p = nxt_http_parse_simd->target(p, end);
+    }
+#endif
+
     for ( ;; ) {
         if (nxt_slow_path(end - p < 10)) {
             return NXT_HTTP_TARGET_AGAIN;
@@ -474,6 +550,12 @@ nxt_http_parse_field_name(nxt_http_request_parse_t *rp, u_char **pos,
         i++;                                                                  \
     }
 
+#if (NXT_HTTP_PARSE_SIMD)
+    if (nxt_http_parse_simd != NULL) {
+        i = nxt_http_parse_simd->field_name(p, i, size, rp->field_key.str);
+    }
+#endif
+
     while (nxt_fast_path(size - i >= 8)) {
         nxt_http_parse_field_name_step
         nxt_http_parse_field_name_step
@@ -564,6 +646,9 @@ nxt_http_parse_field_value(nxt_http_request_parse_t *rp, u_char **pos,
         if (ch == '\0') {
             return NXT_ERROR;
         }
+
+        /* Other control characters, e.g. "\t", are part of the value. */
+        p++;
     }
 
     if (nxt_fast_path(p != *pos)) {
@@ -586,6 +671,16 @@ nxt_http_lookup_field_end(u_char *p, u_char *end)
 {
     nxt_uint_t  n;
 
+#if (NXT_HTTP_PARSE_SIMD)
+    if (nxt_http_parse_simd != NULL) {
+        p = nxt_http_parse_simd->field_end(p, end);
+
+        if (p != end && *p < 0x10) {
+            return p;
+        }
+    }
+#endif
+
 #define nxt_http_lookup_field_end_step                                        \
     {                                                                         \
         if (nxt_slow_path(*p < 0x10)) {                                       \
@@ -646,6 +741,249 @@ nxt_http_lookup_field_end(u_char *p, u_char *end)
 }
 
 
+nxt_uint_t
+nxt_http_parse_simd_init(nxt_uint_t level)
+{
+#if (NXT_HTTP_PARSE_SIMD)
+
+    __builtin_cpu_init();
+
+#if (NXT_HAVE_AVX2)
+
+    if (level >= NXT_HTTP_PARSE_AVX2
+        && __builtin_cpu_supports("avx2")
+        && __builtin_cpu_supports("sse4.2"))
+    {
+        nxt_http_parse_simd = &nxt_http_parse_avx2;
+        return NXT_HTTP_PARSE_AVX2;
+    }
+
+#endif
+
+    if (level >= NXT_HTTP_PARSE_SSE42 && __builtin_cpu_supports("sse4.2")) {
+        nxt_http_parse_simd = &nxt_http_parse_sse42;
+        return NXT_HTTP_PARSE_SSE42;
+    }
+
+    nxt_http_parse_simd = NULL;
+
+#endif
+
+    return NXT_HTTP_PARSE_SCALAR;
+}
+
+
+#if (NXT_HTTP_PARSE_SIMD)
+
+/*
+ * A trap found less than 10 bytes before the end is left to the scalar
+ * code, which returns NXT_HTTP_TARGET_AGAIN in this case.
+ */
+
+__attribute__((target("sse4.2")))
+static u_char *
+nxt_http_parse_target_sse42(u_char *p, u_char *end)
+{
+    int      n;
+    __m128i  traps, data;
+
+    traps = _mm_setr_epi8('\0', '\r', '\n', ' ', '#', '%', '+', '.',
+                          '/', '?', 0, 0, 0, 0, 0, 0);
+
+    while (end - p >= 16 + 10) {
+        data = _mm_loadu_si128((const __m128i *) p);
+
+        n = _mm_cmpestri(traps, 10, data, 16,
+                         _SIDD_UBYTE_OPS|_SIDD_CMP_EQUAL_ANY);
+
+        if (n != 16) {
+            return p + n;
+        }
+
+        p += 16;
+    }
+
+    return p;
+}
+
+
+__attribute__((target("sse4.2")))
+static size_t
+nxt_http_parse_field_name_sse42(u_char *p, size_t i, size_t size,
+    uint8_t *key)
+{
+    int      n;
+    __m128i  valid, data, upper, index;
+
+    valid = _mm_setr_epi8('-', '-', '0', '9', 'A', 'Z', 'a', 'z',
+                          0, 0, 0, 0, 0, 0, 0, 0);
+    index = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                          8, 9, 10, 11, 12, 13, 14, 15);
+
+    while (size - i >= 16) {
+        data = _mm_loadu_si128((const __m128i *) &p[i]);
+
+        n = _mm_cmpestri(valid, 8, data, 16,
+                         _SIDD_UBYTE_OPS|_SIDD_CMP_RANGES
+                         |_SIDD_NEGATIVE_POLARITY);
+
+        if (i + 16 <= 32) {
+            upper = _mm_and_si128(_mm_cmpgt_epi8(data, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmplt_epi8(data, _mm_set1_epi8('Z' + 1)));
+
+            data = _mm_add_epi8(data, _mm_and_si128(upper,
+                                                    _mm_set1_epi8(0x20)));
+
+            data = _mm_and_si128(data, _mm_cmplt_epi8(index,
+                                                      _mm_set1_epi8(n)));
+
+            _mm_storeu_si128((__m128i *) &key[i], data);
+
+        } else if (i < 32) {
+            /* The key would wrap, leave it to the scalar code. */
+            return i;
+        }
+
+        i += n;
+
+        if (n != 16) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+
+__attribute__((target("sse4.2")))
+static u_char *
+nxt_http_lookup_field_end_sse42(u_char *p, u_char *end)
+{
+    int      n;
+    __m128i  range, data;
+
+    range = _mm_setr_epi8(0x00, 0x0f, 0, 0, 0, 0, 0, 0,
+                          0, 0, 0, 0, 0, 0, 0, 0);
+
+    while (end - p >= 16) {
+        data = _mm_loadu_si128((const __m128i *) p);
+
+        n = _mm_cmpestri(range, 2, data, 16,
+                         _SIDD_UBYTE_OPS|_SIDD_CMP_RANGES);
+
+        if (n != 16) {
+            return p + n;
+        }
+
+        p += 16;
+    }
+
+    return p;
+}
+
+
+#if (NXT_HAVE_AVX2)
+
+/*
+ * The AVX2 handlers clear the upper halves of the ymm registers on return
+ * to avoid the AVX-SSE transition penalty in the surrounding SSE code.
+ */
+
+nxt_inline __attribute__((target("avx2"))) __m256i
+nxt_http_parse_in_range_avx2(__m256i data, char from, char to)
+{
+    return _mm256_and_si256(_mm256_cmpgt_epi8(data, _mm256_set1_epi8(from - 1)),
+                            _mm256_cmpgt_epi8(_mm256_set1_epi8(to + 1), data));
+}
+
+
+__attribute__((target("avx2")))
+static size_t
+nxt_http_parse_field_name_avx2(u_char *p, size_t i, size_t size,
+    uint8_t *key)
+{
+    int       n;
+    uint32_t  invalid;
+    __m256i   data, lower, alpha, valid, index;
+
+    index = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7,
+                             8, 9, 10, 11, 12, 13, 14, 15,
+                             16, 17, 18, 19, 20, 21, 22, 23,
+                             24, 25, 26, 27, 28, 29, 30, 31);
+
+    while (size - i >= 32) {
+        data = _mm256_loadu_si256((const __m256i *) &p[i]);
+
+        lower = _mm256_or_si256(data, _mm256_set1_epi8(0x20));
+        alpha = nxt_http_parse_in_range_avx2(lower, 'a', 'z');
+
+        valid = _mm256_or_si256(alpha,
+                                nxt_http_parse_in_range_avx2(data, '0', '9'));
+        valid = _mm256_or_si256(valid,
+                                _mm256_cmpeq_epi8(data, _mm256_set1_epi8('-')));
+
+        invalid = ~(uint32_t) _mm256_movemask_epi8(valid);
+        n = (invalid != 0) ? __builtin_ctz(invalid) : 32;
+
+        if (i == 0) {
+            data = _mm256_blendv_epi8(data, lower, alpha);
+            data = _mm256_and_si256(data,
+                                    _mm256_cmpgt_epi8(_mm256_set1_epi8(n),
+                                                      index));
+
+            _mm256_storeu_si256((__m256i *) key, data);
+
+        } else if (i < 32) {
+            /* The key would wrap, leave it to the scalar code. */
+            break;
+        }
+
+        i += n;
+
+        if (n != 32) {
+            break;
+        }
+    }
+
+    _mm256_zeroupper();
+
+    return i;
+}
+
+
+__attribute__((target("avx2")))
+static u_char *
+nxt_http_lookup_field_end_avx2(u_char *p, u_char *end)
+{
+    uint32_t  mask;
+    __m256i   data, min;
+
+    min = _mm256_set1_epi8(0x0f);
+
+    while (end - p >= 32) {
+        data = _mm256_loadu_si256((const __m256i *) p);
+
+        data = _mm256_cmpeq_epi8(_mm256_min_epu8(data, min), data);
+        mask = _mm256_movemask_epi8(data);
+
+        if (mask != 0) {
+            p += __builtin_ctz(mask);
+            break;
+        }
+
+        p += 32;
+    }
+
+    _mm256_zeroupper();
+
+    return p;
+}
+
+#endif
+
+#endif
+
+
 static nxt_int_t
 nxt_http_parse_field_end(nxt_http_request_parse_t *rp, u_char **pos,
     u_char *end)
@@ -696,88 +1034,75 @@ nxt_http_parse_field_end(nxt_http_request_parse_t *rp, u_char **pos,
 }
 
 
-nxt_http_fields_hash_t *
-nxt_http_fields_hash_create(nxt_http_fields_hash_entry_t *entries,
-    nxt_mp_t *mp)
+/*
+ * The field name may be in any case, since header field names consist
+ * of letters, digits, and "-" which are not changed by setting 0x20 bit.
+ */
+
+nxt_inline uint32_t
+nxt_http_fields_hash_slot(const u_char *p, size_t len)
 {
-    size_t                      min_length, max_length, length, size;
-    nxt_uint_t                  i, j, n;
-    nxt_http_fields_hash_t      *hash;
-    nxt_http_fields_hash_elt_t  *elt;
+    uint32_t  h;
 
-    min_length = 32 + 1;
-    max_length = 0;
+    h = (p[0] | (p[len / 2] << 8) | (p[len - 2 + (len == 1)] << 16)
+         | ((uint32_t) p[len - 1] << 24)) | 0x20202020;
 
-    for (i = 0; entries[i].handler != NULL; i++) {
-        length = entries[i].name.length;
+    h += (uint32_t) len;
 
-        if (length > 32) {
-            /* TODO */
-            return NULL;
-        }
+    /* The MurmurHash3 finalizer. */
 
-        min_length = nxt_min(length, min_length);
-        max_length = nxt_max(length, max_length);
-    }
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
 
-    size = sizeof(nxt_http_fields_hash_t);
+    h ^= nxt_http_fields_hash_disp[h >> (32 - NXT_HTTP_FIELDS_HASH_DISP_BITS)];
+
+    return (h * NXT_HTTP_FIELDS_HASH_MIX) >> (32 - NXT_HTTP_FIELDS_HASH_BITS);
+}
 
-    if (min_length <= 32) {
-        size += (max_length - min_length + 1)
-                * sizeof(nxt_http_fields_hash_elt_t *);
-    }
 
-    hash = nxt_mp_zget(mp, size);
+nxt_http_fields_hash_t *
+nxt_http_fields_hash_create(nxt_http_fields_hash_entry_t *entries,
+    nxt_mp_t *mp)
+{
+    nxt_uint_t                  i, n;
+    nxt_http_fields_hash_t      *hash;
+    nxt_http_fields_hash_elt_t  *elt;
+
+    hash = nxt_mp_zget(mp, sizeof(nxt_http_fields_hash_t));
     if (nxt_slow_path(hash == NULL)) {
         return NULL;
     }
 
-    hash->min_length = min_length;
-    hash->max_length = max_length;
-
-    for (i = 0; entries[i].handler != NULL; i++) {
-        length = entries[i].name.length;
-        elt = hash->elts[length - min_length];
-
-        if (elt != NULL) {
-            continue;
-        }
-
-        n = 1;
-
-        for (j = i + 1; entries[j].handler != NULL; j++) {
-            if (length == entries[j].name.length) {
-                n++;
-            }
-        }
-
-        size = sizeof(nxt_http_fields_hash_elt_t) + nxt_align_size(length, 8);
-
-        elt = nxt_mp_zget(mp, n * size + sizeof(nxt_http_fields_hash_elt_t));
+    for (n = 0; entries[n].handler != NULL; n++) { /* void */ }
 
-        if (nxt_slow_path(elt == NULL)) {
+    for (i = 0; i < n; i++) {
+        if (nxt_slow_path(entries[i].name.length == 0)) {
             return NULL;
         }
 
-        hash->elts[length - min_length] = elt;
+        elt = &hash->elts[nxt_http_fields_hash_slot(entries[i].name.start,
+                                                    entries[i].name.length)];
 
-        for (j = i; entries[j].handler != NULL; j++) {
-            if (length != entries[j].name.length) {
-                continue;
-            }
-
-            elt->handler = entries[j].handler;
-            elt->data = entries[j].data;
-
-            nxt_memcpy_lowcase(elt->key->str, entries[j].name.start, length);
+        if (elt->handler != NULL) {
 
-            n--;
-
-            if (n == 0) {
-                break;
+            if (hash->collisions == NULL) {
+                hash->collisions = nxt_mp_zget(mp,
+                                   n * sizeof(nxt_http_fields_hash_elt_t));
+                if (nxt_slow_path(hash->collisions == NULL)) {
+                    return NULL;
+                }
             }
 
-            elt = nxt_pointer_to(elt, size);
+            elt = &hash->collisions[hash->ncollisions++];
+        }
+
+        if (nxt_slow_path(nxt_http_fields_hash_elt_init(elt, &entries[i], mp)
+                          != NXT_OK))
+        {
+            return NULL;
         }
     }
 
@@ -785,114 +1110,91 @@ nxt_http_fields_hash_create(nxt_http_fields_hash_entry_t *entries,
 }
 
 
-static void
-nxt_http_fields_hash_lookup(nxt_http_fields_hash_t *hash, uint64_t key[4],
-    nxt_http_field_t *field)
+static nxt_int_t
+nxt_http_fields_hash_elt_init(nxt_http_fields_hash_elt_t *elt,
+    nxt_http_fields_hash_entry_t *entry, nxt_mp_t *mp)
 {
-    nxt_http_fields_hash_elt_t  *elt;
+    elt->handler = entry->handler;
+    elt->data = entry->data;
+    elt->length = entry->name.length;
 
-    if (hash == NULL || field->name.length < hash->min_length) {
-        goto not_found;
+    if (elt->length <= 32) {
+        nxt_memcpy_lowcase(elt->key.str, entry->name.start, elt->length);
+        return NXT_OK;
     }
 
-    if (field->name.length > hash->max_length) {
-
-        if (field->name.length > 32 && hash->long_fields != NULL) {
-            nxt_http_fields_hash_lookup_long(hash, field);
-            return;
-        }
-
-        goto not_found;
-    }
-
-    elt = hash->elts[field->name.length - hash->min_length];
-
-    if (elt == NULL) {
-        goto not_found;
+    elt->name = nxt_mp_nget(mp, elt->length);
+    if (nxt_slow_path(elt->name == NULL)) {
+        return NXT_ERROR;
     }
 
-    switch ((field->name.length + 7) / 8) {
-    case 1:
-        do {
-            if (elt->key[0].ui64 == key[0]) {
-                break;
-            }
-
-            elt = nxt_http_fields_hash_next_elt(elt, 1);
-
-        } while (elt->handler != NULL);
-
-        break;
+    nxt_memcpy_lowcase(elt->name, entry->name.start, elt->length);
 
-    case 2:
-        do {
-            if (elt->key[0].ui64 == key[0]
-                && elt->key[1].ui64 == key[1])
-            {
-                break;
-            }
-
-            elt = nxt_http_fields_hash_next_elt(elt, 2);
-
-        } while (elt->handler != NULL);
+    return NXT_OK;
+}
 
-        break;
 
-    case 3:
-        do {
-            if (elt->key[0].ui64 == key[0]
-                && elt->key[1].ui64 == key[1]
-                && elt->key[2].ui64 == key[2])
-            {
-                break;
-            }
+/*
+ * The key contains the lowcase field name padded with zeros
+ * if the name is not longer than 32 bytes.
+ */
 
-            elt = nxt_http_fields_hash_next_elt(elt, 3);
+nxt_inline nxt_bool_t
+nxt_http_fields_hash_test(nxt_http_fields_hash_elt_t *elt, uint64_t key[4],
+    nxt_http_field_t *field)
+{
+    if (elt->length != field->name.length) {
+        return 0;
+    }
 
-        } while (elt->handler != NULL);
+    if (elt->length <= 32) {
+        return (elt->key.ui64[0] == key[0]
+                && elt->key.ui64[1] == key[1]
+                && elt->key.ui64[2] == key[2]
+                && elt->key.ui64[3] == key[3]);
+    }
 
-        break;
+    return (nxt_memcasecmp(elt->name, field->name.start, elt->length) == 0);
+}
 
-    case 4:
-        do {
-            if (elt->key[0].ui64 == key[0]
-                && elt->key[1].ui64 == key[1]
-                && elt->key[2].ui64 == key[2]
-                && elt->key[3].ui64 == key[3])
-            {
-                break;
-            }
 
-            elt = nxt_http_fields_hash_next_elt(elt, 4);
+static void
+nxt_http_fields_hash_lookup(nxt_http_fields_hash_t *hash, uint64_t key[4],
+    nxt_http_field_t *field)
+{
+    nxt_uint_t                  i;
+    nxt_http_fields_hash_elt_t  *elt;
 
-        } while (elt->handler != NULL);
+    if (hash == NULL) {
+        goto not_found;
+    }
 
-        break;
+    elt = &hash->elts[nxt_http_fields_hash_slot(field->name.start,
+                                                field->name.length)];
 
-    default:
-        nxt_unreachable();
+    if (nxt_http_fields_hash_test(elt, key, field)) {
+        goto found;
     }
 
-    field->handler = elt->handler;
-    field->data = elt->data;
+    for (i = 0; i < hash->ncollisions; i++) {
+        elt = &hash->collisions[i];
 
-    return;
+        if (nxt_http_fields_hash_test(elt, key, field)) {
+            goto found;
+        }
+    }
 
 not_found:
 
     field->handler = NULL;
     field->data = 0;
-}
 
+    return;
 
-static void
-nxt_http_fields_hash_lookup_long(nxt_http_fields_hash_t *hash,
-    nxt_http_field_t *field)
-{
-    /* TODO */
+found:
 
-    field->handler = NULL;
-    field->data = 0;
+    field->handler = elt->handler;
+    field->data = elt->data;
 }
 
 
@@ -11,6 +11,7 @@
 typedef struct nxt_http_request_parse_s  nxt_http_request_parse_t;
 typedef struct nxt_http_field_s          nxt_http_field_t;
 typedef struct nxt_http_fields_hash_s    nxt_http_fields_hash_t;
+typedef struct nxt_http_chunk_parse_s    nxt_http_chunk_parse_t;
 
 
 typedef union {
@@ -82,6 +83,16 @@ struct nxt_http_field_s {
 };
 
 
+struct nxt_http_chunk_parse_s {
+    u_char                    *pos;
+    uint64_t                  chunk_size;
+
+    uint8_t                   state;
+    uint8_t                   last;         /* 1 bit */
+    uint8_t                   chunk_error;  /* 1 bit */
+};
+
+
 nxt_inline nxt_int_t
 nxt_http_parse_request_init(nxt_http_request_parse_t *rp, nxt_mp_t *mp)
 {
@@ -96,9 +107,18 @@ nxt_http_parse_request_init(nxt_http_request_parse_t *rp, nxt_mp_t *mp)
 }
 
 
+#define NXT_HTTP_PARSE_SCALAR     0
+#define NXT_HTTP_PARSE_SSE42      1
+#define NXT_HTTP_PARSE_AVX2       2
+
+
+NXT_EXPORT nxt_uint_t nxt_http_parse_simd_init(nxt_uint_t level);
 nxt_int_t nxt_http_parse_request(nxt_http_request_parse_t *rp,
     nxt_buf_mem_t *b);
 
+nxt_int_t nxt_http_chunk_parse(nxt_task_t *task, nxt_http_chunk_parse_t *hcp,
+    nxt_buf_mem_t *mem);
+
 nxt_http_fields_hash_t *nxt_http_fields_hash_create(
     nxt_http_fields_hash_entry_t *entries, nxt_mp_t *mp);
 nxt_int_t nxt_http_fields_process(nxt_list_t *fields, void *ctx,
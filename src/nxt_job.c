@@ -99,7 +99,7 @@ nxt_job_cleanup_add(nxt_mp_t *mp, nxt_job_t *job)
 
 
 /*
- * The (void *) casts in nxt_thread_pool_post() and nxt_event_engine_post()
+ * The (void *) casts in nxt_thread_pool_post() and nxt_thread_pool_return()
  * calls and to the "nxt_work_handler_t" are required by Sun C.
  */
 
@@ -116,7 +116,14 @@ nxt_job_start(nxt_task_t *task, nxt_job_t *job, nxt_work_handler_t handler)
         nxt_work_set(&job->work, nxt_job_thread_trampoline,
                      job->task, job, (void *) handler);
 
-        ret = nxt_thread_pool_post(job->thread_pool, &job->work);
+        if (job->engine != NULL) {
+            /* Jobs started by an engine are posted to a pool at once. */
+            ret = nxt_thread_pool_batch_add(&job->engine->thread_pool_batch,
+                                            job->thread_pool, &job->work);
+
+        } else {
+            ret = nxt_thread_pool_post(job->thread_pool, &job->work);
+        }
 
         if (ret == NXT_OK) {
             return;
@@ -162,7 +169,7 @@ nxt_job_return(nxt_task_t *task, nxt_job_t *job, nxt_work_handler_t handler)
         nxt_work_set(&job->work, nxt_job_thread_return_handler,
                      job->task, job, (void *) handler);
 
-        nxt_event_engine_post(job->engine, &job->work);
+        nxt_thread_pool_return(job->engine, &job->work);
 
         return;
     }
@@ -5,6 +5,7 @@
  */
 
 #include <nxt_main.h>
+#include <nxt_conf.h>
 
 
 nxt_uint_t    nxt_ncpu = 1;
@@ -105,6 +106,14 @@ nxt_lib_start(const char *app, char **argv, char ***envp)
 
     nxt_debug(&nxt_main_task, "pagesize: %ui", nxt_pagesize);
 
+    n = nxt_http_parse_simd_init(NXT_HTTP_PARSE_AVX2);
+
+    nxt_debug(&nxt_main_task, "http parse simd: %d", n);
+
+    n = nxt_conf_json_simd_init(NXT_CONF_JSON_SSE42);
+
+    nxt_debug(&nxt_main_task, "conf json simd: %d", n);
+
     if (argv != NULL) {
         update = (argv[0] == app);
 
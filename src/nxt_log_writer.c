@@ -0,0 +1,427 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+
+
+#define NXT_LOG_RING_SIZE       (64 * 1024)
+#define NXT_LOG_RING_MASK       (NXT_LOG_RING_SIZE - 1)
+
+/* Solaris, AIX, and HP-UX IOV_MAX is 16. */
+#define NXT_LOG_WRITER_IOVS     16
+
+#define NXT_LOG_WRITER_TIMEOUT  (1000 * 1000000LL)
+
+
+/*
+ * A ring has a single producer, the thread which owns it, and a single
+ * consumer, the writer thread.  The "tail" and "head" positions grow
+ * monotonically and are masked on buffer access.  The producer fields
+ * are separated from the consumer field by the buffer to keep them in
+ * different cache lines.
+ */
+
+struct nxt_log_ring_s {
+    nxt_atomic_t              tail;
+    nxt_atomic_uint_t         head_cache;
+    nxt_atomic_t              dropped;
+    nxt_atomic_t              closed;
+
+    u_char                    buffer[NXT_LOG_RING_SIZE];
+
+    nxt_atomic_t              head;
+    nxt_atomic_uint_t         reported;
+    nxt_log_ring_t            *next;
+};
+
+
+typedef struct {
+    nxt_log_ring_t            *ring;
+    nxt_atomic_uint_t         size;
+} nxt_log_writer_chunk_t;
+
+
+typedef struct {
+    nxt_atomic_t              running;
+    nxt_atomic_t              sleeping;
+    nxt_atomic_t              quit;
+    nxt_log_overflow_t        overflow;
+
+    nxt_thread_t              *thread;
+    nxt_thread_handle_t       handle;
+    nxt_sem_t                 sem;
+
+    /* The mutex protects the list of rings. */
+    nxt_thread_mutex_t        mutex;
+    nxt_log_ring_t            *rings;
+    nxt_bool_t                initialized;
+
+    nxt_uint_t                dropped;
+} nxt_log_writer_t;
+
+
+static nxt_log_ring_t *nxt_log_ring_create(nxt_thread_t *thr);
+static void nxt_log_writer_loop(void *data);
+static nxt_bool_t nxt_log_writer_flush(nxt_thread_t *thr);
+static nxt_bool_t nxt_log_writer_drain(nxt_thread_t *thr);
+
+
+static nxt_log_writer_t  nxt_log_writer;
+
+
+nxt_int_t
+nxt_log_writer_start(nxt_log_overflow_t overflow)
+{
+    nxt_thread_link_t  *link;
+
+    if (nxt_log_writer.running) {
+        return NXT_OK;
+    }
+
+    if (!nxt_log_writer.initialized) {
+        if (nxt_thread_mutex_create(&nxt_log_writer.mutex) != NXT_OK) {
+            return NXT_ERROR;
+        }
+
+        nxt_log_writer.initialized = 1;
+    }
+
+    if (nxt_sem_init(&nxt_log_writer.sem, 0) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    nxt_log_writer.overflow = overflow;
+    nxt_log_writer.sleeping = 0;
+    nxt_log_writer.quit = 0;
+
+    link = nxt_zalloc(sizeof(nxt_thread_link_t));
+
+    if (nxt_fast_path(link != NULL)) {
+        link->start = nxt_log_writer_loop;
+
+        if (nxt_thread_create(&nxt_log_writer.handle, link) == NXT_OK) {
+            nxt_log_writer.running = 1;
+            return NXT_OK;
+        }
+    }
+
+    nxt_sem_destroy(&nxt_log_writer.sem);
+
+    return NXT_ERROR;
+}
+
+
+/*
+ * The writer drains all rings before exit.  Messages logged after
+ * the writer has been stopped are written synchronously.
+ */
+
+void
+nxt_log_writer_stop(void)
+{
+    if (!nxt_log_writer.running) {
+        return;
+    }
+
+    nxt_log_writer.running = 0;
+
+    (void) nxt_atomic_xchg(&nxt_log_writer.quit, 1);
+    (void) nxt_sem_post(&nxt_log_writer.sem);
+
+    nxt_thread_wait(nxt_log_writer.handle);
+
+    nxt_sem_destroy(&nxt_log_writer.sem);
+}
+
+
+nxt_uint_t
+nxt_log_writer_dropped(void)
+{
+    return nxt_log_writer.dropped;
+}
+
+
+void
+nxt_log_write(u_char *msg, size_t size)
+{
+    size_t             n;
+    nxt_uint_t         tail, head, pos;
+    nxt_thread_t       *thr;
+    nxt_log_ring_t     *ring;
+
+    thr = nxt_thread();
+
+    if (!nxt_log_writer.running
+        || thr == nxt_log_writer.thread
+        || size > NXT_LOG_RING_SIZE)
+    {
+        goto sync;
+    }
+
+    ring = thr->log_ring;
+
+    if (nxt_slow_path(ring == NULL)) {
+        ring = nxt_log_ring_create(thr);
+        if (nxt_slow_path(ring == NULL)) {
+            goto sync;
+        }
+    }
+
+    tail = ring->tail;
+
+    if (tail + size - ring->head_cache > NXT_LOG_RING_SIZE) {
+
+        for ( ;; ) {
+            head = ring->head;
+            ring->head_cache = head;
+
+            if (tail + size - head <= NXT_LOG_RING_SIZE) {
+                break;
+            }
+
+            if (nxt_log_writer.overflow == NXT_LOG_OVERFLOW_DROP) {
+                ring->dropped++;
+                return;
+            }
+
+            nxt_log_writer_wakeup();
+
+            nxt_nanosleep(1000000);
+
+            if (!nxt_log_writer.running) {
+                goto sync;
+            }
+        }
+    }
+
+    pos = tail & NXT_LOG_RING_MASK;
+    n = nxt_min(size, NXT_LOG_RING_SIZE - pos);
+
+    nxt_memcpy(&ring->buffer[pos], msg, n);
+
+    if (n != size) {
+        nxt_memcpy(ring->buffer, msg + n, size - n);
+    }
+
+    /* The full barrier makes the message visible before the new tail. */
+    (void) nxt_atomic_cmp_set(&ring->tail, tail, tail + size);
+
+    nxt_log_writer_wakeup();
+
+    return;
+
+sync:
+
+    (void) nxt_write_console(nxt_stderr, msg, size);
+}
+
+
+static nxt_log_ring_t *
+nxt_log_ring_create(nxt_thread_t *thr)
+{
+    nxt_log_ring_t  *ring;
+
+    ring = nxt_malloc(sizeof(nxt_log_ring_t));
+    if (nxt_slow_path(ring == NULL)) {
+        return NULL;
+    }
+
+    ring->tail = 0;
+    ring->head_cache = 0;
+    ring->dropped = 0;
+    ring->closed = 0;
+    ring->head = 0;
+    ring->reported = 0;
+
+    (void) nxt_thread_mutex_lock(&nxt_log_writer.mutex);
+
+    ring->next = nxt_log_writer.rings;
+    nxt_log_writer.rings = ring;
+
+    (void) nxt_thread_mutex_unlock(&nxt_log_writer.mutex);
+
+    thr->log_ring = ring;
+
+    return ring;
+}
+
+
+/* The ring is freed by the writer after it has been drained. */
+
+void
+nxt_log_ring_release(nxt_log_ring_t *ring)
+{
+    (void) nxt_atomic_cmp_set(&ring->closed, 0, 1);
+}
+
+
+void
+nxt_log_writer_wakeup(void)
+{
+    if (nxt_log_writer.sleeping
+        && nxt_atomic_cmp_set(&nxt_log_writer.sleeping, 1, 0))
+    {
+        (void) nxt_sem_post(&nxt_log_writer.sem);
+    }
+}
+
+
+static void
+nxt_log_writer_loop(void *data)
+{
+    nxt_uint_t    quit;
+    nxt_thread_t  *thr;
+
+    thr = nxt_thread();
+    nxt_log_writer.thread = thr;
+
+    for ( ;; ) {
+        quit = nxt_log_writer.quit;
+
+        if (nxt_log_writer_flush(thr)) {
+            continue;
+        }
+
+        if (quit) {
+            break;
+        }
+
+        /*
+         * A message published after the sleeping flag has been set
+         * either is found by the second drain or wakes the writer up.
+         */
+
+        (void) nxt_atomic_cmp_set(&nxt_log_writer.sleeping, 0, 1);
+
+        if (!nxt_log_writer_flush(thr)) {
+            (void) nxt_sem_wait(&nxt_log_writer.sem, NXT_LOG_WRITER_TIMEOUT);
+        }
+
+        nxt_log_writer.sleeping = 0;
+    }
+
+    nxt_log_writer.thread = NULL;
+}
+
+
+static nxt_bool_t
+nxt_log_writer_flush(nxt_thread_t *thr)
+{
+    nxt_bool_t  done;
+
+    done = nxt_log_writer_drain(thr);
+
+    if (nxt_access_log_flush()) {
+        done = 1;
+    }
+
+    return done;
+}
+
+
+static nxt_bool_t
+nxt_log_writer_drain(nxt_thread_t *thr)
+{
+    size_t                  size;
+    ssize_t                 n;
+    nxt_uint_t              i, nchunks, niov, dropped, pos, head, tail;
+    nxt_bool_t              closed;
+    nxt_log_ring_t          *ring, **prev;
+    nxt_log_writer_chunk_t  chunks[NXT_LOG_WRITER_IOVS / 2];
+    struct iovec            iov[NXT_LOG_WRITER_IOVS];
+
+    nchunks = 0;
+    niov = 0;
+    size = 0;
+    dropped = 0;
+
+    (void) nxt_thread_mutex_lock(&nxt_log_writer.mutex);
+
+    prev = &nxt_log_writer.rings;
+
+    for (ring = *prev; ring != NULL; ring = *prev) {
+
+        /* The "closed" flag is tested before the final tail is read. */
+        closed = nxt_atomic_fetch_add(&ring->closed, 0);
+        tail = nxt_atomic_fetch_add(&ring->tail, 0);
+        head = ring->head;
+
+        if (ring->dropped != ring->reported) {
+            dropped += ring->dropped - ring->reported;
+            ring->reported = ring->dropped;
+        }
+
+        if (head == tail) {
+            if (closed) {
+                *prev = ring->next;
+                nxt_free(ring);
+                continue;
+            }
+
+            prev = &ring->next;
+            continue;
+        }
+
+        if (nchunks == NXT_LOG_WRITER_IOVS / 2) {
+            break;
+        }
+
+        chunks[nchunks].ring = ring;
+        chunks[nchunks].size = tail - head;
+        nchunks++;
+
+        pos = head & NXT_LOG_RING_MASK;
+
+        iov[niov].iov_base = &ring->buffer[pos];
+        iov[niov].iov_len = nxt_min(tail - head, NXT_LOG_RING_SIZE - pos);
+
+        if (iov[niov].iov_len != tail - head) {
+            niov++;
+            iov[niov].iov_base = ring->buffer;
+            iov[niov].iov_len = tail - head - iov[niov - 1].iov_len;
+        }
+
+        niov++;
+        size += tail - head;
+
+        prev = &ring->next;
+    }
+
+    (void) nxt_thread_mutex_unlock(&nxt_log_writer.mutex);
+
+    if (dropped != 0) {
+        nxt_log_writer.dropped += dropped;
+
+        nxt_log_error(NXT_LOG_WARN, thr->log,
+                      "%ui log messages have been dropped", dropped);
+    }
+
+    if (niov == 0) {
+        return 0;
+    }
+
+    n = writev(nxt_stderr, iov, niov);
+
+    if (n == -1) {
+        if (nxt_errno == NXT_EINTR) {
+            return 1;
+        }
+
+        /* The messages are discarded to not retry a failing write forever. */
+        n = size;
+    }
+
+    /* The rings are released in order of the written data. */
+
+    for (i = 0; i < nchunks && n > 0; i++) {
+        size = nxt_min((size_t) n, chunks[i].size);
+
+        (void) nxt_atomic_fetch_add(&chunks[i].ring->head, size);
+
+        n -= size;
+    }
+
+    return 1;
+}
@@ -0,0 +1,43 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NXT_LOG_WRITER_H_INCLUDED_
+#define _NXT_LOG_WRITER_H_INCLUDED_
+
+
+/*
+ * The log writer moves writing of log messages out of the logging threads.
+ * Each thread copies its messages to its own ring buffer and a dedicated
+ * writer thread drains all the rings to the stderr file descriptor with
+ * writev().  The stderr descriptor is replaced by dup2() on log file
+ * reopening, so the writer continues to write to the new file.
+ * The writer also renders access log records, see nxt_access_log.h.
+ */
+
+typedef enum {
+    /* A thread waits while its ring buffer is full. */
+    NXT_LOG_OVERFLOW_BLOCK = 0,
+    /* A message is dropped and counted if the ring buffer is full. */
+    NXT_LOG_OVERFLOW_DROP
+} nxt_log_overflow_t;
+
+
+typedef struct nxt_log_ring_s  nxt_log_ring_t;
+
+
+NXT_EXPORT nxt_int_t nxt_log_writer_start(nxt_log_overflow_t overflow);
+NXT_EXPORT void nxt_log_writer_stop(void);
+NXT_EXPORT void nxt_log_writer_wakeup(void);
+NXT_EXPORT nxt_uint_t nxt_log_writer_dropped(void);
+
+/*
+ * nxt_log_write() writes a message synchronously if the log writer
+ * is not started.
+ */
+NXT_EXPORT void nxt_log_write(u_char *msg, size_t size);
+NXT_EXPORT void nxt_log_ring_release(nxt_log_ring_t *ring);
+
+
+#endif /* _NXT_LOG_WRITER_H_INCLUDED_ */
@@ -26,6 +26,7 @@ typedef struct nxt_thread_s          nxt_thread_t;
 typedef struct nxt_event_engine_s    nxt_event_engine_t;
 typedef struct nxt_log_s             nxt_log_t;
 typedef struct nxt_thread_pool_s     nxt_thread_pool_t;
+typedef struct nxt_thread_pool_worker_s  nxt_thread_pool_worker_t;
 
 typedef void (*nxt_work_handler_t)(nxt_task_t *task, void *obj, void *data);
 
@@ -48,10 +49,13 @@ typedef uint16_t                     nxt_port_id_t;
 #include <nxt_random.h>
 #include <nxt_string.h>
 #include <nxt_lvlhsh.h>
+#include <nxt_flathsh.h>
 #include <nxt_atomic.h>
 #include <nxt_spinlock.h>
 #include <nxt_work_queue.h>
 #include <nxt_log.h>
+#include <nxt_log_writer.h>
+#include <nxt_access_log.h>
 #include <nxt_thread_time.h>
 #include <nxt_rbtree.h>
 #include <nxt_timer.h>
@@ -138,6 +142,7 @@ typedef void (*nxt_event_conn_handler_t)(nxt_thread_t *thr, nxt_conn_t *c);
 #include <nxt_listen_socket.h>
 
 #include <nxt_conn.h>
+#include <nxt_http_date.h>
 #include <nxt_event_engine.h>
 
 #include <nxt_job.h>
@@ -146,6 +146,18 @@ static nxt_conf_map_t  nxt_common_app_conf[] = {
         offsetof(nxt_common_app_conf_t, u.php.index),
     },
 
+    {
+        nxt_string("stat_interval"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_common_app_conf_t, u.php.stat_interval),
+    },
+
+    {
+        nxt_string("threads"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_common_app_conf_t, u.php.threads),
+    },
+
     {
         nxt_string("executable"),
         NXT_CONF_MAP_CSTRZ,
@@ -413,6 +425,8 @@ nxt_main_start_worker_process(nxt_task_t *task, nxt_runtime_t *rt,
 
     nxt_sprintf(title, end, "\"%V\" application%Z", &app_conf->name);
 
+    nxt_app_module_preload(task, &app_conf->type);
+
     init->start = nxt_app_start;
     init->name = (char *) title;
     init->port_handlers = nxt_app_process_port_handlers;
@@ -28,6 +28,35 @@ nxt_mem_mmap(void *addr, size_t len, nxt_uint_t protection, nxt_uint_t flags,
 }
 
 
+/*
+ * nxt_mem_mmap_huge() maps anonymous memory backed by huge pages
+ * if possible and falls back to ordinary pages otherwise.
+ */
+
+void *
+nxt_mem_mmap_huge(size_t len, nxt_uint_t protection, nxt_uint_t flags)
+{
+#if (NXT_HAVE_MAP_HUGETLB)
+    void  *p;
+
+    if (len % NXT_MEM_MAP_HUGE_SIZE == 0) {
+        p = mmap(NULL, len, protection, flags | NXT_MEM_MAP_HUGE, -1, 0);
+
+        if (p != MAP_FAILED) {
+            nxt_thread_log_debug("mmap(%uz, %uxi, %uxi) huge: %p",
+                                 len, protection, flags, p);
+            return p;
+        }
+
+        nxt_thread_log_debug("mmap(%uz, %uxi, %uxi) huge failed %E",
+                             len, protection, flags, nxt_errno);
+    }
+#endif
+
+    return nxt_mem_mmap(NULL, len, protection, flags, -1, 0);
+}
+
+
 void
 nxt_mem_munmap(void *addr, size_t len)
 {
@@ -43,6 +43,16 @@
 #define NXT_MEM_MAP_FILE      (MAP_SHARED | NXT_MEM_MAP_PREFAULT)
 
 
+#if (NXT_HAVE_MAP_HUGETLB)
+/*
+ * Linux MAP_HUGETLB mappings succeed only if huge pages are reserved
+ * and the length is a multiple of the huge page size.
+ */
+#define NXT_MEM_MAP_HUGE      MAP_HUGETLB
+#define NXT_MEM_MAP_HUGE_SIZE (2 * 1024 * 1024)
+#endif
+
+
 #define                                                                       \
     nxt_mem_map_file_ctx_t(ctx)
 
@@ -59,6 +69,8 @@ nxt_mem_unmap(addr, ctx, len)                                                 \
 
 NXT_EXPORT void *nxt_mem_mmap(void *addr, size_t len, nxt_uint_t protection,
     nxt_uint_t flags, nxt_fd_t fd, nxt_off_t offset);
+NXT_EXPORT void *nxt_mem_mmap_huge(size_t len, nxt_uint_t protection,
+    nxt_uint_t flags);
 NXT_EXPORT void nxt_mem_munmap(void *addr, size_t len);
 
 
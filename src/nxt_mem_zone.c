@@ -18,6 +18,18 @@
 #define NXT_MEM_ZONE_PAGE_USED      2
 
 
+/*
+ * The zone has up to NXT_MEM_ZONE_CACHES caches of free chunks, a cache
+ * is chosen by CPU the allocating thread runs on.  The caches reside in
+ * the zone and so they are shared by all processes using the zone.
+ * A cache may hold a page for each slot, so there are no more caches
+ * than the zone can spare 1/NXT_MEM_ZONE_CACHE_SHARE of its pages for.
+ */
+#define NXT_MEM_ZONE_CACHES         16
+#define NXT_MEM_ZONE_CACHE_SHARE    32
+#define NXT_MEM_ZONE_CACHE_MAX      32
+
+
 typedef struct nxt_mem_zone_page_s  nxt_mem_zone_page_t;
 
 struct nxt_mem_zone_page_s {
@@ -59,10 +71,26 @@ typedef struct {
     uint32_t               chunks;
     uint32_t               start;
     uint32_t               map_size;
+    /* The maximum number of the slot chunks in a cache. */
+    uint32_t               cache_max;
     nxt_mem_zone_page_t    *pages;
 } nxt_mem_zone_slot_t;
 
 
+typedef struct {
+    /* Free chunks linked through their first word. */
+    void                   *chunks;
+    uint32_t               count;
+} nxt_mem_zone_magazine_t;
+
+
+typedef struct {
+    nxt_thread_spinlock_t    lock;
+    /* A magazine for each zone slot. */
+    nxt_mem_zone_magazine_t  slots[];
+} nxt_mem_zone_cache_t;
+
+
 typedef struct {
     NXT_RBTREE_NODE        (node);
     uint32_t               size;
@@ -80,6 +108,17 @@ struct nxt_mem_zone_s {
     uint32_t               max_chunk_size;
     uint32_t               small_bitmap_min_size;
 
+    /* Allocation failures are expected, e.g. by caches evicting entries. */
+    uint8_t                log_nomem;       /* 1 bit */
+
+    uint32_t               npages;
+    uint32_t               nslots;
+
+    /* The caches, each cache_size bytes long. */
+    u_char                 *caches;
+    uint32_t               ncaches;
+    uint32_t               cache_size;
+
     u_char                 *start;
     u_char                 *end;
 
@@ -122,6 +161,11 @@ nxt_mem_zone_chunk_is_free(map, chunk)                                        \
     ((map[chunk / 8] & (0x80 >> (chunk & 7))) == 0)
 
 
+#define                                                                       \
+nxt_mem_zone_cache_slot(zone, cache, slot)                                    \
+    &(cache)->slots[(slot) - (zone)->slots]
+
+
 #define                                                                       \
 nxt_mem_zone_fresh_junk(p, size)                                              \
     nxt_memset((p), 0xA5, size)
@@ -140,6 +184,13 @@ static void nxt_mem_zone_slot_init(nxt_mem_zone_slot_t *slot,
     nxt_uint_t page_size);
 static intptr_t nxt_mem_zone_rbtree_compare(nxt_rbtree_node_t *node1,
     nxt_rbtree_node_t *node2);
+static nxt_mem_zone_cache_t *nxt_mem_zone_cache(nxt_mem_zone_t *zone);
+static void *nxt_mem_zone_cache_alloc(nxt_mem_zone_t *zone,
+    nxt_mem_zone_slot_t *slot, size_t size);
+static nxt_bool_t nxt_mem_zone_cache_free(nxt_mem_zone_t *zone,
+    nxt_mem_zone_page_t *page, void *p);
+static void nxt_mem_zone_cache_flush(nxt_mem_zone_t *zone,
+    nxt_mem_zone_slot_t *slot, nxt_mem_zone_magazine_t *mag, nxt_uint_t n);
 static void *nxt_mem_zone_alloc_small(nxt_mem_zone_t *zone,
     nxt_mem_zone_slot_t *slot, size_t size);
 static nxt_uint_t nxt_mem_zone_alloc_chunk(uint8_t *map, nxt_uint_t offset,
@@ -185,9 +236,16 @@ nxt_mem_zone_init(u_char *start, size_t zone_size, nxt_uint_t page_size)
     zone = (nxt_mem_zone_t *) start;
 
     /* The function returns address after all slots. */
-    page = nxt_mem_zone_slots_init(zone, page_size);
+    zone->caches = nxt_align_ptr(nxt_mem_zone_slots_init(zone, page_size), 64);
+
+    page = (nxt_mem_zone_page_t *)
+               (zone->caches + NXT_MEM_ZONE_CACHES * zone->cache_size);
 
     zone->pages = page;
+    zone->npages = pages;
+    zone->ncaches = nxt_min(pages / (zone->nslots * NXT_MEM_ZONE_CACHE_SHARE),
+                            NXT_MEM_ZONE_CACHES);
+    zone->log_nomem = 1;
 
     for (n = 0; n < pages; n++) {
         page[n].size = NXT_MEM_ZONE_PAGE_FRESH;
@@ -249,6 +307,12 @@ nxt_mem_zone_pages(u_char *start, size_t zone_size, nxt_uint_t page_size)
      */
     reserved = sizeof(nxt_mem_zone_t) + (n * sizeof(nxt_mem_zone_slot_t));
 
+    /* Each cache occupies its own CPU cache lines. */
+    size = nxt_align_size(sizeof(nxt_mem_zone_cache_t)
+                          + n * sizeof(nxt_mem_zone_magazine_t), 64);
+
+    reserved += 64 + NXT_MEM_ZONE_CACHES * size;
+
     end = nxt_trunc_ptr(start + zone_size, page_size);
     zone_size = end - start;
 
@@ -264,6 +328,8 @@ nxt_mem_zone_pages(u_char *start, size_t zone_size, nxt_uint_t page_size)
 
     zone = (nxt_mem_zone_t *) start;
 
+    zone->nslots = n;
+    zone->cache_size = size;
     zone->start = nxt_align_ptr(start + reserved, page_size);
     zone->end = end;
 
@@ -345,6 +411,13 @@ nxt_mem_zone_slot_init(nxt_mem_zone_slot_t *slot, nxt_uint_t page_size)
      */
     slot->start = page_size - slot->chunks * slot->size;
 
+    /*
+     * A cache may keep free chunks up to a quarter of page
+     * but at least one chunk.
+     */
+    slot->cache_max = nxt_min(nxt_max(page_size / 4 / slot->size, 1),
+                              NXT_MEM_ZONE_CACHE_MAX);
+
     /* slot->chunks should be one less than actual number of chunks. */
     slot->chunks--;
 
@@ -449,6 +522,13 @@ nxt_mem_zone_zalloc(nxt_mem_zone_t *zone, size_t size)
 }
 
 
+void
+nxt_mem_zone_log_nomem(nxt_mem_zone_t *zone, nxt_bool_t log)
+{
+    zone->log_nomem = log;
+}
+
+
 void *
 nxt_mem_zone_align(nxt_mem_zone_t *zone, size_t alignment, size_t size)
 {
@@ -460,6 +540,8 @@ nxt_mem_zone_align(nxt_mem_zone_t *zone, size_t alignment, size_t size)
         return NULL;
     }
 
+    slot = NULL;
+
     if (size <= zone->max_chunk_size && alignment <= zone->max_chunk_size) {
         /* All chunks are aligned to 16. */
 
@@ -484,10 +566,19 @@ nxt_mem_zone_align(nxt_mem_zone_t *zone, size_t alignment, size_t size)
         nxt_thread_log_debug("mem zone alloc: @%uz:%uz chunk:%uD",
                              alignment, size, slot->size);
 
+        p = nxt_mem_zone_cache_alloc(zone, slot, size);
+
+        if (nxt_fast_path(p != NULL)) {
+            nxt_thread_log_debug("mem zone alloc: %p", p);
+            return p;
+        }
+
         nxt_thread_spin_lock(&zone->lock);
 
         p = nxt_mem_zone_alloc_small(zone, slot, size);
 
+        nxt_thread_spin_unlock(&zone->lock);
+
     } else {
 
         nxt_thread_log_debug("mem zone alloc: @%uz:%uz", alignment, size);
@@ -495,14 +586,33 @@ nxt_mem_zone_align(nxt_mem_zone_t *zone, size_t alignment, size_t size)
         nxt_thread_spin_lock(&zone->lock);
 
         p = nxt_mem_zone_alloc_large(zone, alignment, size);
+
+        nxt_thread_spin_unlock(&zone->lock);
     }
 
-    nxt_thread_spin_unlock(&zone->lock);
+    if (nxt_slow_path(p == NULL)) {
+        /*
+         * The caches may keep pages which are enough to allocate
+         * after the pages are coalesced.
+         */
+        nxt_mem_zone_flush(zone);
+
+        nxt_thread_spin_lock(&zone->lock);
+
+        if (slot != NULL) {
+            p = nxt_mem_zone_alloc_small(zone, slot, size);
+
+        } else {
+            p = nxt_mem_zone_alloc_large(zone, alignment, size);
+        }
+
+        nxt_thread_spin_unlock(&zone->lock);
+    }
 
     if (nxt_fast_path(p != NULL)) {
         nxt_thread_log_debug("mem zone alloc: %p", p);
 
-    } else {
+    } else if (zone->log_nomem) {
         nxt_log_moderate(&nxt_mem_zone_log_moderation,
                     NXT_LOG_ALERT, nxt_thread_log(),
                     "nxt_mem_zone_alloc(%uz, %uz) failed, not enough memory",
@@ -586,6 +696,227 @@ nxt_mem_zone_alloc_small(nxt_mem_zone_t *zone, nxt_mem_zone_slot_t *slot,
 }
 
 
+static nxt_mem_zone_cache_t *
+nxt_mem_zone_cache(nxt_mem_zone_t *zone)
+{
+    nxt_uint_t  n;
+
+#if (NXT_HAVE_SCHED_GETCPU)
+    int  cpu;
+
+    cpu = sched_getcpu();
+
+    n = (cpu >= 0) ? (nxt_uint_t) cpu : (nxt_uint_t) nxt_thread_tid(NULL);
+#else
+    n = (nxt_uint_t) nxt_thread_tid(NULL);
+#endif
+
+    n %= zone->ncaches;
+
+    return (nxt_mem_zone_cache_t *) (zone->caches + n * zone->cache_size);
+}
+
+
+/*
+ * A cache is refilled by half of its capacity at once and returns half
+ * of its chunks when it is full, so the zone lock is acquired once per
+ * several allocations and frees.  If the cache is locked by another
+ * thread, the zone is used directly.
+ */
+
+static void *
+nxt_mem_zone_cache_alloc(nxt_mem_zone_t *zone, nxt_mem_zone_slot_t *slot,
+    size_t size)
+{
+    void                     *p;
+    nxt_uint_t               n;
+    nxt_mem_zone_cache_t     *cache;
+    nxt_mem_zone_magazine_t  *mag;
+
+    if (zone->ncaches == 0) {
+        return NULL;
+    }
+
+    cache = nxt_mem_zone_cache(zone);
+
+    if (!nxt_thread_spin_trylock(&cache->lock)) {
+        return NULL;
+    }
+
+    mag = nxt_mem_zone_cache_slot(zone, cache, slot);
+
+    if (mag->count == 0) {
+        n = (slot->cache_max + 1) / 2;
+
+        nxt_thread_spin_lock(&zone->lock);
+
+        do {
+            p = nxt_mem_zone_alloc_small(zone, slot, size);
+
+            if (p == NULL) {
+                break;
+            }
+
+            *(void **) p = mag->chunks;
+            mag->chunks = p;
+            mag->count++;
+
+            n--;
+
+        } while (n != 0);
+
+        nxt_thread_spin_unlock(&zone->lock);
+    }
+
+    p = mag->chunks;
+
+    if (nxt_fast_path(p != NULL)) {
+        mag->chunks = *(void **) p;
+        mag->count--;
+    }
+
+    nxt_thread_spin_unlock(&cache->lock);
+
+    return p;
+}
+
+
+static nxt_bool_t
+nxt_mem_zone_cache_free(nxt_mem_zone_t *zone, nxt_mem_zone_page_t *page,
+    void *p)
+{
+    uint32_t                 size, offset;
+    nxt_mem_zone_slot_t      *slot;
+    nxt_mem_zone_cache_t     *cache;
+    nxt_mem_zone_magazine_t  *mag;
+
+    if (zone->ncaches == 0) {
+        return 0;
+    }
+
+    /*
+     * The page size is not changed while the page has allocated chunks,
+     * so it can be tested without the zone lock.
+     */
+    size = page->size;
+
+    if (size < 16) {
+        /* The page is not chunked. */
+        return 0;
+    }
+
+    for (slot = zone->slots; slot->size < size; slot++) { /* void */ }
+
+    offset = ((uintptr_t) p & zone->page_size_mask) - slot->start;
+
+    if (nxt_slow_path(slot->size != size || offset % size != 0)) {
+        /* The zone reports the error. */
+        return 0;
+    }
+
+    cache = nxt_mem_zone_cache(zone);
+
+    if (!nxt_thread_spin_trylock(&cache->lock)) {
+        return 0;
+    }
+
+    mag = nxt_mem_zone_cache_slot(zone, cache, slot);
+
+    if (mag->count == slot->cache_max) {
+        nxt_thread_spin_lock(&zone->lock);
+
+        nxt_mem_zone_cache_flush(zone, slot, mag, (slot->cache_max + 1) / 2);
+
+        nxt_thread_spin_unlock(&zone->lock);
+    }
+
+    nxt_mem_zone_free_junk(p, size);
+
+    *(void **) p = mag->chunks;
+    mag->chunks = p;
+    mag->count++;
+
+    nxt_thread_spin_unlock(&cache->lock);
+
+    return 1;
+}
+
+
+/* The cache and the zone must be locked. */
+
+static void
+nxt_mem_zone_cache_flush(nxt_mem_zone_t *zone, nxt_mem_zone_slot_t *slot,
+    nxt_mem_zone_magazine_t *mag, nxt_uint_t n)
+{
+    void                 *p;
+    const char           *err;
+    nxt_mem_zone_page_t  *page;
+
+    while (n != 0 && mag->chunks != NULL) {
+        p = mag->chunks;
+        mag->chunks = *(void **) p;
+        mag->count--;
+        n--;
+
+        page = nxt_mem_zone_addr_page(zone, p);
+
+        err = nxt_mem_zone_free_chunk(zone, page, p);
+
+        if (nxt_slow_path(err != NULL)) {
+            /* Double frees to a cache are found here. */
+            nxt_thread_log_alert("nxt_mem_zone_free(%p): %s", p, err);
+        }
+    }
+}
+
+
+void
+nxt_mem_zone_flush(nxt_mem_zone_t *zone)
+{
+    nxt_uint_t            i, n;
+    nxt_mem_zone_slot_t   *slot;
+    nxt_mem_zone_cache_t  *cache;
+
+    for (i = 0; i < zone->ncaches; i++) {
+        cache = (nxt_mem_zone_cache_t *) (zone->caches + i * zone->cache_size);
+
+        nxt_thread_spin_lock(&cache->lock);
+        nxt_thread_spin_lock(&zone->lock);
+
+        slot = zone->slots;
+
+        for (n = 0; n < zone->nslots; n++) {
+            nxt_mem_zone_cache_flush(zone, &slot[n], &cache->slots[n],
+                                     slot[n].cache_max);
+        }
+
+        nxt_thread_spin_unlock(&zone->lock);
+        nxt_thread_spin_unlock(&cache->lock);
+    }
+}
+
+
+nxt_bool_t
+nxt_mem_zone_is_empty(nxt_mem_zone_t *zone)
+{
+    nxt_bool_t                 empty;
+    nxt_rbtree_node_t          *node;
+    nxt_mem_zone_free_block_t  *block;
+
+    nxt_thread_spin_lock(&zone->lock);
+
+    node = nxt_rbtree_root(&zone->free_pages);
+    block = (nxt_mem_zone_free_block_t *) node;
+
+    empty = (node != nxt_rbtree_sentinel(&zone->free_pages)
+             && block->size == zone->npages);
+
+    nxt_thread_spin_unlock(&zone->lock);
+
+    return empty;
+}
+
+
 static nxt_uint_t
 nxt_mem_zone_alloc_chunk(uint8_t *map, nxt_uint_t offset, nxt_uint_t size)
 {
@@ -791,6 +1122,10 @@ nxt_mem_zone_free(nxt_mem_zone_t *zone, void *p)
     {
         page = nxt_mem_zone_addr_page(zone, p);
 
+        if (nxt_fast_path(nxt_mem_zone_cache_free(zone, page, p))) {
+            return;
+        }
+
         nxt_thread_spin_lock(&zone->lock);
 
         if (nxt_mem_zone_page_is_chunked(page)) {
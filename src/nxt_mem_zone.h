@@ -13,6 +13,7 @@ typedef struct nxt_mem_zone_s  nxt_mem_zone_t;
 
 NXT_EXPORT nxt_mem_zone_t *nxt_mem_zone_init(u_char *start, size_t zone_size,
     nxt_uint_t page_size);
+NXT_EXPORT void nxt_mem_zone_log_nomem(nxt_mem_zone_t *zone, nxt_bool_t log);
 
 #define                                                                       \
 nxt_mem_zone_alloc(zone, size)                                                \
@@ -25,5 +26,12 @@ NXT_EXPORT void *nxt_mem_zone_zalloc(nxt_mem_zone_t *zone, size_t size)
     NXT_MALLOC_LIKE;
 NXT_EXPORT void nxt_mem_zone_free(nxt_mem_zone_t *zone, void *p);
 
+/*
+ * nxt_mem_zone_flush() returns free chunks kept in the zone caches
+ * to the zone pages.
+ */
+NXT_EXPORT void nxt_mem_zone_flush(nxt_mem_zone_t *zone);
+NXT_EXPORT nxt_bool_t nxt_mem_zone_is_empty(nxt_mem_zone_t *zone);
+
 
 #endif /* _NXT_MEM_ZONE_H_INCLUDED_ */
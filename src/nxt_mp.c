@@ -16,9 +16,16 @@
  * with different chunk sizes and non-freeable pages.  Cluster size must be
  * a multiple of page size and may be not a power of 2.  Allocations greater
  * than page are allocated outside clusters.  Start addresses and sizes of
- * the clusters and large allocations are stored in rbtree blocks to find
- * them on free operations.  The rbtree nodes are sorted by start addresses.
- * The rbtree is also used to destroy memory pool.
+ * the clusters and large allocations are stored in blocks which are kept
+ * in an open addressing hash by start addresses.  Clusters are aligned to
+ * a power of 2 not less than cluster size, so a cluster of freed memory
+ * is found by the aligned address and a large allocation is found by
+ * its own address.  The hash is also used to destroy memory pool.
+ *
+ * Clusters of destroyed pools are kept in a thread cache and are reused
+ * by new pools with the same cluster geometry, so short-lived pools
+ * created by a thread for connections and requests do not call malloc()
+ * and free() for clusters.
  */
 
 
@@ -87,7 +94,6 @@ typedef enum {
 
 
 typedef struct {
-    NXT_RBTREE_NODE      (node);
     nxt_mp_block_type_t  type:8;
 
     /* Block size must be less than 4G. */
@@ -98,15 +104,21 @@ typedef struct {
 } nxt_mp_block_t;
 
 
+#define NXT_MP_BLOCKS_INLINE  8
+
+
 struct nxt_mp_s {
-    /* rbtree of nxt_mp_block_t. */
-    nxt_rbtree_t         blocks;
+    /* Hash of nxt_mp_block_t, the size is blocks_mask + 1. */
+    nxt_mp_block_t       **blocks;
+    uint32_t             blocks_mask;
+    uint32_t             nblocks;
 
     uint8_t              chunk_size_shift;
     uint8_t              page_size_shift;
     uint32_t             page_size;
     uint32_t             page_alignment;
     uint32_t             cluster_size;
+    uint32_t             cluster_alignment;
     uint32_t             retain;
 
 #if (NXT_DEBUG)
@@ -116,6 +128,8 @@ struct nxt_mp_s {
 
     nxt_work_t           *cleanup;
 
+    nxt_mp_block_t       *blocks_inline[NXT_MP_BLOCKS_INLINE];
+
     /* Lists of nxt_mp_page_t. */
     nxt_queue_t          free_pages;
     nxt_queue_t          nget_pages;
@@ -144,6 +158,36 @@ struct nxt_mp_s {
     memset((p), 0x5A, size)
 
 
+#define nxt_mp_block_hash(start)                                              \
+    ((uint32_t) (((uint64_t) ((uintptr_t) (start) >> 4)                       \
+                  * 0x9E3779B97F4A7C15ULL) >> 32))
+
+
+/*
+ * Up to NXT_MP_CACHE_SIZE bytes of clusters are cached by a thread
+ * for each of NXT_MP_CACHE_CLASSES cluster geometries.
+ */
+
+#define NXT_MP_CACHE_CLASSES  4
+#define NXT_MP_CACHE_SIZE     (64 * 1024)
+
+
+typedef struct {
+    uint32_t             cluster_size;
+    uint32_t             pages;
+    uint32_t             max;
+    uint32_t             n;
+
+    /* Free clusters linked through the first word of cluster memory. */
+    nxt_mp_block_t       *free;
+} nxt_mp_cache_class_t;
+
+
+struct nxt_mp_cache_s {
+    nxt_mp_cache_class_t  classes[NXT_MP_CACHE_CLASSES];
+};
+
+
 #if !(NXT_DEBUG_MEMORY)
 static void *nxt_mp_alloc_small(nxt_mp_t *mp, size_t size);
 static void *nxt_mp_get_small(nxt_mp_t *mp, nxt_queue_t *pages, size_t size);
@@ -151,9 +195,15 @@ static nxt_mp_page_t *nxt_mp_alloc_page(nxt_mp_t *mp);
 static nxt_mp_block_t *nxt_mp_alloc_cluster(nxt_mp_t *mp);
 #endif
 static void *nxt_mp_alloc_large(nxt_mp_t *mp, size_t alignment, size_t size);
-static intptr_t nxt_mp_rbtree_compare(nxt_rbtree_node_t *node1,
-    nxt_rbtree_node_t *node2);
-static nxt_mp_block_t *nxt_mp_find_block(nxt_rbtree_t *tree, u_char *p);
+static void nxt_mp_block_free(nxt_mp_t *mp, nxt_mp_block_t *block);
+static nxt_mp_cache_class_t *nxt_mp_cache_class(nxt_mp_t *mp,
+    nxt_bool_t add);
+static nxt_mp_block_t *nxt_mp_find_block(nxt_mp_t *mp, u_char *p);
+static nxt_mp_block_t *nxt_mp_blocks_find(nxt_mp_t *mp, u_char *start);
+static nxt_int_t nxt_mp_blocks_insert(nxt_mp_t *mp, nxt_mp_block_t *block);
+static void nxt_mp_blocks_add(nxt_mp_block_t **blocks, uint32_t mask,
+    nxt_mp_block_t *block);
+static void nxt_mp_blocks_delete(nxt_mp_t *mp, nxt_mp_block_t *block);
 static const char *nxt_mp_chunk_free(nxt_mp_t *mp, nxt_mp_block_t *cluster,
     u_char *p);
 
@@ -258,6 +308,10 @@ nxt_mp_create(size_t cluster_size, size_t page_alignment, size_t page_size,
         mp->page_size = page_size;
         mp->page_alignment = nxt_max(page_alignment, NXT_MAX_ALIGNMENT);
         mp->cluster_size = cluster_size;
+        mp->cluster_alignment = 1 << (nxt_lg2(cluster_size - 1) + 1);
+
+        mp->blocks = mp->blocks_inline;
+        mp->blocks_mask = NXT_MP_BLOCKS_INLINE - 1;
 
         chunk_pages = mp->chunk_pages;
 
@@ -270,8 +324,6 @@ nxt_mp_create(size_t cluster_size, size_t page_alignment, size_t page_size,
         nxt_queue_init(&mp->free_pages);
         nxt_queue_init(&mp->nget_pages);
         nxt_queue_init(&mp->get_pages);
-
-        nxt_rbtree_init(&mp->blocks, nxt_mp_rbtree_compare);
     }
 
     nxt_debug_alloc("mp %p create(%uz, %uz, %uz, %uz)", mp, cluster_size,
@@ -284,10 +336,9 @@ nxt_mp_create(size_t cluster_size, size_t page_alignment, size_t page_size,
 void
 nxt_mp_destroy(nxt_mp_t *mp)
 {
-    void               *p;
-    nxt_work_t         *work, *next_work;
-    nxt_mp_block_t     *block;
-    nxt_rbtree_node_t  *node, *next;
+    uint32_t        i;
+    nxt_work_t      *work, *next_work;
+    nxt_mp_block_t  *block;
 
     nxt_debug_alloc("mp %p destroy", mp);
 
@@ -302,23 +353,93 @@ nxt_mp_destroy(nxt_mp_t *mp)
         mp->cleanup = next_work;
     }
 
-    next = nxt_rbtree_root(&mp->blocks);
+    for (i = 0; i <= mp->blocks_mask; i++) {
+        block = mp->blocks[i];
 
-    while (next != nxt_rbtree_sentinel(&mp->blocks)) {
+        if (block != NULL) {
+            nxt_mp_block_free(mp, block);
+        }
+    }
 
-        node = nxt_rbtree_destroy_next(&mp->blocks, &next);
-        block = (nxt_mp_block_t *) node;
+    if (mp->blocks != mp->blocks_inline) {
+        nxt_free(mp->blocks);
+    }
 
-        p = block->start;
+    nxt_free(mp);
+}
 
-        if (block->type != NXT_MP_EMBEDDED_BLOCK) {
-            nxt_free(block);
+
+void
+nxt_mp_reset(nxt_mp_t *mp)
+{
+    uint32_t        i;
+    nxt_uint_t      n, pages;
+    nxt_work_t      *work, *next_work;
+    nxt_mp_block_t  *block;
+
+    nxt_debug_alloc("mp %p reset", mp);
+
+    nxt_mp_thread_assert(mp);
+
+    while (mp->cleanup != NULL) {
+        work = mp->cleanup;
+        next_work = work->next;
+
+        work->handler(work->task, work->obj, work->data);
+
+        mp->cleanup = next_work;
+    }
+
+    pages = mp->page_size_shift - mp->chunk_size_shift;
+
+    for (n = 0; n < pages; n++) {
+        nxt_queue_init(&mp->chunk_pages[n]);
+    }
+
+    nxt_queue_init(&mp->free_pages);
+    nxt_queue_init(&mp->nget_pages);
+    nxt_queue_init(&mp->get_pages);
+
+    i = 0;
+
+    while (i <= mp->blocks_mask) {
+        block = mp->blocks[i];
+
+        if (block != NULL && block->type != NXT_MP_CLUSTER_BLOCK) {
+            /*
+             * The deletion may move a following block to the slot,
+             * so the slot is tested again.
+             */
+            nxt_mp_blocks_delete(mp, block);
+            nxt_mp_block_free(mp, block);
+
+            continue;
         }
 
-        nxt_free(p);
+        i++;
     }
 
-    nxt_free(mp);
+    for (i = 0; i <= mp->blocks_mask; i++) {
+        block = mp->blocks[i];
+
+        if (block == NULL) {
+            continue;
+        }
+
+        /* Clusters are kept and all their pages become free. */
+
+        n = mp->cluster_size >> mp->page_size_shift;
+
+        while (n != 0) {
+            n--;
+
+            block->pages[n].size = 0;
+            block->pages[n].fails = 0;
+            block->pages[n].u.map = 0;
+
+            nxt_queue_insert_head(&mp->free_pages, &block->pages[n].link);
+        }
+    }
 }
 
 
@@ -357,8 +478,7 @@ nxt_mp_test_sizes(size_t cluster_size, size_t page_alignment, size_t page_size,
 nxt_bool_t
 nxt_mp_is_empty(nxt_mp_t *mp)
 {
-    return (nxt_rbtree_is_empty(&mp->blocks)
-            && nxt_queue_is_empty(&mp->free_pages));
+    return (mp->nblocks == 0 && nxt_queue_is_empty(&mp->free_pages));
 }
 
 
@@ -643,24 +763,43 @@ nxt_mp_alloc_page(nxt_mp_t *mp)
 static nxt_mp_block_t *
 nxt_mp_alloc_cluster(nxt_mp_t *mp)
 {
-    nxt_uint_t      n;
-    nxt_mp_block_t  *cluster;
+    nxt_uint_t            n;
+    nxt_mp_block_t        *cluster;
+    nxt_mp_cache_class_t  *cls;
 
     n = mp->cluster_size >> mp->page_size_shift;
 
-    cluster = nxt_zalloc(sizeof(nxt_mp_block_t) + n * sizeof(nxt_mp_page_t));
+    cls = nxt_mp_cache_class(mp, 0);
 
-    if (nxt_slow_path(cluster == NULL)) {
-        return NULL;
-    }
+    if (cls != NULL && cls->free != NULL) {
+        cluster = cls->free;
+        cls->free = *(nxt_mp_block_t **) cluster->start;
+        cls->n--;
+
+        nxt_memzero(cluster->pages, n * sizeof(nxt_mp_page_t));
+
+    } else {
+        cluster = nxt_zalloc(sizeof(nxt_mp_block_t)
+                             + n * sizeof(nxt_mp_page_t));
+
+        if (nxt_slow_path(cluster == NULL)) {
+            return NULL;
+        }
+
+        /* NXT_MP_CLUSTER_BLOCK type is zero. */
 
-    /* NXT_MP_CLUSTER_BLOCK type is zero. */
+        cluster->size = mp->cluster_size;
 
-    cluster->size = mp->cluster_size;
+        cluster->start = nxt_memalign(mp->cluster_alignment,
+                                      mp->cluster_size);
+        if (nxt_slow_path(cluster->start == NULL)) {
+            nxt_free(cluster);
+            return NULL;
+        }
+    }
 
-    cluster->start = nxt_memalign(mp->page_alignment, mp->cluster_size);
-    if (nxt_slow_path(cluster->start == NULL)) {
-        nxt_free(cluster);
+    if (nxt_slow_path(nxt_mp_blocks_insert(mp, cluster) != NXT_OK)) {
+        nxt_mp_block_free(mp, cluster);
         return NULL;
     }
 
@@ -675,8 +814,6 @@ nxt_mp_alloc_cluster(nxt_mp_t *mp)
                                 &cluster->pages[n].link);
     }
 
-    nxt_rbtree_insert(&mp->blocks, &cluster->node);
-
     return cluster;
 }
 
@@ -728,21 +865,114 @@ nxt_mp_alloc_large(nxt_mp_t *mp, size_t alignment, size_t size)
     block->size = size;
     block->start = p;
 
-    nxt_rbtree_insert(&mp->blocks, &block->node);
+    if (nxt_slow_path(nxt_mp_blocks_insert(mp, block) != NXT_OK)) {
+        nxt_mp_block_free(mp, block);
+        return NULL;
+    }
 
     return p;
 }
 
 
-static intptr_t
-nxt_mp_rbtree_compare(nxt_rbtree_node_t *node1, nxt_rbtree_node_t *node2)
+static void
+nxt_mp_block_free(nxt_mp_t *mp, nxt_mp_block_t *block)
 {
-    nxt_mp_block_t  *block1, *block2;
+    u_char                *p;
+    nxt_mp_cache_class_t  *cls;
 
-    block1 = (nxt_mp_block_t *) node1;
-    block2 = (nxt_mp_block_t *) node2;
+    p = block->start;
 
-    return (uintptr_t) block1->start - (uintptr_t) block2->start;
+    if (block->type == NXT_MP_CLUSTER_BLOCK) {
+        cls = nxt_mp_cache_class(mp, 1);
+
+        if (cls != NULL && cls->n < cls->max) {
+            *(nxt_mp_block_t **) p = cls->free;
+            cls->free = block;
+            cls->n++;
+
+            return;
+        }
+    }
+
+    if (block->type != NXT_MP_EMBEDDED_BLOCK) {
+        nxt_free(block);
+    }
+
+    nxt_free(p);
+}
+
+
+static nxt_mp_cache_class_t *
+nxt_mp_cache_class(nxt_mp_t *mp, nxt_bool_t add)
+{
+    uint32_t              pages;
+    nxt_uint_t            i;
+    nxt_thread_t          *thr;
+    nxt_mp_cache_t        *cache;
+    nxt_mp_cache_class_t  *cls;
+
+    thr = nxt_thread();
+    cache = thr->mp_cache;
+
+    if (cache == NULL) {
+        if (!add) {
+            return NULL;
+        }
+
+        cache = nxt_zalloc(sizeof(nxt_mp_cache_t));
+        if (nxt_slow_path(cache == NULL)) {
+            return NULL;
+        }
+
+        thr->mp_cache = cache;
+    }
+
+    pages = mp->cluster_size >> mp->page_size_shift;
+
+    for (i = 0; i < NXT_MP_CACHE_CLASSES; i++) {
+        cls = &cache->classes[i];
+
+        if (cls->cluster_size == mp->cluster_size && cls->pages == pages) {
+            return cls;
+        }
+
+        if (cls->cluster_size == 0) {
+            if (!add) {
+                return NULL;
+            }
+
+            cls->cluster_size = mp->cluster_size;
+            cls->pages = pages;
+            cls->max = nxt_max(NXT_MP_CACHE_SIZE / mp->cluster_size, 1);
+
+            return cls;
+        }
+    }
+
+    return NULL;
+}
+
+
+void
+nxt_mp_cache_free(nxt_mp_cache_t *cache)
+{
+    nxt_uint_t            i;
+    nxt_mp_block_t        *cluster;
+    nxt_mp_cache_class_t  *cls;
+
+    for (i = 0; i < NXT_MP_CACHE_CLASSES; i++) {
+        cls = &cache->classes[i];
+
+        while (cls->free != NULL) {
+            cluster = cls->free;
+            cls->free = *(nxt_mp_block_t **) cluster->start;
+
+            nxt_free(cluster->start);
+            nxt_free(cluster);
+        }
+    }
+
+    nxt_free(cache);
 }
 
 
@@ -757,7 +987,7 @@ nxt_mp_free(nxt_mp_t *mp, void *p)
 
     nxt_debug_alloc("mp %p free(%p)", mp, p);
 
-    block = nxt_mp_find_block(&mp->blocks, p);
+    block = nxt_mp_find_block(mp, p);
 
     if (nxt_fast_path(block != NULL)) {
 
@@ -769,7 +999,7 @@ nxt_mp_free(nxt_mp_t *mp, void *p)
             }
 
         } else if (nxt_fast_path(p == block->start)) {
-            nxt_rbtree_delete(&mp->blocks, &block->node);
+            nxt_mp_blocks_delete(mp, block);
 
             if (block->type == NXT_MP_DISCRETE_BLOCK) {
                 nxt_free(block);
@@ -794,30 +1024,138 @@ nxt_mp_free(nxt_mp_t *mp, void *p)
 
 
 static nxt_mp_block_t *
-nxt_mp_find_block(nxt_rbtree_t *tree, u_char *p)
+nxt_mp_find_block(nxt_mp_t *mp, u_char *p)
 {
-    nxt_mp_block_t     *block;
-    nxt_rbtree_node_t  *node, *sentinel;
+    u_char          *start;
+    nxt_mp_block_t  *block;
 
-    node = nxt_rbtree_root(tree);
-    sentinel = nxt_rbtree_sentinel(tree);
+    /* A cluster or an aligned large allocation. */
 
-    while (node != sentinel) {
+    start = nxt_trunc_ptr(p, mp->cluster_alignment);
 
-        block = (nxt_mp_block_t *) node;
+    block = nxt_mp_blocks_find(mp, start);
 
-        if (p < block->start) {
-            node = node->left;
+    if (block != NULL && p < block->start + block->size) {
+        return block;
+    }
 
-        } else if (p >= block->start + block->size) {
-            node = node->right;
+    return nxt_mp_blocks_find(mp, p);
+}
 
-        } else {
+
+static nxt_mp_block_t *
+nxt_mp_blocks_find(nxt_mp_t *mp, u_char *start)
+{
+    uint32_t        i;
+    nxt_mp_block_t  *block;
+
+    i = nxt_mp_block_hash(start) & mp->blocks_mask;
+
+    for ( ;; ) {
+        block = mp->blocks[i];
+
+        if (block == NULL || block->start == start) {
             return block;
         }
+
+        i = (i + 1) & mp->blocks_mask;
     }
+}
 
-    return NULL;
+
+static nxt_int_t
+nxt_mp_blocks_insert(nxt_mp_t *mp, nxt_mp_block_t *block)
+{
+    uint32_t        i, mask;
+    nxt_mp_block_t  **blocks;
+
+    /* The hash is kept no more than 3/4 full. */
+
+    if ((mp->nblocks + 1) * 4 > (mp->blocks_mask + 1) * 3) {
+        mask = mp->blocks_mask * 2 + 1;
+
+        blocks = nxt_zalloc((mask + 1) * sizeof(nxt_mp_block_t *));
+        if (nxt_slow_path(blocks == NULL)) {
+            return NXT_ERROR;
+        }
+
+        for (i = 0; i <= mp->blocks_mask; i++) {
+            if (mp->blocks[i] != NULL) {
+                nxt_mp_blocks_add(blocks, mask, mp->blocks[i]);
+            }
+        }
+
+        if (mp->blocks != mp->blocks_inline) {
+            nxt_free(mp->blocks);
+        }
+
+        mp->blocks = blocks;
+        mp->blocks_mask = mask;
+    }
+
+    nxt_mp_blocks_add(mp->blocks, mp->blocks_mask, block);
+    mp->nblocks++;
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_mp_blocks_add(nxt_mp_block_t **blocks, uint32_t mask,
+    nxt_mp_block_t *block)
+{
+    uint32_t  i;
+
+    i = nxt_mp_block_hash(block->start) & mask;
+
+    while (blocks[i] != NULL) {
+        i = (i + 1) & mask;
+    }
+
+    blocks[i] = block;
+}
+
+
+static void
+nxt_mp_blocks_delete(nxt_mp_t *mp, nxt_mp_block_t *block)
+{
+    uint32_t        i, j, k, mask;
+    nxt_mp_block_t  **blocks;
+
+    blocks = mp->blocks;
+    mask = mp->blocks_mask;
+
+    i = nxt_mp_block_hash(block->start) & mask;
+
+    while (blocks[i] != block) {
+        i = (i + 1) & mask;
+    }
+
+    /*
+     * The following blocks are shifted back to the freed slot unless
+     * their hash slots lie cyclically between the freed slot and
+     * the block, so probe sequences are not broken.
+     */
+
+    j = i;
+
+    for ( ;; ) {
+        j = (j + 1) & mask;
+
+        if (blocks[j] == NULL) {
+            break;
+        }
+
+        k = nxt_mp_block_hash(blocks[j]->start) & mask;
+
+        if ((j > i && (k <= i || k > j)) || (j < i && (k <= i && k > j))) {
+            blocks[i] = blocks[j];
+            i = j;
+        }
+    }
+
+    blocks[i] = NULL;
+    mp->nblocks--;
 }
 
 
@@ -922,12 +1260,8 @@ nxt_mp_chunk_free(nxt_mp_t *mp, nxt_mp_block_t *cluster, u_char *p)
          n--;
     } while (n != 0);
 
-    nxt_rbtree_delete(&mp->blocks, &cluster->node);
-
-    p = cluster->start;
-
-    nxt_free(cluster);
-    nxt_free(p);
+    nxt_mp_blocks_delete(mp, cluster);
+    nxt_mp_block_free(mp, cluster);
 
     return NULL;
 }
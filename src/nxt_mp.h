@@ -24,7 +24,8 @@
  * may also improve data cache locality.
  */
 
-typedef struct nxt_mp_s  nxt_mp_t;
+typedef struct nxt_mp_s        nxt_mp_t;
+typedef struct nxt_mp_cache_s  nxt_mp_cache_t;
 
 
 /*
@@ -41,6 +42,13 @@ NXT_EXPORT nxt_mp_t *nxt_mp_create(size_t cluster_size, size_t page_alignment,
  */
 NXT_EXPORT void nxt_mp_destroy(nxt_mp_t *mp);
 
+/*
+ * nxt_mp_reset() frees all allocations and runs cleanup handlers, but
+ * keeps the pool's clusters to be reused by subsequent allocations.
+ * The pool's retention counter is not changed.
+ */
+NXT_EXPORT void nxt_mp_reset(nxt_mp_t *mp);
+
 /* nxt_mp_test_sizes() tests validity of memory pool parameters. */
 NXT_EXPORT nxt_bool_t nxt_mp_test_sizes(size_t cluster_size,
     size_t page_alignment, size_t page_size, size_t min_chunk_size);
@@ -115,4 +123,10 @@ NXT_EXPORT nxt_int_t nxt_mp_cleanup(nxt_mp_t *mp, nxt_work_handler_t handler,
 
 NXT_EXPORT void nxt_mp_thread_adopt(nxt_mp_t *mp);
 
+/*
+ * nxt_mp_cache_free() frees clusters cached by a thread for memory pools
+ * created later by the thread.
+ */
+NXT_EXPORT void nxt_mp_cache_free(nxt_mp_cache_t *cache);
+
 #endif /* _NXT_MP_H_INCLUDED_ */
@@ -8,6 +8,11 @@
 #include <openssl/ssl.h>
 #include <openssl/conf.h>
 #include <openssl/err.h>
+#include <openssl/rand.h>
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+#include <openssl/core_names.h>
+#endif
 
 
 typedef struct {
@@ -15,23 +20,65 @@ typedef struct {
 
     int            ssl_error;
     uint8_t        times;      /* 2 bits */
+    uint8_t        ktls;       /* 1 bit */
+
+    size_t         buffer_size;
+    nxt_off_t      sent;
+    nxt_msec_t     last;
 
     nxt_buf_mem_t  buffer;
 } nxt_openssl_conn_t;
 
 
+/*
+ * Session ticket keys are shared by all listeners and survive
+ * reconfiguration, so tickets issued before a listener update are
+ * still accepted.  A new key is generated each lifetime period;
+ * tickets encrypted with the previous key are accepted and renewed.
+ */
+
+#define NXT_OPENSSL_TICKET_KEY_LIFETIME  3600  /* seconds */
+
+typedef struct {
+    u_char         name[16];
+    u_char         aes_key[32];
+    u_char         hmac_key[32];
+    nxt_time_t     created;
+} nxt_openssl_ticket_key_t;
+
+
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+typedef EVP_MAC_CTX  nxt_openssl_hmac_ctx_t;
+#else
+typedef HMAC_CTX     nxt_openssl_hmac_ctx_t;
+#endif
+
+
 static nxt_int_t nxt_openssl_server_init(nxt_ssltls_conf_t *conf);
+static nxt_int_t nxt_openssl_bundle(nxt_thread_t *thr, SSL_CTX *ctx,
+    nxt_str_t *bundle);
+static void nxt_openssl_server_free(nxt_ssltls_conf_t *conf);
+static int nxt_openssl_ticket_key_handler(SSL *s, u_char *name, u_char *iv,
+    EVP_CIPHER_CTX *ectx, nxt_openssl_hmac_ctx_t *hctx, int enc);
+static nxt_int_t nxt_openssl_hmac_init(nxt_openssl_hmac_ctx_t *hctx,
+    nxt_openssl_ticket_key_t *key);
 
 static void nxt_openssl_conn_init(nxt_task_t *task, nxt_ssltls_conf_t *conf,
     nxt_conn_t *c);
-static void nxt_openssl_session_cleanup(nxt_task_t *task, void *data);
+static void nxt_openssl_session_cleanup(nxt_task_t *task, void *obj,
+    void *data);
 static void nxt_openssl_conn_handshake(nxt_task_t *task, void *obj, void *data);
 static void nxt_openssl_conn_io_read(nxt_task_t *task, void *obj, void *data);
+static void nxt_openssl_conn_io_write(nxt_task_t *task, void *obj, void *data);
+static void nxt_openssl_conn_write_timer_handler(nxt_task_t *task, void *obj,
+    void *data);
+static ssize_t nxt_openssl_conn_io_sendbuf(nxt_task_t *task, nxt_conn_t *c,
+    nxt_sendbuf_t *sb);
+static size_t nxt_openssl_record_size(nxt_task_t *task,
+    nxt_openssl_conn_t *ssltls);
+static void nxt_openssl_conn_close_notify(nxt_task_t *task, nxt_conn_t *c);
 static void nxt_openssl_conn_io_shutdown(nxt_task_t *task, void *obj,
     void *data);
-static ssize_t nxt_openssl_conn_io_write_chunk(nxt_conn_t *c, nxt_buf_t *b,
-    size_t limit);
-static ssize_t nxt_openssl_conn_io_send(nxt_conn_t *c, void *buf, size_t size);
 static nxt_int_t nxt_openssl_conn_test_error(nxt_task_t *task,
     nxt_conn_t *c, int ret, nxt_err_t sys_err, nxt_work_handler_t handler);
 static void nxt_cdecl nxt_openssl_conn_error(nxt_conn_t *c, nxt_err_t err,
@@ -45,6 +92,7 @@ static u_char *nxt_openssl_copy_error(u_char *p, u_char *end);
 const nxt_ssltls_lib_t  nxt_openssl_lib = {
     nxt_openssl_server_init,
     NULL,
+    nxt_openssl_server_free,
 };
 
 
@@ -56,11 +104,11 @@ static nxt_conn_io_t  nxt_openssl_conn_io = {
     NULL,
     NULL,
 
-    nxt_conn_io_write,
-    nxt_openssl_conn_io_write_chunk,
+    nxt_openssl_conn_io_write,
+    NULL,
+    NULL,
     NULL,
     NULL,
-    nxt_openssl_conn_io_send,
 
     nxt_openssl_conn_io_shutdown,
 };
@@ -69,6 +117,9 @@ static nxt_conn_io_t  nxt_openssl_conn_io = {
 static long  nxt_openssl_version;
 static int   nxt_openssl_connection_index;
 
+static nxt_thread_spinlock_t     nxt_openssl_ticket_lock;
+static nxt_openssl_ticket_key_t  nxt_openssl_ticket_keys[2];
+
 
 static nxt_int_t
 nxt_openssl_start(nxt_thread_t *thr)
@@ -79,6 +130,21 @@ nxt_openssl_start(nxt_thread_t *thr)
         return NXT_OK;
     }
 
+#if (OPENSSL_VERSION_NUMBER >= 0x10100003L)
+
+    if (OPENSSL_init_ssl(OPENSSL_INIT_LOAD_CONFIG, NULL) == 0) {
+        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+                              "OPENSSL_init_ssl() failed");
+        return NXT_ERROR;
+    }
+
+    nxt_openssl_version = OpenSSL_version_num();
+
+    nxt_log_error(NXT_LOG_INFO, thr->log, "%s, %xl",
+                  OpenSSL_version(OPENSSL_VERSION), nxt_openssl_version);
+
+#else
+
     SSL_load_error_strings();
 
     OPENSSL_config(NULL);
@@ -96,6 +162,8 @@ nxt_openssl_start(nxt_thread_t *thr)
     nxt_log_error(NXT_LOG_INFO, thr->log, "%s, %xl",
                   SSLeay_version(SSLEAY_VERSION), nxt_openssl_version);
 
+#endif
+
 #ifndef SSL_OP_NO_COMPRESSION
     {
         /*
@@ -141,7 +209,11 @@ nxt_openssl_server_init(nxt_ssltls_conf_t *conf)
         return NXT_ERROR;
     }
 
+#if (OPENSSL_VERSION_NUMBER >= 0x10100003L)
+    ctx = SSL_CTX_new(TLS_server_method());
+#else
     ctx = SSL_CTX_new(SSLv23_server_method());
+#endif
     if (ctx == NULL) {
         nxt_openssl_log_error(NXT_LOG_CRIT, thr->log, "SSL_CTX_new() failed");
         return NXT_ERROR;
@@ -171,22 +243,38 @@ nxt_openssl_server_init(nxt_ssltls_conf_t *conf)
 
 #endif
 
-    certificate = conf->certificate;
+#ifdef SSL_OP_ENABLE_KTLS
+    /*
+     * The kernel TLS offload allows to send static files with sendfile().
+     * OpenSSL silently falls back to userspace encryption if the kernel
+     * does not support the negotiated cipher.
+     */
+    SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
 
-    if (SSL_CTX_use_certificate_chain_file(ctx, certificate) == 0) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+    if (conf->bundle.length != 0) {
+        if (nxt_openssl_bundle(thr, ctx, &conf->bundle) != NXT_OK) {
+            goto fail;
+        }
+
+    } else {
+        certificate = conf->certificate;
+
+        if (SSL_CTX_use_certificate_chain_file(ctx, certificate) == 0) {
+            nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
                               "SSL_CTX_use_certificate_file(\"%s\") failed",
                               certificate);
-        goto fail;
-    }
+            goto fail;
+        }
 
-    key = conf->certificate_key;
+        key = conf->certificate_key;
 
-    if (SSL_CTX_use_PrivateKey_file(ctx, key, SSL_FILETYPE_PEM) == 0) {
-        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+        if (SSL_CTX_use_PrivateKey_file(ctx, key, SSL_FILETYPE_PEM) == 0) {
+            nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
                               "SSL_CTX_use_PrivateKey_file(\"%s\") failed",
                               key);
-        goto fail;
+            goto fail;
+        }
     }
 
     ciphers = (conf->ciphers != NULL) ? conf->ciphers : "HIGH:!aNULL:!MD5";
@@ -200,6 +288,40 @@ nxt_openssl_server_init(nxt_ssltls_conf_t *conf)
 
     SSL_CTX_set_options(ctx, SSL_OP_CIPHER_SERVER_PREFERENCE);
 
+    /*
+     * The context is shared by all router threads, so the sessions
+     * cached by one thread can be resumed on connections of others.
+     */
+    if (conf->session_cache != 0) {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, conf->session_cache);
+
+    } else {
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_OFF);
+    }
+
+    if (conf->session_timeout != 0) {
+        SSL_CTX_set_timeout(ctx, conf->session_timeout);
+    }
+
+    if (conf->name.length != 0) {
+        SSL_CTX_set_session_id_context(ctx, conf->name.start,
+                                       nxt_min(conf->name.length,
+                                               SSL_MAX_SID_CTX_LENGTH));
+    }
+
+    if (conf->session_tickets) {
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+        SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx,
+                                             nxt_openssl_ticket_key_handler);
+#else
+        SSL_CTX_set_tlsext_ticket_key_cb(ctx, nxt_openssl_ticket_key_handler);
+#endif
+
+    } else {
+        SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+    }
+
     if (conf->ca_certificate != NULL) {
 
         /* TODO: verify callback */
@@ -241,20 +363,242 @@ fail:
 
     SSL_CTX_free(ctx);
 
+    conf->ctx = NULL;
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+nxt_openssl_bundle(nxt_thread_t *thr, SSL_CTX *ctx, nxt_str_t *bundle)
+{
+    BIO       *bio;
+    X509      *x509, *ca;
+    u_long    err;
+    EVP_PKEY  *key;
+
+    bio = BIO_new_mem_buf(bundle->start, bundle->length);
+    if (bio == NULL) {
+        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+                              "BIO_new_mem_buf() failed");
+        return NXT_ERROR;
+    }
+
+    x509 = PEM_read_bio_X509_AUX(bio, NULL, NULL, NULL);
+    if (x509 == NULL) {
+        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+                              "PEM_read_bio_X509_AUX() failed");
+        goto fail;
+    }
+
+    if (SSL_CTX_use_certificate(ctx, x509) == 0) {
+        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+                              "SSL_CTX_use_certificate() failed");
+        X509_free(x509);
+        goto fail;
+    }
+
+    X509_free(x509);
+
+    /* The rest certificates of the chain, the key block is skipped. */
+
+    for ( ;; ) {
+        ca = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+        if (ca == NULL) {
+            break;
+        }
+
+        if (SSL_CTX_add_extra_chain_cert(ctx, ca) == 0) {
+            nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+                                  "SSL_CTX_add_extra_chain_cert() failed");
+            X509_free(ca);
+            goto fail;
+        }
+    }
+
+    err = ERR_peek_last_error();
+
+    if (ERR_GET_LIB(err) != ERR_LIB_PEM
+        || ERR_GET_REASON(err) != PEM_R_NO_START_LINE)
+    {
+        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+                              "PEM_read_bio_X509() failed");
+        goto fail;
+    }
+
+    ERR_clear_error();
+
+    (void) BIO_reset(bio);
+
+    key = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+    if (key == NULL) {
+        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+                              "PEM_read_bio_PrivateKey() failed");
+        goto fail;
+    }
+
+    if (SSL_CTX_use_PrivateKey(ctx, key) == 0) {
+        nxt_openssl_log_error(NXT_LOG_CRIT, thr->log,
+                              "SSL_CTX_use_PrivateKey() failed");
+        EVP_PKEY_free(key);
+        goto fail;
+    }
+
+    EVP_PKEY_free(key);
+
+    BIO_free(bio);
+
+    return NXT_OK;
+
+fail:
+
+    BIO_free(bio);
+
     return NXT_ERROR;
 }
 
 
+static void
+nxt_openssl_server_free(nxt_ssltls_conf_t *conf)
+{
+    if (conf->ctx != NULL) {
+        SSL_CTX_free(conf->ctx);
+        conf->ctx = NULL;
+    }
+}
+
+
+static int
+nxt_openssl_ticket_key_handler(SSL *s, u_char *name, u_char *iv,
+    EVP_CIPHER_CTX *ectx, nxt_openssl_hmac_ctx_t *hctx, int enc)
+{
+    int                       rc;
+    nxt_time_t                now;
+    nxt_uint_t                i;
+    const EVP_CIPHER          *cipher;
+    nxt_openssl_ticket_key_t  *keys, key;
+
+    cipher = EVP_aes_256_cbc();
+    keys = nxt_openssl_ticket_keys;
+
+    if (enc == 1) {
+        now = nxt_thread_time(nxt_thread());
+
+        nxt_thread_spin_lock(&nxt_openssl_ticket_lock);
+
+        if (now - keys[0].created >= NXT_OPENSSL_TICKET_KEY_LIFETIME) {
+            keys[1] = keys[0];
+
+            if (RAND_bytes(keys[0].name, sizeof(keys[0].name)) != 1
+                || RAND_bytes(keys[0].aes_key, sizeof(keys[0].aes_key)) != 1
+                || RAND_bytes(keys[0].hmac_key, sizeof(keys[0].hmac_key)) != 1)
+            {
+                keys[0] = keys[1];
+                nxt_thread_spin_unlock(&nxt_openssl_ticket_lock);
+                return -1;
+            }
+
+            keys[0].created = now;
+        }
+
+        key = keys[0];
+
+        nxt_thread_spin_unlock(&nxt_openssl_ticket_lock);
+
+        if (RAND_bytes(iv, EVP_CIPHER_iv_length(cipher)) != 1) {
+            return -1;
+        }
+
+        if (EVP_EncryptInit_ex(ectx, cipher, NULL, key.aes_key, iv) != 1) {
+            return -1;
+        }
+
+        if (nxt_openssl_hmac_init(hctx, &key) != NXT_OK) {
+            return -1;
+        }
+
+        nxt_memcpy(name, key.name, sizeof(key.name));
+
+        return 1;
+    }
+
+    rc = 0;
+
+    nxt_thread_spin_lock(&nxt_openssl_ticket_lock);
+
+    for (i = 0; i < 2; i++) {
+        if (keys[i].created != 0
+            && nxt_memcmp(name, keys[i].name, sizeof(keys[i].name)) == 0)
+        {
+            key = keys[i];
+
+            /* A ticket encrypted with the previous key should be renewed. */
+            rc = (i == 0) ? 1 : 2;
+            break;
+        }
+    }
+
+    nxt_thread_spin_unlock(&nxt_openssl_ticket_lock);
+
+    if (rc == 0) {
+        return 0;
+    }
+
+    if (EVP_DecryptInit_ex(ectx, cipher, NULL, key.aes_key, iv) != 1) {
+        return -1;
+    }
+
+    if (nxt_openssl_hmac_init(hctx, &key) != NXT_OK) {
+        return -1;
+    }
+
+    return rc;
+}
+
+
+static nxt_int_t
+nxt_openssl_hmac_init(nxt_openssl_hmac_ctx_t *hctx,
+    nxt_openssl_ticket_key_t *key)
+{
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+
+    OSSL_PARAM  params[3];
+
+    params[0] = OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,
+                                                  key->hmac_key,
+                                                  sizeof(key->hmac_key));
+    params[1] = OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+                                                 (char *) "SHA256", 0);
+    params[2] = OSSL_PARAM_construct_end();
+
+    if (EVP_MAC_CTX_set_params(hctx, params) != 1) {
+        return NXT_ERROR;
+    }
+
+#else
+
+    if (HMAC_Init_ex(hctx, key->hmac_key, sizeof(key->hmac_key),
+                     EVP_sha256(), NULL)
+        != 1)
+    {
+        return NXT_ERROR;
+    }
+
+#endif
+
+    return NXT_OK;
+}
+
+
 static void
 nxt_openssl_conn_init(nxt_task_t *task, nxt_ssltls_conf_t *conf, nxt_conn_t *c)
 {
-    int                     ret;
-    SSL                     *s;
-    SSL_CTX                 *ctx;
-    nxt_openssl_conn_t      *ssltls;
-    nxt_mem_pool_cleanup_t  *mpcl;
+    int                 ret;
+    SSL                 *s;
+    SSL_CTX             *ctx;
+    nxt_openssl_conn_t  *ssltls;
 
-    nxt_log_debug(c->socket.log, "openssl conn init");
+    nxt_debug(task, "openssl conn init");
 
     ssltls = nxt_mp_zget(c->mem_pool, sizeof(nxt_openssl_conn_t));
     if (ssltls == NULL) {
@@ -262,12 +606,7 @@ nxt_openssl_conn_init(nxt_task_t *task, nxt_ssltls_conf_t *conf, nxt_conn_t *c)
     }
 
     c->u.ssltls = ssltls;
-    nxt_buf_mem_set_size(&ssltls->buffer, conf->buffer_size);
-
-    mpcl = nxt_mem_pool_cleanup(c->mem_pool, 0);
-    if (mpcl == NULL) {
-        goto fail;
-    }
+    ssltls->buffer_size = conf->buffer_size;
 
     ctx = conf->ctx;
 
@@ -278,8 +617,13 @@ nxt_openssl_conn_init(nxt_task_t *task, nxt_ssltls_conf_t *conf, nxt_conn_t *c)
     }
 
     ssltls->session = s;
-    mpcl->handler = nxt_openssl_session_cleanup;
-    mpcl->data = ssltls;
+
+    ret = nxt_mp_cleanup(c->mem_pool, nxt_openssl_session_cleanup,
+                         &task->thread->engine->task, ssltls, NULL);
+    if (ret != NXT_OK) {
+        SSL_free(s);
+        goto fail;
+    }
 
     ret = SSL_set_fd(s, c->socket.fd);
 
@@ -311,16 +655,29 @@ fail:
 
 
 static void
-nxt_openssl_session_cleanup(nxt_task_t *task, void *data)
+nxt_openssl_session_cleanup(nxt_task_t *task, void *obj, void *data)
 {
     nxt_openssl_conn_t  *ssltls;
 
-    ssltls = data;
+    ssltls = obj;
 
     nxt_debug(task, "openssl session cleanup");
 
     nxt_free(ssltls->buffer.start);
 
+    /*
+     * OpenSSL removes a session from the cache if a connection has been
+     * closed without "close notify" alert.  However, clients often just
+     * close idle connections, so the session is kept resumable unless
+     * a protocol or system error has occurred.
+     */
+    if (ssltls->ssl_error != SSL_ERROR_SSL
+        && ssltls->ssl_error != SSL_ERROR_SYSCALL)
+    {
+        SSL_set_shutdown(ssltls->session,
+                         SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+    }
+
     SSL_free(ssltls->session);
 }
 
@@ -332,6 +689,7 @@ nxt_openssl_conn_handshake(nxt_task_t *task, void *obj, void *data)
     nxt_int_t           n;
     nxt_err_t           err;
     nxt_conn_t          *c;
+    nxt_event_engine_t  *engine;
     nxt_openssl_conn_t  *ssltls;
 
     c = obj;
@@ -349,9 +707,28 @@ nxt_openssl_conn_handshake(nxt_task_t *task, void *obj, void *data)
 
     nxt_debug(task, "SSL_do_handshake(%d): %d err:%d", c->socket.fd, ret, err);
 
+    engine = task->thread->engine;
+
     if (ret > 0) {
         /* ret == 1, the handshake was successfully completed. */
-        nxt_openssl_conn_io_read(task, c, data);
+
+#ifdef SSL_OP_ENABLE_KTLS
+        if (BIO_get_ktls_send(SSL_get_wbio(ssltls->session))) {
+            ssltls->ktls = 1;
+            c->sendfile = NXT_CONN_SENDFILE_ON;
+        }
+#endif
+
+        nxt_debug(task, "SSL %s, %s, reused:%d, ktls:%d",
+                  SSL_get_version(ssltls->session),
+                  SSL_get_cipher_name(ssltls->session),
+                  SSL_session_reused(ssltls->session), ssltls->ktls);
+
+        nxt_timer_disable(engine, &c->read_timer);
+
+        /* The read state is notified that the connection is established. */
+        nxt_work_queue_add(c->read_work_queue, c->read_state->ready_handler,
+                           task, c, data);
         return;
     }
 
@@ -362,11 +739,21 @@ nxt_openssl_conn_handshake(nxt_task_t *task, void *obj, void *data)
         nxt_openssl_conn_error(c, err, "SSL_do_handshake(%d) failed",
                                c->socket.fd);
 
+        nxt_timer_disable(engine, &c->read_timer);
+
         nxt_work_queue_add(c->read_work_queue, c->read_state->error_handler,
                            task, c, data);
 
-    } else if (ssltls->ssl_error == SSL_ERROR_WANT_READ && ssltls->times < 2) {
-        ssltls->times++;
+    } else if (n == NXT_AGAIN) {
+        c->socket.error_handler = c->read_state->error_handler;
+
+        if (c->read_timer.state == NXT_TIMER_DISABLED) {
+            nxt_conn_timer(engine, c, c->read_state, &c->read_timer);
+        }
+
+        if (ssltls->ssl_error == SSL_ERROR_WANT_READ && ssltls->times < 2) {
+            ssltls->times++;
+        }
     }
 }
 
@@ -374,108 +761,404 @@ nxt_openssl_conn_handshake(nxt_task_t *task, void *obj, void *data)
 static void
 nxt_openssl_conn_io_read(nxt_task_t *task, void *obj, void *data)
 {
-    int                 ret;
-    nxt_buf_t           *b;
-    nxt_int_t           n;
-    nxt_err_t           err;
-    nxt_conn_t          *c;
-    nxt_work_handler_t  handler;
-    nxt_openssl_conn_t  *ssltls;
+    int                     ret;
+    nxt_buf_t               *b;
+    nxt_int_t               n;
+    nxt_err_t               err;
+    nxt_conn_t              *c;
+    nxt_event_engine_t      *engine;
+    nxt_openssl_conn_t      *ssltls;
+    const nxt_conn_state_t  *state;
 
     c = obj;
 
     nxt_debug(task, "openssl conn read");
 
-    handler = c->read_state->ready_handler;
+    engine = task->thread->engine;
+    state = c->read_state;
     b = c->read;
 
     /* b == NULL is used to test descriptor readiness. */
 
-    if (b != NULL) {
-        ssltls = c->u.ssltls;
+    if (b == NULL) {
+        nxt_work_queue_add(c->read_work_queue, state->ready_handler,
+                           task, c, data);
+        return;
+    }
 
-        ret = SSL_read(ssltls->session, b->mem.free, b->mem.end - b->mem.free);
+    ssltls = c->u.ssltls;
 
-        err = (ret <= 0) ? nxt_socket_errno : 0;
+    ret = SSL_read(ssltls->session, b->mem.free, b->mem.end - b->mem.free);
 
-        nxt_debug(task, "SSL_read(%d, %p, %uz): %d err:%d",
-                  c->socket.fd, b->mem.free, b->mem.end - b->mem.free,
-                  ret, err);
+    err = (ret <= 0) ? nxt_socket_errno : 0;
 
-        if (ret > 0) {
-            /* c->socket.read_ready is kept. */
-            b->mem.free += ret;
-            handler = c->read_state->ready_handler;
+    nxt_debug(task, "SSL_read(%d, %p, %uz): %d err:%d",
+              c->socket.fd, b->mem.free, b->mem.end - b->mem.free, ret, err);
 
-        } else {
-            n = nxt_openssl_conn_test_error(task, c, ret, err,
-                                            nxt_openssl_conn_io_read);
+    if (ret > 0) {
+        /*
+         * c->socket.read_ready is kept since SSL_read() may leave
+         * decrypted data in the library buffer.
+         */
+        b->mem.free += ret;
+        c->nbytes = ret;
+        c->received += ret;
 
-            if (nxt_fast_path(n != NXT_ERROR)) {
-                return;
-            }
+        nxt_fd_event_block_read(engine, &c->socket);
+
+        if (state->timer_autoreset) {
+            nxt_timer_disable(engine, &c->read_timer);
+        }
+
+        nxt_work_queue_add(c->read_work_queue, state->ready_handler,
+                           task, c, data);
+        return;
+    }
+
+    n = nxt_openssl_conn_test_error(task, c, ret, err,
+                                    nxt_openssl_conn_io_read);
 
-            nxt_openssl_conn_error(c, err, "SSL_read(%d, %p, %uz) failed",
-                                   c->socket.fd, b->mem.free,
-                                   b->mem.end - b->mem.free);
+    if (n == NXT_AGAIN) {
+        c->socket.error_handler = state->error_handler;
 
-            handler = c->read_state->error_handler;
+        if (c->read_timer.state == NXT_TIMER_DISABLED) {
+            nxt_conn_timer(engine, c, state, &c->read_timer);
         }
+
+        return;
     }
 
-    nxt_work_queue_add(c->read_work_queue, handler, task, c, data);
+    nxt_fd_event_block_read(engine, &c->socket);
+    nxt_timer_disable(engine, &c->read_timer);
+
+    if (n == 0) {
+        /* The close handler has been already queued. */
+        return;
+    }
+
+    nxt_openssl_conn_error(c, err, "SSL_read(%d, %p, %uz) failed",
+                           c->socket.fd, b->mem.free, b->mem.end - b->mem.free);
+
+    nxt_work_queue_add(&engine->fast_work_queue, state->error_handler,
+                       task, c, data);
 }
 
 
-static ssize_t
-nxt_openssl_conn_io_write_chunk(nxt_conn_t *c, nxt_buf_t *b, size_t limit)
+/*
+ * The write is similar to nxt_conn_io_write(), however, the data are
+ * encrypted by SSL_write() with one record per call.  If the kernel has
+ * taken over the encryption, the plain nxt_conn_io_sendbuf() is used, so
+ * file buffers are sent with sendfile().  A "close notify" alert is sent
+ * after the last buffer to mark the end of a close-delimited response.
+ */
+
+static void
+nxt_openssl_conn_io_write(nxt_task_t *task, void *obj, void *data)
 {
+    ssize_t             ret;
+    nxt_buf_t           *b;
+    nxt_conn_t          *c;
+    nxt_sendbuf_t       sb;
+    nxt_event_engine_t  *engine;
     nxt_openssl_conn_t  *ssltls;
 
-    nxt_debug(c->socket.task, "openssl conn write chunk");
+    c = obj;
+
+    nxt_debug(task, "openssl conn write fd:%d", c->socket.fd);
+
+    if (!c->socket.write_ready || c->write == NULL) {
+        return;
+    }
 
+    engine = task->thread->engine;
     ssltls = c->u.ssltls;
 
-    return nxt_sendbuf_copy_coalesce(c, &ssltls->buffer, b, limit);
+    c->socket.write_handler = nxt_openssl_conn_io_write;
+    c->socket.error_handler = c->write_state->error_handler;
+
+    b = c->write;
+
+    sb.socket = c->socket.fd;
+    sb.error = 0;
+    sb.sent = 0;
+    sb.size = 0;
+    sb.buf = b;
+    sb.limit = 10 * 1024 * 1024;
+    sb.ready = 1;
+    sb.sync = 0;
+    sb.last = 0;
+
+    do {
+        if (ssltls->ktls) {
+            ret = nxt_conn_io_sendbuf(task, &sb);
+
+            c->socket.write_ready = sb.ready;
+            c->socket.error = sb.error;
+
+        } else {
+            ret = nxt_openssl_conn_io_sendbuf(task, c, &sb);
+        }
+
+        if (ret < 0) {
+            /* ret == NXT_AGAIN || ret == NXT_ERROR. */
+            break;
+        }
+
+        sb.sent += ret;
+        sb.limit -= ret;
+
+        b = nxt_sendbuf_update(b, ret);
+
+        if (b == NULL) {
+            nxt_fd_event_block_write(engine, &c->socket);
+
+            if (sb.last) {
+                nxt_openssl_conn_close_notify(task, c);
+            }
+
+            break;
+        }
+
+        sb.buf = b;
+
+        if (!c->socket.write_ready) {
+            ret = NXT_AGAIN;
+            break;
+        }
+
+    } while (sb.limit != 0);
+
+    nxt_debug(task, "openssl conn: %i sent:%O", ret, sb.sent);
+
+    if (sb.sent != 0) {
+        if (c->write_state->timer_autoreset) {
+            nxt_timer_disable(engine, &c->write_timer);
+        }
+    }
+
+    if (ret != NXT_ERROR) {
+
+        if (sb.limit == 0) {
+            /*
+             * Postpone writing until next event poll to allow to
+             * process other recevied events and to get new events.
+             */
+            c->write_timer.handler = nxt_openssl_conn_write_timer_handler;
+            nxt_timer_add(engine, &c->write_timer, 0);
+
+        } else if (ret == NXT_AGAIN) {
+            /*
+             * The events have been toggled by nxt_openssl_conn_test_error()
+             * or by nxt_conn_io_sendbuf() in the kernel TLS case.
+             */
+            nxt_conn_timer(engine, c, c->write_state, &c->write_timer);
+
+            if (ssltls->ktls && nxt_fd_event_is_disabled(c->socket.write)) {
+                nxt_fd_event_enable_write(engine, &c->socket);
+            }
+        }
+    }
+
+    if (ret == 0 || sb.sent != 0) {
+        /* "ret == 0" means a sync buffer was processed. */
+        c->sent += sb.sent;
+        nxt_work_queue_add(c->write_work_queue, c->write_state->ready_handler,
+                           task, c, data);
+        /*
+         * Fall through if first operations were
+         * successful but the last one failed.
+         */
+    }
+
+    if (nxt_slow_path(ret == NXT_ERROR)) {
+        nxt_fd_event_block_write(engine, &c->socket);
+
+        nxt_work_queue_add(c->write_work_queue, c->write_state->error_handler,
+                           task, c, data);
+    }
 }
 
 
+static void
+nxt_openssl_conn_write_timer_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t   *c;
+    nxt_timer_t  *timer;
+
+    timer = obj;
+
+    nxt_debug(task, "openssl conn write timer");
+
+    c = nxt_write_timer_conn(timer);
+    c->delayed = 0;
+
+    c->io->write(task, c, c->socket.data);
+}
+
+
+/*
+ * The buffer is filled only if it is empty, since SSL_write() should
+ * be retried with the same data after SSL_ERROR_WANT_WRITE.  The chain
+ * is updated by the caller only after the data have been encrypted.
+ */
+
 static ssize_t
-nxt_openssl_conn_io_send(nxt_conn_t *c, void *buf, size_t size)
+nxt_openssl_conn_io_sendbuf(nxt_task_t *task, nxt_conn_t *c,
+    nxt_sendbuf_t *sb)
 {
     int                 ret;
+    u_char              *p;
+    size_t              size, record;
+    ssize_t             n;
+    nxt_buf_t           *b;
     nxt_err_t           err;
-    nxt_int_t           n;
+    nxt_buf_mem_t       *bm;
     nxt_openssl_conn_t  *ssltls;
 
     ssltls = c->u.ssltls;
+    bm = &ssltls->buffer;
+
+    if (bm->start == NULL) {
+        bm->start = nxt_malloc(ssltls->buffer_size);
+        if (nxt_slow_path(bm->start == NULL)) {
+            return NXT_ERROR;
+        }
 
-    ret = SSL_write(ssltls->session, buf, size);
+        bm->pos = bm->start;
+        bm->free = bm->start;
+        bm->end = bm->start + ssltls->buffer_size;
+    }
 
-    if (ret <= 0) {
-        err = nxt_socket_errno;
-        c->socket.error = err;
+    if (bm->pos == bm->free) {
+        record = nxt_openssl_record_size(task, ssltls);
+        record = nxt_min(record, sb->limit);
 
-    } else {
-        err = 0;
+        p = bm->start;
+
+        for (b = sb->buf; b != NULL; b = b->next) {
+
+            if (nxt_buf_is_file(b)) {
+                size = nxt_min((nxt_off_t) (record - (p - bm->start)),
+                               b->file_end - b->file_pos);
+
+                n = nxt_file_read(b->file, p, size, b->file_pos);
+
+                if (nxt_slow_path(n != (ssize_t) size)) {
+                    if (n >= 0) {
+                        nxt_log(task, NXT_LOG_ERR,
+                                "file \"%FN\" has changed while sending",
+                                b->file->name);
+                    }
+
+                    return NXT_ERROR;
+                }
+
+            } else if (nxt_buf_is_mem(b)) {
+                size = nxt_min(record - (p - bm->start),
+                               (size_t) (b->mem.free - b->mem.pos));
+
+                nxt_memcpy(p, b->mem.pos, size);
+
+            } else {
+                sb->sync = 1;
+                sb->last |= nxt_buf_is_last(b);
+                continue;
+            }
+
+            p += size;
+
+            if ((size_t) (p - bm->start) == record) {
+                break;
+            }
+        }
+
+        bm->pos = bm->start;
+        bm->free = p;
+
+        if (bm->free == bm->start) {
+            return sb->sync ? 0 : NXT_AGAIN;
+        }
     }
 
-    nxt_log_debug(c->socket.log, "SSL_write(%d, %p, %uz): %d err:%d",
-                  c->socket.fd, buf, size, ret, err);
+    size = bm->free - bm->pos;
+
+    ret = SSL_write(ssltls->session, bm->pos, size);
+
+    err = (ret <= 0) ? nxt_socket_errno : 0;
+
+    nxt_debug(task, "SSL_write(%d, %p, %uz): %d err:%d",
+              c->socket.fd, bm->pos, size, ret, err);
 
     if (ret > 0) {
+        /* The partial writes are not enabled. */
+        bm->pos = bm->start;
+        bm->free = bm->start;
+
+        ssltls->sent += ret;
+        ssltls->last = task->thread->engine->timers.now;
+
         return ret;
     }
 
-    n = nxt_openssl_conn_test_error(c->socket.task, c, ret, err,
-                                    nxt_conn_io_write);
+    n = nxt_openssl_conn_test_error(task, c, ret, err,
+                                    nxt_openssl_conn_io_write);
 
     if (n == NXT_ERROR) {
         nxt_openssl_conn_error(c, err, "SSL_write(%d, %p, %uz) failed",
-                               c->socket.fd, buf, size);
+                               c->socket.fd, bm->pos, size);
+        return NXT_ERROR;
     }
 
-    return n;
+    /* The close handler has been already queued if n == 0. */
+
+    return NXT_AGAIN;
+}
+
+
+static size_t
+nxt_openssl_record_size(nxt_task_t *task, nxt_openssl_conn_t *ssltls)
+{
+    nxt_msec_t  now;
+
+    now = task->thread->engine->timers.now;
+
+    if (ssltls->sent != 0
+        && (nxt_msec_int_t) (now - ssltls->last) >= NXT_SSLTLS_RECORD_IDLE)
+    {
+        ssltls->sent = 0;
+    }
+
+    if (ssltls->sent < NXT_SSLTLS_RECORD_BOOST) {
+        return nxt_min(NXT_SSLTLS_RECORD_SMALL, ssltls->buffer_size);
+    }
+
+    return ssltls->buffer_size;
+}
+
+
+static void
+nxt_openssl_conn_close_notify(nxt_task_t *task, nxt_conn_t *c)
+{
+    int                 ret;
+    nxt_openssl_conn_t  *ssltls;
+
+    ssltls = c->u.ssltls;
+
+    if (!SSL_is_init_finished(ssltls->session)) {
+        return;
+    }
+
+    /*
+     * The alert is sent without waiting for the peer's one,
+     * an error here is not fatal since the connection is closed anyway.
+     */
+    ret = SSL_shutdown(ssltls->session);
+
+    nxt_debug(task, "SSL_shutdown(%d): %d", c->socket.fd, ret);
+
+    if (ret < 0) {
+        ERR_clear_error();
+    }
 }
 
 
@@ -593,7 +1276,7 @@ nxt_openssl_conn_test_error(nxt_task_t *task, nxt_conn_t *c, int ret,
 
     ssltls->ssl_error = SSL_get_error(ssltls->session, ret);
 
-    nxt_log_debug(c->socket.log, "SSL_get_error(): %d", ssltls->ssl_error);
+    nxt_debug(task, "SSL_get_error(): %d", ssltls->ssl_error);
 
     switch (ssltls->ssl_error) {
 
@@ -706,7 +1389,9 @@ nxt_openssl_log_error_level(nxt_conn_t *c, nxt_err_t err)
     case SSL_R_ERROR_IN_RECEIVED_CIPHER_LIST:             /*  151 */
     case SSL_R_EXCESSIVE_MESSAGE_SIZE:                    /*  152 */
     case SSL_R_LENGTH_MISMATCH:                           /*  159 */
+#ifdef SSL_R_NO_CIPHERS_PASSED
     case SSL_R_NO_CIPHERS_PASSED:                         /*  182 */
+#endif
     case SSL_R_NO_CIPHERS_SPECIFIED:                      /*  183 */
     case SSL_R_NO_COMPRESSION_SPECIFIED:                  /*  187 */
     case SSL_R_NO_SHARED_CIPHER:                          /*  193 */
@@ -812,7 +1497,11 @@ nxt_openssl_copy_error(u_char *p, u_char *end)
     clear = 0;
 
     for ( ;; ) {
+#if (OPENSSL_VERSION_NUMBER >= 0x30000000L)
+        err = ERR_get_error_all(NULL, NULL, NULL, &data, &flags);
+#else
         err = ERR_get_error_line_data(NULL, NULL, &data, &flags);
+#endif
         if (err == 0) {
             break;
         }
@@ -34,6 +34,11 @@ static nxt_int_t nxt_php_run(nxt_task_t *task,
 #   endif
 #endif
 
+#if defined(ZTS) && defined(NXT_PHP7)
+#   define NXT_PHP_THREADS 1
+ZEND_TSRMLS_CACHE_DEFINE()
+#endif
+
 static int nxt_php_startup(sapi_module_struct *sapi_module);
 static int nxt_php_send_headers(sapi_headers_struct *sapi_headers);
 static char *nxt_php_read_cookies(void);
@@ -116,6 +121,9 @@ static sapi_module_struct  nxt_php_sapi_module =
     NULL                         /* input_filter_init */
 };
 
+typedef struct nxt_php_request_s  nxt_php_request_t;
+typedef struct nxt_php_chunk_s    nxt_php_chunk_t;
+
 typedef struct {
     nxt_task_t           *task;
     nxt_app_rmsg_t       *rmsg;
@@ -125,11 +133,86 @@ typedef struct {
     nxt_mp_t             *mem_pool;
 
     size_t               body_preread_size;
+
+    /* The request and output chunk of a request run by a PHP thread. */
+    nxt_php_request_t    *request;
+    nxt_php_chunk_t      *chunk;
 } nxt_php_run_ctx_t;
 
 nxt_inline nxt_int_t nxt_php_write(nxt_php_run_ctx_t *ctx,
                       const u_char *data, size_t len,
                       nxt_bool_t flush, nxt_bool_t last);
+static nxt_int_t nxt_php_execute(nxt_php_run_ctx_t *ctx);
+
+
+#if (NXT_PHP_THREADS)
+
+/*
+ * A request run by a PHP thread owns a copy of the request message,
+ * since the port buffers are reused as soon as the port handler returns.
+ * The thread never touches the port: the response is collected in chunks
+ * which are posted to the worker engine and are written there.
+ */
+
+struct nxt_php_request_s {
+    nxt_php_run_ctx_t    ctx;
+    nxt_task_t           task;
+    nxt_work_t           work;
+    nxt_event_engine_t   *engine;
+
+    nxt_app_rmsg_t       rmsg;
+    nxt_app_wmsg_t       wmsg;
+    nxt_buf_t            buf;
+
+    /* Allocated beforehand, since its handler frees the request. */
+    nxt_php_chunk_t      *last;
+};
+
+
+struct nxt_php_chunk_s {
+    nxt_work_t           work;
+    size_t               size;
+    size_t               capacity;
+    nxt_bool_t           last;
+    u_char               data[];
+};
+
+
+#define NXT_PHP_CHUNK_SIZE  16384
+
+
+static void nxt_php_thread_init(void);
+static nxt_int_t nxt_php_thread_post(nxt_task_t *task, nxt_app_rmsg_t *rmsg,
+    nxt_app_wmsg_t *wmsg);
+static void nxt_php_thread_handler(nxt_task_t *task, void *obj, void *data);
+static nxt_int_t nxt_php_thread_write(nxt_php_run_ctx_t *ctx,
+    const u_char *data, size_t len, nxt_bool_t flush, nxt_bool_t last);
+static void nxt_php_chunk_handler(nxt_task_t *task, void *obj, void *data);
+
+static nxt_thread_pool_t   *nxt_php_thread_pool;
+static nxt_thread_mutex_t  nxt_php_scripts_mutex;
+
+#endif
+
+
+typedef struct {
+    nxt_str_t            path;
+    nxt_str_t            script;
+    nxt_time_t           checked;
+} nxt_php_script_t;
+
+
+#define NXT_PHP_SCRIPTS_MAX  4096
+
+
+static nxt_int_t nxt_php_script_test(nxt_lvlhsh_query_t *lhq, void *data);
+static nxt_int_t nxt_php_script_find(nxt_task_t *task, nxt_php_run_ctx_t *ctx,
+    nxt_str_t *path);
+static nxt_str_t *nxt_php_script_lookup(nxt_task_t *task, nxt_str_t *path);
+static void nxt_php_script_add(nxt_task_t *task, nxt_str_t *path,
+    nxt_str_t *script);
+static void nxt_php_script_insert(nxt_task_t *task, nxt_str_t *path,
+    nxt_str_t *script);
 
 
 static nxt_str_t nxt_php_path;
@@ -137,6 +220,30 @@ static nxt_str_t nxt_php_root;
 static nxt_str_t nxt_php_script;
 static nxt_str_t nxt_php_index = nxt_string("index.php");
 
+/*
+ * The pool is created once and is reset after each request, so pages
+ * allocated for a request are reused by the following ones.
+ */
+static nxt_mp_t      *nxt_php_mem_pool;
+
+/*
+ * Resolved script file names of the non-absolute mode keyed by path.
+ * With threads the hash and its counter are protected by
+ * nxt_php_scripts_mutex.
+ */
+static nxt_lvlhsh_t  nxt_php_scripts;
+static nxt_uint_t    nxt_php_nscripts;
+static nxt_time_t    nxt_php_stat_interval;
+
+
+static const nxt_lvlhsh_proto_t  nxt_php_scripts_proto  nxt_aligned(64) = {
+    NXT_LVLHSH_DEFAULT,
+    nxt_php_script_test,
+    nxt_lvlhsh_alloc,
+    nxt_lvlhsh_free,
+};
+
+
 static void
 nxt_php_strdup(nxt_str_t *dst, nxt_str_t *src)
 {
@@ -238,6 +345,47 @@ nxt_php_init(nxt_task_t *task, nxt_common_app_conf_t *conf)
         nxt_php_strdup(index, &c->index);
     }
 
+    nxt_php_stat_interval = c->stat_interval;
+
+    nxt_php_mem_pool = nxt_mp_create(1024, 128, 256, 32);
+    if (nxt_slow_path(nxt_php_mem_pool == NULL)) {
+        return NXT_ERROR;
+    }
+
+#if (NXT_PHP_THREADS)
+
+    tsrm_startup(nxt_max(c->threads, 1), 1, 0, NULL);
+    (void) ts_resource(0);
+    ZEND_TSRMLS_CACHE_UPDATE();
+
+    if (c->threads > 1) {
+        if (nxt_thread_mutex_create(&nxt_php_scripts_mutex) != NXT_OK) {
+            return NXT_ERROR;
+        }
+
+        nxt_php_thread_pool = nxt_thread_pool_create(c->threads,
+                                                     60000 * 1000000LL,
+                                                     nxt_php_thread_init,
+                                                     task->thread->engine,
+                                                     NULL);
+        if (nxt_slow_path(nxt_php_thread_pool == NULL)) {
+            return NXT_ERROR;
+        }
+
+        nxt_log_error(NXT_LOG_INFO, task->log,
+                      "php runs requests in up to %D threads", c->threads);
+    }
+
+#else
+
+    if (c->threads > 1) {
+        nxt_log_error(NXT_LOG_WARN, task->log,
+                      "php \"threads\" require ZTS build of PHP 7, "
+                      "requests are run serially");
+    }
+
+#endif
+
     sapi_startup(&nxt_php_sapi_module);
     nxt_php_startup(&nxt_php_sapi_module);
 
@@ -289,6 +437,10 @@ nxt_php_read_request(nxt_task_t *task, nxt_app_rmsg_t *rmsg,
     }
 
     if (nxt_php_path.start == NULL) {
+        if (nxt_php_script_find(task, ctx, &h->path) == NXT_OK) {
+            goto script_done;
+        }
+
         if (h->path.start[h->path.length - 1] == '/') {
             script_name = nxt_php_index;
 
@@ -301,6 +453,11 @@ nxt_php_read_request(nxt_task_t *task, nxt_app_rmsg_t *rmsg,
         ctx->script.start = nxt_mp_nget(ctx->mem_pool,
             ctx->script.length + 1);
 
+        if (nxt_slow_path(ctx->script.start == NULL)) {
+            rc = NXT_ERROR;
+            goto fail;
+        }
+
         p = ctx->script.start;
 
         nxt_memcpy(p, nxt_php_root.start, nxt_php_root.length);
@@ -316,10 +473,14 @@ nxt_php_read_request(nxt_task_t *task, nxt_app_rmsg_t *rmsg,
 
         p[0] = '\0';
 
+        nxt_php_script_add(task, &h->path, &ctx->script);
+
     } else {
         ctx->script = nxt_php_path;
     }
 
+script_done:
+
     NXT_READ(&h->version);
 
     NXT_READ(&ctx->r.remote);
@@ -351,32 +512,59 @@ static nxt_int_t
 nxt_php_run(nxt_task_t *task,
     nxt_app_rmsg_t *rmsg, nxt_app_wmsg_t *wmsg)
 {
-    nxt_int_t                 rc;
-    zend_file_handle          file_handle;
-    nxt_php_run_ctx_t         run_ctx;
-    nxt_app_request_header_t  *h;
+    nxt_int_t          rc;
+    nxt_php_run_ctx_t  run_ctx;
 
     if (nxt_php_root.length == 0) {
         return NXT_ERROR;
     }
 
+#if (NXT_PHP_THREADS)
+
+    if (nxt_php_thread_pool != NULL) {
+        return nxt_php_thread_post(task, rmsg, wmsg);
+    }
+
+#endif
+
     nxt_memzero(&run_ctx, sizeof(run_ctx));
 
     run_ctx.task = task;
     run_ctx.rmsg = rmsg;
     run_ctx.wmsg = wmsg;
 
-    run_ctx.mem_pool = nxt_mp_create(1024, 128, 256, 32);
+    run_ctx.mem_pool = nxt_php_mem_pool;
+
+    rc = nxt_php_execute(&run_ctx);
+
+    if (nxt_fast_path(rc == NXT_OK)) {
+        nxt_app_msg_flush(task, wmsg, 1);
+    }
+
+    nxt_mp_reset(run_ctx.mem_pool);
+
+    return rc;
+}
+
+
+static nxt_int_t
+nxt_php_execute(nxt_php_run_ctx_t *ctx)
+{
+    nxt_int_t                 rc;
+    nxt_task_t                *task;
+    zend_file_handle          file_handle;
+    nxt_app_request_header_t  *h;
 
-    h = &run_ctx.r.header;
+    task = ctx->task;
+    h = &ctx->r.header;
 
-    rc = nxt_php_read_request(task, rmsg, &run_ctx);
+    rc = nxt_php_read_request(task, ctx->rmsg, ctx);
 
     if (nxt_slow_path(rc != NXT_OK)) {
-        goto fail;
+        return NXT_ERROR;
     }
 
-    SG(server_context) = &run_ctx;
+    SG(server_context) = ctx;
     SG(request_info).request_uri = (char *) h->target.start;
     SG(request_info).request_method = (char *) h->method.start;
 
@@ -394,38 +582,410 @@ nxt_php_run(nxt_task_t *task,
     SG(request_info).path_translated = NULL;
 
     file_handle.type = ZEND_HANDLE_FILENAME;
-    file_handle.filename = (char *) run_ctx.script.start;
+    file_handle.filename = (char *) ctx->script.start;
     file_handle.free_filename = 0;
     file_handle.opened_path = NULL;
 
-    nxt_debug(task, "handle.filename = '%s'", run_ctx.script.start);
+    nxt_debug(task, "handle.filename = '%s'", ctx->script.start);
 
     if (nxt_php_path.start != NULL) {
         nxt_debug(task, "run script %V in absolute mode", &nxt_php_path);
 
     } else {
-        nxt_debug(task, "run script %V", &run_ctx.script);
+        nxt_debug(task, "run script %V", &ctx->script);
     }
 
     if (nxt_slow_path(php_request_startup() == FAILURE)) {
         nxt_debug(task, "php_request_startup() failed");
-        goto fail;
+        return NXT_ERROR;
     }
 
     php_execute_script(&file_handle TSRMLS_CC);
     php_request_shutdown(NULL);
 
-    nxt_app_msg_flush(task, wmsg, 1);
+    return NXT_OK;
+}
+
+
+#if (NXT_PHP_THREADS)
+
+static void
+nxt_php_thread_init(void)
+{
+    (void) ts_resource(0);
+    ZEND_TSRMLS_CACHE_UPDATE();
+}
+
+
+static nxt_int_t
+nxt_php_thread_post(nxt_task_t *task, nxt_app_rmsg_t *rmsg,
+    nxt_app_wmsg_t *wmsg)
+{
+    u_char             *p;
+    size_t             size;
+    nxt_buf_t          *b;
+    nxt_php_request_t  *req;
+
+    size = 0;
+
+    for (b = rmsg->buf; b != NULL; b = b->next) {
+        size += nxt_buf_mem_used_size(&b->mem);
+    }
+
+    req = nxt_zalloc(sizeof(nxt_php_request_t) + size);
+    if (nxt_slow_path(req == NULL)) {
+        return NXT_ERROR;
+    }
+
+    req->last = nxt_malloc(sizeof(nxt_php_chunk_t));
+    if (nxt_slow_path(req->last == NULL)) {
+        nxt_free(req);
+        return NXT_ERROR;
+    }
+
+    p = (u_char *) req + sizeof(nxt_php_request_t);
+
+    nxt_buf_mem_init(&req->buf, p, size);
+
+    for (b = rmsg->buf; b != NULL; b = b->next) {
+        p = nxt_cpymem(p, b->mem.pos, nxt_buf_mem_used_size(&b->mem));
+    }
+
+    req->buf.mem.free = p;
+
+    req->rmsg.buf = &req->buf;
+
+    req->wmsg = *wmsg;
+    req->wmsg.write = NULL;
+    req->wmsg.buf = &req->wmsg.write;
+
+    req->engine = task->thread->engine;
+    req->task = *task;
+
+    req->ctx.rmsg = &req->rmsg;
+    req->ctx.wmsg = &req->wmsg;
+    req->ctx.request = req;
 
-    nxt_mp_destroy(run_ctx.mem_pool);
+    nxt_work_set(&req->work, nxt_php_thread_handler, &req->task, req, NULL);
+
+    if (nxt_slow_path(nxt_thread_pool_post(nxt_php_thread_pool, &req->work)
+                      != NXT_OK))
+    {
+        nxt_free(req->last);
+        nxt_free(req);
+        return NXT_ERROR;
+    }
 
     return NXT_OK;
+}
 
-fail:
 
-    nxt_mp_destroy(run_ctx.mem_pool);
+static void
+nxt_php_thread_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_php_chunk_t    *chunk;
+    nxt_php_run_ctx_t  *ctx;
+    nxt_php_request_t  *req;
+
+    req = obj;
+    ctx = &req->ctx;
+
+    ctx->task = task;
+
+    nxt_thread_time_update(task->thread);
+
+    ctx->mem_pool = nxt_mp_create(1024, 128, 256, 32);
 
-    return NXT_ERROR;
+    if (nxt_fast_path(ctx->mem_pool != NULL)) {
+        (void) nxt_php_execute(ctx);
+        nxt_mp_destroy(ctx->mem_pool);
+    }
+
+    if (ctx->chunk != NULL) {
+        nxt_event_engine_post(req->engine, &ctx->chunk->work);
+    }
+
+    /*
+     * The last chunk is posted after the output in the same queue.
+     * Its handler frees the request, so the request must not be used
+     * after that.
+     */
+
+    chunk = req->last;
+
+    chunk->work.next = NULL;
+    nxt_work_set(&chunk->work, nxt_php_chunk_handler, &req->engine->task,
+                 chunk, req);
+
+    chunk->size = 0;
+    chunk->capacity = 0;
+    chunk->last = 1;
+
+    nxt_event_engine_post(req->engine, &chunk->work);
+}
+
+
+static nxt_int_t
+nxt_php_thread_write(nxt_php_run_ctx_t *ctx, const u_char *data, size_t len,
+    nxt_bool_t flush, nxt_bool_t last)
+{
+    size_t             size;
+    nxt_php_chunk_t    *chunk;
+    nxt_php_request_t  *req;
+
+    req = ctx->request;
+    chunk = ctx->chunk;
+
+    if (chunk != NULL && chunk->size + len > chunk->capacity) {
+        nxt_event_engine_post(req->engine, &chunk->work);
+        chunk = NULL;
+    }
+
+    if (chunk == NULL) {
+        size = nxt_max(len, NXT_PHP_CHUNK_SIZE);
+
+        chunk = nxt_malloc(sizeof(nxt_php_chunk_t) + size);
+        if (nxt_slow_path(chunk == NULL)) {
+            ctx->chunk = NULL;
+            return NXT_ERROR;
+        }
+
+        chunk->work.next = NULL;
+        nxt_work_set(&chunk->work, nxt_php_chunk_handler, &req->engine->task,
+                     chunk, req);
+
+        chunk->size = 0;
+        chunk->capacity = size;
+        chunk->last = 0;
+    }
+
+    if (len > 0) {
+        nxt_memcpy(chunk->data + chunk->size, data, len);
+        chunk->size += len;
+    }
+
+    if (flush || last) {
+        chunk->last = last;
+        nxt_event_engine_post(req->engine, &chunk->work);
+        chunk = NULL;
+    }
+
+    ctx->chunk = chunk;
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_php_chunk_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_php_chunk_t    *chunk;
+    nxt_php_request_t  *req;
+
+    chunk = obj;
+    req = data;
+
+    if (chunk->size > 0) {
+        (void) nxt_app_msg_write_raw(task, &req->wmsg, chunk->data,
+                                     chunk->size);
+    }
+
+    (void) nxt_app_msg_flush(task, &req->wmsg, chunk->last);
+
+    if (chunk->last) {
+        nxt_free(req);
+    }
+
+    nxt_free(chunk);
+}
+
+#endif
+
+
+static nxt_int_t
+nxt_php_script_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    nxt_php_script_t  *script;
+
+    script = data;
+
+    if (nxt_strstr_eq(&lhq->key, &script->path)) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static nxt_int_t
+nxt_php_script_find(nxt_task_t *task, nxt_php_run_ctx_t *ctx, nxt_str_t *path)
+{
+    nxt_int_t  rc;
+    nxt_str_t  *script;
+
+#if (NXT_PHP_THREADS)
+
+    if (nxt_php_thread_pool != NULL) {
+        /*
+         * The entry can be freed by another thread as soon as the lock
+         * is released, so the script file name is copied.
+         */
+
+        rc = NXT_DECLINED;
+
+        nxt_thread_mutex_lock(&nxt_php_scripts_mutex);
+
+        script = nxt_php_script_lookup(task, path);
+
+        if (script != NULL) {
+            ctx->script.start = nxt_mp_nget(ctx->mem_pool, script->length + 1);
+
+            if (nxt_fast_path(ctx->script.start != NULL)) {
+                ctx->script.length = script->length;
+                nxt_memcpy(ctx->script.start, script->start,
+                           script->length + 1);
+                rc = NXT_OK;
+            }
+        }
+
+        nxt_thread_mutex_unlock(&nxt_php_scripts_mutex);
+
+        return rc;
+    }
+
+#endif
+
+    script = nxt_php_script_lookup(task, path);
+
+    if (script != NULL) {
+        ctx->script = *script;
+        rc = NXT_OK;
+
+    } else {
+        rc = NXT_DECLINED;
+    }
+
+    return rc;
+}
+
+
+static nxt_str_t *
+nxt_php_script_lookup(nxt_task_t *task, nxt_str_t *path)
+{
+    nxt_time_t          now;
+    nxt_php_script_t    *script;
+    nxt_file_info_t     fi;
+    nxt_lvlhsh_query_t  lhq;
+
+    lhq.key_hash = nxt_djb_hash(path->start, path->length);
+    lhq.key = *path;
+    lhq.proto = &nxt_php_scripts_proto;
+
+    if (nxt_lvlhsh_find(&nxt_php_scripts, &lhq) != NXT_OK) {
+        return NULL;
+    }
+
+    script = lhq.value;
+
+    now = nxt_thread_time(task->thread);
+
+    if (now - script->checked <= nxt_php_stat_interval) {
+        return &script->script;
+    }
+
+    if (stat((char *) script->script.start, &fi) == 0 && nxt_is_file(&fi)) {
+        script->checked = now;
+        return &script->script;
+    }
+
+    nxt_debug(task, "php script \"%V\" is not a file anymore",
+              &script->script);
+
+    lhq.pool = NULL;
+
+    if (nxt_lvlhsh_delete(&nxt_php_scripts, &lhq) == NXT_OK) {
+        nxt_php_nscripts--;
+        nxt_free(script);
+    }
+
+    return NULL;
+}
+
+
+static void
+nxt_php_script_add(nxt_task_t *task, nxt_str_t *path, nxt_str_t *script)
+{
+    nxt_file_info_t  fi;
+
+    /*
+     * Only existing files are cached, so missing ones cannot flood it.
+     * The number of cached scripts is checked by nxt_php_script_insert()
+     * under the lock.
+     */
+
+    if (stat((char *) script->start, &fi) != 0 || !nxt_is_file(&fi)) {
+        return;
+    }
+
+#if (NXT_PHP_THREADS)
+
+    if (nxt_php_thread_pool != NULL) {
+        nxt_thread_mutex_lock(&nxt_php_scripts_mutex);
+        nxt_php_script_insert(task, path, script);
+        nxt_thread_mutex_unlock(&nxt_php_scripts_mutex);
+
+        return;
+    }
+
+#endif
+
+    nxt_php_script_insert(task, path, script);
+}
+
+
+static void
+nxt_php_script_insert(nxt_task_t *task, nxt_str_t *path, nxt_str_t *script)
+{
+    u_char              *p;
+    nxt_php_script_t    *s;
+    nxt_lvlhsh_query_t  lhq;
+
+    if (nxt_php_nscripts >= NXT_PHP_SCRIPTS_MAX) {
+        return;
+    }
+
+    s = nxt_malloc(sizeof(nxt_php_script_t) + path->length
+                   + script->length + 1);
+    if (nxt_slow_path(s == NULL)) {
+        return;
+    }
+
+    p = (u_char *) s + sizeof(nxt_php_script_t);
+
+    s->path.length = path->length;
+    s->path.start = p;
+    p = nxt_cpymem(p, path->start, path->length);
+
+    s->script.length = script->length;
+    s->script.start = p;
+    p = nxt_cpymem(p, script->start, script->length);
+    *p = '\0';
+
+    s->checked = nxt_thread_time(task->thread);
+
+    lhq.key_hash = nxt_djb_hash(s->path.start, s->path.length);
+    lhq.key = s->path;
+    lhq.replace = 0;
+    lhq.value = s;
+    lhq.proto = &nxt_php_scripts_proto;
+    lhq.pool = NULL;
+
+    if (nxt_lvlhsh_insert(&nxt_php_scripts, &lhq) != NXT_OK) {
+        nxt_free(s);
+        return;
+    }
+
+    nxt_php_nscripts++;
 }
 
 
@@ -435,6 +995,14 @@ nxt_php_write(nxt_php_run_ctx_t *ctx, const u_char *data, size_t len,
 {
     nxt_int_t  rc;
 
+#if (NXT_PHP_THREADS)
+
+    if (ctx->request != NULL) {
+        return nxt_php_thread_write(ctx, data, len, flush, last);
+    }
+
+#endif
+
     if (len > 0) {
         rc = nxt_app_msg_write_raw(ctx->task, ctx->wmsg, data, len);
 
@@ -489,7 +1057,7 @@ nxt_php_flush(void *server_context)
 
     ctx = server_context;
 
-    (void) nxt_app_msg_flush(ctx->task, ctx->wmsg, 0);
+    (void) nxt_php_write(ctx, NULL, 0, 1, 0);
 }
 
 
@@ -104,7 +104,11 @@ struct nxt_port_s {
     uint32_t            max_size;
     /* Maximum interleave of message parts. */
     uint32_t            max_share;
-    uint32_t            app_req_id;
+    /* Requests passed to the application and not yet responded. */
+    uint32_t            app_pending;
+    /* Responses completed on other engines and not yet accounted. */
+    nxt_atomic_t        app_responses;
+    nxt_nsec_t          idle_start;
 
     nxt_port_handler_t  handler;
     nxt_port_handler_t  *data;
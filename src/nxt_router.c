@@ -12,11 +12,18 @@
 typedef struct {
     nxt_str_t  type;
     uint32_t   workers;
+    uint32_t   spare_workers;
+    uint32_t   idle_timeout;
+    uint32_t   threads;
 } nxt_router_app_conf_t;
 
 
 typedef struct {
-    nxt_str_t  application;
+    nxt_str_t         application;
+    nxt_str_t         share;
+    nxt_conf_value_t  *proxy;
+    nxt_conf_value_t  *cache;
+    nxt_conf_value_t  *tls;
 } nxt_router_listener_conf_t;
 
 
@@ -96,7 +103,7 @@ static nxt_int_t nxt_router_threads_create(nxt_task_t *task, nxt_runtime_t *rt,
     nxt_router_temp_conf_t *tmcf);
 static nxt_int_t nxt_router_thread_create(nxt_task_t *task, nxt_runtime_t *rt,
     nxt_event_engine_t *engine);
-static void nxt_router_apps_sort(nxt_router_t *router,
+static void nxt_router_apps_sort(nxt_task_t *task, nxt_router_t *router,
     nxt_router_temp_conf_t *tmcf);
 
 static void nxt_router_engines_post(nxt_router_temp_conf_t *tmcf);
@@ -123,9 +130,27 @@ static void nxt_router_conf_release(nxt_task_t *task,
 static void nxt_router_send_sw_request(nxt_task_t *task, void *obj,
     void *data);
 static nxt_bool_t nxt_router_app_free(nxt_task_t *task, nxt_app_t *app);
-static nxt_port_t * nxt_router_app_get_port(nxt_app_t *app, uint32_t req_id);
+static void nxt_router_app_spare(nxt_task_t *task, nxt_app_t *app);
+static void nxt_router_app_idle_timer_start(nxt_task_t *task, nxt_app_t *app);
+static void nxt_router_app_idle_timeout(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_app_port_quit(nxt_task_t *task, void *obj, void *data);
+static nxt_port_t * nxt_router_app_get_port(nxt_app_t *app);
 static void nxt_router_app_release_port(nxt_task_t *task, void *obj,
     void *data);
+static void nxt_router_app_responses_handler(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_app_port_ready(nxt_task_t *task, nxt_port_t *port,
+    nxt_app_t *app, uint32_t responses);
+
+#if (NXT_SSLTLS)
+static nxt_ssltls_conf_t *nxt_router_tls_conf_create(nxt_task_t *task,
+    nxt_mp_t *mp, nxt_conf_value_t *conf, nxt_conf_value_t *value);
+static void nxt_router_tls_conf_free(nxt_task_t *task, void *obj, void *data);
+static void nxt_router_conn_tls_ready(nxt_task_t *task, void *obj, void *data);
+static void nxt_router_conn_tls_timeout(nxt_task_t *task, void *obj,
+    void *data);
+#endif
 
 static void nxt_router_conn_init(nxt_task_t *task, void *obj, void *data);
 static void nxt_router_conn_http_header_parse(nxt_task_t *task, void *obj,
@@ -145,12 +170,15 @@ static nxt_int_t nxt_go_prepare_msg(nxt_task_t *task, nxt_app_request_t *r,
 static void nxt_router_conn_ready(nxt_task_t *task, void *obj, void *data);
 static void nxt_router_conn_close(nxt_task_t *task, void *obj, void *data);
 static void nxt_router_conn_free(nxt_task_t *task, void *obj, void *data);
+static nxt_buf_t *nxt_router_app_header_fields(nxt_task_t *task,
+    nxt_conn_t *c, nxt_buf_t *b);
+static void nxt_router_access_log_response(nxt_task_t *task, nxt_conn_t *c,
+    nxt_buf_t *b);
+static void nxt_router_access_log(nxt_task_t *task, nxt_conn_t *c);
 static void nxt_router_conn_error(nxt_task_t *task, void *obj, void *data);
 static void nxt_router_conn_timeout(nxt_task_t *task, void *obj, void *data);
 static nxt_msec_t nxt_router_conn_timeout_value(nxt_conn_t *c, uintptr_t data);
 
-static void nxt_router_gen_error(nxt_task_t *task, nxt_conn_t *c, int code,
-    const char* fmt, ...);
 
 static nxt_router_t  *nxt_router;
 
@@ -159,6 +187,7 @@ static nxt_app_prepare_msg_t  nxt_app_prepare_msg[] = {
     nxt_python_prepare_msg,
     nxt_php_prepare_msg,
     nxt_go_prepare_msg,
+    NULL,  /* FastCGI applications are served by listeners. */
 };
 
 
@@ -187,7 +216,17 @@ nxt_router_start(nxt_task_t *task, void *data)
 
     nxt_router = router;
 
-    return NXT_OK;
+    if (rt->access_log_file != NULL) {
+        ret = nxt_access_log_init(rt->access_log_file->fd,
+                                  rt->access_log_format, rt->log_overflow);
+        if (nxt_slow_path(ret != NXT_OK)) {
+            return ret;
+        }
+    }
+
+    /* Router threads do not wait for log writes. */
+
+    return nxt_log_writer_start(rt->log_overflow);
 }
 
 
@@ -208,7 +247,7 @@ nxt_router_sw_create(nxt_task_t *task, nxt_app_t *app, nxt_req_app_link_t *ra)
     sw->ra = ra;
 
     nxt_debug(task, "sw %p create, request #%uxD, app '%V' %p", sw,
-                    ra->req_id, &app->name, app);
+                    (ra != NULL) ? ra->req_id : 0, &app->name, app);
 
     rt = task->thread->runtime;
     main_port = rt->port_by_type[NXT_PROCESS_MAIN];
@@ -300,17 +339,14 @@ nxt_router_ra_release(nxt_task_t *task, void *obj, void *data)
 
     if (ra->app_port != NULL) {
 
-        nxt_router_app_release_port(task, ra->app_port, ra->app_port->app);
+        /* The app port is held until the complete response is received. */
 
-#if 0
-        /* Uncomment to hold app port until complete response received. */
         if (ra->rc->conn != NULL) {
             ra->rc->app_port = ra->app_port;
 
         } else {
             nxt_router_app_release_port(task, ra->app_port, ra->app_port->app);
         }
-#endif
     }
 
     nxt_mp_release(ra->mem_pool, ra);
@@ -456,6 +492,7 @@ static void
 nxt_router_conf_apply(nxt_task_t *task, void *obj, void *data)
 {
     nxt_int_t                    ret;
+    nxt_app_t                    *app;
     nxt_router_t                 *router;
     nxt_runtime_t                *rt;
     nxt_queue_link_t             *qlk;
@@ -494,10 +531,22 @@ nxt_router_conf_apply(nxt_task_t *task, void *obj, void *data)
         goto fail;
     }
 
-    nxt_router_apps_sort(router, tmcf);
+    nxt_queue_each(app, &tmcf->apps, nxt_app_t, link) {
+
+        nxt_router_app_idle_timer_start(task, app);
+
+    } nxt_queue_loop;
+
+    nxt_router_apps_sort(task, router, tmcf);
 
     nxt_router_engines_post(tmcf);
 
+    nxt_queue_each(app, &router->apps, nxt_app_t, link) {
+
+        nxt_router_app_spare(task, app);
+
+    } nxt_queue_loop;
+
     nxt_queue_add(&router->sockets, &tmcf->updating);
     nxt_queue_add(&router->sockets, &tmcf->creating);
 
@@ -601,6 +650,39 @@ static nxt_conf_map_t  nxt_router_app_conf[] = {
         NXT_CONF_MAP_INT32,
         offsetof(nxt_router_app_conf_t, workers),
     },
+
+    {
+        nxt_string("spare_workers"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_app_conf_t, spare_workers),
+    },
+
+    {
+        nxt_string("threads"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_app_conf_t, threads),
+    },
+};
+
+
+static nxt_conf_map_t  nxt_router_app_processes_conf[] = {
+    {
+        nxt_string("max"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_app_conf_t, workers),
+    },
+
+    {
+        nxt_string("spare"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_app_conf_t, spare_workers),
+    },
+
+    {
+        nxt_string("idle_timeout"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_app_conf_t, idle_timeout),
+    },
 };
 
 
@@ -610,8 +692,69 @@ static nxt_conf_map_t  nxt_router_listener_conf[] = {
         NXT_CONF_MAP_STR,
         offsetof(nxt_router_listener_conf_t, application),
     },
+
+    {
+        nxt_string("share"),
+        NXT_CONF_MAP_STR,
+        offsetof(nxt_router_listener_conf_t, share),
+    },
+
+    {
+        nxt_string("proxy"),
+        NXT_CONF_MAP_PTR,
+        offsetof(nxt_router_listener_conf_t, proxy),
+    },
+
+    {
+        nxt_string("cache"),
+        NXT_CONF_MAP_PTR,
+        offsetof(nxt_router_listener_conf_t, cache),
+    },
+
+    {
+        nxt_string("tls"),
+        NXT_CONF_MAP_PTR,
+        offsetof(nxt_router_listener_conf_t, tls),
+    },
+};
+
+
+#if (NXT_SSLTLS)
+
+static nxt_conf_map_t  nxt_router_tls_conf[] = {
+    {
+        nxt_string("certificate"),
+        NXT_CONF_MAP_STR_COPY,
+        offsetof(nxt_ssltls_conf_t, name),
+    },
+
+    {
+        nxt_string("ciphers"),
+        NXT_CONF_MAP_CSTRZ,
+        offsetof(nxt_ssltls_conf_t, ciphers),
+    },
+
+    {
+        nxt_string("session_cache"),
+        NXT_CONF_MAP_SIZE,
+        offsetof(nxt_ssltls_conf_t, session_cache),
+    },
+
+    {
+        nxt_string("session_timeout"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_ssltls_conf_t, session_timeout),
+    },
+
+    {
+        nxt_string("session_tickets"),
+        NXT_CONF_MAP_INT8,
+        offsetof(nxt_ssltls_conf_t, session_tickets),
+    },
 };
 
+#endif
+
 
 static nxt_conf_map_t  nxt_router_http_conf[] = {
     {
@@ -655,6 +798,12 @@ static nxt_conf_map_t  nxt_router_http_conf[] = {
         NXT_CONF_MAP_MSEC,
         offsetof(nxt_socket_conf_t, body_read_timeout),
     },
+
+    {
+        nxt_string("static_cache_valid"),
+        NXT_CONF_MAP_MSEC,
+        offsetof(nxt_socket_conf_t, static_cache_valid),
+    },
 };
 
 
@@ -662,17 +811,17 @@ static nxt_int_t
 nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
     u_char *start, u_char *end)
 {
-    u_char                      *p;
     size_t                      size;
     nxt_mp_t                    *mp;
     uint32_t                    next;
     nxt_int_t                   ret;
     nxt_str_t                   name;
     nxt_app_t                   *app, *prev;
+    nxt_buf_mem_t               json;
     nxt_app_type_t              type;
     nxt_sockaddr_t              *sa;
     nxt_conf_value_t            *conf, *http;
-    nxt_conf_value_t            *applications, *application;
+    nxt_conf_value_t            *applications, *application, *processes;
     nxt_conf_value_t            *listeners, *listener;
     nxt_socket_conf_t           *skcf;
     nxt_app_lang_module_t       *lang;
@@ -682,6 +831,7 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
     static nxt_str_t  http_path = nxt_string("/http");
     static nxt_str_t  applications_path = nxt_string("/applications");
     static nxt_str_t  listeners_path = nxt_string("/listeners");
+    static nxt_str_t  processes_path = nxt_string("processes");
 
     conf = nxt_conf_json_parse(tmcf->mem_pool, start, end, NULL);
     if (conf == NULL) {
@@ -702,6 +852,16 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         tmcf->conf->threads = nxt_ncpu;
     }
 
+    /* The router thread engines have ids 1 .. NXT_REQ_ID_ENGINE_MASK. */
+
+    if (tmcf->conf->threads > NXT_REQ_ID_ENGINE_MASK) {
+        nxt_log(task, NXT_LOG_WARN, "the number of router threads %uD "
+                "is limited to %d", tmcf->conf->threads,
+                NXT_REQ_ID_ENGINE_MASK);
+
+        tmcf->conf->threads = NXT_REQ_ID_ENGINE_MASK;
+    }
+
     applications = nxt_conf_get_path(conf, &applications_path);
     if (applications == NULL) {
         nxt_log(task, NXT_LOG_CRIT, "no \"applications\" block");
@@ -710,6 +870,9 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
 
     next = 0;
 
+    /* The buffer is reused for all applications. */
+    nxt_memzero(&json, sizeof(nxt_buf_mem_t));
+
     for ( ;; ) {
         application = nxt_conf_next_object_member(applications, &name, &next);
         if (application == NULL) {
@@ -718,7 +881,15 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
 
         nxt_debug(task, "application \"%V\"", &name);
 
-        size = nxt_conf_json_length(application, NULL);
+        json.pos = json.start;
+        json.free = json.start;
+
+        ret = nxt_conf_json_dump(tmcf->mem_pool, &json, application, NULL, 0);
+        if (ret != NXT_OK) {
+            goto fail;
+        }
+
+        size = nxt_buf_mem_used_size(&json);
 
         app = nxt_malloc(sizeof(nxt_app_t) + name.length + size);
         if (app == NULL) {
@@ -730,10 +901,8 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         app->name.start = nxt_pointer_to(app, sizeof(nxt_app_t));
         app->conf.start = nxt_pointer_to(app, sizeof(nxt_app_t) + name.length);
 
-        p = nxt_conf_json_print(app->conf.start, application, NULL);
-        app->conf.length = p - app->conf.start;
-
-        nxt_assert(app->conf.length <= size);
+        nxt_memcpy(app->conf.start, json.pos, size);
+        app->conf.length = size;
 
         nxt_debug(task, "application conf \"%V\"", &app->conf);
 
@@ -748,6 +917,9 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         }
 
         apcf.workers = 1;
+        apcf.spare_workers = 0;
+        apcf.idle_timeout = 0;
+        apcf.threads = 1;
 
         ret = nxt_conf_map_object(mp, application, nxt_router_app_conf,
                                   nxt_nitems(nxt_router_app_conf), &apcf);
@@ -756,8 +928,29 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
             goto app_fail;
         }
 
+        if (nxt_app_parse_type(&apcf.type) == NXT_APP_FASTCGI) {
+            /* FastCGI applications are served by listeners directly. */
+            nxt_free(app);
+            continue;
+        }
+
+        processes = nxt_conf_get_object_member(application, &processes_path,
+                                               NULL);
+        if (processes != NULL) {
+            ret = nxt_conf_map_object(mp, processes,
+                                      nxt_router_app_processes_conf,
+                                      nxt_nitems(nxt_router_app_processes_conf),
+                                      &apcf);
+            if (ret != NXT_OK) {
+                nxt_log(task, NXT_LOG_CRIT, "application processes map error");
+                goto app_fail;
+            }
+        }
+
         nxt_debug(task, "application type: %V", &apcf.type);
         nxt_debug(task, "application workers: %D", apcf.workers);
+        nxt_debug(task, "application spare workers: %D", apcf.spare_workers);
+        nxt_debug(task, "application idle timeout: %D", apcf.idle_timeout);
 
         lang = nxt_app_lang_module(task->thread->runtime, &apcf.type);
 
@@ -796,6 +989,30 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
 
         app->type = type;
         app->max_workers = apcf.workers;
+        app->spare_workers = nxt_min(apcf.spare_workers, apcf.workers);
+        /* The value is limited by the configuration validation. */
+        app->idle_timeout = (nxt_msec_t) apcf.idle_timeout * 1000;
+
+        /*
+         * Go applications run each request in a goroutine and
+         * PHP applications may run requests in a thread pool.
+         */
+
+        switch (type) {
+
+        case NXT_APP_GO:
+            app->max_pending_requests = NXT_INT32_T_MAX;
+            break;
+
+        case NXT_APP_PHP:
+            app->max_pending_requests = apcf.threads;
+            break;
+
+        default:
+            app->max_pending_requests = 1;
+            break;
+        }
+
         app->live = 1;
         app->prepare_msg = nxt_app_prepare_msg[type];
 
@@ -840,6 +1057,8 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
             goto fail;
         }
 
+        nxt_memzero(&lscf, sizeof(nxt_router_listener_conf_t));
+
         ret = nxt_conf_map_object(mp, listener, nxt_router_listener_conf,
                                   nxt_nitems(nxt_router_listener_conf), &lscf);
         if (ret != NXT_OK) {
@@ -857,6 +1076,7 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         skcf->max_body_size = 2 * 1024 * 1024;
         skcf->header_read_timeout = 5000;
         skcf->body_read_timeout = 5000;
+        skcf->static_cache_valid = 60000;
 
         if (http != NULL) {
             ret = nxt_conf_map_object(mp, http, nxt_router_http_conf,
@@ -872,6 +1092,61 @@ nxt_router_conf_create(nxt_task_t *task, nxt_router_temp_conf_t *tmcf,
         skcf->router_conf->count++;
         skcf->application = nxt_router_listener_application(tmcf,
                                                             &lscf.application);
+        skcf->share = lscf.share;
+        skcf->access_name = nxt_access_log_name(lscf.application.length != 0
+                                                ? &lscf.application : &name);
+
+        if (skcf->application == NULL && lscf.application.length != 0) {
+            application = nxt_conf_get_object_member(applications,
+                                                     &lscf.application, NULL);
+        } else {
+            application = NULL;
+        }
+
+        if (application != NULL) {
+            nxt_memzero(&apcf, sizeof(nxt_router_app_conf_t));
+
+            ret = nxt_conf_map_object(mp, application, nxt_router_app_conf,
+                                      nxt_nitems(nxt_router_app_conf), &apcf);
+            if (ret != NXT_OK) {
+                nxt_log(task, NXT_LOG_CRIT, "application map error");
+                goto fail;
+            }
+
+            if (nxt_app_parse_type(&apcf.type) == NXT_APP_FASTCGI) {
+                skcf->fastcgi = nxt_router_fastcgi_conf_create(task, mp,
+                                                               application);
+                if (skcf->fastcgi == NULL) {
+                    goto fail;
+                }
+            }
+        }
+
+        if (lscf.proxy != NULL) {
+            skcf->proxy = nxt_router_proxy_conf_create(task, mp, lscf.proxy);
+            if (skcf->proxy == NULL) {
+                goto fail;
+            }
+        }
+
+        if (lscf.cache != NULL) {
+            skcf->cache = nxt_router_cache_conf_create(task, mp, lscf.cache);
+            if (skcf->cache == NULL) {
+                goto fail;
+            }
+        }
+
+#if (NXT_SSLTLS)
+        if (lscf.tls != NULL) {
+            skcf->ssltls = nxt_router_tls_conf_create(task, mp, conf,
+                                                      lscf.tls);
+            if (skcf->ssltls == NULL) {
+                goto fail;
+            }
+
+            skcf->listen.ssltls = 1;
+        }
+#endif
 
         nxt_queue_insert_tail(&tmcf->pending, &skcf->link);
     }
@@ -898,6 +1173,92 @@ fail:
 }
 
 
+#if (NXT_SSLTLS)
+
+static nxt_ssltls_conf_t *
+nxt_router_tls_conf_create(nxt_task_t *task, nxt_mp_t *mp,
+    nxt_conf_value_t *conf, nxt_conf_value_t *value)
+{
+    nxt_int_t          ret;
+    nxt_conf_value_t   *certificates, *bundle;
+    nxt_ssltls_conf_t  *tls;
+
+    static nxt_str_t  certificates_path = nxt_string("/certificates");
+
+    tls = nxt_mp_zget(mp, sizeof(nxt_ssltls_conf_t));
+    if (nxt_slow_path(tls == NULL)) {
+        return NULL;
+    }
+
+    /*
+     * The records start small and grow up to the maximum
+     * SSL/TLS record size, see nxt_ssltls.h.
+     */
+    tls->buffer_size = 16384;
+
+    tls->session_cache = 20480;
+    tls->session_timeout = 300;
+    tls->session_tickets = 1;
+
+    ret = nxt_conf_map_object(mp, value, nxt_router_tls_conf,
+                              nxt_nitems(nxt_router_tls_conf), tls);
+    if (ret != NXT_OK) {
+        nxt_log(task, NXT_LOG_CRIT, "tls map error");
+        return NULL;
+    }
+
+    certificates = nxt_conf_get_path(conf, &certificates_path);
+
+    bundle = (certificates != NULL)
+             ? nxt_conf_get_object_member(certificates, &tls->name, NULL)
+             : NULL;
+
+    if (bundle == NULL) {
+        nxt_log(task, NXT_LOG_CRIT, "certificate \"%V\" not found",
+                &tls->name);
+        return NULL;
+    }
+
+    /* The bundle is valid only while the configuration is parsed. */
+    nxt_conf_get_string(bundle, &tls->bundle);
+
+    tls->lib = &nxt_openssl_lib;
+
+    ret = tls->lib->server_init(tls);
+
+    tls->bundle.length = 0;
+    tls->bundle.start = NULL;
+
+    if (ret != NXT_OK) {
+        nxt_log(task, NXT_LOG_CRIT, "certificate \"%V\" cannot be used",
+                &tls->name);
+        return NULL;
+    }
+
+    ret = nxt_mp_cleanup(mp, nxt_router_tls_conf_free,
+                         &task->thread->engine->task, tls, NULL);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        tls->lib->server_free(tls);
+        return NULL;
+    }
+
+    return tls;
+}
+
+
+static void
+nxt_router_tls_conf_free(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_ssltls_conf_t  *tls;
+
+    tls = obj;
+
+    tls->lib->server_free(tls);
+}
+
+#endif
+
+
 static nxt_app_t *
 nxt_router_app_find(nxt_queue_t *queue, nxt_str_t *name)
 {
@@ -1203,6 +1564,13 @@ nxt_router_engines_create(nxt_task_t *task, nxt_router_t *router,
             return NXT_ERROR;
         }
 
+        /*
+         * Router engines are never deleted, so the engine position
+         * gives an id unique among the router threads, see
+         * NXT_REQ_ID_ENGINE_BITS.
+         */
+        recf->engine->id = n + 1;
+
         ret = nxt_router_engine_conf_create(tmcf, recf);
         if (nxt_slow_path(ret != NXT_OK)) {
             return ret;
@@ -1345,6 +1713,25 @@ nxt_router_engine_joints_create(nxt_router_temp_conf_t *tmcf,
         joint->socket_conf = skcf;
 
         joint->engine = recf->engine;
+
+        nxt_lvlhsh_init(&joint->static_cache.hash);
+        joint->static_cache.entries = 0;
+        nxt_queue_init(&joint->static_cache.expiry_queue);
+
+        if (nxt_router_proxy_pool_init(tmcf->conf->mem_pool, &joint->proxy,
+                                       skcf->proxy)
+            != NXT_OK)
+        {
+            return NXT_ERROR;
+        }
+
+        if (nxt_router_proxy_pool_init(tmcf->conf->mem_pool, &joint->fastcgi,
+                                       (skcf->fastcgi != NULL)
+                                       ? skcf->fastcgi->upstream : NULL)
+            != NXT_OK)
+        {
+            return NXT_ERROR;
+        }
     }
 
     return NXT_OK;
@@ -1455,7 +1842,8 @@ nxt_router_thread_create(nxt_task_t *task, nxt_runtime_t *rt,
 
 
 static void
-nxt_router_apps_sort(nxt_router_t *router, nxt_router_temp_conf_t *tmcf)
+nxt_router_apps_sort(nxt_task_t *task, nxt_router_t *router,
+    nxt_router_temp_conf_t *tmcf)
 {
     nxt_app_t    *app;
     nxt_port_t   *port;
@@ -1468,6 +1856,10 @@ nxt_router_apps_sort(nxt_router_t *router, nxt_router_temp_conf_t *tmcf)
 
         app->live = 0;
 
+        if (app->idle_timeout != 0) {
+            nxt_timer_delete(task->thread->engine, &app->idle_timer);
+        }
+
         if (nxt_router_app_free(NULL, app) != 0) {
             continue;
         }
@@ -1479,17 +1871,32 @@ nxt_router_apps_sort(nxt_router_t *router, nxt_router_temp_conf_t *tmcf)
             continue;
         }
 
-        do {
-            port = nxt_router_app_get_port(app, 0);
-            if (port == NULL) {
-                break;
+        /*
+         * Idle ports are stopped here, the busy ones are stopped
+         * when their last response is complete.
+         */
+
+        nxt_thread_mutex_lock(&app->mutex);
+
+        nxt_queue_each(port, &app->ports, nxt_port_t, app_link) {
+
+            if (port->app_pending != 0) {
+                continue;
             }
 
+            nxt_queue_remove(&port->app_link);
+            port->app_link.next = NULL;
+
+            app->idle_workers--;
+
             nxt_thread_log_debug("port %p send quit", port);
 
             nxt_port_socket_write(&port->engine->task, port,
                                   NXT_PORT_MSG_QUIT, -1, 0, 0, NULL);
-        } while (1);
+
+        } nxt_queue_loop;
+
+        nxt_thread_mutex_unlock(&app->mutex);
 
     } nxt_queue_loop;
 
@@ -1788,6 +2195,10 @@ nxt_router_conf_release(nxt_task_t *task, nxt_socket_conf_joint_t *joint)
 
     nxt_queue_remove(&joint->link);
 
+    nxt_router_static_cache_free(task, &joint->static_cache);
+    nxt_router_proxy_pool_free(task, &joint->proxy);
+    nxt_router_proxy_pool_free(task, &joint->fastcgi);
+
     skcf = joint->socket_conf;
     rtcf = skcf->router_conf;
     lock = &rtcf->router->lock;
@@ -1890,6 +2301,23 @@ static const nxt_conn_state_t  nxt_router_conn_read_body_state
 };
 
 
+#if (NXT_SSLTLS)
+
+static const nxt_conn_state_t  nxt_router_conn_tls_handshake_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_router_conn_tls_ready,
+    .close_handler = nxt_router_conn_close,
+    .error_handler = nxt_router_conn_error,
+
+    .timer_handler = nxt_router_conn_tls_timeout,
+    .timer_value = nxt_router_conn_timeout_value,
+    .timer_data = offsetof(nxt_socket_conf_t, header_read_timeout),
+};
+
+#endif
+
+
 static void
 nxt_router_conn_init(nxt_task_t *task, void *obj, void *data)
 {
@@ -1897,6 +2325,9 @@ nxt_router_conn_init(nxt_task_t *task, void *obj, void *data)
     nxt_conn_t               *c;
     nxt_event_engine_t       *engine;
     nxt_socket_conf_joint_t  *joint;
+#if (NXT_SSLTLS)
+    nxt_ssltls_conf_t        *ssltls;
+#endif
 
     c = obj;
     joint = data;
@@ -1910,47 +2341,99 @@ nxt_router_conn_init(nxt_task_t *task, void *obj, void *data)
 
     c->socket.data = NULL;
 
+    if (nxt_access_log_enabled) {
+        c->access.start = nxt_thread_monotonic_time(task->thread);
+        c->access.name = joint->socket_conf->access_name;
+    }
+
     engine = task->thread->engine;
     c->read_work_queue = &engine->fast_work_queue;
     c->write_work_queue = &engine->fast_work_queue;
 
+#if (NXT_SSLTLS)
+    ssltls = joint->socket_conf->ssltls;
+
+    if (ssltls != NULL) {
+        c->socket.read_work_queue = &engine->read_work_queue;
+        c->read_state = &nxt_router_conn_tls_handshake_state;
+
+        ssltls->conn_init(task, ssltls, c);
+        return;
+    }
+#endif
+
     c->read_state = &nxt_router_conn_read_header_state;
 
     nxt_conn_read(engine, c);
 }
 
 
-static const nxt_conn_state_t  nxt_router_conn_write_state
-    nxt_aligned(64) =
-{
-    .ready_handler = nxt_router_conn_ready,
-    .close_handler = nxt_router_conn_close,
-    .error_handler = nxt_router_conn_error,
-};
-
+#if (NXT_SSLTLS)
 
 static void
-nxt_router_app_data_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+nxt_router_conn_tls_ready(nxt_task_t *task, void *obj, void *data)
 {
-    size_t               dump_size;
-    nxt_buf_t            *b, *last;
-    nxt_conn_t           *c;
-    nxt_req_conn_link_t  *rc;
-    nxt_event_engine_t   *engine;
+    nxt_conn_t  *c;
 
-    b = msg->buf;
-    engine = task->thread->engine;
+    c = obj;
 
-    rc = nxt_event_engine_request_find(engine, msg->port_msg.stream);
-    if (nxt_slow_path(rc == NULL)) {
-        nxt_debug(task, "request id %08uxD not found", msg->port_msg.stream);
+    nxt_debug(task, "router conn tls ready");
 
-        return;
-    }
+    c->read_state = &nxt_router_conn_read_header_state;
 
-    c = rc->conn;
+    nxt_conn_read(task->thread->engine, c);
+}
 
-    dump_size = nxt_buf_used_size(b);
+
+static void
+nxt_router_conn_tls_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t   *c;
+    nxt_timer_t  *timer;
+
+    timer = obj;
+
+    nxt_debug(task, "router conn tls handshake timeout");
+
+    c = nxt_read_timer_conn(timer);
+
+    nxt_router_conn_close(task, c, c->socket.data);
+}
+
+#endif
+
+
+static const nxt_conn_state_t  nxt_router_conn_write_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_router_conn_ready,
+    .close_handler = nxt_router_conn_close,
+    .error_handler = nxt_router_conn_error,
+};
+
+
+static void
+nxt_router_app_data_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
+{
+    size_t               dump_size;
+    nxt_buf_t            *b, *last;
+    nxt_conn_t           *c;
+    nxt_req_conn_link_t  *rc;
+    nxt_event_engine_t   *engine;
+
+    b = msg->buf;
+    engine = task->thread->engine;
+
+    rc = nxt_event_engine_request_find(engine, msg->port_msg.stream);
+    if (nxt_slow_path(rc == NULL)) {
+        nxt_debug(task, "request id %08uxD not found", msg->port_msg.stream);
+
+        return;
+    }
+
+    c = rc->conn;
+
+    dump_size = nxt_buf_used_size(b);
 
     if (dump_size > 300) {
         dump_size = 300;
@@ -1992,6 +2475,96 @@ nxt_router_app_data_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg)
         msg->buf = NULL;
     }
 
+    if (!rc->header) {
+        rc->header = 1;
+        b = nxt_router_app_header_fields(task, c, b);
+    }
+
+    nxt_router_conn_output(task, c, b);
+}
+
+
+/*
+ * The "Server" and "Date" fields are added after the status line of
+ * an application response unless the application has set them.
+ * The header must be in the first response buffer.
+ */
+
+static nxt_buf_t *
+nxt_router_app_header_fields(nxt_task_t *task, nxt_conn_t *c, nxt_buf_t *b)
+{
+    u_char      *pos, *end, *lf, *last;
+    size_t      size;
+    nxt_buf_t   *h;
+    nxt_uint_t  fields;
+
+    if (!nxt_buf_is_mem(b)) {
+        return b;
+    }
+
+    pos = b->mem.pos;
+    end = b->mem.free;
+
+    if (end - pos < 12 || nxt_memcmp(pos, "HTTP/1.", 7) != 0) {
+        return b;
+    }
+
+    lf = nxt_memchr(pos, '\n', end - pos);
+    if (lf == NULL) {
+        return b;
+    }
+
+    last = nxt_memstrn(lf - 1, end, "\r\n\r\n", 4);
+    if (last == NULL) {
+        return b;
+    }
+
+    fields = NXT_HTTP_FIELDS;
+
+    if (nxt_memcasestrn(lf, last + 2, "\nServer:", 8) != NULL) {
+        fields &= ~NXT_HTTP_FIELD_SERVER;
+    }
+
+    if (nxt_memcasestrn(lf, last + 2, "\nDate:", 6) != NULL) {
+        fields &= ~NXT_HTTP_FIELD_DATE;
+    }
+
+    if (fields == 0) {
+        return b;
+    }
+
+    size = lf + 1 - pos;
+
+    h = nxt_buf_mem_alloc(c->mem_pool, size + NXT_HTTP_FIELDS_LEN, 0);
+    if (nxt_slow_path(h == NULL)) {
+        return b;
+    }
+
+    h->mem.free = nxt_cpymem(h->mem.free, pos, size);
+    h->mem.free = nxt_http_fields_add(task, h->mem.free, fields);
+
+    b->mem.pos = lf + 1;
+    h->next = b;
+
+    return h;
+}
+
+
+void
+nxt_router_conn_output(nxt_task_t *task, nxt_conn_t *c, nxt_buf_t *b)
+{
+    nxt_socket_conf_joint_t  *joint;
+
+    joint = c->listen->socket.data;
+
+    if (joint->socket_conf->cache != NULL) {
+        nxt_router_cache_output(task, c, b);
+    }
+
+    if (nxt_access_log_enabled) {
+        nxt_router_access_log_response(task, c, b);
+    }
+
     if (c->write == NULL) {
         c->write = b;
         c->write_state = &nxt_router_conn_write_state;
@@ -2016,6 +2589,8 @@ nxt_router_text_by_code(int code)
     case 408: return "Request Timeout";
     case 411: return "Length Required";
     case 413: return "Request Entity Too Large";
+    case 502: return "Bad Gateway";
+    case 504: return "Gateway Timeout";
     case 500:
     default:  return "Internal server error";
     }
@@ -2035,11 +2610,17 @@ nxt_router_get_error_buf(nxt_task_t *task, nxt_mp_t *mp, int code,
     }
 
     b->mem.free = nxt_sprintf(b->mem.free, b->mem.end,
-        "HTTP/1.0 %d %s\r\n"
-        "Content-Type: text/plain\r\n"
-        "Connection: close\r\n\r\n",
+        "HTTP/1.0 %d %s\r\n",
         code, nxt_router_text_by_code(code));
 
+    b->mem.free = nxt_http_fields_add(task, b->mem.free, NXT_HTTP_FIELDS);
+
+    b->mem.free = nxt_cpymem(b->mem.free,
+                             "Content-Type: text/plain\r\n"
+                             "Connection: close\r\n\r\n",
+                             sizeof("Content-Type: text/plain\r\n"
+                                    "Connection: close\r\n\r\n") - 1);
+
     msg = (const char *) b->mem.free;
 
     b->mem.free = nxt_vsprintf(b->mem.free, b->mem.end, fmt, args);
@@ -2063,8 +2644,7 @@ nxt_router_get_error_buf(nxt_task_t *task, nxt_mp_t *mp, int code,
 }
 
 
-
-static void
+void
 nxt_router_gen_error(nxt_task_t *task, nxt_conn_t *c, int code,
     const char* fmt, ...)
 {
@@ -2086,17 +2666,7 @@ nxt_router_gen_error(nxt_task_t *task, nxt_conn_t *c, int code,
         return;
     }
 
-    if (c->write == NULL) {
-        c->write = b;
-        c->write_state = &nxt_router_conn_write_state;
-
-        nxt_conn_write(task->thread->engine, c);
-
-    } else {
-        nxt_debug(task, "router data attach out bufs to existing chain");
-
-        nxt_buf_chain_add(&c->write, b);
-    }
+    nxt_router_conn_output(task, c, b);
 }
 
 
@@ -2117,7 +2687,7 @@ nxt_router_sw_ready(nxt_task_t *task, nxt_port_recv_msg_t *msg, void *data)
 
     nxt_debug(task, "sw %p got port %p", sw, msg->new_port);
 
-    nxt_router_app_release_port(task, msg->new_port, sw->app);
+    nxt_router_app_port_ready(task, msg->new_port, sw->app, 0);
 
     nxt_router_sw_release(task, sw);
 }
@@ -2156,10 +2726,29 @@ nxt_router_send_sw_request(nxt_task_t *task, void *obj, void *data)
 
     sw = obj;
     app = sw->app;
+    ra = sw->ra;
+
+    if (ra == NULL) {
+        /* A spare worker is started ahead of requests. */
+
+        if (!app->live
+            || app->idle_workers + app->pending_workers >= app->spare_workers
+            || app->workers + app->pending_workers >= app->max_workers)
+        {
+            nxt_debug(task, "app '%V' %p %uD/%uD idle/pending workers, "
+                      "spare worker is not required", &app->name, app,
+                      app->idle_workers, app->pending_workers);
+
+            nxt_router_sw_release(task, sw);
+
+            return;
+        }
+
+        goto start;
+    }
 
     if (nxt_queue_is_empty(&app->requests)) {
-        ra = sw->ra;
-        app_port = nxt_router_app_get_port(app, ra->req_id);
+        app_port = nxt_router_app_get_port(app);
 
         if (app_port != NULL) {
             nxt_debug(task, "app '%V' %p process request #%uxD",
@@ -2176,7 +2765,7 @@ nxt_router_send_sw_request(nxt_task_t *task, void *obj, void *data)
         }
     }
 
-    nxt_queue_insert_tail(&app->requests, &sw->ra->link);
+    nxt_queue_insert_tail(&app->requests, &ra->link);
 
     if (app->workers + app->pending_workers >= app->max_workers) {
         nxt_debug(task, "app '%V' %p %uD/%uD running/pending workers, "
@@ -2188,6 +2777,8 @@ nxt_router_send_sw_request(nxt_task_t *task, void *obj, void *data)
         return;
     }
 
+start:
+
     app->pending_workers++;
 
     nxt_debug(task, "sw %p send", sw);
@@ -2247,12 +2838,165 @@ nxt_router_app_free(nxt_task_t *task, nxt_app_t *app)
         nxt_router_sw_create(task, app, ra);
     }
 
+    if (app->live == 1 && task != NULL) {
+        nxt_router_app_spare(task, app);
+    }
+
     return 0;
 }
 
 
+static void
+nxt_router_app_spare(nxt_task_t *task, nxt_app_t *app)
+{
+    uint32_t  n, spare, avail;
+
+    if (app->spare_workers == 0) {
+        return;
+    }
+
+    /*
+     * The counters are read without locking, so the estimate may be stale;
+     * nxt_router_send_sw_request() rechecks it on the main engine.
+     */
+
+    spare = app->idle_workers + app->pending_workers;
+
+    if (spare >= app->spare_workers) {
+        return;
+    }
+
+    n = app->spare_workers - spare;
+
+    spare = app->workers + app->pending_workers;
+    avail = (spare < app->max_workers) ? app->max_workers - spare : 0;
+
+    n = nxt_min(n, avail);
+
+    nxt_debug(task, "app '%V' %p start %uD spare workers", &app->name, app, n);
+
+    while (n != 0) {
+        if (nxt_slow_path(nxt_router_sw_create(task, app, NULL) == NULL)) {
+            return;
+        }
+
+        n--;
+    }
+}
+
+
+static void
+nxt_router_app_idle_timer_start(nxt_task_t *task, nxt_app_t *app)
+{
+    nxt_event_engine_t  *engine;
+
+    if (app->idle_timeout == 0) {
+        return;
+    }
+
+    engine = task->thread->engine;
+
+    app->idle_timer.task = &engine->task;
+    app->idle_timer.work_queue = &engine->fast_work_queue;
+    app->idle_timer.handler = nxt_router_app_idle_timeout;
+    app->idle_timer.log = engine->task.log;
+
+    nxt_timer_add(engine, &app->idle_timer, app->idle_timeout);
+}
+
+
+/*
+ * Idle ports are kept in LIFO order, so the least recently used port is
+ * the last one.  Ports idle longer than idle_timeout are stopped while
+ * more than spare_workers ports remain idle.
+ */
+
+static void
+nxt_router_app_idle_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_app_t             *app;
+    nxt_msec_t            idle, next;
+    nxt_port_t            *port;
+    nxt_timer_t           *timer;
+    nxt_queue_link_t      *lnk;
+    nxt_event_engine_t    *engine;
+    nxt_monotonic_time_t  now;
+
+    timer = obj;
+    app = nxt_timer_data(timer, nxt_app_t, idle_timer);
+
+    engine = task->thread->engine;
+    next = app->idle_timeout;
+
+    nxt_thread_mutex_lock(&app->mutex);
+
+    /*
+     * The ports are released by different engines, so the idle time
+     * is measured with the monotonic clock read under the mutex rather
+     * than with the engine timer clocks.
+     */
+
+    nxt_monotonic_time(&now);
+
+    lnk = nxt_queue_last(&app->ports);
+
+    while (app->idle_workers > app->spare_workers
+           && lnk != nxt_queue_head(&app->ports))
+    {
+        port = nxt_queue_link_data(lnk, nxt_port_t, app_link);
+        lnk = nxt_queue_prev(lnk);
+
+        /* Ports which run requests but can take more are skipped. */
+
+        if (port->app_pending != 0) {
+            continue;
+        }
+
+        idle = (now.monotonic - port->idle_start) / 1000000;
+
+        if (idle < app->idle_timeout) {
+            next = app->idle_timeout - idle;
+            break;
+        }
+
+        nxt_queue_remove(&port->app_link);
+        port->app_link.next = NULL;
+
+        app->idle_workers--;
+
+        nxt_debug(task, "app '%V' %p port %p idle for %M, stop it",
+                  &app->name, app, port, idle);
+
+        port->work.next = NULL;
+        port->work.handler = nxt_router_app_port_quit;
+        port->work.task = &port->engine->task;
+        port->work.obj = port;
+        port->work.data = app;
+
+        nxt_event_engine_post(port->engine, &port->work);
+    }
+
+    nxt_thread_mutex_unlock(&app->mutex);
+
+    nxt_timer_add(engine, timer, next);
+}
+
+
+static void
+nxt_router_app_port_quit(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_port_t  *port;
+
+    port = obj;
+
+    nxt_debug(task, "port %p send quit", port);
+
+    nxt_port_socket_write(task, port, NXT_PORT_MSG_QUIT, -1, 0, 0, NULL);
+}
+
+
 static nxt_port_t *
-nxt_router_app_get_port(nxt_app_t *app, uint32_t req_id)
+nxt_router_app_get_port(nxt_app_t *app)
 {
     nxt_port_t        *port;
     nxt_queue_link_t  *lnk;
@@ -2263,13 +3007,19 @@ nxt_router_app_get_port(nxt_app_t *app, uint32_t req_id)
 
     if (!nxt_queue_is_empty(&app->ports)) {
         lnk = nxt_queue_first(&app->ports);
-        nxt_queue_remove(lnk);
-
-        lnk->next = NULL;
 
         port = nxt_queue_link_data(lnk, nxt_port_t, app_link);
 
-        port->app_req_id = req_id;
+        if (port->app_pending == 0) {
+            app->idle_workers--;
+        }
+
+        port->app_pending++;
+
+        if (port->app_pending == app->max_pending_requests) {
+            nxt_queue_remove(lnk);
+            lnk->next = NULL;
+        }
     }
 
     nxt_thread_mutex_unlock(&app->mutex);
@@ -2278,30 +3028,36 @@ nxt_router_app_get_port(nxt_app_t *app, uint32_t req_id)
 }
 
 
+/*
+ * A response is accounted on the port engine.  The port work is posted
+ * once for all responses completed by other engines in the meantime.
+ */
+
 static void
 nxt_router_app_release_port(nxt_task_t *task, void *obj, void *data)
 {
-    nxt_app_t            *app;
-    nxt_port_t           *port;
-    nxt_work_t           *work;
-    nxt_queue_link_t     *lnk;
-    nxt_req_app_link_t   *ra;
+    nxt_app_t   *app;
+    nxt_port_t  *port;
+    nxt_work_t  *work;
 
     port = obj;
     app = data;
 
     nxt_assert(app != NULL);
     nxt_assert(app == port->app);
-    nxt_assert(port->app_link.next == NULL);
-
 
     if (task->thread->engine != port->engine) {
+
+        if (nxt_atomic_fetch_add(&port->app_responses, 1) != 0) {
+            return;
+        }
+
         work = &port->work;
 
         nxt_debug(task, "post release port to engine %p", port->engine);
 
         work->next = NULL;
-        work->handler = nxt_router_app_release_port;
+        work->handler = nxt_router_app_responses_handler;
         work->task = &port->engine->task;
         work->obj = port;
         work->data = app;
@@ -2311,8 +3067,88 @@ nxt_router_app_release_port(nxt_task_t *task, void *obj, void *data)
         return;
     }
 
-    if (!nxt_queue_is_empty(&app->requests)) {
-        lnk = nxt_queue_first(&app->requests);
+    nxt_router_app_port_ready(task, port, app, 1);
+}
+
+
+static void
+nxt_router_app_responses_handler(nxt_task_t *task, void *obj, void *data)
+{
+    uint32_t    responses;
+    nxt_port_t  *port;
+
+    port = obj;
+
+    responses = nxt_atomic_xchg(&port->app_responses, 0);
+
+    nxt_router_app_port_ready(task, port, data, responses);
+}
+
+
+/*
+ * Accounts the completed responses and passes queued requests to the port
+ * while it can run more of them.  Ports with free request slots are kept
+ * in the most recently released order, so ports with no requests are
+ * ordered by their idle time.
+ */
+
+static void
+nxt_router_app_port_ready(nxt_task_t *task, nxt_port_t *port, nxt_app_t *app,
+    uint32_t responses)
+{
+    uint32_t              pending;
+    nxt_bool_t            alive;
+    nxt_queue_t           requests;
+    nxt_queue_link_t      *lnk;
+    nxt_req_app_link_t    *ra;
+    nxt_monotonic_time_t  now;
+
+    nxt_queue_init(&requests);
+
+    alive = app->live && port->pair[1] != -1;
+
+    nxt_thread_mutex_lock(&app->mutex);
+
+    if (port->app_link.next != NULL) {
+        nxt_queue_remove(&port->app_link);
+        port->app_link.next = NULL;
+
+        if (port->app_pending == 0) {
+            app->idle_workers--;
+        }
+    }
+
+    port->app_pending -= responses;
+
+    if (alive) {
+        while (!nxt_queue_is_empty(&app->requests)
+               && port->app_pending < app->max_pending_requests)
+        {
+            lnk = nxt_queue_first(&app->requests);
+            nxt_queue_remove(lnk);
+            nxt_queue_insert_tail(&requests, lnk);
+
+            port->app_pending++;
+        }
+
+        if (port->app_pending < app->max_pending_requests) {
+            nxt_queue_insert_head(&app->ports, &port->app_link);
+
+            if (port->app_pending == 0) {
+                nxt_monotonic_time(&now);
+
+                port->idle_start = now.monotonic;
+                app->idle_workers++;
+            }
+        }
+    }
+
+    pending = port->app_pending;
+
+    nxt_thread_mutex_unlock(&app->mutex);
+
+    while (!nxt_queue_is_empty(&requests)) {
+        lnk = nxt_queue_first(&requests);
         nxt_queue_remove(lnk);
 
         ra = nxt_queue_link_data(lnk, nxt_req_app_link_t, link);
@@ -2321,16 +3157,21 @@ nxt_router_app_release_port(nxt_task_t *task, void *obj, void *data)
                   &app->name, app, ra->req_id);
 
         ra->app_port = port;
-        port->app_req_id = ra->req_id;
 
         nxt_router_process_http_request_mp(task, ra, port);
 
         nxt_router_ra_release(task, ra, ra->work.data);
+    }
 
+    if (alive) {
+        nxt_debug(task, "app '%V' %p port %p runs %uD requests",
+                  &app->name, app, port, pending);
         return;
     }
 
-    port->app_req_id = 0;
+    if (pending != 0) {
+        return;
+    }
 
     if (port->pair[1] == -1) {
         nxt_debug(task, "app '%V' %p port already closed (pid %PI dead?)",
@@ -2346,24 +3187,10 @@ nxt_router_app_release_port(nxt_task_t *task, void *obj, void *data)
         return;
     }
 
-    if (!app->live) {
-        nxt_debug(task, "app '%V' %p is not alive, send QUIT to port",
-                  &app->name, app);
-
-        nxt_port_socket_write(task, port, NXT_PORT_MSG_QUIT,
-                              -1, 0, 0, NULL);
-
-        return;
-    }
-
-    nxt_debug(task, "app '%V' %p requests queue is empty, keep the port",
+    nxt_debug(task, "app '%V' %p is not alive, send QUIT to port",
               &app->name, app);
 
-    nxt_thread_mutex_lock(&app->mutex);
-
-    nxt_queue_insert_head(&app->ports, &port->app_link);
-
-    nxt_thread_mutex_unlock(&app->mutex);
+    nxt_port_socket_write(task, port, NXT_PORT_MSG_QUIT, -1, 0, 0, NULL);
 }
 
 
@@ -2374,7 +3201,6 @@ nxt_router_app_remove_port(nxt_port_t *port)
     nxt_bool_t  busy;
 
     app = port->app;
-    busy = port->app_req_id != 0;
 
     if (app == NULL) {
         nxt_thread_log_debug("port %p app remove, no app", port);
@@ -2386,11 +3212,16 @@ nxt_router_app_remove_port(nxt_port_t *port)
 
     nxt_thread_mutex_lock(&app->mutex);
 
+    busy = port->app_pending != 0;
+
     if (port->app_link.next != NULL) {
 
         nxt_queue_remove(&port->app_link);
         port->app_link.next = NULL;
 
+        if (!busy) {
+            app->idle_workers--;
+        }
     }
 
     nxt_thread_mutex_unlock(&app->mutex);
@@ -2405,8 +3236,8 @@ nxt_router_app_remove_port(nxt_port_t *port)
         return 1;
     }
 
-    nxt_thread_log_debug("port %p app remove, busy, app '%V' %p, req #%uxD",
-                         port, &app->name, app, port->app_req_id);
+    nxt_thread_log_debug("port %p app remove, busy, app '%V' %p, %uD requests",
+                         port, &app->name, app, port->app_pending);
 
     return 0;
 }
@@ -2434,12 +3265,15 @@ nxt_router_app_port(nxt_task_t *task, nxt_req_app_link_t *ra)
     }
 
 
-    port = nxt_router_app_get_port(app, ra->req_id);
+    port = nxt_router_app_get_port(app);
 
     if (port != NULL) {
         nxt_debug(task, "already have port for app '%V'", &app->name);
 
         ra->app_port = port;
+
+        nxt_router_app_spare(task, app);
+
         return NXT_OK;
     }
 
@@ -2460,7 +3294,7 @@ nxt_router_conn_http_header_parse(nxt_task_t *task, void *obj, void *data)
 {
     size_t                    size;
     nxt_int_t                 ret;
-    nxt_buf_t                 *buf;
+    nxt_buf_t                 *buf, *out;
     nxt_conn_t                *c;
     nxt_sockaddr_t            *local;
     nxt_app_parse_ctx_t       *ap;
@@ -2514,6 +3348,39 @@ nxt_router_conn_http_header_parse(nxt_task_t *task, void *obj, void *data)
                   "content length: %O, preread: %uz",
                   h->parsed_content_length, nxt_buf_mem_used_size(&buf->mem));
 
+        if (joint->socket_conf->share.length != 0) {
+            ret = nxt_router_static_handler(task, c, ap, &out);
+
+            if (ret == NXT_OK) {
+                nxt_mp_free(c->mem_pool, ap);
+                c->socket.data = NULL;
+
+                if (nxt_access_log_enabled) {
+                    nxt_router_access_log_response(task, c, out);
+                }
+
+                c->write = out;
+                c->write_state = &nxt_router_conn_write_state;
+
+                nxt_conn_write(task->thread->engine, c);
+                return;
+            }
+
+            if (nxt_slow_path(ret == NXT_ERROR)) {
+                nxt_router_gen_error(task, c, 500, "Failed to serve "
+                                     "static file");
+                return;
+            }
+
+            if (joint->socket_conf->application == NULL
+                && joint->socket_conf->proxy == NULL
+                && joint->socket_conf->fastcgi == NULL)
+            {
+                nxt_router_gen_error(task, c, 404, "File not found");
+                return;
+            }
+        }
+
         if (b->done) {
             nxt_router_process_http_request(task, c, ap);
 
@@ -2529,8 +3396,11 @@ nxt_router_conn_http_header_parse(nxt_task_t *task, void *obj, void *data)
         }
 
         if (nxt_buf_mem_free_size(&buf->mem) == 0) {
-            size = nxt_min(joint->socket_conf->body_buffer_size,
-                           (size_t) h->parsed_content_length);
+            size = joint->socket_conf->body_buffer_size;
+
+            if (!h->chunked) {
+                size = nxt_min(size, (size_t) h->parsed_content_length);
+            }
 
             buf->next = nxt_buf_mem_alloc(c->mem_pool, size, 0);
             if (nxt_slow_path(buf->next == NULL)) {
@@ -2540,6 +3410,7 @@ nxt_router_conn_http_header_parse(nxt_task_t *task, void *obj, void *data)
             }
 
             c->read = buf->next;
+            ap->chunk_parser.pos = c->read->mem.free;
 
             b->preread_size += nxt_buf_mem_used_size(&buf->mem);
         }
@@ -2624,18 +3495,38 @@ nxt_router_conn_http_body_read(nxt_task_t *task, void *obj, void *data)
         return;
 
     case NXT_ERROR:
+        if (ap->chunk_parser.chunk_error) {
+            nxt_router_gen_error(task, c, 400, "Invalid chunked body");
+            return;
+        }
+
         nxt_router_gen_error(task, c, 500, "Read body error");
         return;
 
     default:  /* NXT_AGAIN */
 
-        if (nxt_buf_mem_free_size(&buf->mem) == 0) {
-            joint = c->listen->socket.data;
+        joint = c->listen->socket.data;
+
+        /* A chunked body is buffered as a whole, see nxt_application.c. */
 
+        if (h->chunked
+            && joint->socket_conf->max_body_size > 0
+            && b->preread_size + nxt_buf_mem_used_size(&buf->mem)
+               > joint->socket_conf->max_body_size)
+        {
+            nxt_router_gen_error(task, c, 413, "Chunked body too big");
+            return;
+        }
+
+        if (nxt_buf_mem_free_size(&buf->mem) == 0) {
             b->preread_size += nxt_buf_mem_used_size(&buf->mem);
 
-            size = nxt_min(joint->socket_conf->body_buffer_size,
-                           (size_t) h->parsed_content_length - b->preread_size);
+            size = joint->socket_conf->body_buffer_size;
+
+            if (!h->chunked) {
+                size = nxt_min(size, (size_t) h->parsed_content_length
+                                     - b->preread_size);
+            }
 
             buf->next = nxt_buf_mem_alloc(c->mem_pool, size, 0);
             if (nxt_slow_path(buf->next == NULL)) {
@@ -2645,10 +3536,11 @@ nxt_router_conn_http_body_read(nxt_task_t *task, void *obj, void *data)
             }
 
             c->read = buf->next;
+            ap->chunk_parser.pos = c->read->mem.free;
         }
 
-        nxt_debug(task, "router request body read again, rest: %uz",
-                  h->parsed_content_length - b->preread_size);
+        nxt_debug(task, "router request body read again, read: %uz",
+                  b->preread_size);
     }
 
     nxt_conn_read(task->thread->engine, c);
@@ -2659,21 +3551,60 @@ static void
 nxt_router_process_http_request(nxt_task_t *task, nxt_conn_t *c,
     nxt_app_parse_ctx_t *ap)
 {
-    nxt_mp_t             *port_mp;
-    nxt_int_t            res;
-    nxt_port_t           *port;
-    nxt_req_id_t         req_id;
-    nxt_event_engine_t   *engine;
-    nxt_req_app_link_t   *ra;
-    nxt_req_conn_link_t  *rc;
+    nxt_int_t                res;
+    nxt_socket_conf_joint_t  *joint;
 
-    engine = task->thread->engine;
+    joint = c->listen->socket.data;
 
-    do {
-        req_id = nxt_random(&task->thread->random);
-    } while (nxt_event_engine_request_find(engine, req_id) != NULL);
+    if (nxt_access_log_enabled) {
+        c->access.pass = nxt_thread_monotonic_time(task->thread);
+    }
+
+    if (joint->socket_conf->cache != NULL) {
+        res = nxt_router_cache_handler(task, c, ap);
 
-    rc = nxt_conn_request_add(c, req_id);
+        if (res == NXT_OK) {
+            return;
+        }
+
+        if (nxt_slow_path(res == NXT_ERROR)) {
+            nxt_router_gen_error(task, c, 500, "Failed to allocate "
+                                 "cache request");
+            return;
+        }
+    }
+
+    nxt_router_http_request_pass(task, c, ap);
+}
+
+
+void
+nxt_router_http_request_pass(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap)
+{
+    nxt_mp_t                 *port_mp;
+    nxt_int_t                res;
+    nxt_port_t               *port;
+    nxt_event_engine_t       *engine;
+    nxt_req_app_link_t       *ra;
+    nxt_req_conn_link_t      *rc;
+    nxt_socket_conf_joint_t  *joint;
+
+    joint = c->listen->socket.data;
+
+    if (joint->socket_conf->proxy != NULL) {
+        nxt_router_proxy_handler(task, c, ap);
+        return;
+    }
+
+    if (joint->socket_conf->fastcgi != NULL) {
+        nxt_router_fastcgi_handler(task, c, ap);
+        return;
+    }
+
+    engine = task->thread->engine;
+
+    rc = nxt_conn_request_add(c);
 
     if (nxt_slow_path(rc == NULL)) {
         nxt_router_gen_error(task, c, 500, "Failed to allocate "
@@ -2682,10 +3613,15 @@ nxt_router_process_http_request(nxt_task_t *task, nxt_conn_t *c,
         return;
     }
 
-    nxt_event_engine_request_add(engine, rc);
+    if (nxt_slow_path(nxt_event_engine_request_add(engine, rc) != NXT_OK)) {
+        nxt_conn_request_remove(c, rc);
+        nxt_router_gen_error(task, c, 500, "Failed to allocate request id");
+
+        return;
+    }
 
     nxt_debug(task, "req_id %uxD linked to conn %p at engine %p",
-              req_id, c, engine);
+              rc->req_id, c, engine);
 
     c->socket.data = NULL;
 
@@ -2741,7 +3677,7 @@ nxt_router_process_http_request_mp(nxt_task_t *task, nxt_req_app_link_t *ra,
         if (nxt_slow_path(res != NXT_OK)) {
             nxt_router_gen_error(task, c, 500,
                                  "Failed to send reply port to application");
-            return;
+            goto fail;
         }
 
         nxt_process_connected_port_add(port->process, reply_port);
@@ -2757,7 +3693,7 @@ nxt_router_process_http_request_mp(nxt_task_t *task, nxt_req_app_link_t *ra,
     if (nxt_slow_path(res != NXT_OK)) {
         nxt_router_gen_error(task, c, 500,
                              "Failed to prepare message for application");
-        return;
+        goto fail;
     }
 
     nxt_debug(task, "about to send %d bytes buffer to worker port %d",
@@ -2770,8 +3706,18 @@ nxt_router_process_http_request_mp(nxt_task_t *task, nxt_req_app_link_t *ra,
     if (nxt_slow_path(res != NXT_OK)) {
         nxt_router_gen_error(task, c, 500,
                              "Failed to send message to application");
-        return;
+        goto fail;
     }
+
+    return;
+
+fail:
+
+    /* The request has not reached the application. */
+
+    ra->app_port = NULL;
+
+    nxt_router_app_release_port(task, port, port->app);
 }
 
 
@@ -3155,6 +4101,10 @@ nxt_router_conn_free(nxt_task_t *task, void *obj, void *data)
 
     nxt_queue_remove(&c->link);
 
+    if (nxt_access_log_enabled) {
+        nxt_router_access_log(task, c);
+    }
+
     joint = c->listen->socket.data;
 
     task = &task->thread->engine->task;
@@ -3165,6 +4115,106 @@ nxt_router_conn_free(nxt_task_t *task, void *obj, void *data)
 }
 
 
+/*
+ * The response status is taken from the status line of the first
+ * response buffer, so it is logged the same way for applications,
+ * upstreams, cached responses, static files, and router errors.
+ */
+
+static void
+nxt_router_access_log_response(nxt_task_t *task, nxt_conn_t *c, nxt_buf_t *b)
+{
+    u_char     *p;
+    nxt_int_t  status;
+
+    if (c->access.response != 0) {
+        return;
+    }
+
+    c->access.response = nxt_thread_monotonic_time(task->thread);
+
+    if (b == NULL || !nxt_buf_is_mem(b)) {
+        return;
+    }
+
+    p = b->mem.pos;
+
+    /* "HTTP/1.x NNN" */
+
+    if (b->mem.free - p >= 12 && nxt_memcmp(p, "HTTP/1.", 7) == 0) {
+        status = nxt_int_parse(p + 9, 3);
+
+        if (status > 0) {
+            c->access.status = status;
+        }
+    }
+}
+
+
+static void
+nxt_router_access_log(nxt_task_t *task, nxt_conn_t *c)
+{
+    nxt_nsec_t               now, elapsed;
+    nxt_realtime_t           *rt;
+    nxt_sockaddr_t           *sa;
+    nxt_access_log_record_t  record;
+
+    /* Connections closed before a request has been received are skipped. */
+
+    if (c->access.status == 0 && c->received == 0) {
+        return;
+    }
+
+    now = nxt_thread_monotonic_time(task->thread);
+    elapsed = now - c->access.start;
+
+    rt = nxt_thread_realtime(task->thread);
+
+    record.time = (uint64_t) rt->sec * 1000 + rt->nsec / 1000000
+                  - elapsed / 1000000;
+    record.request_time = nxt_min(elapsed / 1000, NXT_INT32_T_MAX);
+
+    if (c->access.pass != 0 && c->access.response > c->access.pass) {
+        record.upstream_time = nxt_min((c->access.response - c->access.pass)
+                                       / 1000, NXT_INT32_T_MAX);
+
+    } else {
+        record.upstream_time = 0;
+    }
+
+    record.bytes_in = c->received;
+    record.bytes_out = c->sent;
+    record.status = c->access.status;
+    record.name = c->access.name;
+
+    sa = c->remote;
+    record.family = sa->u.sockaddr.sa_family;
+    record.port = 0;
+
+    switch (record.family) {
+
+    case AF_INET:
+        record.port = sa->u.sockaddr_in.sin_port;
+        nxt_memcpy(record.addr, &sa->u.sockaddr_in.sin_addr,
+                   sizeof(struct in_addr));
+        break;
+
+#if (NXT_INET6)
+    case AF_INET6:
+        record.port = sa->u.sockaddr_in6.sin6_port;
+        nxt_memcpy(record.addr, &sa->u.sockaddr_in6.sin6_addr,
+                   sizeof(struct in6_addr));
+        break;
+#endif
+
+    default:
+        break;
+    }
+
+    nxt_access_log_write(&record);
+}
+
+
 static void
 nxt_router_conn_error(nxt_task_t *task, void *obj, void *data)
 {
@@ -12,6 +12,7 @@
 #include <nxt_runtime.h>
 #include <nxt_main_process.h>
 #include <nxt_application.h>
+#include <nxt_conf.h>
 
 
 typedef struct {
@@ -81,6 +82,14 @@ struct nxt_app_s {
     uint32_t               pending_workers;
     uint32_t               workers;
     uint32_t               max_workers;
+    uint32_t               spare_workers;
+    uint32_t               idle_workers;   /* Protected by mutex. */
+
+    /* The number of requests a worker runs at once. */
+    uint32_t               max_pending_requests;
+
+    nxt_msec_t             idle_timeout;
+    nxt_timer_t            idle_timer;
 
     nxt_app_type_t         type:8;
     uint8_t                live;   /* 1 bit */
@@ -98,6 +107,33 @@ typedef struct {
 } nxt_router_socket_t;
 
 
+typedef struct {
+    nxt_uint_t             npeers;
+    nxt_sockaddr_t         **peers;
+    uint32_t               keepalive;
+    uint8_t                least_conn;   /* 1 bit */
+} nxt_router_proxy_conf_t;
+
+
+typedef struct {
+    nxt_router_proxy_conf_t  *upstream;
+    nxt_str_t              root;
+    nxt_str_t              script;
+    nxt_str_t              index;
+} nxt_router_fastcgi_conf_t;
+
+
+typedef struct {
+    nxt_cache_t            *cache;
+    size_t                 size;
+    size_t                 max_response_size;
+    uint32_t               valid;
+    nxt_msec_t             lock_timeout;
+    nxt_uint_t             nheaders;
+    nxt_str_t              *headers;
+} nxt_router_cache_conf_t;
+
+
 typedef struct {
     uint32_t               count;
     nxt_queue_link_t       link;
@@ -106,6 +142,9 @@ typedef struct {
     nxt_sockaddr_t         *sockaddr;
 
     nxt_app_t              *application;
+    nxt_router_proxy_conf_t  *proxy;
+    nxt_router_fastcgi_conf_t  *fastcgi;
+    nxt_router_cache_conf_t    *cache;
 
     nxt_listen_socket_t    listen;
 
@@ -116,9 +155,89 @@ typedef struct {
     size_t                 max_body_size;
     nxt_msec_t             header_read_timeout;
     nxt_msec_t             body_read_timeout;
+
+    nxt_str_t              share;
+    nxt_msec_t             static_cache_valid;
+
+    /* An access log name index of the listener application or address. */
+    uint16_t               access_name;
+
+#if (NXT_SSLTLS)
+    nxt_ssltls_conf_t      *ssltls;
+#endif
 } nxt_socket_conf_t;
 
 
+typedef struct {
+    nxt_lvlhsh_t           hash;
+    nxt_uint_t             entries;
+    /* Of nxt_router_static_file_t, the least recently used is the last. */
+    nxt_queue_t            expiry_queue;
+} nxt_router_static_cache_t;
+
+
+typedef struct {
+    nxt_queue_t            idle;     /* of nxt_conn_t */
+    uint32_t               active;
+    nxt_sockaddr_t         *sockaddr;
+} nxt_router_proxy_peer_t;
+
+
+typedef struct {
+    nxt_uint_t               current;
+    nxt_router_proxy_conf_t  *conf;
+    nxt_router_proxy_peer_t  *peers;
+} nxt_router_proxy_pool_t;
+
+
+typedef struct nxt_router_upstream_s  nxt_router_upstream_t;
+
+typedef struct {
+    /* A response part has been read into the upstream buffer. */
+    void                   (*read)(nxt_task_t *task,
+                                   nxt_router_upstream_t *u);
+    /* Tests whether the connection close completes the response. */
+    nxt_bool_t             (*eof)(nxt_router_upstream_t *u);
+    /* A sent request is repeated regardless of its method. */
+    uint8_t                resend;   /* 1 bit */
+} nxt_router_upstream_proto_t;
+
+
+/*
+ * The request state shared by the proxy and FastCGI modules,
+ * the modules embed it in their requests.
+ */
+
+struct nxt_router_upstream_s {
+    const nxt_router_upstream_proto_t  *proto;
+
+    nxt_mp_t                 *mem_pool;
+    nxt_req_conn_link_t      *rc;
+    nxt_app_parse_ctx_t      *ap;
+    nxt_router_proxy_pool_t  *pool;
+    nxt_router_proxy_peer_t  *peer;
+    nxt_conn_t               *conn;
+
+    nxt_buf_t                *request;
+    nxt_buf_t                *header;
+    /* The next read buffer, allocated on read if it is NULL. */
+    nxt_buf_t                *buffer;
+    u_char                   *scan;
+    size_t                   body_buffer_size;
+
+    uint32_t                 tries;
+    uint32_t                 nbufs;
+
+    uint8_t                  head;       /* 1 bit */
+    uint8_t                  reused;     /* 1 bit */
+    uint8_t                  sent;       /* 1 bit */
+    uint8_t                  received;   /* 1 bit */
+    uint8_t                  started;    /* 1 bit */
+    uint8_t                  keepalive;  /* 1 bit */
+    uint8_t                  paused;     /* 1 bit */
+};
+
+
 typedef struct {
     uint32_t               count;
     nxt_queue_link_t       link;
@@ -126,6 +245,9 @@ typedef struct {
     nxt_socket_conf_t      *socket_conf;
 
     /* Modules configuraitons. */
+    nxt_router_static_cache_t  static_cache;
+    nxt_router_proxy_pool_t    proxy;
+    nxt_router_proxy_pool_t    fastcgi;
 } nxt_socket_conf_joint_t;
 
 
@@ -135,4 +257,50 @@ void nxt_router_remove_pid_handler(nxt_task_t *task, nxt_port_recv_msg_t *msg);
 
 nxt_bool_t nxt_router_app_remove_port(nxt_port_t *port);
 
+nxt_int_t nxt_router_static_handler(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap, nxt_buf_t **out);
+void nxt_router_static_cache_free(nxt_task_t *task,
+    nxt_router_static_cache_t *cache);
+
+nxt_router_proxy_conf_t *nxt_router_proxy_conf_create(nxt_task_t *task,
+    nxt_mp_t *mp, nxt_conf_value_t *value);
+nxt_int_t nxt_router_proxy_pool_init(nxt_mp_t *mp,
+    nxt_router_proxy_pool_t *pool, nxt_router_proxy_conf_t *conf);
+void nxt_router_proxy_pool_free(nxt_task_t *task,
+    nxt_router_proxy_pool_t *pool);
+void nxt_router_proxy_handler(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap);
+nxt_int_t nxt_router_proxy_field(u_char *start, u_char *end, nxt_str_t *name,
+    nxt_str_t *value);
+
+nxt_router_upstream_t *nxt_router_upstream_create(nxt_task_t *task,
+    nxt_conn_t *c, nxt_app_parse_ctx_t *ap, size_t size,
+    nxt_router_proxy_pool_t *pool, const nxt_router_upstream_proto_t *proto);
+void nxt_router_upstream_connect(nxt_task_t *task, nxt_router_upstream_t *u);
+void nxt_router_upstream_read(nxt_task_t *task, nxt_router_upstream_t *u);
+nxt_int_t nxt_router_upstream_header_parse(nxt_router_upstream_t *u);
+void nxt_router_upstream_output(nxt_task_t *task, nxt_router_upstream_t *u,
+    nxt_buf_t *b);
+void nxt_router_upstream_buf_completion(nxt_task_t *task, void *obj,
+    void *data);
+void nxt_router_upstream_finalize(nxt_task_t *task, nxt_router_upstream_t *u,
+    int code, const char *msg);
+
+nxt_router_fastcgi_conf_t *nxt_router_fastcgi_conf_create(nxt_task_t *task,
+    nxt_mp_t *mp, nxt_conf_value_t *value);
+void nxt_router_fastcgi_handler(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap);
+
+nxt_router_cache_conf_t *nxt_router_cache_conf_create(nxt_task_t *task,
+    nxt_mp_t *mp, nxt_conf_value_t *value);
+nxt_int_t nxt_router_cache_handler(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap);
+void nxt_router_cache_output(nxt_task_t *task, nxt_conn_t *c, nxt_buf_t *b);
+
+void nxt_router_http_request_pass(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap);
+void nxt_router_conn_output(nxt_task_t *task, nxt_conn_t *c, nxt_buf_t *b);
+void nxt_router_gen_error(nxt_task_t *task, nxt_conn_t *c, int code,
+    const char* fmt, ...);
+
 #endif  /* _NXT_ROUTER_H_INCLUDED_ */
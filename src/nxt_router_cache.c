@@ -0,0 +1,870 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_router.h>
+
+
+/*
+ * The listener response cache stores complete responses to GET and HEAD
+ * requests without body and "Authorization" header.  The key consists of
+ * the method, the "Host" header, the request target, and the "key_headers"
+ * values.  A response is cached if its status is cacheable and it has no
+ * "Set-Cookie" header.  The "Cache-Control" s-maxage or max-age
+ * directives set the response validity, and the listener "valid" value is
+ * used otherwise.  The "no-store", "no-cache", and "private" directives,
+ * "Vary: *", and "Vary" headers not included in the key disable caching.
+ *
+ * Concurrent misses are coalesced by nxt_cache: only the first request
+ * is passed to the application, the others wait for its response up to
+ * "lock_timeout".  The responses are stored in the cache shared memory
+ * zone and are sent to clients directly from there.  The "Date" and "Age"
+ * header fields are not stored, they are inserted after the status line
+ * on each hit.
+ */
+
+
+/* Seconds an uncacheable response is passed without waiting. */
+#define NXT_ROUTER_CACHE_PASS  5
+
+
+typedef struct {
+    nxt_cache_query_t         query;
+
+    nxt_conn_t                *conn;
+    nxt_app_parse_ctx_t       *ap;
+    nxt_router_cache_conf_t   *conf;
+
+    u_char                    *start;
+    size_t                    size;
+    size_t                    capacity;
+
+    uint8_t                   head;      /* 1 bit */
+    uint8_t                   done;      /* 1 bit */
+    uint8_t                   skip;      /* 1 bit */
+} nxt_router_cache_request_t;
+
+
+static void nxt_router_cache_conf_free(nxt_task_t *task, void *obj,
+    void *data);
+static nxt_str_t *nxt_router_cache_field(nxt_app_request_header_t *h,
+    nxt_str_t *name);
+static void nxt_router_cache_pass(nxt_task_t *task, void *obj, void *data);
+static void nxt_router_cache_ready(nxt_task_t *task, void *obj, void *data);
+static void nxt_router_cache_update(nxt_task_t *task, void *obj, void *data);
+static void nxt_router_cache_node_release(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_cache_request_cleanup(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_cache_capture(nxt_router_cache_request_t *rq,
+    nxt_buf_t *b);
+static void nxt_router_cache_store(nxt_task_t *task,
+    nxt_router_cache_request_t *rq);
+static size_t nxt_router_cache_strip(u_char *start, size_t size);
+static nxt_time_t nxt_router_cache_valid(nxt_router_cache_request_t *rq,
+    u_char *p, u_char *end);
+static nxt_int_t nxt_router_cache_control(u_char *p, u_char *end,
+    nxt_int_t *max_age, nxt_int_t *s_maxage);
+static nxt_int_t nxt_router_cache_vary(nxt_router_cache_conf_t *conf,
+    u_char *p, u_char *end);
+
+
+static nxt_conf_map_t  nxt_router_cache_conf[] = {
+    {
+        nxt_string("size"),
+        NXT_CONF_MAP_SIZE,
+        offsetof(nxt_router_cache_conf_t, size),
+    },
+
+    {
+        nxt_string("max_response_size"),
+        NXT_CONF_MAP_SIZE,
+        offsetof(nxt_router_cache_conf_t, max_response_size),
+    },
+
+    {
+        nxt_string("valid"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_cache_conf_t, valid),
+    },
+
+    {
+        nxt_string("lock_timeout"),
+        NXT_CONF_MAP_MSEC,
+        offsetof(nxt_router_cache_conf_t, lock_timeout),
+    },
+};
+
+
+static const nxt_cache_query_state_t  nxt_router_cache_query_state = {
+    .nocache_handler = nxt_router_cache_pass,
+    .ready_handler = nxt_router_cache_ready,
+    .update_handler = nxt_router_cache_update,
+    .timeout_handler = nxt_router_cache_pass,
+    .error_handler = nxt_router_cache_pass,
+};
+
+
+#define nxt_router_cache_name_is(p, len, s)                                   \
+    ((len) == sizeof(s) - 1                                                   \
+     && nxt_memcasecmp(p, (u_char *) s, sizeof(s) - 1) == 0)
+
+
+nxt_router_cache_conf_t *
+nxt_router_cache_conf_create(nxt_task_t *task, nxt_mp_t *mp,
+    nxt_conf_value_t *value)
+{
+    uint32_t                 i;
+    nxt_int_t                ret;
+    nxt_conf_value_t         *headers, *header;
+    nxt_router_cache_conf_t  *conf;
+
+    static nxt_str_t  key_headers_str = nxt_string("key_headers");
+
+    conf = nxt_mp_zget(mp, sizeof(nxt_router_cache_conf_t));
+    if (nxt_slow_path(conf == NULL)) {
+        return NULL;
+    }
+
+    conf->size = 16 * 1024 * 1024;
+    conf->max_response_size = 1024 * 1024;
+    conf->valid = 0;
+    conf->lock_timeout = 5000;
+
+    ret = nxt_conf_map_object(mp, value, nxt_router_cache_conf,
+                              nxt_nitems(nxt_router_cache_conf), conf);
+    if (ret != NXT_OK) {
+        nxt_log(task, NXT_LOG_CRIT, "cache map error");
+        return NULL;
+    }
+
+    headers = nxt_conf_get_object_member(value, &key_headers_str, NULL);
+
+    if (headers != NULL) {
+        for (i = 0; nxt_conf_get_array_element(headers, i) != NULL; i++) {
+            /* void */
+        }
+
+        conf->nheaders = i;
+
+        conf->headers = nxt_mp_get(mp, i * sizeof(nxt_str_t));
+        if (nxt_slow_path(conf->headers == NULL)) {
+            return NULL;
+        }
+
+        for (i = 0; i < conf->nheaders; i++) {
+            header = nxt_conf_get_array_element(headers, i);
+
+            nxt_conf_get_string(header, &conf->headers[i]);
+        }
+    }
+
+    conf->cache = nxt_cache_create(conf->size);
+    if (nxt_slow_path(conf->cache == NULL)) {
+        nxt_log(task, NXT_LOG_CRIT, "cache zone of %uz bytes creation failed",
+                conf->size);
+        return NULL;
+    }
+
+    ret = nxt_mp_cleanup(mp, nxt_router_cache_conf_free,
+                         &task->thread->engine->task, conf, NULL);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        nxt_cache_destroy(conf->cache);
+        return NULL;
+    }
+
+    return conf;
+}
+
+
+static void
+nxt_router_cache_conf_free(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_router_cache_conf_t  *conf;
+
+    conf = obj;
+
+    nxt_debug(task, "router cache free");
+
+    nxt_cache_destroy(conf->cache);
+}
+
+
+/*
+ * nxt_router_cache_handler() returns NXT_DECLINED if the request cannot
+ * be cached and should be passed as usual, or NXT_OK if the request has
+ * been taken by the cache.
+ */
+
+nxt_int_t
+nxt_router_cache_handler(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap)
+{
+    u_char                      *p;
+    size_t                      size;
+    nxt_str_t                   *value;
+    nxt_uint_t                  i;
+    nxt_router_cache_conf_t     *conf;
+    nxt_socket_conf_joint_t     *joint;
+    nxt_app_request_header_t    *h;
+    nxt_router_cache_request_t  *rq;
+
+    static nxt_str_t  authorization_str = nxt_string("Authorization");
+
+    h = &ap->r.header;
+
+    if (!nxt_str_eq(&h->method, "GET", 3)
+        && !nxt_str_eq(&h->method, "HEAD", 4))
+    {
+        return NXT_DECLINED;
+    }
+
+    if (h->parsed_content_length > 0
+        || h->chunked
+        || nxt_router_cache_field(h, &authorization_str) != NULL)
+    {
+        return NXT_DECLINED;
+    }
+
+    joint = c->listen->socket.data;
+    conf = joint->socket_conf->cache;
+
+    size = h->method.length + 1 + h->host.length + 1 + h->target.length;
+
+    for (i = 0; i < conf->nheaders; i++) {
+        value = nxt_router_cache_field(h, &conf->headers[i]);
+
+        size += 1 + ((value != NULL) ? value->length : 0);
+    }
+
+    if (size > 0xffff) {
+        return NXT_DECLINED;
+    }
+
+    rq = nxt_mp_zget(c->mem_pool, sizeof(nxt_router_cache_request_t) + size);
+    if (nxt_slow_path(rq == NULL)) {
+        return NXT_ERROR;
+    }
+
+    p = (u_char *) rq + sizeof(nxt_router_cache_request_t);
+
+    rq->query.key_data = p;
+    rq->query.key_len = size;
+
+    p = nxt_cpymem(p, h->method.start, h->method.length);
+    *p++ = ' ';
+    p = nxt_cpymem(p, h->host.start, h->host.length);
+    *p++ = ' ';
+    p = nxt_cpymem(p, h->target.start, h->target.length);
+
+    for (i = 0; i < conf->nheaders; i++) {
+        value = nxt_router_cache_field(h, &conf->headers[i]);
+
+        *p++ = '\n';
+
+        if (value != NULL) {
+            p = nxt_cpymem(p, value->start, value->length);
+        }
+    }
+
+    rq->query.state = &nxt_router_cache_query_state;
+    rq->query.data = rq;
+    rq->query.timeout = conf->lock_timeout;
+
+    rq->conn = c;
+    rq->ap = ap;
+    rq->conf = conf;
+    rq->head = (h->method.length == 4);
+
+    /* The header read timer is not reset after the header has been parsed. */
+    nxt_timer_disable(task->thread->engine, &c->read_timer);
+
+    nxt_debug(task, "router cache query \"%*s\"",
+              (size_t) rq->query.key_len, rq->query.key_data);
+
+    nxt_cache_query(task, conf->cache, &rq->query);
+
+    return NXT_OK;
+}
+
+
+static nxt_str_t *
+nxt_router_cache_field(nxt_app_request_header_t *h, nxt_str_t *name)
+{
+    nxt_http_field_t  *field;
+
+    nxt_list_each(field, h->fields) {
+
+        if (field->name.length == name->length
+            && nxt_memcasecmp(field->name.start, name->start, name->length)
+               == 0)
+        {
+            return &field->value;
+        }
+
+    } nxt_list_loop;
+
+    return NULL;
+}
+
+
+static void
+nxt_router_cache_pass(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_router_cache_request_t  *rq;
+
+    rq = data;
+
+    nxt_debug(task, "router cache pass");
+
+    rq->done = 1;
+
+    nxt_router_http_request_pass(task, rq->conn, rq->ap);
+}
+
+
+static void
+nxt_router_cache_ready(nxt_task_t *task, void *obj, void *data)
+{
+    u_char                      *eol;
+    nxt_mp_t                    *mp;
+    nxt_buf_t                   *status, *fields, *b, *last;
+    nxt_int_t                   ret;
+    nxt_conn_t                  *c;
+    nxt_time_t                  age;
+    nxt_cache_node_t            *node;
+    nxt_router_cache_request_t  *rq;
+
+    rq = data;
+    c = rq->conn;
+    mp = c->mem_pool;
+    node = rq->query.node;
+
+    nxt_debug(task, "router cache hit: %uz", node->size);
+
+    rq->done = 1;
+
+    ret = nxt_mp_cleanup(mp, nxt_router_cache_node_release,
+                         &task->thread->engine->task, node, rq->conf->cache);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        nxt_cache_release(rq->conf->cache, node);
+        goto fail;
+    }
+
+    /* The status line has been checked by nxt_router_cache_valid(). */
+    eol = nxt_memchr(node->data, '\n', node->size) + 1;
+
+    status = nxt_buf_mem_alloc(mp, 0, 0);
+    if (nxt_slow_path(status == NULL)) {
+        goto fail;
+    }
+
+    fields = nxt_buf_mem_alloc(mp, NXT_HTTP_DATE_FIELD_LEN
+                                   + sizeof("Age: \r\n") - 1
+                                   + NXT_TIME_T_LEN, 0);
+    if (nxt_slow_path(fields == NULL)) {
+        goto fail;
+    }
+
+    b = nxt_buf_mem_alloc(mp, 0, 0);
+    if (nxt_slow_path(b == NULL)) {
+        goto fail;
+    }
+
+    last = nxt_buf_sync_alloc(mp, NXT_BUF_SYNC_LAST);
+    if (nxt_slow_path(last == NULL)) {
+        goto fail;
+    }
+
+    status->mem.start = node->data;
+    status->mem.pos = node->data;
+    status->mem.free = eol;
+    status->mem.end = eol;
+
+    age = nxt_thread_time(task->thread) - node->updated;
+
+    fields->mem.free = nxt_http_fields_add(task, fields->mem.free,
+                                           NXT_HTTP_FIELD_DATE);
+    fields->mem.free = nxt_sprintf(fields->mem.free, fields->mem.end,
+                                   "Age: %T\r\n", nxt_max(age, 0));
+
+    b->mem.start = eol;
+    b->mem.pos = eol;
+    b->mem.free = node->data + node->size;
+    b->mem.end = b->mem.free;
+
+    status->next = fields;
+    fields->next = b;
+    b->next = last;
+
+    nxt_mp_free(mp, rq->ap);
+    c->socket.data = NULL;
+
+    nxt_router_conn_output(task, c, status);
+
+    return;
+
+fail:
+
+    nxt_router_gen_error(task, c, 500, "Failed to send cached response");
+}
+
+
+static void
+nxt_router_cache_update(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_int_t                   ret;
+    nxt_conn_t                  *c;
+    nxt_req_conn_link_t         *rc;
+    nxt_router_cache_request_t  *rq;
+
+    rq = data;
+    c = rq->conn;
+
+    nxt_debug(task, "router cache miss");
+
+    ret = nxt_mp_cleanup(c->mem_pool, nxt_router_cache_request_cleanup,
+                         &task->thread->engine->task, rq, NULL);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        rq->done = 1;
+        nxt_cache_cancel(task, &rq->query);
+    }
+
+    nxt_router_http_request_pass(task, c, rq->ap);
+
+    if (rq->done) {
+        return;
+    }
+
+    /*
+     * The response is captured by nxt_router_conn_output() via the request
+     * link created by the application, proxy, or FastCGI handler.  If the
+     * request has failed synchronously, the update is cancelled.
+     */
+
+    if (c->write == NULL && !nxt_queue_is_empty(&c->requests)) {
+        rc = nxt_queue_link_data(nxt_queue_last(&c->requests),
+                                 nxt_req_conn_link_t, link);
+        rc->cache = rq;
+        return;
+    }
+
+    rq->done = 1;
+    nxt_cache_cancel(task, &rq->query);
+}
+
+
+static void
+nxt_router_cache_node_release(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_cache_release(data, obj);
+}
+
+
+static void
+nxt_router_cache_request_cleanup(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_router_cache_request_t  *rq;
+
+    rq = obj;
+
+    if (!rq->done) {
+        rq->done = 1;
+        nxt_cache_cancel(task, &rq->query);
+    }
+}
+
+
+void
+nxt_router_cache_output(nxt_task_t *task, nxt_conn_t *c, nxt_buf_t *b)
+{
+    nxt_queue_link_t            *link;
+    nxt_req_conn_link_t         *rc;
+    nxt_router_cache_request_t  *rq;
+
+    for (link = nxt_queue_first(&c->requests);
+         link != nxt_queue_tail(&c->requests);
+         link = nxt_queue_next(link))
+    {
+        rc = nxt_queue_link_data(link, nxt_req_conn_link_t, link);
+        rq = rc->cache;
+
+        if (rq == NULL || rq->done) {
+            continue;
+        }
+
+        nxt_router_cache_capture(rq, b);
+
+        for ( /* void */ ; b != NULL; b = b->next) {
+            if (nxt_buf_is_last(b)) {
+                nxt_router_cache_store(task, rq);
+                break;
+            }
+        }
+
+        return;
+    }
+}
+
+
+static void
+nxt_router_cache_capture(nxt_router_cache_request_t *rq, nxt_buf_t *b)
+{
+    u_char    *p;
+    size_t    size, capacity;
+    nxt_mp_t  *mp;
+
+    mp = rq->conn->mem_pool;
+
+    for ( /* void */ ; b != NULL && !rq->skip; b = b->next) {
+
+        if (nxt_buf_is_sync(b)) {
+            continue;
+        }
+
+        if (!nxt_buf_is_mem(b) || nxt_buf_is_file(b)) {
+            rq->skip = 1;
+            break;
+        }
+
+        size = nxt_buf_mem_used_size(&b->mem);
+
+        if (rq->size + size > rq->conf->max_response_size) {
+            rq->skip = 1;
+            break;
+        }
+
+        if (rq->size + size > rq->capacity) {
+            capacity = nxt_max(rq->capacity * 2, rq->size + size);
+            capacity = nxt_max(capacity, 4096);
+            capacity = nxt_min(capacity, rq->conf->max_response_size);
+
+            p = nxt_mp_alloc(mp, capacity);
+            if (nxt_slow_path(p == NULL)) {
+                rq->skip = 1;
+                break;
+            }
+
+            if (rq->start != NULL) {
+                nxt_memcpy(p, rq->start, rq->size);
+                nxt_mp_free(mp, rq->start);
+            }
+
+            rq->start = p;
+            rq->capacity = capacity;
+        }
+
+        nxt_memcpy(rq->start + rq->size, b->mem.pos, size);
+        rq->size += size;
+    }
+
+    if (rq->skip && rq->start != NULL) {
+        nxt_mp_free(mp, rq->start);
+        rq->start = NULL;
+    }
+}
+
+
+static void
+nxt_router_cache_store(nxt_task_t *task, nxt_router_cache_request_t *rq)
+{
+    nxt_int_t   ret;
+    nxt_time_t  valid;
+
+    rq->done = 1;
+
+    valid = 0;
+
+    if (!rq->skip) {
+        valid = nxt_router_cache_valid(rq, rq->start,
+                                       rq->start + rq->size);
+    }
+
+    if (valid > 0) {
+        rq->size = nxt_router_cache_strip(rq->start, rq->size);
+
+        ret = nxt_cache_update(task, &rq->query, rq->start, rq->size, valid);
+
+        if (nxt_slow_path(ret != NXT_OK)) {
+            nxt_log(task, NXT_LOG_WARN, "router cache zone is full, "
+                    "response of %uz bytes is not cached", rq->size);
+        }
+
+    } else {
+        nxt_debug(task, "router cache response is not cacheable");
+
+        (void) nxt_cache_update(task, &rq->query, NULL, 0,
+                                NXT_ROUTER_CACHE_PASS);
+    }
+
+    if (rq->start != NULL) {
+        nxt_mp_free(rq->conn->mem_pool, rq->start);
+        rq->start = NULL;
+    }
+}
+
+
+/*
+ * nxt_router_cache_strip() removes the "Date" and "Age" fields from
+ * a complete response header in place and returns the new response size.
+ */
+
+static size_t
+nxt_router_cache_strip(u_char *start, size_t size)
+{
+    u_char  *p, *end, *eol, *last, *colon;
+    size_t  length;
+
+    end = start + size;
+
+    p = nxt_memchr(start, '\n', size) + 1;
+
+    for ( ;; ) {
+        eol = nxt_memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            break;
+        }
+
+        last = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+
+        if (last == p) {
+            /* The end of the header. */
+            break;
+        }
+
+        colon = nxt_memchr(p, ':', last - p);
+        length = (colon != NULL) ? (size_t) (colon - p) : 0;
+
+        if (nxt_router_cache_name_is(p, length, "Date")
+            || nxt_router_cache_name_is(p, length, "Age"))
+        {
+            eol++;
+            nxt_memmove(p, eol, end - eol);
+            end -= eol - p;
+            continue;
+        }
+
+        p = eol + 1;
+    }
+
+    return end - start;
+}
+
+
+/*
+ * nxt_router_cache_valid() returns the response validity in seconds,
+ * or 0 if the response cannot be cached.
+ */
+
+static nxt_time_t
+nxt_router_cache_valid(nxt_router_cache_request_t *rq, u_char *p, u_char *end)
+{
+    u_char     *eol, *last, *colon, *value;
+    size_t     length;
+    nxt_off_t  content_length;
+    nxt_int_t  status, max_age, s_maxage;
+
+    if (end - p < 12
+        || nxt_memcmp(p, "HTTP/1.", 7) != 0
+        || p[8] != ' ')
+    {
+        return 0;
+    }
+
+    status = nxt_int_parse(p + 9, 3);
+
+    switch (status) {
+    case 200:
+    case 203:
+    case 300:
+    case 301:
+    case 404:
+    case 410:
+        break;
+    default:
+        return 0;
+    }
+
+    max_age = -1;
+    s_maxage = -1;
+    content_length = -1;
+
+    eol = nxt_memchr(p, '\n', end - p);
+
+    for ( ;; ) {
+        if (eol == NULL) {
+            /* The response header is incomplete. */
+            return 0;
+        }
+
+        p = eol + 1;
+
+        eol = nxt_memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            return 0;
+        }
+
+        last = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+
+        if (last == p) {
+            /* The end of the header. */
+            break;
+        }
+
+        colon = nxt_memchr(p, ':', last - p);
+        if (colon == NULL) {
+            continue;
+        }
+
+        length = colon - p;
+
+        for (value = colon + 1; value < last && *value == ' '; value++) {
+            /* void */
+        }
+
+        if (nxt_router_cache_name_is(p, length, "Set-Cookie")) {
+            return 0;
+        }
+
+        if (nxt_router_cache_name_is(p, length, "Cache-Control")) {
+            if (nxt_router_cache_control(value, last, &max_age, &s_maxage)
+                != NXT_OK)
+            {
+                return 0;
+            }
+
+        } else if (nxt_router_cache_name_is(p, length, "Vary")) {
+            if (nxt_router_cache_vary(rq->conf, value, last) != NXT_OK) {
+                return 0;
+            }
+
+        } else if (nxt_router_cache_name_is(p, length, "Content-Length")) {
+            content_length = nxt_off_t_parse(value, last - value);
+
+            if (content_length < 0) {
+                return 0;
+            }
+        }
+    }
+
+    /* A response truncated by an upstream error must not be cached. */
+
+    if (!rq->head
+        && content_length >= 0
+        && content_length != end - (eol + 1))
+    {
+        return 0;
+    }
+
+    if (s_maxage >= 0) {
+        return s_maxage;
+    }
+
+    if (max_age >= 0) {
+        return max_age;
+    }
+
+    return rq->conf->valid;
+}
+
+
+static nxt_int_t
+nxt_router_cache_control(u_char *p, u_char *end, nxt_int_t *max_age,
+    nxt_int_t *s_maxage)
+{
+    u_char     *token, *eq, *next;
+    size_t     length;
+    nxt_int_t  n;
+
+    while (p < end) {
+
+        while (p < end && (*p == ' ' || *p == ',')) {
+            p++;
+        }
+
+        token = p;
+
+        next = nxt_memchr(p, ',', end - p);
+        if (next == NULL) {
+            next = end;
+        }
+
+        for (p = next; p > token && p[-1] == ' '; p--) {
+            /* void */
+        }
+
+        eq = nxt_memchr(token, '=', p - token);
+        length = ((eq != NULL) ? eq : p) - token;
+
+        if (nxt_router_cache_name_is(token, length, "no-store")
+            || nxt_router_cache_name_is(token, length, "no-cache")
+            || nxt_router_cache_name_is(token, length, "private"))
+        {
+            return NXT_DECLINED;
+        }
+
+        if (eq != NULL) {
+            n = nxt_int_parse(eq + 1, p - (eq + 1));
+
+            if (nxt_router_cache_name_is(token, length, "max-age")) {
+                *max_age = (n >= 0) ? n : 0;
+
+            } else if (nxt_router_cache_name_is(token, length, "s-maxage")) {
+                *s_maxage = (n >= 0) ? n : 0;
+            }
+        }
+
+        p = next;
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_router_cache_vary(nxt_router_cache_conf_t *conf, u_char *p, u_char *end)
+{
+    u_char      *token, *next;
+    nxt_uint_t  i;
+
+    while (p < end) {
+
+        while (p < end && (*p == ' ' || *p == ',')) {
+            p++;
+        }
+
+        if (p == end) {
+            break;
+        }
+
+        token = p;
+
+        next = nxt_memchr(p, ',', end - p);
+        if (next == NULL) {
+            next = end;
+        }
+
+        for (p = next; p > token && p[-1] == ' '; p--) {
+            /* void */
+        }
+
+        for (i = 0; i < conf->nheaders; i++) {
+            if ((size_t) (p - token) == conf->headers[i].length
+                && nxt_memcasecmp(token, conf->headers[i].start,
+                                  conf->headers[i].length) == 0)
+            {
+                break;
+            }
+        }
+
+        if (i == conf->nheaders) {
+            /* Including "Vary: *". */
+            return NXT_DECLINED;
+        }
+
+        p = next;
+    }
+
+    return NXT_OK;
+}
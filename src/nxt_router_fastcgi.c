@@ -0,0 +1,908 @@
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_router.h>
+
+
+/*
+ * An application with the "fastcgi" type is served by the router itself:
+ * requests are passed to FastCGI servers over the keep-alive connections
+ * of the proxy module, which also handles connection, retries, timeouts
+ * and suspended reading, so this module only encodes the request and
+ * decodes the response.  Common FastCGI servers do not multiplex
+ * connections, so a connection carries one request at a time with the
+ * request ID 1.  The response records are parsed by
+ * nxt_fastcgi_record_parse() which returns the stdout data as buffers
+ * pointing into the read buffer, so the response body is passed to the
+ * client without copying.  A read buffer is freed when all its parts
+ * have been sent.
+ */
+
+#define NXT_ROUTER_FASTCGI_RECORD_SIZE    65535
+
+#define NXT_ROUTER_FASTCGI_RESPONDER      1
+#define NXT_ROUTER_FASTCGI_KEEP_CONN      1
+
+
+typedef struct {
+    nxt_router_upstream_t      upstream;
+
+    nxt_router_fastcgi_conf_t  *conf;
+    nxt_fastcgi_parse_t        parse;
+} nxt_router_fastcgi_t;
+
+
+/* The FCGI_PARAMS stream writer. */
+
+typedef struct {
+    u_char                     *pos;
+    size_t                     record;
+    size_t                     rest;
+} nxt_router_fastcgi_params_t;
+
+
+#define nxt_router_fastcgi_field_is(name, s)                                  \
+    ((name)->length == sizeof(s) - 1                                          \
+     && nxt_memcasecmp((name)->start, (u_char *) s, sizeof(s) - 1) == 0)
+
+
+static nxt_int_t nxt_router_fastcgi_request_create(nxt_task_t *task,
+    nxt_router_fastcgi_t *p, nxt_sockaddr_t *local);
+static nxt_bool_t nxt_router_fastcgi_skip_field(nxt_str_t *name);
+static size_t nxt_router_fastcgi_param_size(size_t name, size_t value);
+static void nxt_router_fastcgi_param(nxt_router_fastcgi_params_t *pw,
+    nxt_str_t *name, nxt_str_t *value, nxt_bool_t http);
+static void nxt_router_fastcgi_params_copy(nxt_router_fastcgi_params_t *pw,
+    u_char *src, size_t size, nxt_bool_t http);
+static u_char *nxt_router_fastcgi_length(u_char *p, size_t length);
+static u_char *nxt_router_fastcgi_record(u_char *p, nxt_uint_t type,
+    size_t length);
+static void nxt_router_fastcgi_response_read(nxt_task_t *task,
+    nxt_router_upstream_t *u);
+static nxt_buf_t *nxt_router_fastcgi_last_buf(nxt_fastcgi_parse_t *fp);
+static void nxt_router_fastcgi_stderr(nxt_task_t *task, nxt_buf_t *b);
+static nxt_int_t nxt_router_fastcgi_stdout(nxt_task_t *task,
+    nxt_router_upstream_t *u, nxt_buf_t *b);
+static nxt_int_t nxt_router_fastcgi_header(nxt_task_t *task,
+    nxt_router_upstream_t *u, nxt_buf_t *in, nxt_buf_t **out);
+static nxt_int_t nxt_router_fastcgi_header_process(nxt_task_t *task,
+    nxt_router_upstream_t *u, nxt_buf_t **out);
+
+
+static nxt_conf_map_t  nxt_router_fastcgi_conf[] = {
+    {
+        nxt_string("root"),
+        NXT_CONF_MAP_STR_COPY,
+        offsetof(nxt_router_fastcgi_conf_t, root),
+    },
+
+    {
+        nxt_string("script"),
+        NXT_CONF_MAP_STR_COPY,
+        offsetof(nxt_router_fastcgi_conf_t, script),
+    },
+
+    {
+        nxt_string("index"),
+        NXT_CONF_MAP_STR_COPY,
+        offsetof(nxt_router_fastcgi_conf_t, index),
+    },
+};
+
+
+/*
+ * A request sent completely is repeated regardless of its method,
+ * since no request is repeated once the server has sent something.
+ */
+
+static const nxt_router_upstream_proto_t  nxt_router_fastcgi_proto = {
+    .read = nxt_router_fastcgi_response_read,
+    .resend = 1,
+};
+
+
+/* The order is the same as in nxt_router_fastcgi_request_create(). */
+
+static nxt_str_t  nxt_router_fastcgi_params[] = {
+    nxt_string("GATEWAY_INTERFACE"),
+    nxt_string("SERVER_SOFTWARE"),
+    nxt_string("SERVER_PROTOCOL"),
+    nxt_string("SERVER_NAME"),
+    nxt_string("SERVER_ADDR"),
+    nxt_string("SERVER_PORT"),
+    nxt_string("REMOTE_ADDR"),
+    nxt_string("REQUEST_METHOD"),
+    nxt_string("REQUEST_URI"),
+    nxt_string("QUERY_STRING"),
+    nxt_string("DOCUMENT_ROOT"),
+    nxt_string("SCRIPT_NAME"),
+    nxt_string("SCRIPT_FILENAME"),
+    nxt_string("CONTENT_TYPE"),
+    nxt_string("CONTENT_LENGTH"),
+    nxt_string("REDIRECT_STATUS"),
+};
+
+
+nxt_router_fastcgi_conf_t *
+nxt_router_fastcgi_conf_create(nxt_task_t *task, nxt_mp_t *mp,
+    nxt_conf_value_t *value)
+{
+    nxt_int_t                  ret;
+    nxt_router_fastcgi_conf_t  *conf;
+
+    static nxt_str_t  index_str = nxt_string("index.php");
+
+    conf = nxt_mp_zget(mp, sizeof(nxt_router_fastcgi_conf_t));
+    if (nxt_slow_path(conf == NULL)) {
+        return NULL;
+    }
+
+    ret = nxt_conf_map_object(mp, value, nxt_router_fastcgi_conf,
+                              nxt_nitems(nxt_router_fastcgi_conf), conf);
+    if (ret != NXT_OK) {
+        nxt_log(task, NXT_LOG_CRIT, "fastcgi application map error");
+        return NULL;
+    }
+
+    /* The script name starts with a slash. */
+
+    if (conf->root.length != 0
+        && conf->root.start[conf->root.length - 1] == '/')
+    {
+        conf->root.length--;
+    }
+
+    if (conf->index.length == 0) {
+        conf->index = index_str;
+    }
+
+    conf->upstream = nxt_router_proxy_conf_create(task, mp, value);
+    if (conf->upstream == NULL) {
+        return NULL;
+    }
+
+    return conf;
+}
+
+
+void
+nxt_router_fastcgi_handler(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap)
+{
+    nxt_router_fastcgi_t     *p;
+    nxt_router_upstream_t    *u;
+    nxt_socket_conf_joint_t  *joint;
+
+    joint = c->listen->socket.data;
+
+    u = nxt_router_upstream_create(task, c, ap, sizeof(nxt_router_fastcgi_t),
+                                   &joint->fastcgi, &nxt_router_fastcgi_proto);
+    if (nxt_slow_path(u == NULL)) {
+        return;
+    }
+
+    p = nxt_container_of(u, nxt_router_fastcgi_t, upstream);
+
+    p->conf = joint->socket_conf->fastcgi;
+    p->parse.last_buf = nxt_router_fastcgi_last_buf;
+    p->parse.mem_pool = u->mem_pool;
+
+    /* A connection is kept alive if the response has been completed. */
+    u->keepalive = 1;
+
+    if (nxt_slow_path(nxt_router_fastcgi_request_create(task, p,
+                                                   joint->socket_conf->sockaddr)
+                      != NXT_OK))
+    {
+        nxt_router_upstream_finalize(task, u, 500, "Failed to create "
+                                     "FastCGI request");
+        return;
+    }
+
+    nxt_router_upstream_connect(task, u);
+}
+
+
+/*
+ * The request consists of FCGI_BEGIN_REQUEST, the FCGI_PARAMS stream and
+ * the FCGI_STDIN stream.  The parameters are written to a single buffer
+ * split into records, and the body is sent as records with the data
+ * pointing to the request body buffers.
+ */
+
+static nxt_int_t
+nxt_router_fastcgi_request_create(nxt_task_t *task, nxt_router_fastcgi_t *p,
+    nxt_sockaddr_t *local)
+{
+    u_char                       *s, ch;
+    size_t                       size, n;
+    uint32_t                     port;
+    nxt_buf_t                    *b, *in, *d, *last;
+    nxt_off_t                    length, rest;
+    nxt_str_t                    *v, script_name, value;
+    nxt_str_t                    values[nxt_nitems(nxt_router_fastcgi_params)];
+    nxt_uint_t                   i;
+    nxt_http_field_t             *field;
+    nxt_app_request_t            *r;
+    nxt_router_fastcgi_conf_t    *conf;
+    nxt_app_request_header_t     *h;
+    nxt_router_upstream_t        *u;
+    nxt_router_fastcgi_params_t  pw;
+    u_char                       port_buf[NXT_INT32_T_LEN];
+    u_char                       length_buf[NXT_OFF_T_LEN];
+
+    static nxt_str_t  gateway_interface = nxt_string("CGI/1.1");
+    static nxt_str_t  server_software = nxt_string("Unit/" NXT_VERSION);
+    static nxt_str_t  redirect_status = nxt_string("200");
+
+    u = &p->upstream;
+    r = &u->ap->r;
+    h = &r->header;
+    conf = p->conf;
+
+    if (conf->script.length != 0) {
+        script_name.length = 1 + conf->script.length;
+
+    } else {
+        script_name.length = h->path.length;
+
+        if (h->path.length == 0 || h->path.start[h->path.length - 1] == '/') {
+            script_name.length += conf->index.length;
+        }
+    }
+
+    /* SCRIPT_NAME is followed by SCRIPT_FILENAME in the same memory. */
+
+    script_name.start = nxt_mp_nget(u->mem_pool, 2 * script_name.length
+                                                 + conf->root.length);
+    if (nxt_slow_path(script_name.start == NULL)) {
+        return NXT_ERROR;
+    }
+
+    s = script_name.start;
+
+    if (conf->script.length != 0) {
+        *s++ = '/';
+        s = nxt_cpymem(s, conf->script.start, conf->script.length);
+
+    } else {
+        s = nxt_cpymem(s, h->path.start, h->path.length);
+
+        if (h->path.length == 0 || h->path.start[h->path.length - 1] == '/') {
+            s = nxt_cpymem(s, conf->index.start, conf->index.length);
+        }
+    }
+
+    s = nxt_cpymem(s, conf->root.start, conf->root.length);
+    nxt_memcpy(s, script_name.start, script_name.length);
+
+    v = values;
+
+    *v++ = gateway_interface;
+    *v++ = server_software;
+    *v++ = h->version;
+
+    /* The server name is the Host header field value without port. */
+
+    value = h->host;
+
+    for (n = value.length; n > 0; n--) {
+        ch = value.start[n - 1];
+
+        if (ch == ':') {
+            value.length = n - 1;
+            break;
+        }
+
+        if (ch < '0' || ch > '9') {
+            break;
+        }
+    }
+
+    *v++ = (value.length != 0) ? value : r->local;
+    *v++ = r->local;
+
+    port = nxt_sockaddr_port_number(local);
+
+    v->start = port_buf;
+    v->length = (port != 0) ? nxt_sprintf(port_buf, port_buf + NXT_INT32_T_LEN,
+                                          "%uD", port) - port_buf
+                            : 0;
+    v++;
+
+    *v++ = r->remote;
+    *v++ = h->method;
+    *v++ = h->target;
+    *v++ = h->query;
+    *v++ = conf->root;
+    *v++ = script_name;
+
+    v->start = script_name.start + script_name.length;
+    v->length = conf->root.length + script_name.length;
+    v++;
+
+    *v++ = h->content_type;
+
+    /*
+     * A chunked request body has been already decoded and its length
+     * is passed in parsed_content_length.
+     */
+    length = h->parsed_content_length;
+
+    v->start = length_buf;
+    v->length = 0;
+
+    if (length != 0 || h->content_length.length != 0 || h->chunked) {
+        v->length = nxt_sprintf(length_buf, length_buf + NXT_OFF_T_LEN,
+                                "%O", length) - length_buf;
+    }
+
+    v++;
+
+    *v = redirect_status;
+
+    size = 0;
+
+    for (i = 0; i < nxt_nitems(nxt_router_fastcgi_params); i++) {
+        size += nxt_router_fastcgi_param_size(
+                                           nxt_router_fastcgi_params[i].length,
+                                           values[i].length);
+    }
+
+    nxt_list_each(field, h->fields) {
+
+        if (nxt_router_fastcgi_skip_field(&field->name)) {
+            continue;
+        }
+
+        size += nxt_router_fastcgi_param_size(5 + field->name.length,
+                                              field->value.length);
+
+    } nxt_list_loop;
+
+    n = (size + NXT_ROUTER_FASTCGI_RECORD_SIZE - 1)
+        / NXT_ROUTER_FASTCGI_RECORD_SIZE;
+
+    /*
+     * FCGI_BEGIN_REQUEST, the parameter records, the empty FCGI_PARAMS
+     * record, and the empty FCGI_STDIN record if there is no body.
+     */
+    b = nxt_buf_mem_alloc(u->mem_pool, 16 + size + 8 * n + 8 + 8, 0);
+    if (nxt_slow_path(b == NULL)) {
+        return NXT_ERROR;
+    }
+
+    s = nxt_router_fastcgi_record(b->mem.free, NXT_FASTCGI_BEGIN_REQUEST, 8);
+
+    *s++ = 0;
+    *s++ = NXT_ROUTER_FASTCGI_RESPONDER;
+    *s++ = NXT_ROUTER_FASTCGI_KEEP_CONN;
+    nxt_memzero(s, 5);
+    s += 5;
+
+    pw.pos = s;
+    pw.record = 0;
+    pw.rest = size;
+
+    for (i = 0; i < nxt_nitems(nxt_router_fastcgi_params); i++) {
+        nxt_router_fastcgi_param(&pw, &nxt_router_fastcgi_params[i],
+                                 &values[i], 0);
+    }
+
+    nxt_list_each(field, h->fields) {
+
+        if (nxt_router_fastcgi_skip_field(&field->name)) {
+            continue;
+        }
+
+        nxt_router_fastcgi_param(&pw, &field->name, &field->value, 1);
+
+    } nxt_list_loop;
+
+    s = nxt_router_fastcgi_record(pw.pos, NXT_FASTCGI_PARAMS, 0);
+
+    if (length == 0) {
+        s = nxt_router_fastcgi_record(s, NXT_FASTCGI_STDIN, 0);
+    }
+
+    b->mem.free = s;
+
+    u->request = b;
+
+    rest = length;
+
+    for (in = r->body.buf; in != NULL && rest > 0; in = in->next) {
+        s = in->mem.pos;
+        size = nxt_min((nxt_off_t) nxt_buf_mem_used_size(&in->mem), rest);
+
+        rest -= size;
+
+        while (size != 0) {
+            n = nxt_min(size, NXT_ROUTER_FASTCGI_RECORD_SIZE);
+
+            d = nxt_buf_mem_alloc(u->mem_pool, 8, 0);
+            if (nxt_slow_path(d == NULL)) {
+                return NXT_ERROR;
+            }
+
+            d->mem.free = nxt_router_fastcgi_record(d->mem.free,
+                                                    NXT_FASTCGI_STDIN, n);
+            b->next = d;
+            b = d;
+
+            d = nxt_buf_mem_alloc(u->mem_pool, 0, 0);
+            if (nxt_slow_path(d == NULL)) {
+                return NXT_ERROR;
+            }
+
+            d->mem.start = s;
+            d->mem.pos = s;
+            d->mem.free = s + n;
+            d->mem.end = d->mem.free;
+
+            b->next = d;
+            b = d;
+
+            s += n;
+            size -= n;
+        }
+    }
+
+    if (length != 0) {
+        last = nxt_buf_mem_alloc(u->mem_pool, 8, 0);
+        if (nxt_slow_path(last == NULL)) {
+            return NXT_ERROR;
+        }
+
+        last->mem.free = nxt_router_fastcgi_record(last->mem.free,
+                                                   NXT_FASTCGI_STDIN, 0);
+        b->next = last;
+    }
+
+    nxt_debug(task, "fastcgi request params: %uz, body: %O",
+              nxt_buf_mem_used_size(&u->request->mem), length);
+
+    return NXT_OK;
+}
+
+
+/*
+ * Content-Type and Content-Length are passed as CGI variables, and
+ * the "Proxy" field is not passed to protect CGI scripts from setting
+ * HTTP_PROXY by clients.
+ */
+
+static nxt_bool_t
+nxt_router_fastcgi_skip_field(nxt_str_t *name)
+{
+    return nxt_router_fastcgi_field_is(name, "Content-Type")
+           || nxt_router_fastcgi_field_is(name, "Content-Length")
+           || nxt_router_fastcgi_field_is(name, "Proxy");
+}
+
+
+static size_t
+nxt_router_fastcgi_param_size(size_t name, size_t value)
+{
+    return ((name < 128) ? 1 : 4) + ((value < 128) ? 1 : 4) + name + value;
+}
+
+
+static void
+nxt_router_fastcgi_param(nxt_router_fastcgi_params_t *pw, nxt_str_t *name,
+    nxt_str_t *value, nxt_bool_t http)
+{
+    u_char  *s, lengths[8];
+
+    s = nxt_router_fastcgi_length(lengths, name->length + (http ? 5 : 0));
+    s = nxt_router_fastcgi_length(s, value->length);
+
+    nxt_router_fastcgi_params_copy(pw, lengths, s - lengths, 0);
+
+    if (http) {
+        nxt_router_fastcgi_params_copy(pw, (u_char *) "HTTP_", 5, 0);
+    }
+
+    nxt_router_fastcgi_params_copy(pw, name->start, name->length, http);
+    nxt_router_fastcgi_params_copy(pw, value->start, value->length, 0);
+}
+
+
+/*
+ * The parameters are copied record by record, and an HTTP header field
+ * name is converted to upper case with dashes replaced by underscores.
+ */
+
+static void
+nxt_router_fastcgi_params_copy(nxt_router_fastcgi_params_t *pw, u_char *src,
+    size_t size, nxt_bool_t http)
+{
+    u_char  ch, *dst, *end;
+    size_t  n;
+
+    while (size != 0) {
+
+        if (pw->record == 0) {
+            pw->record = nxt_min(pw->rest, NXT_ROUTER_FASTCGI_RECORD_SIZE);
+            pw->pos = nxt_router_fastcgi_record(pw->pos, NXT_FASTCGI_PARAMS,
+                                                pw->record);
+        }
+
+        n = nxt_min(size, pw->record);
+
+        pw->record -= n;
+        pw->rest -= n;
+        size -= n;
+
+        if (!http) {
+            pw->pos = nxt_cpymem(pw->pos, src, n);
+            src += n;
+            continue;
+        }
+
+        dst = pw->pos;
+        end = dst + n;
+
+        while (dst < end) {
+            ch = *src++;
+
+            if (ch >= 'a' && ch <= 'z') {
+                ch &= ~0x20;
+
+            } else if (ch == '-') {
+                ch = '_';
+            }
+
+            *dst++ = ch;
+        }
+
+        pw->pos = dst;
+    }
+}
+
+
+static u_char *
+nxt_router_fastcgi_length(u_char *p, size_t length)
+{
+    if (length < 128) {
+        *p++ = (u_char) length;
+        return p;
+    }
+
+    *p++ = (u_char) ((length >> 24) | 0x80);
+    *p++ = (u_char) (length >> 16);
+    *p++ = (u_char) (length >> 8);
+    *p++ = (u_char) length;
+
+    return p;
+}
+
+
+static u_char *
+nxt_router_fastcgi_record(u_char *p, nxt_uint_t type, size_t length)
+{
+    *p++ = 1;
+    *p++ = (u_char) type;
+    *p++ = 0;
+    *p++ = 1;
+    *p++ = (u_char) (length >> 8);
+    *p++ = (u_char) length;
+    *p++ = 0;
+    *p++ = 0;
+
+    return p;
+}
+
+
+/*
+ * The read buffer is retained while it is parsed, so the parser always
+ * creates stdout and stderr buffers pointing into the read buffer and
+ * the read buffer is freed when all of them have been completed.
+ */
+
+static void
+nxt_router_fastcgi_response_read(nxt_task_t *task, nxt_router_upstream_t *u)
+{
+    nxt_int_t             ret;
+    nxt_buf_t             *b;
+    nxt_router_fastcgi_t  *p;
+
+    p = nxt_container_of(u, nxt_router_fastcgi_t, upstream);
+
+    b = u->buffer;
+    u->buffer = NULL;
+
+    b->data = u;
+    b->completion_handler = nxt_router_upstream_buf_completion;
+
+    u->nbufs++;
+
+    b->retain = 1;
+
+    nxt_fastcgi_record_parse(task, &p->parse, b);
+
+    nxt_router_fastcgi_stderr(task, p->parse.out[1]);
+
+    ret = nxt_router_fastcgi_stdout(task, u, p->parse.out[0]);
+
+    b->retain--;
+
+    if (b->retain == 0) {
+        b->completion_handler(task, b, b->parent);
+    }
+
+    if (nxt_slow_path(ret != NXT_OK)) {
+        nxt_router_upstream_finalize(task, u, 502, "Invalid FastCGI response "
+                                     "header");
+        return;
+    }
+
+    if (nxt_slow_path(p->parse.error || p->parse.fastcgi_error)) {
+        nxt_router_upstream_finalize(task, u, 502, "Invalid FastCGI "
+                                     "response");
+        return;
+    }
+
+    if (p->parse.done) {
+
+        if (nxt_slow_path(!u->started)) {
+            nxt_router_upstream_finalize(task, u, 502, "FastCGI response "
+                                         "has no header");
+            return;
+        }
+
+        nxt_router_upstream_finalize(task, u, 0, NULL);
+        return;
+    }
+
+    nxt_router_upstream_read(task, u);
+}
+
+
+static nxt_buf_t *
+nxt_router_fastcgi_last_buf(nxt_fastcgi_parse_t *fp)
+{
+    return nxt_buf_sync_alloc(fp->mem_pool, 0);
+}
+
+
+static void
+nxt_router_fastcgi_stderr(nxt_task_t *task, nxt_buf_t *b)
+{
+    size_t     size;
+    nxt_buf_t  *next;
+
+    for ( /* void */ ; b != NULL; b = next) {
+        next = b->next;
+
+        size = nxt_buf_mem_used_size(&b->mem);
+
+        while (size != 0
+               && (b->mem.pos[size - 1] == '\n'
+                   || b->mem.pos[size - 1] == '\r'))
+        {
+            size--;
+        }
+
+        if (size != 0) {
+            nxt_log(task, NXT_LOG_ERR, "FastCGI stderr: \"%*s\"",
+                    size, b->mem.pos);
+        }
+
+        b->completion_handler(task, b, b->parent);
+    }
+}
+
+
+static nxt_int_t
+nxt_router_fastcgi_stdout(nxt_task_t *task, nxt_router_upstream_t *u,
+    nxt_buf_t *b)
+{
+    nxt_int_t  ret;
+    nxt_buf_t  *next, *out, **tail;
+
+    ret = NXT_OK;
+    out = NULL;
+    tail = &out;
+
+    for ( /* void */ ; b != NULL; b = next) {
+        next = b->next;
+        b->next = NULL;
+
+        if (nxt_buf_is_sync(b)) {
+            /* The last buffer is sent by nxt_router_upstream_finalize(). */
+            nxt_mp_free(u->mem_pool, b);
+            continue;
+        }
+
+        if (!u->started && ret == NXT_OK) {
+            ret = nxt_router_fastcgi_header(task, u, b, tail);
+
+            if (ret == NXT_OK) {
+                u->started = 1;
+                tail = &(*tail)->next;
+
+            } else if (ret == NXT_AGAIN) {
+                ret = NXT_OK;
+            }
+        }
+
+        if (!u->started || u->head || nxt_buf_mem_used_size(&b->mem) == 0) {
+            b->completion_handler(task, b, b->parent);
+            continue;
+        }
+
+        *tail = b;
+        tail = &b->next;
+    }
+
+    if (out != NULL) {
+        nxt_router_upstream_output(task, u, out);
+    }
+
+    return ret;
+}
+
+
+/*
+ * The CGI response header is collected in the header buffer, and only
+ * the header part of the stdout buffer is consumed.
+ */
+
+static nxt_int_t
+nxt_router_fastcgi_header(nxt_task_t *task, nxt_router_upstream_t *u,
+    nxt_buf_t *in, nxt_buf_t **out)
+{
+    size_t     size;
+    nxt_int_t  ret;
+    nxt_buf_t  *h;
+
+    h = u->header;
+
+    size = nxt_min((size_t) nxt_buf_mem_used_size(&in->mem),
+                   (size_t) (h->mem.end - h->mem.free));
+
+    h->mem.free = nxt_cpymem(h->mem.free, in->mem.pos, size);
+
+    ret = nxt_router_upstream_header_parse(u);
+
+    if (ret == NXT_AGAIN) {
+        in->mem.pos += size;
+
+        if (h->mem.free == h->mem.end) {
+            nxt_log(task, NXT_LOG_ERR, "too long FastCGI response header");
+            return NXT_ERROR;
+        }
+
+        return NXT_AGAIN;
+    }
+
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    in->mem.pos += size - (h->mem.free - u->scan);
+
+    return nxt_router_fastcgi_header_process(task, u, out);
+}
+
+
+/*
+ * The "Status" field sets the response status, and a response with
+ * the "Location" field and without the "Status" field is a redirect.
+ * The client connection is always closed after the response.
+ */
+
+static nxt_int_t
+nxt_router_fastcgi_header_process(nxt_task_t *task, nxt_router_upstream_t *u,
+    nxt_buf_t **out)
+{
+    u_char      *pos, *lf, *end, *s;
+    size_t      size;
+    nxt_int_t   ret;
+    nxt_str_t   name, value, status;
+    nxt_buf_t   *b;
+    nxt_bool_t  location;
+    nxt_uint_t  n, fields;
+
+    static nxt_str_t  ok_status = nxt_string("200 OK");
+    static nxt_str_t  found_status = nxt_string("302 Found");
+
+    pos = u->header->mem.start;
+    end = u->scan;
+
+    status.length = 0;
+    location = 0;
+    n = 0;
+    fields = NXT_HTTP_FIELDS;
+
+    for ( /* void */ ; pos < end; pos = lf + 1) {
+        lf = nxt_memchr(pos, '\n', end - pos);
+
+        ret = nxt_router_proxy_field(pos, lf, &name, &value);
+
+        if (ret == NXT_DONE) {
+            break;
+        }
+
+        if (ret != NXT_OK) {
+            return NXT_ERROR;
+        }
+
+        n++;
+
+        if (nxt_router_fastcgi_field_is(&name, "Status")) {
+
+            if (value.length < 3
+                || nxt_int_parse(value.start, 3) < 100
+                || (value.length > 3 && value.start[3] != ' '))
+            {
+                return NXT_ERROR;
+            }
+
+            status = value;
+
+        } else if (nxt_router_fastcgi_field_is(&name, "Location")) {
+            location = 1;
+
+        } else if (nxt_router_fastcgi_field_is(&name, "Server")) {
+            fields &= ~NXT_HTTP_FIELD_SERVER;
+
+        } else if (nxt_router_fastcgi_field_is(&name, "Date")) {
+            fields &= ~NXT_HTTP_FIELD_DATE;
+        }
+    }
+
+    if (status.length == 0) {
+        status = location ? found_status : ok_status;
+    }
+
+    nxt_debug(task, "fastcgi response status: %V", &status);
+
+    /* A normalized line can be longer by ": " and CRLF. */
+    size = sizeof("HTTP/1.1 \r\n") - 1 + status.length
+           + (end - u->header->mem.start) + 2 * n + NXT_HTTP_FIELDS_LEN
+           + sizeof("Connection: close\r\n\r\n") - 1;
+
+    b = nxt_buf_mem_alloc(u->mem_pool, size, 0);
+    if (nxt_slow_path(b == NULL)) {
+        return NXT_ERROR;
+    }
+
+    s = nxt_cpymem(b->mem.free, "HTTP/1.1 ", sizeof("HTTP/1.1 ") - 1);
+    s = nxt_cpymem(s, status.start, status.length);
+    *s++ = '\r'; *s++ = '\n';
+
+    s = nxt_http_fields_add(task, s, fields);
+
+    for (pos = u->header->mem.start; pos < end; pos = lf + 1) {
+        lf = nxt_memchr(pos, '\n', end - pos);
+
+        if (nxt_router_proxy_field(pos, lf, &name, &value) != NXT_OK) {
+            break;
+        }
+
+        if (nxt_router_fastcgi_field_is(&name, "Status")
+            || nxt_router_fastcgi_field_is(&name, "Connection")
+            || nxt_router_fastcgi_field_is(&name, "Keep-Alive")
+            || nxt_router_fastcgi_field_is(&name, "Transfer-Encoding"))
+        {
+            continue;
+        }
+
+        s = nxt_cpymem(s, name.start, name.length);
+        *s++ = ':'; *s++ = ' ';
+        s = nxt_cpymem(s, value.start, value.length);
+        *s++ = '\r'; *s++ = '\n';
+    }
+
+    s = nxt_cpymem(s, "Connection: close\r\n\r\n",
+                   sizeof("Connection: close\r\n\r\n") - 1);
+
+    b->mem.free = s;
+
+    *out = b;
+
+    return NXT_OK;
+}
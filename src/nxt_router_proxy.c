@@ -0,0 +1,1655 @@
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_router.h>
+
+
+/*
+ * A listener with the "proxy" object passes requests to HTTP/1.1 servers.
+ * Each engine keeps idle keep-alive connections to the servers in its
+ * listener joint, so the connection pool and the balancing state require
+ * no locking.  The request body is sent as it has been read by the router,
+ * and the response is streamed to the client buffer by buffer: reading
+ * from the server is suspended while the client has NXT_ROUTER_PROXY_BUFS
+ * unsent buffers.
+ *
+ * The upstream connection lifecycle, that is connection, sending the
+ * request, reading, timeouts, retries and keep-alive, is shared with the
+ * FastCGI module through nxt_router_upstream_t: a module only creates the
+ * request and handles the response parts read into the upstream buffer.
+ */
+
+#define NXT_ROUTER_PROXY_TIMEOUT        60000
+#define NXT_ROUTER_PROXY_IDLE_TIMEOUT   60000
+#define NXT_ROUTER_PROXY_CHECK_TIMEOUT  1000
+#define NXT_ROUTER_PROXY_BUFS           8
+
+
+typedef struct {
+    nxt_router_upstream_t     upstream;
+
+    nxt_http_chunk_parse_t    chunk;
+    nxt_off_t                 rest;
+
+    uint8_t                   chunked;    /* 1 bit */
+} nxt_router_proxy_t;
+
+
+typedef struct {
+    nxt_str_t                 balance;
+    uint32_t                  keepalive;
+} nxt_router_proxy_conf_map_t;
+
+
+#define nxt_router_proxy_field_is(name, s)                                    \
+    ((name)->length == sizeof(s) - 1                                          \
+     && nxt_memcasecmp((name)->start, (u_char *) s, sizeof(s) - 1) == 0)
+
+
+static nxt_router_proxy_peer_t *nxt_router_proxy_peer(
+    nxt_router_proxy_pool_t *pool);
+static nxt_int_t nxt_router_proxy_request_create(nxt_task_t *task,
+    nxt_router_upstream_t *u);
+static nxt_bool_t nxt_router_proxy_hop_by_hop(nxt_str_t *name);
+static void nxt_router_proxy_response_read(nxt_task_t *task,
+    nxt_router_upstream_t *u);
+static nxt_int_t nxt_router_proxy_header_process(nxt_task_t *task,
+    nxt_router_proxy_t *p, nxt_buf_t **out);
+static void nxt_router_proxy_body(nxt_task_t *task, nxt_router_proxy_t *p);
+static void nxt_router_proxy_output(nxt_task_t *task, nxt_router_upstream_t *u,
+    nxt_buf_t *b);
+static nxt_bool_t nxt_router_proxy_eof(nxt_router_upstream_t *u);
+static void nxt_router_upstream_send(nxt_task_t *task,
+    nxt_router_upstream_t *u);
+static void nxt_router_upstream_connected(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_upstream_sent(nxt_task_t *task, void *obj, void *data);
+static void nxt_router_upstream_ready(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_upstream_check(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_upstream_closed(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_upstream_conn_error(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_upstream_read_timeout(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_upstream_write_timeout(nxt_task_t *task, void *obj,
+    void *data);
+static nxt_msec_t nxt_router_upstream_timeout_value(nxt_conn_t *c,
+    uintptr_t data);
+static nxt_conn_t *nxt_router_upstream_detach(nxt_router_upstream_t *u);
+static void nxt_router_upstream_error(nxt_task_t *task,
+    nxt_router_upstream_t *u, int code, const char *msg);
+static void nxt_router_proxy_idle(nxt_router_proxy_peer_t *peer,
+    nxt_conn_t *c);
+static void nxt_router_proxy_idle_read(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_proxy_idle_close(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_proxy_idle_timeout(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_router_proxy_close(nxt_task_t *task, nxt_conn_t *c);
+static void nxt_router_proxy_conn_free(nxt_task_t *task, void *obj,
+    void *data);
+
+
+static nxt_conf_map_t  nxt_router_proxy_conf[] = {
+    {
+        nxt_string("balance"),
+        NXT_CONF_MAP_STR,
+        offsetof(nxt_router_proxy_conf_map_t, balance),
+    },
+
+    {
+        nxt_string("keepalive"),
+        NXT_CONF_MAP_INT32,
+        offsetof(nxt_router_proxy_conf_map_t, keepalive),
+    },
+};
+
+
+static const nxt_router_upstream_proto_t  nxt_router_proxy_proto = {
+    .read = nxt_router_proxy_response_read,
+    .eof = nxt_router_proxy_eof,
+};
+
+
+static const nxt_conn_state_t  nxt_router_upstream_connect_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_router_upstream_connected,
+    .close_handler = nxt_router_upstream_conn_error,
+    .error_handler = nxt_router_upstream_conn_error,
+
+    .timer_handler = nxt_router_upstream_write_timeout,
+    .timer_value = nxt_router_upstream_timeout_value,
+    .timer_data = NXT_ROUTER_PROXY_TIMEOUT,
+};
+
+
+static const nxt_conn_state_t  nxt_router_upstream_send_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_router_upstream_sent,
+    .close_handler = nxt_router_upstream_conn_error,
+    .error_handler = nxt_router_upstream_conn_error,
+
+    .timer_handler = nxt_router_upstream_write_timeout,
+    .timer_value = nxt_router_upstream_timeout_value,
+    .timer_data = NXT_ROUTER_PROXY_TIMEOUT,
+    .timer_autoreset = 1,
+};
+
+
+static const nxt_conn_state_t  nxt_router_upstream_read_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_router_upstream_ready,
+    .close_handler = nxt_router_upstream_closed,
+    .error_handler = nxt_router_upstream_conn_error,
+
+    .timer_handler = nxt_router_upstream_read_timeout,
+    .timer_value = nxt_router_upstream_timeout_value,
+    .timer_data = NXT_ROUTER_PROXY_TIMEOUT,
+    .timer_autoreset = 1,
+};
+
+
+static const nxt_conn_state_t  nxt_router_proxy_idle_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_router_proxy_idle_read,
+    .close_handler = nxt_router_proxy_idle_close,
+    .error_handler = nxt_router_proxy_idle_close,
+
+    .timer_handler = nxt_router_proxy_idle_timeout,
+    .timer_value = nxt_router_upstream_timeout_value,
+    .timer_data = NXT_ROUTER_PROXY_IDLE_TIMEOUT,
+};
+
+
+static const nxt_conn_state_t  nxt_router_proxy_close_state
+    nxt_aligned(64) =
+{
+    .ready_handler = nxt_router_proxy_conn_free,
+};
+
+
+static nxt_str_t  nxt_router_proxy_hop_by_hop_fields[] = {
+    nxt_string("Connection"),
+    nxt_string("Keep-Alive"),
+    nxt_string("Proxy-Connection"),
+    nxt_string("TE"),
+    nxt_string("Trailer"),
+    nxt_string("Transfer-Encoding"),
+    nxt_string("Upgrade"),
+    nxt_string("Content-Length"),
+    nxt_string("Expect"),
+};
+
+
+nxt_router_proxy_conf_t *
+nxt_router_proxy_conf_create(nxt_task_t *task, nxt_mp_t *mp,
+    nxt_conf_value_t *value)
+{
+    uint32_t                     i;
+    nxt_int_t                    ret;
+    nxt_str_t                    name;
+    nxt_sockaddr_t               *sa;
+    nxt_conf_value_t             *servers, *server;
+    nxt_router_proxy_conf_t      *conf;
+    nxt_router_proxy_conf_map_t  map;
+
+    static nxt_str_t  servers_str = nxt_string("servers");
+
+    map.balance.length = 0;
+    map.keepalive = 16;
+
+    ret = nxt_conf_map_object(mp, value, nxt_router_proxy_conf,
+                              nxt_nitems(nxt_router_proxy_conf), &map);
+    if (ret != NXT_OK) {
+        nxt_log(task, NXT_LOG_CRIT, "proxy map error");
+        return NULL;
+    }
+
+    servers = nxt_conf_get_object_member(value, &servers_str, NULL);
+    if (servers == NULL) {
+        nxt_log(task, NXT_LOG_CRIT, "no proxy \"servers\"");
+        return NULL;
+    }
+
+    for (i = 0; nxt_conf_get_array_element(servers, i) != NULL; i++) {
+        /* void */
+    }
+
+    if (i == 0) {
+        nxt_log(task, NXT_LOG_CRIT, "empty proxy \"servers\"");
+        return NULL;
+    }
+
+    conf = nxt_mp_zget(mp, sizeof(nxt_router_proxy_conf_t)
+                           + i * sizeof(nxt_sockaddr_t *));
+    if (nxt_slow_path(conf == NULL)) {
+        return NULL;
+    }
+
+    conf->npeers = i;
+    conf->peers = nxt_pointer_to(conf, sizeof(nxt_router_proxy_conf_t));
+    conf->keepalive = map.keepalive;
+    conf->least_conn = nxt_str_eq(&map.balance, "least_conn", 10);
+
+    for (i = 0; i < conf->npeers; i++) {
+        server = nxt_conf_get_array_element(servers, i);
+
+        nxt_conf_get_string(server, &name);
+
+        sa = nxt_sockaddr_parse(mp, &name);
+        if (sa == NULL) {
+            nxt_log(task, NXT_LOG_CRIT, "invalid proxy server \"%V\"", &name);
+            return NULL;
+        }
+
+        sa->type = SOCK_STREAM;
+
+        nxt_debug(task, "proxy server: \"%*s\"",
+                  sa->length, nxt_sockaddr_start(sa));
+
+        conf->peers[i] = sa;
+    }
+
+    return conf;
+}
+
+
+nxt_int_t
+nxt_router_proxy_pool_init(nxt_mp_t *mp, nxt_router_proxy_pool_t *pool,
+    nxt_router_proxy_conf_t *conf)
+{
+    nxt_uint_t  i;
+
+    pool->current = 0;
+    pool->conf = conf;
+    pool->peers = NULL;
+
+    if (conf == NULL) {
+        return NXT_OK;
+    }
+
+    pool->peers = nxt_mp_zget(mp, conf->npeers
+                                  * sizeof(nxt_router_proxy_peer_t));
+    if (nxt_slow_path(pool->peers == NULL)) {
+        return NXT_ERROR;
+    }
+
+    for (i = 0; i < conf->npeers; i++) {
+        nxt_queue_init(&pool->peers[i].idle);
+        pool->peers[i].sockaddr = conf->peers[i];
+    }
+
+    return NXT_OK;
+}
+
+
+void
+nxt_router_proxy_pool_free(nxt_task_t *task, nxt_router_proxy_pool_t *pool)
+{
+    nxt_uint_t        i;
+    nxt_conn_t        *c;
+    nxt_queue_link_t  *lnk;
+
+    if (pool->conf == NULL) {
+        return;
+    }
+
+    for (i = 0; i < pool->conf->npeers; i++) {
+
+        while (!nxt_queue_is_empty(&pool->peers[i].idle)) {
+            lnk = nxt_queue_first(&pool->peers[i].idle);
+            nxt_queue_remove(lnk);
+
+            c = nxt_queue_link_data(lnk, nxt_conn_t, link);
+
+            nxt_router_proxy_close(task, c);
+        }
+    }
+}
+
+
+void
+nxt_router_proxy_handler(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap)
+{
+    nxt_router_upstream_t    *u;
+    nxt_socket_conf_joint_t  *joint;
+
+    joint = c->listen->socket.data;
+
+    u = nxt_router_upstream_create(task, c, ap, sizeof(nxt_router_proxy_t),
+                                   &joint->proxy, &nxt_router_proxy_proto);
+    if (nxt_slow_path(u == NULL)) {
+        return;
+    }
+
+    /* The response header is read directly to the header buffer. */
+    u->buffer = u->header;
+
+    if (nxt_slow_path(nxt_router_proxy_request_create(task, u) != NXT_OK)) {
+        nxt_router_upstream_finalize(task, u, 500, "Failed to create proxy "
+                                     "request");
+        return;
+    }
+
+    nxt_router_upstream_connect(task, u);
+}
+
+
+/*
+ * The client connection memory pool is retained by the upstream request,
+ * so the request survives the client connection closure and the client
+ * connection closure is indicated by rc->conn set to NULL.  The request
+ * is allocated with the module part of the given size, and NULL is
+ * returned if an error response has been already sent to the client.
+ */
+
+nxt_router_upstream_t *
+nxt_router_upstream_create(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap, size_t size, nxt_router_proxy_pool_t *pool,
+    const nxt_router_upstream_proto_t *proto)
+{
+    nxt_event_engine_t       *engine;
+    nxt_req_conn_link_t      *rc;
+    nxt_router_upstream_t    *u;
+    nxt_socket_conf_joint_t  *joint;
+
+    engine = task->thread->engine;
+    joint = c->listen->socket.data;
+
+    rc = nxt_conn_request_add(c);
+
+    if (nxt_slow_path(rc == NULL)) {
+        nxt_router_gen_error(task, c, 500, "Failed to allocate "
+                             "req->conn link");
+        return NULL;
+    }
+
+    if (nxt_slow_path(nxt_event_engine_request_add(engine, rc) != NXT_OK)) {
+        nxt_conn_request_remove(c, rc);
+        nxt_router_gen_error(task, c, 500, "Failed to allocate request id");
+        return NULL;
+    }
+
+    u = nxt_mp_retain(c->mem_pool, size);
+    if (nxt_slow_path(u == NULL)) {
+        nxt_router_gen_error(task, c, 500, "Failed to allocate upstream "
+                             "request");
+        return NULL;
+    }
+
+    nxt_memzero(u, size);
+
+    /* The header read timer is not reset after the header has been parsed. */
+    nxt_timer_disable(engine, &c->read_timer);
+
+    c->socket.data = NULL;
+
+    u->proto = proto;
+    u->mem_pool = c->mem_pool;
+    u->rc = rc;
+    u->ap = ap;
+    u->pool = pool;
+    u->body_buffer_size = joint->socket_conf->body_buffer_size;
+    u->head = nxt_str_eq(&ap->r.header.method, "HEAD", 4);
+
+    u->header = nxt_buf_mem_alloc(c->mem_pool,
+                                  joint->socket_conf->large_header_buffer_size,
+                                  0);
+    if (nxt_slow_path(u->header == NULL)) {
+        nxt_router_upstream_finalize(task, u, 500, "Failed to allocate "
+                                     "upstream response buffer");
+        return NULL;
+    }
+
+    u->peer = nxt_router_proxy_peer(pool);
+
+    return u;
+}
+
+
+/*
+ * The round robin balancing starts from the next server on each request,
+ * and the least connections balancing looks for a server with the least
+ * active requests starting from the same server, so servers with equal
+ * number of requests are used in turn.
+ */
+
+static nxt_router_proxy_peer_t *
+nxt_router_proxy_peer(nxt_router_proxy_pool_t *pool)
+{
+    nxt_uint_t               i, n, current;
+    nxt_router_proxy_peer_t  *peer, *best;
+
+    n = pool->conf->npeers;
+    current = pool->current;
+
+    pool->current = (current + 1 < n) ? current + 1 : 0;
+
+    best = &pool->peers[current];
+
+    if (pool->conf->least_conn) {
+
+        for (i = 1; i < n; i++) {
+            peer = &pool->peers[(current + i) % n];
+
+            if (peer->active < best->active) {
+                best = peer;
+            }
+        }
+    }
+
+    return best;
+}
+
+
+static nxt_int_t
+nxt_router_proxy_request_create(nxt_task_t *task, nxt_router_upstream_t *u)
+{
+    u_char                    *s;
+    size_t                    size;
+    nxt_buf_t                 *b, *in, *d;
+    nxt_off_t                 length, rest;
+    nxt_str_t                 *xff;
+    nxt_sockaddr_t            *sa;
+    nxt_http_field_t          *field;
+    nxt_app_request_t         *r;
+    nxt_app_request_header_t  *h;
+
+    r = &u->ap->r;
+    h = &r->header;
+    sa = u->peer->sockaddr;
+
+    xff = NULL;
+
+    size = h->method.length + 1 + h->target.length
+           + sizeof(" HTTP/1.1\r\n") - 1;
+
+    nxt_list_each(field, h->fields) {
+
+        if (nxt_router_proxy_hop_by_hop(&field->name)) {
+            continue;
+        }
+
+        if (nxt_router_proxy_field_is(&field->name, "X-Forwarded-For")) {
+            xff = &field->value;
+            continue;
+        }
+
+        size += field->name.length + 2 + field->value.length + 2;
+
+    } nxt_list_loop;
+
+    if (h->host.length == 0) {
+        size += sizeof("Host: \r\n") - 1 + sa->length;
+    }
+
+    size += sizeof("X-Forwarded-For: \r\n") - 1 + r->remote.length;
+
+    if (xff != NULL) {
+        size += xff->length + 2;
+    }
+
+    size += sizeof("Content-Length: \r\n") - 1 + NXT_OFF_T_LEN + 2;
+
+    b = nxt_buf_mem_alloc(u->mem_pool, size, 0);
+    if (nxt_slow_path(b == NULL)) {
+        return NXT_ERROR;
+    }
+
+    s = b->mem.free;
+
+    s = nxt_cpymem(s, h->method.start, h->method.length);
+    *s++ = ' ';
+    s = nxt_cpymem(s, h->target.start, h->target.length);
+    s = nxt_cpymem(s, " HTTP/1.1\r\n", sizeof(" HTTP/1.1\r\n") - 1);
+
+    nxt_list_each(field, h->fields) {
+
+        if (nxt_router_proxy_hop_by_hop(&field->name)
+            || nxt_router_proxy_field_is(&field->name, "X-Forwarded-For"))
+        {
+            continue;
+        }
+
+        s = nxt_cpymem(s, field->name.start, field->name.length);
+        *s++ = ':'; *s++ = ' ';
+        s = nxt_cpymem(s, field->value.start, field->value.length);
+        *s++ = '\r'; *s++ = '\n';
+
+    } nxt_list_loop;
+
+    if (h->host.length == 0) {
+        s = nxt_sprintf(s, b->mem.end, "Host: %*s\r\n",
+                        (size_t) sa->length, nxt_sockaddr_start(sa));
+    }
+
+    s = nxt_cpymem(s, "X-Forwarded-For: ", sizeof("X-Forwarded-For: ") - 1);
+
+    if (xff != NULL) {
+        s = nxt_cpymem(s, xff->start, xff->length);
+        *s++ = ','; *s++ = ' ';
+    }
+
+    s = nxt_cpymem(s, r->remote.start, r->remote.length);
+    *s++ = '\r'; *s++ = '\n';
+
+    /*
+     * A chunked request body has been already decoded and its length
+     * is passed in parsed_content_length.
+     */
+    length = h->parsed_content_length;
+
+    if (length != 0 || h->content_length.length != 0 || h->chunked) {
+        s = nxt_sprintf(s, b->mem.end, "Content-Length: %O\r\n", length);
+    }
+
+    *s++ = '\r'; *s++ = '\n';
+
+    b->mem.free = s;
+
+    u->request = b;
+
+    rest = length;
+
+    for (in = r->body.buf; in != NULL && rest > 0; in = in->next) {
+        size = nxt_min((nxt_off_t) nxt_buf_mem_used_size(&in->mem), rest);
+
+        if (size == 0) {
+            continue;
+        }
+
+        d = nxt_buf_mem_alloc(u->mem_pool, 0, 0);
+        if (nxt_slow_path(d == NULL)) {
+            return NXT_ERROR;
+        }
+
+        d->mem.start = in->mem.pos;
+        d->mem.pos = in->mem.pos;
+        d->mem.free = in->mem.pos + size;
+        d->mem.end = d->mem.free;
+
+        b->next = d;
+        b = d;
+
+        rest -= size;
+    }
+
+    nxt_debug(task, "proxy request header: %uz, body: %O",
+              nxt_buf_mem_used_size(&u->request->mem), length);
+
+    return NXT_OK;
+}
+
+
+static nxt_bool_t
+nxt_router_proxy_hop_by_hop(nxt_str_t *name)
+{
+    nxt_uint_t  i;
+    nxt_str_t   *field;
+
+    for (i = 0; i < nxt_nitems(nxt_router_proxy_hop_by_hop_fields); i++) {
+        field = &nxt_router_proxy_hop_by_hop_fields[i];
+
+        if (name->length == field->length
+            && nxt_memcasecmp(name->start, field->start, field->length) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+void
+nxt_router_upstream_connect(nxt_task_t *task, nxt_router_upstream_t *u)
+{
+    nxt_mp_t                 *mp;
+    nxt_buf_t                *b;
+    nxt_conn_t               *c;
+    nxt_queue_link_t         *lnk;
+    nxt_event_engine_t       *engine;
+    nxt_router_proxy_peer_t  *peer;
+
+    engine = task->thread->engine;
+    peer = u->peer;
+
+    for (b = u->request; b != NULL; b = b->next) {
+        b->mem.pos = b->mem.start;
+    }
+
+    u->header->mem.pos = u->header->mem.start;
+    u->header->mem.free = u->header->mem.start;
+    u->scan = u->header->mem.start;
+    u->sent = 0;
+
+    if (!nxt_queue_is_empty(&peer->idle)) {
+        lnk = nxt_queue_first(&peer->idle);
+        nxt_queue_remove(lnk);
+
+        c = nxt_queue_link_data(lnk, nxt_conn_t, link);
+
+        nxt_debug(task, "upstream reuse connection %p", c);
+
+        nxt_timer_disable(engine, &c->read_timer);
+        nxt_fd_event_block_read(engine, &c->socket);
+
+        u->reused = 1;
+        u->conn = c;
+        c->socket.data = u;
+        peer->active++;
+
+        nxt_router_upstream_send(task, u);
+        return;
+    }
+
+    u->reused = 0;
+    u->tries++;
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (nxt_slow_path(mp == NULL)) {
+        goto fail;
+    }
+
+    c = nxt_conn_create(mp, task);
+    if (nxt_slow_path(c == NULL)) {
+        nxt_mp_destroy(mp);
+        goto fail;
+    }
+
+    nxt_debug(task, "upstream connect to %*s",
+              (size_t) peer->sockaddr->length,
+              nxt_sockaddr_start(peer->sockaddr));
+
+    c->remote = peer->sockaddr;
+    c->read_work_queue = &engine->fast_work_queue;
+    c->write_work_queue = &engine->fast_work_queue;
+    c->write_state = &nxt_router_upstream_connect_state;
+
+    u->conn = c;
+    c->socket.data = u;
+    peer->active++;
+
+    nxt_conn_connect(engine, c);
+
+    return;
+
+fail:
+
+    nxt_router_upstream_finalize(task, u, 500, "Failed to create upstream "
+                                 "connection");
+}
+
+
+static void
+nxt_router_upstream_send(nxt_task_t *task, nxt_router_upstream_t *u)
+{
+    nxt_conn_t  *c;
+
+    c = u->conn;
+
+    c->write = u->request;
+    c->write_state = &nxt_router_upstream_send_state;
+
+    nxt_conn_write(task->thread->engine, c);
+}
+
+
+static void
+nxt_router_upstream_connected(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t             *c;
+    nxt_router_upstream_t  *u;
+
+    c = obj;
+    u = c->socket.data;
+
+    nxt_debug(task, "upstream connected");
+
+    if (u == NULL) {
+        return;
+    }
+
+    nxt_router_upstream_send(task, u);
+}
+
+
+static void
+nxt_router_upstream_sent(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_buf_t              *b;
+    nxt_conn_t             *c;
+    nxt_router_upstream_t  *u;
+
+    c = obj;
+    u = c->socket.data;
+
+    if (u == NULL) {
+        return;
+    }
+
+    for (b = c->write; b != NULL; b = b->next) {
+        if (nxt_buf_mem_used_size(&b->mem) != 0) {
+            break;
+        }
+    }
+
+    c->write = b;
+
+    if (b != NULL) {
+        nxt_conn_write(task->thread->engine, c);
+        return;
+    }
+
+    nxt_debug(task, "upstream request sent");
+
+    u->sent = 1;
+
+    nxt_router_upstream_read(task, u);
+}
+
+
+void
+nxt_router_upstream_read(nxt_task_t *task, nxt_router_upstream_t *u)
+{
+    nxt_conn_t          *c;
+    nxt_event_engine_t  *engine;
+
+    if (u->rc->conn == NULL) {
+        nxt_router_upstream_finalize(task, u, -1, NULL);
+        return;
+    }
+
+    c = u->conn;
+    engine = task->thread->engine;
+
+    if (u->nbufs >= NXT_ROUTER_PROXY_BUFS) {
+        nxt_debug(task, "upstream read suspended");
+
+        u->paused = 1;
+
+        c->read_timer.handler = nxt_router_upstream_check;
+        nxt_timer_add(engine, &c->read_timer, NXT_ROUTER_PROXY_CHECK_TIMEOUT);
+        return;
+    }
+
+    if (u->buffer == NULL) {
+        u->buffer = nxt_buf_mem_alloc(u->mem_pool, u->body_buffer_size, 0);
+        if (nxt_slow_path(u->buffer == NULL)) {
+            nxt_router_upstream_finalize(task, u, 500, "Failed to allocate "
+                                         "upstream response buffer");
+            return;
+        }
+    }
+
+    c->read = u->buffer;
+    c->read_state = &nxt_router_upstream_read_state;
+
+    nxt_conn_read(engine, c);
+}
+
+
+static void
+nxt_router_upstream_ready(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t             *c;
+    nxt_router_upstream_t  *u;
+
+    c = obj;
+    u = c->socket.data;
+
+    if (u == NULL) {
+        return;
+    }
+
+    u->received = 1;
+
+    u->proto->read(task, u);
+}
+
+
+static void
+nxt_router_proxy_response_read(nxt_task_t *task, nxt_router_upstream_t *u)
+{
+    size_t              size;
+    nxt_int_t           ret;
+    nxt_buf_t           *b, *out;
+    nxt_router_proxy_t  *p;
+
+    p = nxt_container_of(u, nxt_router_proxy_t, upstream);
+
+    if (u->started) {
+        nxt_router_proxy_body(task, p);
+        return;
+    }
+
+    b = u->header;
+
+    ret = nxt_router_upstream_header_parse(u);
+
+    if (ret == NXT_AGAIN) {
+        if (b->mem.free == b->mem.end) {
+            nxt_router_upstream_error(task, u, 502, "Too long proxy response "
+                                      "header");
+            return;
+        }
+
+        nxt_router_upstream_read(task, u);
+        return;
+    }
+
+    if (ret == NXT_OK) {
+        ret = nxt_router_proxy_header_process(task, p, &out);
+    }
+
+    if (nxt_slow_path(ret != NXT_OK)) {
+        nxt_router_upstream_error(task, u, 502, "Invalid proxy response "
+                                  "header");
+        return;
+    }
+
+    u->started = 1;
+    u->buffer = NULL;
+
+    nxt_router_proxy_output(task, u, out);
+
+    if (p->rest == 0) {
+        nxt_router_upstream_finalize(task, u, 0, NULL);
+        return;
+    }
+
+    /* The body part read together with the header. */
+    size = b->mem.free - u->scan;
+
+    if (size == 0) {
+        nxt_router_upstream_read(task, u);
+        return;
+    }
+
+    u->buffer = nxt_buf_mem_alloc(u->mem_pool,
+                                  nxt_max(size, u->body_buffer_size), 0);
+    if (nxt_slow_path(u->buffer == NULL)) {
+        nxt_router_upstream_finalize(task, u, 500, "Failed to allocate "
+                                     "upstream response buffer");
+        return;
+    }
+
+    u->buffer->mem.free = nxt_cpymem(u->buffer->mem.free, u->scan, size);
+
+    nxt_router_proxy_body(task, p);
+}
+
+
+nxt_int_t
+nxt_router_upstream_header_parse(nxt_router_upstream_t *u)
+{
+    u_char     *pos, *lf, *end;
+    nxt_buf_t  *b;
+
+    b = u->header;
+    pos = u->scan;
+    end = b->mem.free;
+
+    for ( ;; ) {
+        lf = nxt_memchr(pos, '\n', end - pos);
+
+        if (lf == NULL) {
+            u->scan = pos;
+            return NXT_AGAIN;
+        }
+
+        if (lf == pos || (lf == pos + 1 && *pos == '\r')) {
+
+            if (pos == b->mem.start) {
+                return NXT_ERROR;
+            }
+
+            u->scan = lf + 1;
+            return NXT_OK;
+        }
+
+        pos = lf + 1;
+    }
+}
+
+
+/*
+ * The response header is passed to the client without hop-by-hop fields:
+ * the client connection is always closed after the response, and chunked
+ * response body is decoded, so it is delimited by the connection close.
+ */
+
+static nxt_int_t
+nxt_router_proxy_header_process(nxt_task_t *task, nxt_router_proxy_t *p,
+    nxt_buf_t **out)
+{
+    u_char                 *pos, *lf, *end, *s;
+    size_t                 size;
+    nxt_int_t              ret, status;
+    nxt_str_t              line, name, value;
+    nxt_buf_t              *b;
+    nxt_uint_t             n, fields;
+    nxt_router_upstream_t  *u;
+
+    u = &p->upstream;
+
+    pos = u->header->mem.start;
+    end = u->scan;
+
+    lf = nxt_memchr(pos, '\n', end - pos);
+
+    line.start = pos;
+    line.length = (lf > pos && lf[-1] == '\r') ? lf - 1 - pos : lf - pos;
+
+    if (line.length < 12
+        || nxt_memcmp(line.start, "HTTP/1.", 7) != 0
+        || line.start[8] != ' '
+        || (line.length > 12 && line.start[12] != ' '))
+    {
+        return NXT_ERROR;
+    }
+
+    status = nxt_int_parse(&line.start[9], 3);
+
+    if (status < 200) {
+        /* Also informational responses are not supported. */
+        return NXT_ERROR;
+    }
+
+    nxt_debug(task, "proxy response status: %i", status);
+
+    u->keepalive = (line.start[7] == '1');
+    p->chunked = 0;
+    p->rest = -1;
+
+    n = 1;
+    fields = NXT_HTTP_FIELDS;
+
+    for (pos = lf + 1; pos < end; pos = lf + 1) {
+        lf = nxt_memchr(pos, '\n', end - pos);
+
+        ret = nxt_router_proxy_field(pos, lf, &name, &value);
+
+        if (ret == NXT_DONE) {
+            break;
+        }
+
+        if (ret != NXT_OK) {
+            return NXT_ERROR;
+        }
+
+        n++;
+
+        if (nxt_router_proxy_field_is(&name, "Content-Length")) {
+            p->rest = nxt_off_t_parse(value.start, value.length);
+
+            if (p->rest < 0) {
+                return NXT_ERROR;
+            }
+
+        } else if (nxt_router_proxy_field_is(&name, "Transfer-Encoding")) {
+
+            if (nxt_memcasestrn(value.start, value.start + value.length,
+                                "chunked", 7)
+                == NULL)
+            {
+                return NXT_ERROR;
+            }
+
+            p->chunked = 1;
+
+        } else if (nxt_router_proxy_field_is(&name, "Connection")) {
+
+            if (nxt_memcasestrn(value.start, value.start + value.length,
+                                "close", 5)
+                != NULL)
+            {
+                u->keepalive = 0;
+            }
+
+        } else if (nxt_router_proxy_field_is(&name, "Server")) {
+            fields &= ~NXT_HTTP_FIELD_SERVER;
+
+        } else if (nxt_router_proxy_field_is(&name, "Date")) {
+            fields &= ~NXT_HTTP_FIELD_DATE;
+        }
+    }
+
+    if (u->head || status == 204 || status == 304) {
+        p->chunked = 0;
+        p->rest = 0;
+
+    } else if (p->chunked) {
+        p->rest = -1;
+        nxt_memzero(&p->chunk, sizeof(nxt_http_chunk_parse_t));
+
+    } else if (p->rest < 0) {
+        u->keepalive = 0;
+    }
+
+    /* A normalized line can be longer by ": " and CRLF. */
+    size = (end - u->header->mem.start) + 2 * n + NXT_HTTP_FIELDS_LEN
+           + sizeof("Connection: close\r\n\r\n");
+
+    b = nxt_buf_mem_alloc(u->mem_pool, size, 0);
+    if (nxt_slow_path(b == NULL)) {
+        return NXT_ERROR;
+    }
+
+    s = nxt_cpymem(b->mem.free, line.start, line.length);
+    *s++ = '\r'; *s++ = '\n';
+
+    /* The upstream "Server" and "Date" fields are preserved. */
+    s = nxt_http_fields_add(task, s, fields);
+
+    for (pos = line.start; pos < end; pos = lf + 1) {
+        lf = nxt_memchr(pos, '\n', end - pos);
+
+        if (pos == line.start) {
+            continue;
+        }
+
+        if (nxt_router_proxy_field(pos, lf, &name, &value) != NXT_OK) {
+            break;
+        }
+
+        if (nxt_router_proxy_field_is(&name, "Connection")
+            || nxt_router_proxy_field_is(&name, "Keep-Alive")
+            || nxt_router_proxy_field_is(&name, "Proxy-Connection")
+            || nxt_router_proxy_field_is(&name, "Transfer-Encoding")
+            || (p->chunked
+                && nxt_router_proxy_field_is(&name, "Content-Length")))
+        {
+            continue;
+        }
+
+        s = nxt_cpymem(s, name.start, name.length);
+        *s++ = ':'; *s++ = ' ';
+        s = nxt_cpymem(s, value.start, value.length);
+        *s++ = '\r'; *s++ = '\n';
+    }
+
+    s = nxt_cpymem(s, "Connection: close\r\n\r\n",
+                   sizeof("Connection: close\r\n\r\n") - 1);
+
+    b->mem.free = s;
+
+    *out = b;
+
+    return NXT_OK;
+}
+
+
+nxt_int_t
+nxt_router_proxy_field(u_char *start, u_char *end, nxt_str_t *name,
+    nxt_str_t *value)
+{
+    u_char  *colon, *p;
+
+    if (end > start && end[-1] == '\r') {
+        end--;
+    }
+
+    if (end == start) {
+        return NXT_DONE;
+    }
+
+    colon = nxt_memchr(start, ':', end - start);
+
+    if (colon == NULL || colon == start) {
+        return NXT_ERROR;
+    }
+
+    name->start = start;
+    name->length = colon - start;
+
+    p = colon + 1;
+
+    while (p < end && (*p == ' ' || *p == '\t')) {
+        p++;
+    }
+
+    while (end > p && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+
+    value->start = p;
+    value->length = end - p;
+
+    return NXT_OK;
+}
+
+
+/*
+ * Each read buffer is passed to the client as soon as it has been read,
+ * so the buffer contains only new data.
+ */
+
+static void
+nxt_router_proxy_body(nxt_task_t *task, nxt_router_proxy_t *p)
+{
+    size_t                 size;
+    nxt_int_t              ret;
+    nxt_buf_t              *b;
+    nxt_bool_t             done;
+    nxt_router_upstream_t  *u;
+
+    u = &p->upstream;
+    b = u->buffer;
+    done = 0;
+
+    if (p->chunked) {
+        p->chunk.pos = b->mem.pos;
+
+        ret = nxt_http_chunk_parse(task, &p->chunk, &b->mem);
+
+        if (nxt_slow_path(ret == NXT_ERROR)) {
+            u->keepalive = 0;
+            nxt_router_upstream_finalize(task, u, 502, "Invalid proxy "
+                                         "response chunked body");
+            return;
+        }
+
+        done = (ret == NXT_DONE);
+
+        if (done && b->mem.free != p->chunk.pos) {
+            /* The server has sent more data than expected. */
+            u->keepalive = 0;
+            b->mem.free = p->chunk.pos;
+        }
+
+    } else if (p->rest > 0) {
+        size = nxt_buf_mem_used_size(&b->mem);
+
+        if ((nxt_off_t) size >= p->rest) {
+
+            if ((nxt_off_t) size > p->rest) {
+                /* The server has sent more data than expected. */
+                u->keepalive = 0;
+                b->mem.free = b->mem.pos + p->rest;
+            }
+
+            done = 1;
+        }
+
+        p->rest -= nxt_buf_mem_used_size(&b->mem);
+    }
+
+    if (nxt_buf_mem_used_size(&b->mem) != 0) {
+        u->buffer = NULL;
+        nxt_router_proxy_output(task, u, b);
+
+    } else {
+        b->mem.pos = b->mem.start;
+        b->mem.free = b->mem.start;
+    }
+
+    if (done) {
+        nxt_router_upstream_finalize(task, u, 0, NULL);
+        return;
+    }
+
+    nxt_router_upstream_read(task, u);
+}
+
+
+static void
+nxt_router_proxy_output(nxt_task_t *task, nxt_router_upstream_t *u,
+    nxt_buf_t *b)
+{
+    b->data = u;
+    b->completion_handler = nxt_router_upstream_buf_completion;
+
+    u->nbufs++;
+
+    nxt_router_upstream_output(task, u, b);
+}
+
+
+static nxt_bool_t
+nxt_router_proxy_eof(nxt_router_upstream_t *u)
+{
+    nxt_router_proxy_t  *p;
+
+    p = nxt_container_of(u, nxt_router_proxy_t, upstream);
+
+    /* The response body is delimited by the connection close. */
+    return u->started && !p->chunked && p->rest < 0;
+}
+
+
+/*
+ * The buffers are passed to the client as a chain and are completed
+ * at once if the client connection has been closed.
+ */
+
+void
+nxt_router_upstream_output(nxt_task_t *task, nxt_router_upstream_t *u,
+    nxt_buf_t *b)
+{
+    nxt_buf_t  *next;
+
+    if (u->rc->conn != NULL) {
+        nxt_router_conn_output(task, u->rc->conn, b);
+        return;
+    }
+
+    /* The client connection has been closed. */
+
+    for ( /* void */ ; b != NULL; b = next) {
+        next = b->next;
+        b->completion_handler(task, b, b->parent);
+    }
+}
+
+
+/*
+ * The completion handler of buffers counted in u->nbufs, it resumes
+ * the suspended reading.
+ */
+
+void
+nxt_router_upstream_buf_completion(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_buf_t              *b;
+    nxt_router_upstream_t  *u;
+
+    b = obj;
+    u = b->data;
+
+    nxt_mp_free(u->mem_pool, b);
+
+    u->nbufs--;
+
+    if (u->paused) {
+        nxt_debug(task, "upstream read resumed");
+
+        u->paused = 0;
+
+        nxt_timer_disable(task->thread->engine, &u->conn->read_timer);
+
+        nxt_router_upstream_read(task, u);
+    }
+}
+
+
+/*
+ * The client connection is not read while the response is passed,
+ * so its closure is checked periodically if the reading is suspended.
+ */
+
+static void
+nxt_router_upstream_check(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t             *c;
+    nxt_timer_t            *timer;
+    nxt_router_upstream_t  *u;
+
+    timer = obj;
+
+    c = nxt_read_timer_conn(timer);
+    u = c->socket.data;
+
+    if (u == NULL) {
+        return;
+    }
+
+    if (u->rc->conn == NULL) {
+        nxt_router_upstream_finalize(task, u, -1, NULL);
+        return;
+    }
+
+    nxt_timer_add(task->thread->engine, timer, NXT_ROUTER_PROXY_CHECK_TIMEOUT);
+}
+
+
+static void
+nxt_router_upstream_closed(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t             *c;
+    nxt_router_upstream_t  *u;
+
+    c = obj;
+    u = c->socket.data;
+
+    nxt_debug(task, "upstream connection closed by server");
+
+    if (u == NULL) {
+        return;
+    }
+
+    if (u->proto->eof != NULL && u->proto->eof(u)) {
+        nxt_router_upstream_finalize(task, u, 0, NULL);
+        return;
+    }
+
+    nxt_router_upstream_error(task, u, 502, "Upstream connection closed "
+                              "prematurely");
+}
+
+
+static void
+nxt_router_upstream_conn_error(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t             *c;
+    nxt_router_upstream_t  *u;
+
+    c = obj;
+    u = c->socket.data;
+
+    nxt_debug(task, "upstream connection error");
+
+    if (u == NULL) {
+        return;
+    }
+
+    nxt_router_upstream_error(task, u, 502, "Upstream connection failed");
+}
+
+
+static void
+nxt_router_upstream_read_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t             *c;
+    nxt_router_upstream_t  *u;
+
+    c = nxt_read_timer_conn(obj);
+    u = c->socket.data;
+
+    if (u == NULL) {
+        return;
+    }
+
+    c->socket.timedout = 1;
+
+    nxt_router_upstream_error(task, u, 504, "Upstream read timeout");
+}
+
+
+static void
+nxt_router_upstream_write_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t             *c;
+    nxt_router_upstream_t  *u;
+
+    c = nxt_write_timer_conn(obj);
+    u = c->socket.data;
+
+    if (u == NULL) {
+        return;
+    }
+
+    c->socket.timedout = 1;
+
+    nxt_router_upstream_error(task, u, 504, "Upstream connect or write "
+                              "timeout");
+}
+
+
+static nxt_msec_t
+nxt_router_upstream_timeout_value(nxt_conn_t *c, uintptr_t data)
+{
+    return data;
+}
+
+
+/*
+ * The read buffer is left in u->buffer, so it is used again by the next
+ * connection or is freed together with the request memory pool.
+ */
+
+static nxt_conn_t *
+nxt_router_upstream_detach(nxt_router_upstream_t *u)
+{
+    nxt_conn_t  *c;
+
+    c = u->conn;
+
+    u->conn = NULL;
+    u->peer->active--;
+
+    c->socket.data = NULL;
+    c->read = NULL;
+    c->write = NULL;
+
+    return c;
+}
+
+
+/*
+ * A stale keep-alive connection may be closed by the server at the
+ * time the request is sent, so in this case the request is always
+ * repeated.  A failed new connection is repeated with the next server
+ * until all the servers have been tried.  A request is not repeated if
+ * the server has sent something, and a request sent completely is
+ * repeated only if it is idempotent or the protocol allows it.
+ */
+
+static void
+nxt_router_upstream_error(nxt_task_t *task, nxt_router_upstream_t *u,
+    int code, const char *msg)
+{
+    nxt_bool_t                retry;
+    nxt_conn_t                *c;
+    nxt_app_request_header_t  *h;
+
+    c = u->conn;
+    h = &u->ap->r.header;
+
+    retry = !u->received
+            && u->rc->conn != NULL
+            && !c->socket.timedout
+            && (u->reused || u->tries < u->pool->conf->npeers)
+            && (!u->sent
+                || u->reused
+                || u->proto->resend
+                || nxt_str_eq(&h->method, "GET", 3)
+                || nxt_str_eq(&h->method, "HEAD", 4));
+
+    if (!retry) {
+        nxt_router_upstream_finalize(task, u, code, msg);
+        return;
+    }
+
+    nxt_debug(task, "upstream request retry");
+
+    c = nxt_router_upstream_detach(u);
+
+    nxt_router_proxy_close(task, c);
+
+    if (!u->reused) {
+        u->peer = nxt_router_proxy_peer(u->pool);
+    }
+
+    nxt_router_upstream_connect(task, u);
+}
+
+
+/*
+ * The code is 0 if the response has been passed completely, -1 if the
+ * client connection has been closed, or the HTTP error status otherwise.
+ * Only a connection with the completed response is kept alive.
+ */
+
+void
+nxt_router_upstream_finalize(nxt_task_t *task, nxt_router_upstream_t *u,
+    int code, const char *msg)
+{
+    nxt_buf_t                *last;
+    nxt_conn_t               *c, *client;
+    nxt_uint_t               n;
+    nxt_queue_link_t         *lnk;
+    nxt_router_proxy_peer_t  *peer;
+
+    nxt_debug(task, "upstream finalize: %d", code);
+
+    /* The task may belong to the upstream connection being closed. */
+    task = &task->thread->engine->task;
+
+    if (u->conn != NULL) {
+        peer = u->peer;
+
+        c = nxt_router_upstream_detach(u);
+
+        n = 0;
+
+        if (code == 0 && u->keepalive) {
+
+            for (lnk = nxt_queue_first(&peer->idle);
+                 lnk != nxt_queue_tail(&peer->idle);
+                 lnk = nxt_queue_next(lnk))
+            {
+                n++;
+            }
+
+            if (n < u->pool->conf->keepalive) {
+                nxt_router_proxy_idle(peer, c);
+                c = NULL;
+            }
+        }
+
+        if (c != NULL) {
+            nxt_router_proxy_close(task, c);
+        }
+    }
+
+    u->paused = 0;
+
+    client = u->rc->conn;
+
+    if (client != NULL && code >= 0) {
+
+        if (code != 0 && !u->started) {
+            nxt_router_gen_error(task, client, code, "%s", msg);
+
+        } else {
+
+            if (code != 0) {
+                nxt_log(task, NXT_LOG_ERR, "%s", msg);
+            }
+
+            last = nxt_buf_sync_alloc(u->mem_pool, NXT_BUF_SYNC_LAST);
+
+            if (nxt_fast_path(last != NULL)) {
+                nxt_router_conn_output(task, client, last);
+            }
+        }
+    }
+
+    nxt_mp_release(u->mem_pool, NULL);
+}
+
+
+static void
+nxt_router_proxy_idle(nxt_router_proxy_peer_t *peer, nxt_conn_t *c)
+{
+    nxt_queue_insert_head(&peer->idle, &c->link);
+
+    c->read_state = &nxt_router_proxy_idle_state;
+
+    nxt_conn_wait(c);
+}
+
+
+static void
+nxt_router_proxy_idle_read(nxt_task_t *task, void *obj, void *data)
+{
+    u_char      ch;
+    ssize_t     n;
+    nxt_conn_t  *c;
+
+    c = obj;
+
+    if (c->socket.data != NULL) {
+        /* The connection has been reused. */
+        return;
+    }
+
+    n = c->io->recv(c, &ch, 1, MSG_PEEK);
+
+    if (n == NXT_AGAIN) {
+        nxt_conn_wait(c);
+        return;
+    }
+
+    nxt_debug(task, "proxy idle connection closed");
+
+    nxt_queue_remove(&c->link);
+
+    nxt_router_proxy_close(task, c);
+}
+
+
+static void
+nxt_router_proxy_idle_close(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t  *c;
+
+    c = obj;
+
+    if (c->socket.data != NULL) {
+        return;
+    }
+
+    nxt_queue_remove(&c->link);
+
+    nxt_router_proxy_close(task, c);
+}
+
+
+static void
+nxt_router_proxy_idle_timeout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t  *c;
+
+    c = nxt_read_timer_conn(obj);
+
+    nxt_debug(task, "proxy idle connection timeout");
+
+    if (c->socket.data != NULL) {
+        return;
+    }
+
+    nxt_queue_remove(&c->link);
+
+    nxt_router_proxy_close(task, c);
+}
+
+
+static void
+nxt_router_proxy_close(nxt_task_t *task, nxt_conn_t *c)
+{
+    c->socket.data = NULL;
+
+    if (c->socket.fd == -1) {
+        nxt_mp_destroy(c->mem_pool);
+        return;
+    }
+
+    c->write_state = &nxt_router_proxy_close_state;
+
+    nxt_conn_close(task->thread->engine, c);
+}
+
+
+static void
+nxt_router_proxy_conn_free(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_conn_t  *c;
+
+    c = obj;
+
+    nxt_debug(task, "proxy connection free");
+
+    nxt_mp_destroy(c->mem_pool);
+}
@@ -0,0 +1,579 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_router.h>
+
+
+/*
+ * The static files are served directly from the router if the listener
+ * has the "share" document root.  Opened files are kept in a per-engine
+ * cache together with their stat() information, so the cache requires
+ * no locking.  A cache entry is valid for "static_cache_valid" time,
+ * and negative open() results are cached as well, so requests to the
+ * application do not cost an open() call each.  When the cache is full,
+ * the least recently used entry is evicted to cache a new file.
+ */
+
+#define NXT_ROUTER_STATIC_CACHE_MAX  1024
+
+
+typedef struct {
+    nxt_file_t        file;
+    nxt_msec_t        expires;
+    uint32_t          count;
+    uint8_t           cached;   /* 1 bit */
+    nxt_str_t         name;
+
+    nxt_queue_link_t  link;     /* for nxt_router_static_cache_t */
+} nxt_router_static_file_t;
+
+
+typedef struct {
+    nxt_str_t   extension;
+    nxt_str_t   type;
+} nxt_router_static_type_t;
+
+
+static nxt_int_t nxt_router_static_cache_test(nxt_lvlhsh_query_t *lhq,
+    void *data);
+static nxt_router_static_file_t *nxt_router_static_open(nxt_task_t *task,
+    nxt_router_static_cache_t *cache, nxt_str_t *name, nxt_msec_t valid);
+static void nxt_router_static_cache_evict(nxt_task_t *task,
+    nxt_router_static_cache_t *cache);
+static void nxt_router_static_cache_delete(nxt_router_static_cache_t *cache,
+    nxt_router_static_file_t *file);
+static void nxt_router_static_file_release(nxt_task_t *task, void *obj,
+    void *data);
+static nxt_int_t nxt_router_static_range(nxt_str_t *range, nxt_off_t size,
+    nxt_off_t *start, nxt_off_t *end);
+static nxt_str_t *nxt_router_static_type(nxt_str_t *path);
+
+
+static const nxt_lvlhsh_proto_t  nxt_router_static_cache_proto
+    nxt_aligned(64) =
+{
+    NXT_LVLHSH_DEFAULT,
+    nxt_router_static_cache_test,
+    nxt_lvlhsh_alloc,
+    nxt_lvlhsh_free,
+};
+
+
+static nxt_router_static_type_t  nxt_router_static_types[] = {
+    { nxt_string("html"), nxt_string("text/html") },
+    { nxt_string("htm"),  nxt_string("text/html") },
+    { nxt_string("css"),  nxt_string("text/css") },
+    { nxt_string("js"),   nxt_string("application/javascript") },
+    { nxt_string("json"), nxt_string("application/json") },
+    { nxt_string("txt"),  nxt_string("text/plain") },
+    { nxt_string("xml"),  nxt_string("text/xml") },
+    { nxt_string("svg"),  nxt_string("image/svg+xml") },
+    { nxt_string("png"),  nxt_string("image/png") },
+    { nxt_string("jpg"),  nxt_string("image/jpeg") },
+    { nxt_string("jpeg"), nxt_string("image/jpeg") },
+    { nxt_string("gif"),  nxt_string("image/gif") },
+    { nxt_string("ico"),  nxt_string("image/x-icon") },
+    { nxt_string("webp"), nxt_string("image/webp") },
+    { nxt_string("woff"), nxt_string("font/woff") },
+    { nxt_string("woff2"), nxt_string("font/woff2") },
+    { nxt_string("pdf"),  nxt_string("application/pdf") },
+    { nxt_string("zip"),  nxt_string("application/zip") },
+    { nxt_string("mp4"),  nxt_string("video/mp4") },
+};
+
+
+/*
+ * nxt_router_static_handler() returns NXT_OK and the response buffer chain
+ * if the request has been served from the share directory, NXT_DECLINED
+ * if the request should be passed to the application, or NXT_ERROR.
+ */
+
+nxt_int_t
+nxt_router_static_handler(nxt_task_t *task, nxt_conn_t *c,
+    nxt_app_parse_ctx_t *ap, nxt_buf_t **out)
+{
+    u_char                    *p;
+    size_t                    size;
+    nxt_mp_t                  *mp;
+    nxt_int_t                 ret;
+    nxt_str_t                 name, *type;
+    nxt_buf_t                 *header, *body, *last;
+    nxt_off_t                 start, end;
+    nxt_bool_t                head;
+    nxt_time_t                ims;
+    nxt_socket_conf_t         *skcf;
+    nxt_socket_conf_joint_t   *joint;
+    nxt_router_static_file_t  *file;
+    nxt_app_request_header_t  *h;
+
+    h = &ap->r.header;
+
+    head = nxt_str_eq(&h->method, "HEAD", 4);
+
+    if (!head && !nxt_str_eq(&h->method, "GET", 3)) {
+        return NXT_DECLINED;
+    }
+
+    if (h->path.length == 0
+        || h->path.start[0] != '/'
+        || h->path.start[h->path.length - 1] == '/'
+        || nxt_memchr(h->path.start, '\0', h->path.length) != NULL)
+    {
+        return NXT_DECLINED;
+    }
+
+    joint = c->listen->socket.data;
+    skcf = joint->socket_conf;
+    mp = c->mem_pool;
+
+    name.length = skcf->share.length + h->path.length;
+    name.start = nxt_mp_nget(mp, name.length + 1);
+    if (nxt_slow_path(name.start == NULL)) {
+        return NXT_ERROR;
+    }
+
+    p = nxt_cpymem(name.start, skcf->share.start, skcf->share.length);
+    p = nxt_cpymem(p, h->path.start, h->path.length);
+    *p = '\0';
+
+    file = nxt_router_static_open(task, &joint->static_cache, &name,
+                                  skcf->static_cache_valid);
+    if (nxt_slow_path(file == NULL)) {
+        return NXT_ERROR;
+    }
+
+    ret = nxt_mp_cleanup(mp, nxt_router_static_file_release,
+                         &task->thread->engine->task, file, NULL);
+    if (nxt_slow_path(ret != NXT_OK)) {
+        nxt_router_static_file_release(task, file, NULL);
+        return NXT_ERROR;
+    }
+
+    if (file->file.fd == NXT_FILE_INVALID) {
+        return NXT_DECLINED;
+    }
+
+    type = nxt_router_static_type(&h->path);
+
+    size = sizeof("HTTP/1.1 206 Partial Content\r\n") - 1
+           + sizeof("Content-Type: \r\n") - 1 + type->length
+           + sizeof("Content-Length: \r\n") - 1 + NXT_OFF_T_LEN
+           + sizeof("Content-Range: bytes -/\r\n") - 1 + 3 * NXT_OFF_T_LEN
+           + NXT_HTTP_FIELDS_LEN
+           + sizeof("Last-Modified: \r\n") - 1 + NXT_HTTP_DATE_LEN
+           + sizeof("Accept-Ranges: bytes\r\n") - 1
+           + sizeof("Connection: close\r\n\r\n") - 1;
+
+    header = nxt_buf_mem_alloc(mp, size, 0);
+    if (nxt_slow_path(header == NULL)) {
+        return NXT_ERROR;
+    }
+
+    last = nxt_buf_mem_alloc(mp, 0, 0);
+    if (nxt_slow_path(last == NULL)) {
+        return NXT_ERROR;
+    }
+
+    nxt_buf_set_sync(last);
+    nxt_buf_set_last(last);
+
+    p = header->mem.free;
+
+    if (h->if_modified_since.length != 0) {
+        ims = nxt_time_parse(h->if_modified_since.start,
+                             h->if_modified_since.length);
+
+        if (ims != -1 && ims >= file->file.mtime) {
+            p = nxt_cpymem(p, "HTTP/1.1 304 Not Modified\r\n",
+                           sizeof("HTTP/1.1 304 Not Modified\r\n") - 1);
+            p = nxt_http_fields_add(task, p, NXT_HTTP_FIELDS);
+            p = nxt_cpymem(p, "Last-Modified: ",
+                           sizeof("Last-Modified: ") - 1);
+            p = nxt_http_date(p, file->file.mtime);
+            p = nxt_cpymem(p, "\r\nConnection: close\r\n\r\n",
+                           sizeof("\r\nConnection: close\r\n\r\n") - 1);
+
+            header->mem.free = p;
+            header->next = last;
+
+            *out = header;
+
+            return NXT_OK;
+        }
+    }
+
+    start = 0;
+    end = file->file.size;
+
+    ret = NXT_DECLINED;
+
+    if (h->range.length != 0) {
+        ret = nxt_router_static_range(&h->range, file->file.size, &start, &end);
+    }
+
+    if (ret == NXT_ERROR) {
+        p = nxt_cpymem(p, "HTTP/1.1 416 Range Not Satisfiable\r\n",
+                       sizeof("HTTP/1.1 416 Range Not Satisfiable\r\n") - 1);
+        p = nxt_http_fields_add(task, p, NXT_HTTP_FIELDS);
+        p = nxt_sprintf(p, header->mem.end,
+                        "Content-Range: bytes */%O\r\n"
+                        "Content-Length: 0\r\n"
+                        "Connection: close\r\n\r\n",
+                        file->file.size);
+
+        header->mem.free = p;
+        header->next = last;
+
+        *out = header;
+
+        return NXT_OK;
+    }
+
+    if (ret == NXT_OK) {
+        p = nxt_cpymem(p, "HTTP/1.1 206 Partial Content\r\n",
+                       sizeof("HTTP/1.1 206 Partial Content\r\n") - 1);
+        p = nxt_http_fields_add(task, p, NXT_HTTP_FIELDS);
+        p = nxt_sprintf(p, header->mem.end,
+                        "Content-Range: bytes %O-%O/%O\r\n",
+                        start, end - 1, file->file.size);
+
+    } else {
+        p = nxt_cpymem(p, "HTTP/1.1 200 OK\r\n",
+                       sizeof("HTTP/1.1 200 OK\r\n") - 1);
+        p = nxt_http_fields_add(task, p, NXT_HTTP_FIELDS);
+    }
+
+    p = nxt_sprintf(p, header->mem.end,
+                    "Content-Type: %V\r\n"
+                    "Content-Length: %O\r\n"
+                    "Accept-Ranges: bytes\r\n"
+                    "Last-Modified: ",
+                    type, end - start);
+
+    p = nxt_http_date(p, file->file.mtime);
+    p = nxt_cpymem(p, "\r\nConnection: close\r\n\r\n",
+                   sizeof("\r\nConnection: close\r\n\r\n") - 1);
+
+    header->mem.free = p;
+
+    if (head || start == end) {
+        header->next = last;
+
+        *out = header;
+
+        return NXT_OK;
+    }
+
+    body = nxt_buf_file_alloc(mp, 0, 0);
+    if (nxt_slow_path(body == NULL)) {
+        return NXT_ERROR;
+    }
+
+    body->file = &file->file;
+    body->file_pos = start;
+    body->file_end = end;
+
+    header->next = body;
+    body->next = last;
+
+    *out = header;
+
+    return NXT_OK;
+}
+
+
+void
+nxt_router_static_cache_free(nxt_task_t *task,
+    nxt_router_static_cache_t *cache)
+{
+    nxt_lvlhsh_each_t         lhe;
+    nxt_router_static_file_t  *file;
+
+    for ( ;; ) {
+        nxt_memzero(&lhe, sizeof(nxt_lvlhsh_each_t));
+        lhe.proto = &nxt_router_static_cache_proto;
+
+        file = nxt_lvlhsh_each(&cache->hash, &lhe);
+
+        if (file == NULL) {
+            break;
+        }
+
+        nxt_router_static_cache_delete(cache, file);
+        nxt_router_static_file_release(task, file, NULL);
+    }
+}
+
+
+static nxt_int_t
+nxt_router_static_cache_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    nxt_router_static_file_t  *file;
+
+    file = data;
+
+    if (nxt_strstr_eq(&lhq->key, &file->name)) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static nxt_router_static_file_t *
+nxt_router_static_open(nxt_task_t *task, nxt_router_static_cache_t *cache,
+    nxt_str_t *name, nxt_msec_t valid)
+{
+    nxt_int_t                 ret;
+    nxt_msec_t                now;
+    nxt_file_info_t           fi;
+    nxt_lvlhsh_query_t        lhq;
+    nxt_router_static_file_t  *file;
+
+    now = task->thread->engine->timers.now;
+
+    lhq.key_hash = nxt_djb_hash(name->start, name->length);
+    lhq.key = *name;
+    lhq.proto = &nxt_router_static_cache_proto;
+
+    if (nxt_lvlhsh_find(&cache->hash, &lhq) == NXT_OK) {
+        file = lhq.value;
+
+        if ((nxt_msec_int_t) (file->expires - now) > 0) {
+            nxt_debug(task, "static cache hit \"%V\"", name);
+
+            nxt_queue_remove(&file->link);
+            nxt_queue_insert_head(&cache->expiry_queue, &file->link);
+
+            file->count++;
+            return file;
+        }
+
+        nxt_router_static_cache_delete(cache, file);
+        nxt_router_static_file_release(task, file, NULL);
+    }
+
+    file = nxt_zalloc(sizeof(nxt_router_static_file_t) + name->length + 1);
+    if (nxt_slow_path(file == NULL)) {
+        return NULL;
+    }
+
+    file->name.length = name->length;
+    file->name.start = (u_char *) file + sizeof(nxt_router_static_file_t);
+    nxt_memcpy(file->name.start, name->start, name->length + 1);
+
+    file->file.name = file->name.start;
+    file->count = 1;
+
+    ret = nxt_file_open(task, &file->file, NXT_FILE_RDONLY, NXT_FILE_OPEN, 0);
+
+    if (ret == NXT_OK) {
+        ret = nxt_file_info(&file->file, &fi);
+
+        if (nxt_fast_path(ret == NXT_OK && nxt_is_file(&fi))) {
+            file->file.type = NXT_FILE_REGULAR;
+            file->file.size = nxt_file_size(&fi);
+            file->file.mtime = nxt_file_mtime(&fi);
+
+        } else {
+            nxt_file_close(task, &file->file);
+            file->file.fd = NXT_FILE_INVALID;
+        }
+    }
+
+    if (valid != 0) {
+        if (cache->entries >= NXT_ROUTER_STATIC_CACHE_MAX) {
+            nxt_router_static_cache_evict(task, cache);
+        }
+
+        lhq.replace = 0;
+        lhq.value = file;
+        lhq.key = file->name;
+        lhq.pool = NULL;
+
+        if (nxt_lvlhsh_insert(&cache->hash, &lhq) == NXT_OK) {
+            file->expires = now + valid;
+            file->cached = 1;
+            file->count++;
+
+            nxt_queue_insert_head(&cache->expiry_queue, &file->link);
+            cache->entries++;
+        }
+    }
+
+    return file;
+}
+
+
+/*
+ * The file is closed when the requests which still send it release it,
+ * so any entry can be evicted.
+ */
+
+static void
+nxt_router_static_cache_evict(nxt_task_t *task,
+    nxt_router_static_cache_t *cache)
+{
+    nxt_queue_link_t          *link;
+    nxt_router_static_file_t  *file;
+
+    link = nxt_queue_last(&cache->expiry_queue);
+    file = nxt_queue_link_data(link, nxt_router_static_file_t, link);
+
+    nxt_debug(task, "static cache evict \"%V\"", &file->name);
+
+    nxt_router_static_cache_delete(cache, file);
+    nxt_router_static_file_release(task, file, NULL);
+}
+
+
+static void
+nxt_router_static_cache_delete(nxt_router_static_cache_t *cache,
+    nxt_router_static_file_t *file)
+{
+    nxt_lvlhsh_query_t  lhq;
+
+    lhq.key_hash = nxt_djb_hash(file->name.start, file->name.length);
+    lhq.key = file->name;
+    lhq.proto = &nxt_router_static_cache_proto;
+    lhq.pool = NULL;
+
+    if (nxt_lvlhsh_delete(&cache->hash, &lhq) == NXT_OK) {
+        nxt_queue_remove(&file->link);
+
+        file->cached = 0;
+        cache->entries--;
+    }
+}
+
+
+static void
+nxt_router_static_file_release(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_router_static_file_t  *file;
+
+    file = obj;
+
+    if (--file->count != 0) {
+        return;
+    }
+
+    if (file->file.fd != NXT_FILE_INVALID) {
+        nxt_file_close(task, &file->file);
+    }
+
+    nxt_free(file);
+}
+
+
+/*
+ * Only a single "bytes=" range is supported.  The function returns NXT_OK
+ * and the [start, end) range, NXT_ERROR if the range is not satisfiable,
+ * or NXT_DECLINED if the Range header should be ignored.
+ */
+
+static nxt_int_t
+nxt_router_static_range(nxt_str_t *range, nxt_off_t size, nxt_off_t *start,
+    nxt_off_t *end)
+{
+    u_char     *p, *e, *dash;
+    nxt_off_t  from, to;
+
+    p = range->start;
+    e = p + range->length;
+
+    if (range->length <= 6 || nxt_memcmp(p, "bytes=", 6) != 0) {
+        return NXT_DECLINED;
+    }
+
+    p += 6;
+
+    if (nxt_memchr(p, ',', e - p) != NULL) {
+        return NXT_DECLINED;
+    }
+
+    dash = nxt_memchr(p, '-', e - p);
+    if (dash == NULL) {
+        return NXT_DECLINED;
+    }
+
+    if (dash == p) {
+        /* The suffix range "bytes=-N". */
+
+        to = nxt_off_t_parse(dash + 1, e - dash - 1);
+        if (to <= 0) {
+            return (to == 0) ? NXT_ERROR : NXT_DECLINED;
+        }
+
+        *start = (to < size) ? size - to : 0;
+        *end = size;
+
+        return (size != 0) ? NXT_OK : NXT_ERROR;
+    }
+
+    from = nxt_off_t_parse(p, dash - p);
+    if (from < 0) {
+        return NXT_DECLINED;
+    }
+
+    if (dash + 1 == e) {
+        to = size - 1;
+
+    } else {
+        to = nxt_off_t_parse(dash + 1, e - dash - 1);
+        if (to < 0 || to < from) {
+            return NXT_DECLINED;
+        }
+    }
+
+    if (from >= size) {
+        return NXT_ERROR;
+    }
+
+    *start = from;
+    *end = nxt_min(to, size - 1) + 1;
+
+    return NXT_OK;
+}
+
+
+static nxt_str_t *
+nxt_router_static_type(nxt_str_t *path)
+{
+    u_char     *p, *end;
+    nxt_str_t  extension;
+    nxt_uint_t  i;
+
+    static nxt_str_t  default_type = nxt_string("application/octet-stream");
+
+    end = path->start + path->length;
+
+    for (p = end; p > path->start; p--) {
+        if (p[-1] == '.') {
+            break;
+        }
+
+        if (p[-1] == '/') {
+            return &default_type;
+        }
+    }
+
+    if (p == path->start) {
+        return &default_type;
+    }
+
+    extension.start = p;
+    extension.length = end - p;
+
+    for (i = 0; i < nxt_nitems(nxt_router_static_types); i++) {
+        if (nxt_strcasestr_eq(&extension,
+                              &nxt_router_static_types[i].extension))
+        {
+            return &nxt_router_static_types[i].type;
+        }
+    }
+
+    return &default_type;
+}
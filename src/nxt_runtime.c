@@ -560,6 +560,8 @@ nxt_runtime_exit(nxt_task_t *task, void *obj, void *data)
 
     nxt_debug(task, "exit");
 
+    nxt_log_writer_stop();
+
     exit(0);
     nxt_unreachable();
 }
@@ -705,7 +707,7 @@ static nxt_int_t
 nxt_runtime_conf_init(nxt_task_t *task, nxt_runtime_t *rt)
 {
     nxt_int_t                    ret;
-    nxt_str_t                    control;
+    nxt_str_t                    control, name;
     nxt_uint_t                   n;
     nxt_file_t                   *file;
     const char                   *slash;
@@ -756,6 +758,16 @@ nxt_runtime_conf_init(nxt_task_t *task, nxt_runtime_t *rt)
     file = nxt_list_first(rt->log_files);
     file->name = file_name.start;
 
+    if (rt->access_log != NULL) {
+        name.length = nxt_strlen(rt->access_log);
+        name.start = (u_char *) rt->access_log;
+
+        rt->access_log_file = nxt_runtime_log_file_add(rt, &name);
+        if (nxt_slow_path(rt->access_log_file == NULL)) {
+            return NXT_ERROR;
+        }
+    }
+
     slash = "";
     n = nxt_strlen(rt->modules);
 
@@ -806,6 +818,14 @@ nxt_runtime_conf_read_cmd(nxt_task_t *task, nxt_runtime_t *rt)
     static const char  no_group[] = "option \"--group\" requires group name\n";
     static const char  no_pid[] = "option \"--pid\" requires filename\n";
     static const char  no_log[] = "option \"--log\" requires filename\n";
+    static const char  no_access_log[] =
+                       "option \"--access-log\" requires filename\n";
+    static const char  no_access_log_format[] =
+                       "option \"--access-log-format\" requires \"text\" "
+                       "or \"json\"\n";
+    static const char  no_log_overflow[] =
+                       "option \"--log-overflow\" requires \"block\" "
+                       "or \"drop\"\n";
     static const char  no_modules[] =
                        "option \"--modules\" requires directory\n";
 
@@ -826,6 +846,16 @@ nxt_runtime_conf_read_cmd(nxt_task_t *task, nxt_runtime_t *rt)
         "  --log FILE           set log filename\n"
         "                       default: \"" NXT_LOG "\"\n"
         "\n"
+        "  --access-log FILE    set router access log filename\n"
+        "\n"
+        "  --access-log-format FORMAT\n"
+        "                       set access log format, \"text\" or \"json\"\n"
+        "                       default: \"text\"\n"
+        "\n"
+        "  --log-overflow MODE  set router behaviour on log buffer overflow,\n"
+        "                       \"block\" or \"drop\"\n"
+        "                       default: \"block\"\n"
+        "\n"
         "  --modules DIRECTORY  set modules directory name\n"
         "                       default: \"" NXT_MODULES "\"\n"
         "\n"
@@ -925,6 +955,59 @@ nxt_runtime_conf_read_cmd(nxt_task_t *task, nxt_runtime_t *rt)
             continue;
         }
 
+        if (nxt_strcmp(p, "--access-log") == 0) {
+            if (*argv == NULL) {
+                write(STDERR_FILENO, no_access_log, sizeof(no_access_log) - 1);
+                return NXT_ERROR;
+            }
+
+            p = *argv++;
+
+            rt->access_log = p;
+
+            continue;
+        }
+
+        if (nxt_strcmp(p, "--access-log-format") == 0) {
+            p = *argv;
+
+            if (p != NULL && nxt_strcmp(p, "text") == 0) {
+                rt->access_log_format = NXT_ACCESS_LOG_TEXT;
+
+            } else if (p != NULL && nxt_strcmp(p, "json") == 0) {
+                rt->access_log_format = NXT_ACCESS_LOG_JSON;
+
+            } else {
+                write(STDERR_FILENO, no_access_log_format,
+                      sizeof(no_access_log_format) - 1);
+                return NXT_ERROR;
+            }
+
+            argv++;
+
+            continue;
+        }
+
+        if (nxt_strcmp(p, "--log-overflow") == 0) {
+            p = *argv;
+
+            if (p != NULL && nxt_strcmp(p, "block") == 0) {
+                rt->log_overflow = NXT_LOG_OVERFLOW_BLOCK;
+
+            } else if (p != NULL && nxt_strcmp(p, "drop") == 0) {
+                rt->log_overflow = NXT_LOG_OVERFLOW_DROP;
+
+            } else {
+                write(STDERR_FILENO, no_log_overflow,
+                      sizeof(no_log_overflow) - 1);
+                return NXT_ERROR;
+            }
+
+            argv++;
+
+            continue;
+        }
+
         if (nxt_strcmp(p, "--modules") == 0) {
             if (*argv == NULL) {
                 write(STDERR_FILENO, no_modules, sizeof(no_modules) - 1);
@@ -1340,7 +1423,7 @@ nxt_runtime_log_file_add(nxt_runtime_t *rt, nxt_str_t *name)
     nxt_file_t           *file;
     nxt_file_name_str_t  file_name;
 
-    ret = nxt_file_name_create(rt->mem_pool, &file_name, "V%Z", name);
+    ret = nxt_file_name_create(rt->mem_pool, &file_name, "%V%Z", name);
 
     if (nxt_slow_path(ret != NXT_OK)) {
         return NULL;
@@ -40,6 +40,7 @@ struct nxt_runtime_s {
     nxt_lvlhsh_t           ports;               /* of nxt_port_t */
 
     nxt_list_t             *log_files;          /* of nxt_file_t */
+    nxt_file_t             *access_log_file;
 
     uint32_t               last_engine_id;
 
@@ -50,6 +51,8 @@ struct nxt_runtime_s {
     uint8_t                daemon;
     uint8_t                batch;
     uint8_t                main_process;
+    uint8_t                log_overflow;        /* nxt_log_overflow_t */
+    uint8_t                access_log_format;   /* nxt_access_log_format_t */
     const char             *engine;
     uint32_t               engine_connections;
     uint32_t               auxiliary_threads;
@@ -57,6 +60,7 @@ struct nxt_runtime_s {
     const char             *group;
     const char             *pid;
     const char             *log;
+    const char             *access_log;
     const char             *modules;
     const char             *control;
 
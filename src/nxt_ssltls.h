@@ -23,12 +23,29 @@
 #define NXT_SSLTLS_BUFFER_SIZE    4096
 
 
+/*
+ * The latency matters mostly at the start of a response when a client
+ * waits for the first bytes and TCP congestion window is still small,
+ * so a connection starts with 1369-bytes records which fit along with
+ * up to 59-bytes overhead in one 1500-bytes MTU TCP/IPv6 packet with
+ * timestamps.  After NXT_SSLTLS_RECORD_BOOST bytes have been sent the
+ * records grow up to the buffer size to decrease the overhead of bulk
+ * transfers.  An idle connection starts again with small records since
+ * the congestion window may be restarted by the kernel.
+ */
+
+#define NXT_SSLTLS_RECORD_SMALL   1369
+#define NXT_SSLTLS_RECORD_BOOST   (1024 * 1024)
+#define NXT_SSLTLS_RECORD_IDLE    1000  /* msec */
+
+
 typedef struct nxt_ssltls_conf_s  nxt_ssltls_conf_t;
 
 
 typedef struct {
     nxt_int_t                     (*server_init)(nxt_ssltls_conf_t *conf);
     nxt_int_t                     (*set_versions)(nxt_ssltls_conf_t *conf);
+    void                          (*server_free)(nxt_ssltls_conf_t *conf);
 } nxt_ssltls_lib_t;
 
 
@@ -45,7 +62,16 @@ struct nxt_ssltls_conf_s {
 
     char                          *ca_certificate;
 
+    /* A PEM certificate chain followed by a private key. */
+    nxt_str_t                     bundle;
+    /* A session ID context to separate cached sessions of listeners. */
+    nxt_str_t                     name;
+
     size_t                        buffer_size;
+
+    size_t                        session_cache;
+    uint32_t                      session_timeout;    /* seconds */
+    uint8_t                       session_tickets;    /* 1 bit */
 };
 
 
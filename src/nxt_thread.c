@@ -202,8 +202,18 @@ nxt_thread_exit(nxt_thread_t *thr)
         nxt_event_engine_post(engine, &link->work);
     }
 
+    if (thr->mp_cache != NULL) {
+        nxt_mp_cache_free(thr->mp_cache);
+        thr->mp_cache = NULL;
+    }
+
     nxt_thread_time_free(thr);
 
+    if (thr->log_ring != NULL) {
+        nxt_log_ring_release(thr->log_ring);
+        thr->log_ring = NULL;
+    }
+
     pthread_exit(NULL);
     nxt_unreachable();
 }
@@ -152,6 +152,10 @@ struct nxt_thread_s {
     nxt_thread_handle_t      handle;
     nxt_thread_link_t        *link;
     nxt_thread_pool_t        *thread_pool;
+    nxt_thread_pool_worker_t *thread_pool_worker;
+
+    nxt_mp_cache_t           *mp_cache;
+    nxt_log_ring_t           *log_ring;
 
     nxt_thread_time_t        time;
 
@@ -7,11 +7,71 @@
 #include <nxt_main.h>
 
 
+/*
+ * Works are posted to the lock-free pool queue.  A worker thread takes
+ * the whole queue at once to its own local queue and idle workers steal
+ * halves of other local queues, so a burst of posts is spread among
+ * the workers without a global lock.  A sleeping worker is woken up only
+ * when works are posted to the empty pool queue or when a worker has
+ * more works than it can run itself.
+ *
+ * Completions posted by a worker with nxt_thread_pool_return() are
+ * collected and posted to an event engine at once when the worker runs
+ * out of local works.
+ */
+
+
+#define NXT_THREAD_POOL_BATCH  16
+
+
+struct nxt_thread_pool_worker_s {
+    nxt_thread_spinlock_t     lock;
+    nxt_work_t                *head;
+    nxt_work_t                *tail;
+
+    /* The number is read by other workers without the lock. */
+    volatile nxt_uint_t       count;
+
+    nxt_atomic_t              active;
+
+    nxt_event_engine_t        *engine;
+    nxt_work_t                *done_head;
+    nxt_work_t                *done_tail;
+    nxt_uint_t                done;
+
+    nxt_uint_t                runs;
+    nxt_uint_t                steals;
+    nxt_uint_t                batches;
+    nxt_nsec_t                wait_time;
+    nxt_nsec_t                max_wait_time;
+} nxt_aligned(64);
+
+
 static nxt_int_t nxt_thread_pool_init(nxt_thread_pool_t *tp);
+static void nxt_thread_pool_inject(nxt_thread_pool_t *tp, nxt_work_t *head,
+    nxt_work_t *tail, nxt_uint_t n);
 static void nxt_thread_pool_exit(nxt_task_t *task, void *obj, void *data);
 static void nxt_thread_pool_start(void *ctx);
 static void nxt_thread_pool_loop(void *ctx);
-static void nxt_thread_pool_wait(nxt_thread_pool_t *tp);
+static nxt_work_t *nxt_thread_pool_next(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
+static nxt_uint_t nxt_thread_pool_take(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
+static nxt_uint_t nxt_thread_pool_steal(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
+static void nxt_thread_pool_wait(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
+static void nxt_thread_pool_wake(nxt_thread_pool_t *tp);
+static void nxt_thread_pool_spawn(nxt_thread_pool_t *tp);
+static nxt_thread_pool_worker_t *nxt_thread_pool_worker(nxt_thread_pool_t *tp);
+static void nxt_thread_pool_worker_add(nxt_thread_pool_worker_t *worker,
+    nxt_work_t *head, nxt_work_t *tail, nxt_uint_t n);
+static nxt_work_t *nxt_thread_pool_worker_pop(
+    nxt_thread_pool_worker_t *worker);
+static void nxt_thread_pool_worker_exit(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker);
+static void nxt_thread_pool_flush(nxt_thread_pool_worker_t *worker);
+static nxt_nsec_t nxt_thread_pool_time(void);
 
 
 nxt_thread_pool_t *
@@ -19,15 +79,26 @@ nxt_thread_pool_create(nxt_uint_t max_threads, nxt_nsec_t timeout,
     nxt_thread_pool_init_t init, nxt_event_engine_t *engine,
     nxt_work_handler_t exit)
 {
+    size_t             size;
+    nxt_uint_t         n;
     nxt_thread_pool_t  *tp;
 
-    tp = nxt_zalloc(sizeof(nxt_thread_pool_t));
+    /* Workers follow the pool, so the pool is freed by a single nxt_free(). */
+
+    size = (sizeof(nxt_thread_pool_t) + 63) & ~((size_t) 63);
+    n = nxt_max(max_threads, 1);
+
+    tp = nxt_memalign(64, size + n * sizeof(nxt_thread_pool_worker_t));
     if (tp == NULL) {
         return NULL;
     }
 
+    nxt_memzero(tp, size + n * sizeof(nxt_thread_pool_worker_t));
+
     tp->max_threads = max_threads;
     tp->timeout = timeout;
+    tp->nworkers = n;
+    tp->workers = (nxt_thread_pool_worker_t *) ((u_char *) tp + size);
     tp->engine = engine;
     tp->task.thread = engine->task.thread;
     tp->task.log = engine->task.log;
@@ -47,14 +118,120 @@ nxt_thread_pool_post(nxt_thread_pool_t *tp, nxt_work_t *work)
         return NXT_ERROR;
     }
 
-    nxt_locked_work_queue_add(&tp->work_queue, work);
+    nxt_thread_pool_inject(tp, work, work, 1);
+
+    return NXT_OK;
+}
+
+
+/*
+ * An event engine collects works to a batch which is posted at once
+ * when the engine runs out of works.  The pool is initialized on adding,
+ * so a caller can handle the failure immediately.
+ */
+
+nxt_int_t
+nxt_thread_pool_batch_add(nxt_thread_pool_batch_t *batch,
+    nxt_thread_pool_t *tp, nxt_work_t *work)
+{
+    if (nxt_slow_path(nxt_thread_pool_init(tp) != NXT_OK)) {
+        return NXT_ERROR;
+    }
+
+    if (batch->thread_pool != tp) {
+        nxt_thread_pool_batch_post(batch);
+        batch->thread_pool = tp;
+    }
+
+    work->next = batch->head;
+    batch->head = work;
+
+    if (batch->tail == NULL) {
+        batch->tail = work;
+    }
 
-    (void) nxt_sem_post(&tp->sem);
+    batch->count++;
 
     return NXT_OK;
 }
 
 
+void
+nxt_thread_pool_batch_post(nxt_thread_pool_batch_t *batch)
+{
+    if (batch->head != NULL) {
+        nxt_thread_log_debug("thread pool batch post: %ui", batch->count);
+
+        nxt_thread_pool_inject(batch->thread_pool, batch->head, batch->tail,
+                               batch->count);
+
+        batch->head = NULL;
+        batch->tail = NULL;
+        batch->count = 0;
+    }
+}
+
+
+static void
+nxt_thread_pool_inject(nxt_thread_pool_t *tp, nxt_work_t *head,
+    nxt_work_t *tail, nxt_uint_t n)
+{
+    (void) nxt_atomic_fetch_add(&tp->posted, n);
+
+    /*
+     * Works posted to a non-empty queue do not require a wakeup: either
+     * a worker has been woken up for the first works or all workers are
+     * busy and will check the queue before sleeping.  The full barrier
+     * of the atomic add pairs with the one in nxt_thread_pool_wait().
+     */
+
+    if (nxt_atomic_work_queue_add_list(&tp->work_queue, head, tail)) {
+        tp->post_time = nxt_thread_pool_time();
+
+        if (tp->waiting != 0) {
+            (void) nxt_sem_post(&tp->sem);
+        }
+    }
+}
+
+
+/*
+ * A completion is posted to an event engine by a worker thread
+ * together with other completions to the same engine.
+ */
+
+void
+nxt_thread_pool_return(nxt_event_engine_t *engine, nxt_work_t *work)
+{
+    nxt_thread_t              *thr;
+    nxt_thread_pool_worker_t  *worker;
+
+    thr = nxt_thread();
+    worker = thr->thread_pool_worker;
+
+    if (worker == NULL) {
+        nxt_event_engine_post(engine, work);
+        return;
+    }
+
+    if (worker->engine != engine) {
+        nxt_thread_pool_flush(worker);
+        worker->engine = engine;
+    }
+
+    work->next = worker->done_head;
+    worker->done_head = work;
+
+    if (worker->done_tail == NULL) {
+        worker->done_tail = work;
+    }
+
+    if (++worker->done == NXT_THREAD_POOL_BATCH) {
+        nxt_thread_pool_flush(worker);
+    }
+}
+
+
 static nxt_int_t
 nxt_thread_pool_init(nxt_thread_pool_t *tp)
 {
@@ -71,7 +248,7 @@ nxt_thread_pool_init(nxt_thread_pool_t *tp)
         return NXT_ERROR;
     }
 
-    nxt_thread_spin_lock(&tp->work_queue.lock);
+    nxt_thread_spin_lock(&tp->lock);
 
     ret = NXT_OK;
 
@@ -105,7 +282,7 @@ nxt_thread_pool_init(nxt_thread_pool_t *tp)
 
 done:
 
-    nxt_thread_spin_unlock(&tp->work_queue.lock);
+    nxt_thread_spin_unlock(&tp->lock);
 
     return ret;
 }
@@ -130,46 +307,195 @@ nxt_thread_pool_start(void *ctx)
 static void
 nxt_thread_pool_loop(void *ctx)
 {
-    void                *obj, *data;
-    nxt_task_t          *task;
-    nxt_thread_t        *thr;
-    nxt_thread_pool_t   *tp;
-    nxt_work_handler_t  handler;
+    void                      *obj, *data;
+    nxt_task_t                *task;
+    nxt_work_t                *work;
+    nxt_thread_t              *thr;
+    nxt_thread_pool_t         *tp;
+    nxt_work_handler_t        handler;
+    nxt_thread_pool_worker_t  *worker;
 
     tp = ctx;
     thr = nxt_thread();
 
+    worker = nxt_thread_pool_worker(tp);
+
+    if (nxt_slow_path(worker == NULL)) {
+        nxt_log_alert(thr->log, "thread pool has no free workers");
+
+        (void) nxt_atomic_fetch_add(&tp->threads, -1);
+
+        nxt_thread_exit(thr);
+        nxt_unreachable();
+    }
+
+    thr->thread_pool = tp;
+    thr->thread_pool_worker = worker;
+
     if (tp->init != NULL) {
         tp->init();
     }
 
     for ( ;; ) {
-        nxt_thread_pool_wait(tp);
+        work = nxt_thread_pool_next(tp, worker);
 
-        handler = nxt_locked_work_queue_pop(&tp->work_queue, &task, &obj,
-                                            &data);
+        task = work->task;
 
-        if (nxt_fast_path(handler != NULL)) {
-            task->thread = thr;
+        obj = work->obj;
+        nxt_prefetch(obj);
 
-            nxt_log_debug(thr->log, "locked work queue");
+        data = work->data;
+        nxt_prefetch(data);
 
-            handler(task, obj, data);
-        }
+        handler = work->handler;
+
+        worker->runs++;
+
+        task->thread = thr;
+
+        nxt_log_debug(thr->log, "thread pool work");
+
+        handler(task, obj, data);
 
         thr->log = &nxt_main_log;
     }
 }
 
 
+static nxt_work_t *
+nxt_thread_pool_next(nxt_thread_pool_t *tp, nxt_thread_pool_worker_t *worker)
+{
+    nxt_work_t  *work;
+
+    for ( ;; ) {
+        work = nxt_thread_pool_worker_pop(worker);
+
+        if (work != NULL) {
+            return work;
+        }
+
+        nxt_thread_pool_flush(worker);
+
+        if (nxt_thread_pool_take(tp, worker) == 0
+            && nxt_thread_pool_steal(tp, worker) == 0)
+        {
+            nxt_thread_pool_wait(tp, worker);
+        }
+
+        if (worker->count > 1) {
+            /* Let another worker steal a part of the works. */
+            nxt_thread_pool_wake(tp);
+        }
+    }
+}
+
+
+static nxt_uint_t
+nxt_thread_pool_take(nxt_thread_pool_t *tp, nxt_thread_pool_worker_t *worker)
+{
+    nxt_uint_t  n;
+    nxt_nsec_t  now, wait, posted;
+    nxt_work_t  *head, *tail;
+
+    if (nxt_atomic_work_queue_is_empty(&tp->work_queue)) {
+        return 0;
+    }
+
+    head = nxt_atomic_work_queue_take(&tp->work_queue);
+
+    if (head == NULL) {
+        return 0;
+    }
+
+    n = 1;
+
+    for (tail = head; tail->next != NULL; tail = tail->next) {
+        n++;
+    }
+
+    /*
+     * The post time is stale if the first work of the batch has been
+     * posted but the time has not been set yet.
+     */
+
+    now = nxt_thread_pool_time();
+
+    posted = tp->post_time;
+    wait = (posted > tp->take_time && now > posted) ? now - posted : 0;
+    tp->take_time = now;
+
+    worker->batches++;
+    worker->wait_time += wait;
+
+    if (worker->max_wait_time < wait) {
+        worker->max_wait_time = wait;
+    }
+
+    nxt_thread_pool_worker_add(worker, head, tail, n);
+
+    return n;
+}
+
+
+static nxt_uint_t
+nxt_thread_pool_steal(nxt_thread_pool_t *tp, nxt_thread_pool_worker_t *worker)
+{
+    nxt_uint_t                i, j, k, n;
+    nxt_work_t                *head, *tail;
+    nxt_thread_pool_worker_t  *victim;
+
+    i = worker - tp->workers;
+
+    for (k = 1; k < tp->nworkers; k++) {
+        victim = &tp->workers[(i + k) % tp->nworkers];
+
+        if (victim->count == 0 || !nxt_thread_spin_trylock(&victim->lock)) {
+            continue;
+        }
+
+        n = (victim->count + 1) / 2;
+
+        if (n == 0) {
+            nxt_thread_spin_unlock(&victim->lock);
+            continue;
+        }
+
+        head = victim->head;
+        tail = head;
+
+        for (j = 1; j < n; j++) {
+            tail = tail->next;
+        }
+
+        victim->head = tail->next;
+
+        if (victim->head == NULL) {
+            victim->tail = NULL;
+        }
+
+        victim->count -= n;
+
+        nxt_thread_spin_unlock(&victim->lock);
+
+        tail->next = NULL;
+
+        nxt_thread_pool_worker_add(worker, head, tail, n);
+
+        worker->steals++;
+
+        return n;
+    }
+
+    return 0;
+}
+
+
 static void
-nxt_thread_pool_wait(nxt_thread_pool_t *tp)
+nxt_thread_pool_wait(nxt_thread_pool_t *tp, nxt_thread_pool_worker_t *worker)
 {
-    nxt_err_t            err;
-    nxt_thread_t         *thr;
-    nxt_atomic_uint_t    waiting, threads;
-    nxt_thread_link_t    *link;
-    nxt_thread_handle_t  handle;
+    nxt_err_t          err;
+    nxt_thread_t       *thr;
+    nxt_atomic_uint_t  waiting;
 
     thr = nxt_thread();
 
@@ -178,32 +504,73 @@ nxt_thread_pool_wait(nxt_thread_pool_t *tp)
     (void) nxt_atomic_fetch_add(&tp->waiting, 1);
 
     for ( ;; ) {
+        /*
+         * Works added before the waiting counter has been incremented
+         * are found here, later works are followed by a semaphore post.
+         */
+
+        if (nxt_thread_pool_take(tp, worker) != 0
+            || nxt_thread_pool_steal(tp, worker) != 0)
+        {
+            break;
+        }
+
         err = nxt_sem_wait(&tp->sem, tp->timeout);
 
         if (err == 0) {
-            waiting = nxt_atomic_fetch_add(&tp->waiting, -1);
-            break;
+            continue;
         }
 
         if (err == NXT_ETIMEDOUT) {
-            if (nxt_thread_handle_equal(thr->handle, tp->main)) {
+            if (nxt_thread_handle_equal(thr->handle, tp->main)
+                || nxt_thread_pool_has_works(tp))
+            {
                 continue;
             }
         }
 
         (void) nxt_atomic_fetch_add(&tp->waiting, -1);
+
+        nxt_thread_pool_worker_exit(tp, worker);
+
         (void) nxt_atomic_fetch_add(&tp->threads, -1);
 
         nxt_thread_exit(thr);
         nxt_unreachable();
     }
 
+    waiting = nxt_atomic_fetch_add(&tp->waiting, -1);
+
     nxt_log_debug(thr->log, "thread pool awake, waiting: %A", waiting);
 
-    if (waiting > 1) {
+    if (waiting == 1) {
+        /* Keep a spare thread while the last idle thread is busy. */
+        nxt_thread_pool_spawn(tp);
+    }
+}
+
+
+static void
+nxt_thread_pool_wake(nxt_thread_pool_t *tp)
+{
+    /* The atomic operation is a full barrier after the works are added. */
+
+    if (nxt_atomic_fetch_add(&tp->waiting, 0) != 0) {
+        (void) nxt_sem_post(&tp->sem);
         return;
     }
 
+    nxt_thread_pool_spawn(tp);
+}
+
+
+static void
+nxt_thread_pool_spawn(nxt_thread_pool_t *tp)
+{
+    nxt_atomic_uint_t    threads;
+    nxt_thread_link_t    *link;
+    nxt_thread_handle_t  handle;
+
     do {
         threads = tp->threads;
 
@@ -219,10 +586,199 @@ nxt_thread_pool_wait(nxt_thread_pool_t *tp)
         link->start = nxt_thread_pool_loop;
         link->work.data = tp;
 
-        if (nxt_thread_create(&handle, link) != NXT_OK) {
-            (void) nxt_atomic_fetch_add(&tp->threads, -1);
+        if (nxt_thread_create(&handle, link) == NXT_OK) {
+            return;
         }
     }
+
+    (void) nxt_atomic_fetch_add(&tp->threads, -1);
+}
+
+
+/*
+ * A worker slot is released before the threads number is decremented,
+ * so a new thread always finds a free slot.
+ */
+
+static nxt_thread_pool_worker_t *
+nxt_thread_pool_worker(nxt_thread_pool_t *tp)
+{
+    nxt_uint_t                i;
+    nxt_thread_pool_worker_t  *worker;
+
+    for (i = 0; i < tp->nworkers; i++) {
+        worker = &tp->workers[i];
+
+        if (worker->active == 0 && nxt_atomic_cmp_set(&worker->active, 0, 1)) {
+            return worker;
+        }
+    }
+
+    return NULL;
+}
+
+
+static void
+nxt_thread_pool_worker_add(nxt_thread_pool_worker_t *worker, nxt_work_t *head,
+    nxt_work_t *tail, nxt_uint_t n)
+{
+    nxt_thread_spin_lock(&worker->lock);
+
+    if (worker->tail != NULL) {
+        worker->tail->next = head;
+
+    } else {
+        worker->head = head;
+    }
+
+    worker->tail = tail;
+    worker->count += n;
+
+    nxt_thread_spin_unlock(&worker->lock);
+}
+
+
+static nxt_work_t *
+nxt_thread_pool_worker_pop(nxt_thread_pool_worker_t *worker)
+{
+    nxt_work_t  *work;
+
+    /* Only the worker itself adds works to its queue. */
+
+    if (worker->count == 0) {
+        return NULL;
+    }
+
+    nxt_thread_spin_lock(&worker->lock);
+
+    work = worker->head;
+
+    if (work != NULL) {
+        worker->head = work->next;
+
+        if (worker->head == NULL) {
+            worker->tail = NULL;
+        }
+
+        worker->count--;
+    }
+
+    nxt_thread_spin_unlock(&worker->lock);
+
+    return work;
+}
+
+
+static void
+nxt_thread_pool_worker_exit(nxt_thread_pool_t *tp,
+    nxt_thread_pool_worker_t *worker)
+{
+    nxt_work_t  *work, *next, *prev, *tail;
+
+    nxt_thread_pool_flush(worker);
+
+    nxt_thread_spin_lock(&worker->lock);
+
+    work = worker->head;
+
+    worker->head = NULL;
+    worker->tail = NULL;
+    worker->count = 0;
+
+    nxt_thread_spin_unlock(&worker->lock);
+
+    if (work != NULL) {
+        /* The remaining works are returned to the pool queue. */
+
+        tail = work;
+        prev = NULL;
+
+        while (work != NULL) {
+            next = work->next;
+            work->next = prev;
+            prev = work;
+            work = next;
+        }
+
+        nxt_thread_pool_inject(tp, prev, tail, 0);
+    }
+
+    worker->engine = NULL;
+
+    (void) nxt_atomic_cmp_set(&worker->active, 1, 0);
+}
+
+
+static void
+nxt_thread_pool_flush(nxt_thread_pool_worker_t *worker)
+{
+    if (worker->done_head != NULL) {
+        nxt_event_engine_post_list(worker->engine, worker->done_head,
+                                   worker->done_tail);
+
+        worker->done_head = NULL;
+        worker->done_tail = NULL;
+        worker->done = 0;
+    }
+}
+
+
+/*
+ * nxt_monotonic_time() uses a coarse clock on Linux which has the jiffy
+ * precision, while the queue wait time is usually several microseconds.
+ */
+
+static nxt_nsec_t
+nxt_thread_pool_time(void)
+{
+#if (NXT_HAVE_CLOCK_MONOTONIC)
+    struct timespec  ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (nxt_nsec_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+
+#else
+    nxt_monotonic_time_t  now;
+
+    nxt_monotonic_time(&now);
+
+    return now.monotonic;
+#endif
+}
+
+
+void
+nxt_thread_pool_stats(nxt_thread_pool_t *tp, nxt_thread_pool_stats_t *stats)
+{
+    nxt_uint_t                i, runs;
+    nxt_thread_pool_worker_t  *worker;
+
+    nxt_memzero(stats, sizeof(nxt_thread_pool_stats_t));
+
+    stats->threads = tp->threads;
+    stats->waiting = tp->waiting;
+    stats->posted = tp->posted;
+
+    runs = 0;
+
+    for (i = 0; i < tp->nworkers; i++) {
+        worker = &tp->workers[i];
+
+        runs += worker->runs;
+
+        stats->steals += worker->steals;
+        stats->batches += worker->batches;
+        stats->wait_time += worker->wait_time;
+
+        if (stats->max_wait_time < worker->max_wait_time) {
+            stats->max_wait_time = worker->max_wait_time;
+        }
+    }
+
+    /* The counters are read without locks and may be slightly inconsistent. */
+
+    stats->queued = (stats->posted > runs) ? stats->posted - runs : 0;
 }
 
 
@@ -242,6 +798,14 @@ nxt_thread_pool_destroy(nxt_thread_pool_t *tp)
     }
 
     if (tp->max_threads != 0) {
+        /* The works collected by the engine must precede the exit work. */
+
+        if (thr->engine != NULL
+            && thr->engine->thread_pool_batch.thread_pool == tp)
+        {
+            nxt_thread_pool_batch_post(&thr->engine->thread_pool_batch);
+        }
+
         /* Disable new threads creation and mark a pool as being destroyed. */
         tp->max_threads = 0;
 
@@ -281,6 +845,11 @@ nxt_thread_pool_exit(nxt_task_t *task, void *obj, void *data)
         nxt_thread_wait(handle);
     }
 
+    nxt_thread_pool_worker_exit(tp, thread->thread_pool_worker);
+
+    thread->thread_pool = NULL;
+    thread->thread_pool_worker = NULL;
+
     threads = nxt_atomic_fetch_add(&tp->threads, -1);
 
     nxt_debug(task, "thread pool threads: %A", threads);
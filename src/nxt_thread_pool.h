@@ -12,33 +12,86 @@ typedef void (*nxt_thread_pool_init_t)(void);
 
 
 struct nxt_thread_pool_s {
-    nxt_atomic_t             ready;
-    nxt_atomic_t             waiting;
-    nxt_atomic_t             threads;
-    nxt_uint_t               max_threads;
+    nxt_atomic_t              ready;
+    nxt_atomic_t              waiting;
+    nxt_atomic_t              threads;
+    nxt_uint_t                max_threads;
 
-    nxt_sem_t                sem;
-    nxt_nsec_t               timeout;
+    nxt_sem_t                 sem;
+    nxt_nsec_t                timeout;
 
-    nxt_work_t               work;
-    nxt_task_t               task;
+    nxt_work_t                work;
+    nxt_task_t                task;
 
-    nxt_locked_work_queue_t  work_queue;
+    nxt_atomic_work_queue_t   work_queue;
+    nxt_thread_spinlock_t     lock;
 
-    nxt_thread_handle_t      main;
+    nxt_uint_t                nworkers;
+    nxt_thread_pool_worker_t  *workers;
 
-    nxt_event_engine_t       *engine;
-    nxt_thread_pool_init_t   init;
-    nxt_work_handler_t       exit;
+    nxt_atomic_t              posted;
+    nxt_nsec_t                post_time;
+    nxt_nsec_t                take_time;
+
+    nxt_thread_handle_t       main;
+
+    nxt_event_engine_t        *engine;
+    nxt_thread_pool_init_t    init;
+    nxt_work_handler_t        exit;
 };
 
 
+/* Works collected by an event engine to be posted at once. */
+
+typedef struct {
+    nxt_thread_pool_t         *thread_pool;
+    nxt_work_t                *head;
+    nxt_work_t                *tail;
+    nxt_uint_t                count;
+} nxt_thread_pool_batch_t;
+
+
+typedef struct {
+    nxt_uint_t                threads;
+    nxt_uint_t                waiting;
+
+    /* The number of works posted but not yet run. */
+    nxt_uint_t                queued;
+
+    nxt_uint_t                posted;
+
+    /* The number of steal operations, a work may be stolen several times. */
+    nxt_uint_t                steals;
+
+    /*
+     * The number of times a worker has taken the pool queue and the time
+     * the oldest work of the taken queue has waited, the total and the
+     * maximum.  The time is measured only for works posted to an empty
+     * queue, so a burst of posts taken at once counts as one batch.
+     */
+    nxt_uint_t                batches;
+    nxt_nsec_t                wait_time;
+    nxt_nsec_t                max_wait_time;
+} nxt_thread_pool_stats_t;
+
+
 NXT_EXPORT nxt_thread_pool_t *nxt_thread_pool_create(nxt_uint_t max_threads,
     nxt_nsec_t timeout, nxt_thread_pool_init_t init,
     nxt_event_engine_t *engine, nxt_work_handler_t exit);
 NXT_EXPORT void nxt_thread_pool_destroy(nxt_thread_pool_t *tp);
 NXT_EXPORT nxt_int_t nxt_thread_pool_post(nxt_thread_pool_t *tp,
     nxt_work_t *work);
+NXT_EXPORT nxt_int_t nxt_thread_pool_batch_add(nxt_thread_pool_batch_t *batch,
+    nxt_thread_pool_t *tp, nxt_work_t *work);
+NXT_EXPORT void nxt_thread_pool_batch_post(nxt_thread_pool_batch_t *batch);
+NXT_EXPORT void nxt_thread_pool_return(nxt_event_engine_t *engine,
+    nxt_work_t *work);
+NXT_EXPORT void nxt_thread_pool_stats(nxt_thread_pool_t *tp,
+    nxt_thread_pool_stats_t *stats);
+
+
+#define nxt_thread_pool_has_works(tp)                                         \
+    (!nxt_atomic_work_queue_is_empty(&(tp)->work_queue))
 
 
 #endif /* _NXT_UNIX_THREAD_POOL_H_INCLUDED_ */
@@ -309,3 +309,82 @@ nxt_locked_work_queue_move(nxt_thread_t *thr, nxt_locked_work_queue_t *lwq,
         work = work->next;
     }
 }
+
+
+/*
+ * Add a work to an atomic work queue.  The works are pushed in LIFO order,
+ * the order is restored on move.  The function returns 1 if the queue was
+ * empty, so only the first work after a move requires the owner wakeup.
+ */
+
+nxt_bool_t
+nxt_atomic_work_queue_add(nxt_atomic_work_queue_t *awq, nxt_work_t *work)
+{
+    return nxt_atomic_work_queue_add_list(awq, work, work);
+}
+
+
+/*
+ * Add a list of works linked from the last added work to the first one,
+ * that is in order the list would have after adding the works one by one.
+ */
+
+nxt_bool_t
+nxt_atomic_work_queue_add_list(nxt_atomic_work_queue_t *awq, nxt_work_t *head,
+    nxt_work_t *tail)
+{
+    nxt_atomic_uint_t  first;
+
+    do {
+        first = awq->head;
+        tail->next = (nxt_work_t *) first;
+
+    } while (!nxt_atomic_cmp_set(&awq->head, first, (nxt_atomic_uint_t) head));
+
+    return (first == 0);
+}
+
+
+/*
+ * Take all works from an atomic work queue as a list in FIFO order.
+ * The whole list is detached at once, so there is no ABA problem and
+ * the queue may be taken by several threads.
+ */
+
+nxt_work_t *
+nxt_atomic_work_queue_take(nxt_atomic_work_queue_t *awq)
+{
+    nxt_work_t  *work, *next, *prev;
+
+    work = (nxt_work_t *) nxt_atomic_xchg(&awq->head, 0);
+
+    prev = NULL;
+
+    while (work != NULL) {
+        next = work->next;
+        work->next = prev;
+        prev = work;
+        work = next;
+    }
+
+    return prev;
+}
+
+
+/* Move all works from an atomic work queue to a usual work queue. */
+
+void
+nxt_atomic_work_queue_move(nxt_thread_t *thr, nxt_atomic_work_queue_t *awq,
+    nxt_work_queue_t *wq)
+{
+    nxt_work_t  *work, *next;
+
+    for (work = nxt_atomic_work_queue_take(awq); work != NULL; work = next) {
+        next = work->next;
+
+        work->task->thread = thr;
+
+        nxt_work_queue_add(wq, work->handler, work->task,
+                           work->obj, work->data);
+    }
+}
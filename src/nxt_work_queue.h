@@ -82,6 +82,17 @@ typedef struct {
 } nxt_locked_work_queue_t;
 
 
+/*
+ * A lock-free queue of works added by many threads and taken at once
+ * by the owner thread or by any of consumer threads.  The works are linked
+ * through their own "next" fields, so adding does not allocate memory.
+ */
+
+typedef struct {
+    nxt_atomic_t                head;
+} nxt_atomic_work_queue_t;
+
+
 NXT_EXPORT void nxt_work_queue_cache_create(nxt_work_queue_cache_t *cache,
     size_t chunk_size);
 NXT_EXPORT void nxt_work_queue_cache_destroy(nxt_work_queue_cache_t *cache);
@@ -124,5 +135,16 @@ NXT_EXPORT nxt_work_handler_t nxt_locked_work_queue_pop(
 NXT_EXPORT void nxt_locked_work_queue_move(nxt_thread_t *thr,
     nxt_locked_work_queue_t *lwq, nxt_work_queue_t *wq);
 
+NXT_EXPORT nxt_bool_t nxt_atomic_work_queue_add(nxt_atomic_work_queue_t *awq,
+    nxt_work_t *work);
+NXT_EXPORT nxt_bool_t nxt_atomic_work_queue_add_list(
+    nxt_atomic_work_queue_t *awq, nxt_work_t *head, nxt_work_t *tail);
+NXT_EXPORT nxt_work_t *nxt_atomic_work_queue_take(nxt_atomic_work_queue_t *awq);
+NXT_EXPORT void nxt_atomic_work_queue_move(nxt_thread_t *thr,
+    nxt_atomic_work_queue_t *awq, nxt_work_queue_t *wq);
+
+#define nxt_atomic_work_queue_is_empty(awq)                                   \
+    ((awq)->head == 0)
+
 
 #endif /* _NXT_WORK_QUEUE_H_INCLUDED_ */
@@ -0,0 +1,238 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+#define NXT_ACCESS_LOG_TEST_THREADS  4
+#define NXT_ACCESS_LOG_TEST_RECORDS  20000
+
+
+static void nxt_access_log_test_producer(void *data);
+static nxt_int_t nxt_access_log_test_check(nxt_fd_t fd, nxt_uint_t *received);
+
+
+static nxt_uint_t  nxt_access_log_test_name;
+
+
+nxt_int_t
+nxt_access_log_test(nxt_thread_t *thr)
+{
+    nxt_fd_t             fd;
+    nxt_int_t            ret;
+    nxt_str_t            name;
+    nxt_uint_t           i, threads, received;
+    nxt_nsec_t           start, end;
+    nxt_thread_link_t    *link;
+    nxt_thread_handle_t  handles[NXT_ACCESS_LOG_TEST_THREADS];
+    char                 file[] = "/tmp/nxt_access_log_test.XXXXXX";
+
+    fd = mkstemp(file);
+
+    if (fd == -1) {
+        nxt_log_alert(thr->log, "access log test failed: temporary file %E",
+                      nxt_errno);
+        return NXT_ERROR;
+    }
+
+    (void) unlink(file);
+
+    ret = NXT_ERROR;
+
+    if (nxt_access_log_init(fd, NXT_ACCESS_LOG_JSON, NXT_LOG_OVERFLOW_BLOCK)
+        != NXT_OK)
+    {
+        nxt_log_alert(thr->log, "access log test failed: init");
+        goto done;
+    }
+
+    nxt_str_set(&name, "te\"st");
+    nxt_access_log_test_name = nxt_access_log_name(&name);
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    if (nxt_log_writer_start(NXT_LOG_OVERFLOW_BLOCK) != NXT_OK) {
+        nxt_log_alert(thr->log, "access log test failed: start");
+        goto done;
+    }
+
+    for (threads = 0; threads < NXT_ACCESS_LOG_TEST_THREADS; threads++) {
+        link = nxt_zalloc(sizeof(nxt_thread_link_t));
+        if (link == NULL) {
+            break;
+        }
+
+        link->start = nxt_access_log_test_producer;
+        link->work.data = (void *) (uintptr_t) threads;
+
+        if (nxt_thread_create(&handles[threads], link) != NXT_OK) {
+            break;
+        }
+    }
+
+    for (i = 0; i < threads; i++) {
+        nxt_thread_wait(handles[i]);
+    }
+
+    nxt_log_writer_stop();
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    if (threads != NXT_ACCESS_LOG_TEST_THREADS) {
+        nxt_log_alert(thr->log, "access log test failed: threads");
+        goto done;
+    }
+
+    if (nxt_access_log_test_check(fd, &received) != NXT_OK) {
+        nxt_log_alert(thr->log, "access log test failed: "
+                      "invalid or reordered record");
+        goto done;
+    }
+
+    if (received != NXT_ACCESS_LOG_TEST_THREADS * NXT_ACCESS_LOG_TEST_RECORDS
+        || nxt_access_log_dropped() != 0)
+    {
+        nxt_log_alert(thr->log, "access log test failed: "
+                      "%ui records received, %ui dropped",
+                      received, nxt_access_log_dropped());
+        goto done;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "access log test passed: %ui threads, %ui records, %.3fs",
+                  (nxt_uint_t) NXT_ACCESS_LOG_TEST_THREADS, received,
+                  (double) (end - start) / 1000000000);
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_access_log_enabled = 0;
+
+    nxt_fd_close(fd);
+
+    return ret;
+}
+
+
+static void
+nxt_access_log_test_producer(void *data)
+{
+    nxt_uint_t               i, id;
+    nxt_access_log_record_t  record;
+
+    id = (uintptr_t) data;
+
+    nxt_memzero(&record, sizeof(nxt_access_log_record_t));
+
+    record.time = 1500000000000ULL;
+    record.status = 200;
+    record.name = nxt_access_log_test_name;
+    record.family = AF_INET;
+    record.addr[0] = 127;
+    record.addr[3] = id + 1;
+
+    for (i = 0; i < NXT_ACCESS_LOG_TEST_RECORDS; i++) {
+        record.bytes_in = i;
+        record.bytes_out = id;
+
+        nxt_access_log_write(&record);
+    }
+}
+
+
+/*
+ * Records of each thread must be complete and in order.  The thread
+ * is identified by "bytes_out" and the record number is "bytes_in".
+ */
+
+static nxt_int_t
+nxt_access_log_test_check(nxt_fd_t fd, nxt_uint_t *received)
+{
+    off_t       size;
+    u_char      *buf, *p, *end, *eol, *in, *out, *in_end, *out_end;
+    nxt_int_t   ret, id, seq;
+    nxt_uint_t  next[NXT_ACCESS_LOG_TEST_THREADS];
+
+    static const char  prefix[] = "{\"time\":1500000000.000,"
+                                  "\"remote\":\"127.0.0.";
+    static const char  suffix[] = ",\"name\":\"te\\\"st\"}";
+
+    *received = 0;
+    nxt_memzero(next, sizeof(next));
+
+    size = lseek(fd, 0, SEEK_END);
+    if (size <= 0 || lseek(fd, 0, SEEK_SET) == -1) {
+        return NXT_ERROR;
+    }
+
+    buf = nxt_malloc(size);
+    if (buf == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    if (read(fd, buf, size) != size) {
+        goto done;
+    }
+
+    end = buf + size;
+
+    for (p = buf; p < end; p = eol + 1) {
+        eol = nxt_memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            goto done;
+        }
+
+        if ((size_t) (eol - p) <= sizeof(prefix) + sizeof(suffix)
+            || nxt_memcmp(p, prefix, sizeof(prefix) - 1) != 0
+            || nxt_memcmp(eol - (sizeof(suffix) - 1), suffix,
+                          sizeof(suffix) - 1) != 0)
+        {
+            goto done;
+        }
+
+        in = nxt_memstrn(p, eol, "\"bytes_in\":", 11);
+        out = nxt_memstrn(p, eol, "\"bytes_out\":", 12);
+
+        if (in == NULL || out == NULL) {
+            goto done;
+        }
+
+        in += 11;
+        out += 12;
+
+        in_end = nxt_memchr(in, ',', eol - in);
+        out_end = nxt_memchr(out, ',', eol - out);
+
+        if (in_end == NULL || out_end == NULL) {
+            goto done;
+        }
+
+        seq = nxt_int_parse(in, in_end - in);
+        id = nxt_int_parse(out, out_end - out);
+
+        if (id < 0 || id >= NXT_ACCESS_LOG_TEST_THREADS
+            || seq < 0 || (nxt_uint_t) seq != next[id])
+        {
+            goto done;
+        }
+
+        next[id] = seq + 1;
+        (*received)++;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_free(buf);
+
+    return ret;
+}
@@ -0,0 +1,392 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_bench.h"
+
+
+/*
+ * The benchmark runner:
+ *
+ *   make bench
+ *   build/bench [--warmup N] [--runs N] [--json] [name prefix ...]
+ *
+ * Each benchmark is run "warmup" times without measurement and then "runs"
+ * times.  Time per operation is reported as the minimum, the median, the 90th
+ * and the 99th percentiles, the maximum, and the mean of the runs.  The JSON
+ * output is intended to be saved and compared between releases.
+ */
+
+#define NXT_BENCH_MAX     64
+#define NXT_BENCH_WARMUP  3
+#define NXT_BENCH_RUNS    20
+
+
+typedef struct {
+    const nxt_bench_t  *bench;
+
+    /* Nanoseconds per operation. */
+    double             min;
+    double             p50;
+    double             p90;
+    double             p99;
+    double             max;
+    double             mean;
+} nxt_bench_result_t;
+
+
+extern char  **environ;
+
+static nxt_int_t nxt_bench_run(const nxt_bench_t *bench, nxt_uint_t warmup,
+    nxt_uint_t runs, nxt_nsec_t *samples, nxt_bench_result_t *res);
+static nxt_nsec_t nxt_bench_time(void);
+static int nxt_cdecl nxt_bench_sort_cmp(const void *one, const void *two);
+static double nxt_bench_percentile(nxt_nsec_t *samples, nxt_uint_t n,
+    nxt_uint_t percent, nxt_uint_t ops);
+static nxt_bool_t nxt_bench_match(const char *name, char **filters);
+static void nxt_bench_report(nxt_bench_result_t *results, nxt_uint_t n,
+    nxt_uint_t warmup, nxt_uint_t runs, nxt_bool_t json);
+static void nxt_bench_print(u_char *buf, u_char *p);
+
+
+nxt_module_init_t  nxt_init_modules[1];
+nxt_uint_t         nxt_init_modules_n;
+
+static const nxt_bench_t  *nxt_benchs[NXT_BENCH_MAX];
+static nxt_uint_t         nxt_benchs_n;
+
+
+int nxt_cdecl
+main(int argc, char **argv)
+{
+    char                **arg, **filters, *p;
+    nxt_int_t           n;
+    nxt_bool_t          json;
+    nxt_uint_t          i, nfilters, nresults, warmup, runs;
+    nxt_nsec_t          *samples;
+    nxt_task_t          task;
+    nxt_thread_t        *thr;
+    nxt_bench_result_t  *results;
+
+    if (nxt_lib_start("bench", argv, &environ) != NXT_OK) {
+        return 1;
+    }
+
+    nxt_main_log.level = NXT_LOG_INFO;
+    task.log = &nxt_main_log;
+
+    thr = nxt_thread();
+    thr->task = &task;
+
+    warmup = NXT_BENCH_WARMUP;
+    runs = NXT_BENCH_RUNS;
+    json = 0;
+
+    /* The filters replace the processed arguments in place. */
+
+    filters = &nxt_process_argv[1];
+    nfilters = 0;
+
+    for (arg = &nxt_process_argv[1]; *arg != NULL; arg++) {
+        p = *arg;
+
+        if (nxt_strcmp(p, "--json") == 0) {
+            json = 1;
+            continue;
+        }
+
+        if (nxt_strcmp(p, "--warmup") == 0 || nxt_strcmp(p, "--runs") == 0) {
+
+            if (arg[1] == NULL) {
+                goto invalid;
+            }
+
+            n = nxt_int_parse((u_char *) arg[1], nxt_strlen(arg[1]));
+
+            if (n < 0 || (n == 0 && p[2] == 'r')) {
+                goto invalid;
+            }
+
+            if (p[2] == 'w') {
+                warmup = n;
+
+            } else {
+                runs = n;
+            }
+
+            arg++;
+            continue;
+        }
+
+        if (p[0] == '-') {
+            goto invalid;
+        }
+
+        filters[nfilters++] = p;
+    }
+
+    filters[nfilters] = NULL;
+
+    if (nxt_core_bench_init() != NXT_OK) {
+        return 1;
+    }
+
+    samples = nxt_malloc(runs * sizeof(nxt_nsec_t));
+    results = nxt_malloc(nxt_max(nxt_benchs_n, 1)
+                         * sizeof(nxt_bench_result_t));
+
+    if (samples == NULL || results == NULL) {
+        return 1;
+    }
+
+    nresults = 0;
+
+    for (i = 0; i < nxt_benchs_n; i++) {
+
+        if (nfilters != 0 && !nxt_bench_match(nxt_benchs[i]->name, filters)) {
+            continue;
+        }
+
+        if (nxt_bench_run(nxt_benchs[i], warmup, runs, samples,
+                          &results[nresults])
+            != NXT_OK)
+        {
+            nxt_log_alert(thr->log, "benchmark \"%s\" failed",
+                          nxt_benchs[i]->name);
+            return 1;
+        }
+
+        nresults++;
+    }
+
+    nxt_bench_report(results, nresults, warmup, runs, json);
+
+    nxt_free(samples);
+    nxt_free(results);
+
+    return 0;
+
+invalid:
+
+    nxt_log_alert(thr->log, "usage: bench [--warmup N] [--runs N] [--json] "
+                  "[name prefix ...]");
+
+    return 1;
+}
+
+
+nxt_int_t
+nxt_bench_add(const nxt_bench_t *bench)
+{
+    if (nxt_slow_path(nxt_benchs_n == NXT_BENCH_MAX)) {
+        nxt_thread_log_alert("too many benchmarks, \"%s\" is not added",
+                             bench->name);
+        return NXT_ERROR;
+    }
+
+    nxt_benchs[nxt_benchs_n++] = bench;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_bench_run(const nxt_bench_t *bench, nxt_uint_t warmup, nxt_uint_t runs,
+    nxt_nsec_t *samples, nxt_bench_result_t *res)
+{
+    void        *data;
+    nxt_int_t   ret;
+    nxt_uint_t  i;
+    nxt_nsec_t  start, total;
+
+    data = NULL;
+
+    if (bench->setup != NULL && bench->setup(&data) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_OK;
+    total = 0;
+
+    for (i = 0; i < warmup + runs; i++) {
+        start = nxt_bench_time();
+
+        ret = bench->run(data, bench->ops);
+
+        if (ret != NXT_OK) {
+            break;
+        }
+
+        if (i >= warmup) {
+            samples[i - warmup] = nxt_bench_time() - start;
+            total += samples[i - warmup];
+        }
+    }
+
+    if (bench->teardown != NULL) {
+        bench->teardown(data);
+    }
+
+    if (ret != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    res->bench = bench;
+
+    if (runs == 0) {
+        res->min = 0;
+        res->p50 = 0;
+        res->p90 = 0;
+        res->p99 = 0;
+        res->max = 0;
+        res->mean = 0;
+
+        return NXT_OK;
+    }
+
+    nxt_qsort(samples, runs, sizeof(nxt_nsec_t), nxt_bench_sort_cmp);
+
+    res->min = (double) samples[0] / bench->ops;
+    res->p50 = nxt_bench_percentile(samples, runs, 50, bench->ops);
+    res->p90 = nxt_bench_percentile(samples, runs, 90, bench->ops);
+    res->p99 = nxt_bench_percentile(samples, runs, 99, bench->ops);
+    res->max = (double) samples[runs - 1] / bench->ops;
+    res->mean = (double) total / runs / bench->ops;
+
+    return NXT_OK;
+}
+
+
+/*
+ * nxt_monotonic_time() uses a coarse clock on Linux which has the jiffy
+ * precision, so the precise clock is read directly.
+ */
+
+static nxt_nsec_t
+nxt_bench_time(void)
+{
+    struct timespec  ts;
+
+    (void) clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (nxt_nsec_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static int nxt_cdecl
+nxt_bench_sort_cmp(const void *one, const void *two)
+{
+    nxt_nsec_t  first, second;
+
+    first = *(const nxt_nsec_t *) one;
+    second = *(const nxt_nsec_t *) two;
+
+    if (first < second) {
+        return -1;
+    }
+
+    return (first > second);
+}
+
+
+/* The nearest rank percentile of sorted samples. */
+
+static double
+nxt_bench_percentile(nxt_nsec_t *samples, nxt_uint_t n, nxt_uint_t percent,
+    nxt_uint_t ops)
+{
+    nxt_uint_t  rank;
+
+    rank = (percent * n + 99) / 100;
+
+    return (double) samples[rank - 1] / ops;
+}
+
+
+static nxt_bool_t
+nxt_bench_match(const char *name, char **filters)
+{
+    while (*filters != NULL) {
+
+        if (nxt_strncmp(name, *filters, nxt_strlen(*filters)) == 0) {
+            return 1;
+        }
+
+        filters++;
+    }
+
+    return 0;
+}
+
+
+/* Benchmark names are not escaped in JSON and must not contain quotes. */
+
+static void
+nxt_bench_report(nxt_bench_result_t *results, nxt_uint_t n, nxt_uint_t warmup,
+    nxt_uint_t runs, nxt_bool_t json)
+{
+    u_char              *p, *end;
+    uint64_t            ops;
+    nxt_uint_t          i;
+    nxt_bench_result_t  *res;
+    u_char              buf[1024];
+
+    static const char  header[] =
+        "benchmark                          min       p50       p90"
+        "       p99       max      mean        ops/s\n";
+
+    end = buf + sizeof(buf);
+
+    if (json) {
+        p = nxt_sprintf(buf, end, "{\"version\":\"%s\",\"warmup\":%ui,"
+                        "\"runs\":%ui,\"benchmarks\":[",
+                        NXT_VERSION, warmup, runs);
+        nxt_bench_print(buf, p);
+
+        for (i = 0; i < n; i++) {
+            res = &results[i];
+
+            p = nxt_sprintf(buf, end, "%s{\"name\":\"%s\",\"ops\":%ui,"
+                            "\"min\":%.3f,\"p50\":%.3f,\"p90\":%.3f,"
+                            "\"p99\":%.3f,\"max\":%.3f,\"mean\":%.3f}",
+                            (i == 0) ? "\n" : ",\n", res->bench->name,
+                            res->bench->ops, res->min, res->p50, res->p90,
+                            res->p99, res->max, res->mean);
+            nxt_bench_print(buf, p);
+        }
+
+        p = nxt_sprintf(buf, end, "\n]}\n");
+        nxt_bench_print(buf, p);
+
+        return;
+    }
+
+    p = nxt_sprintf(buf, end, "%ui warmup, %ui runs, ns per operation\n\n%s",
+                    warmup, runs, header);
+    nxt_bench_print(buf, p);
+
+    for (i = 0; i < n; i++) {
+        res = &results[i];
+
+        /* The name is truncated to 27 characters and padded with spaces. */
+
+        p = nxt_cpystrn(buf, (u_char *) res->bench->name, 28);
+        p = nxt_cpymem(p, "                            ", 28 - (p - buf));
+
+        ops = (res->p50 != 0) ? (uint64_t) (1000000000 / res->p50) : 0;
+
+        p = nxt_sprintf(p, end, "%8.1f%8.1f%8.1f%8.1f%8.1f%8.1f%13uL\n",
+                        res->min, res->p50, res->p90, res->p99, res->max,
+                        res->mean, ops);
+        nxt_bench_print(buf, p);
+    }
+}
+
+
+static void
+nxt_bench_print(u_char *buf, u_char *p)
+{
+    (void) write(STDOUT_FILENO, buf, p - buf);
+}
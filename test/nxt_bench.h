@@ -0,0 +1,32 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#ifndef _NXT_BENCH_H_INCLUDED_
+#define _NXT_BENCH_H_INCLUDED_
+
+
+/*
+ * A benchmark runs "ops" operations per run.  The setup() function
+ * prepares data shared by all runs and the teardown() function frees it,
+ * both are optional.  The run() function must leave the data in the state
+ * suitable for the next run.  The result is reported as time per operation.
+ */
+
+typedef struct {
+    const char    *name;
+    nxt_uint_t    ops;
+
+    nxt_int_t     (*setup)(void **data);
+    nxt_int_t     (*run)(void *data, nxt_uint_t ops);
+    void          (*teardown)(void *data);
+} nxt_bench_t;
+
+
+nxt_int_t nxt_bench_add(const nxt_bench_t *bench);
+
+nxt_int_t nxt_core_bench_init(void);
+
+
+#endif /* _NXT_BENCH_H_INCLUDED_ */
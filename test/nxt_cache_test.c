@@ -0,0 +1,614 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+#define NXT_CACHE_TEST_SIZE      (1024 * 1024)
+#define NXT_CACHE_TEST_SMALL     (64 * 1024)
+#define NXT_CACHE_TEST_KEYS      10000
+#define NXT_CACHE_TEST_WAITING   3
+#define NXT_CACHE_TEST_TIMEOUT   100
+
+
+/* The handler called for a test query. */
+#define NXT_CACHE_TEST_NONE      0
+#define NXT_CACHE_TEST_NOCACHE   1
+#define NXT_CACHE_TEST_READY     2
+#define NXT_CACHE_TEST_UPDATE    3
+#define NXT_CACHE_TEST_TIMEDOUT  4
+#define NXT_CACHE_TEST_ERROR     5
+
+
+typedef struct {
+    nxt_cache_query_t  query;
+    nxt_uint_t         handler;
+    u_char             key[32];
+} nxt_cache_test_query_t;
+
+
+static nxt_int_t nxt_cache_test_wait(nxt_thread_t *thr,
+    nxt_event_engine_t *engine);
+static nxt_int_t nxt_cache_test_timeout(nxt_thread_t *thr,
+    nxt_event_engine_t *engine);
+static nxt_int_t nxt_cache_test_evict(nxt_thread_t *thr,
+    nxt_event_engine_t *engine);
+static nxt_int_t nxt_cache_test_release(nxt_thread_t *thr,
+    nxt_event_engine_t *engine);
+static void nxt_cache_test_query(nxt_event_engine_t *engine,
+    nxt_cache_t *cache, nxt_cache_test_query_t *tq, const char *key,
+    nxt_msec_t timeout);
+static nxt_uint_t nxt_cache_test_count(nxt_cache_test_query_t *tq,
+    nxt_uint_t n, nxt_uint_t handler);
+static void nxt_cache_test_run(nxt_thread_t *thr, nxt_event_engine_t *engine);
+static void nxt_cache_test_nocache(nxt_task_t *task, void *obj, void *data);
+static void nxt_cache_test_ready(nxt_task_t *task, void *obj, void *data);
+static void nxt_cache_test_update(nxt_task_t *task, void *obj, void *data);
+static void nxt_cache_test_timedout(nxt_task_t *task, void *obj, void *data);
+static void nxt_cache_test_error(nxt_task_t *task, void *obj, void *data);
+
+
+static const nxt_cache_query_state_t  nxt_cache_test_state = {
+    .nocache_handler = nxt_cache_test_nocache,
+    .ready_handler = nxt_cache_test_ready,
+    .update_handler = nxt_cache_test_update,
+    .timeout_handler = nxt_cache_test_timedout,
+    .error_handler = nxt_cache_test_error,
+};
+
+
+nxt_int_t
+nxt_cache_test(nxt_thread_t *thr)
+{
+    nxt_int_t               ret;
+    nxt_event_engine_t      *engine, *prev;
+    nxt_work_queue_cache_t  cache;
+
+    /*
+     * The engine is used only to queue the wake up works and the timers,
+     * they are run by the test itself.
+     */
+
+    engine = nxt_zalloc(sizeof(nxt_event_engine_t));
+    if (engine == NULL) {
+        return NXT_ERROR;
+    }
+
+    engine->task.thread = thr;
+    engine->task.log = thr->log;
+
+    if (nxt_timers_init(&engine->timers, 16) != NXT_OK) {
+        nxt_free(engine);
+        return NXT_ERROR;
+    }
+
+    nxt_work_queue_cache_create(&cache, 0);
+    engine->fast_work_queue.cache = &cache;
+
+    nxt_work_queue_thread_adopt(&engine->fast_work_queue);
+
+    prev = thr->engine;
+    thr->engine = engine;
+
+    nxt_thread_time_update(thr);
+
+    ret = NXT_ERROR;
+
+    if (nxt_cache_test_wait(thr, engine) != NXT_OK
+        || nxt_cache_test_timeout(thr, engine) != NXT_OK
+        || nxt_cache_test_evict(thr, engine) != NXT_OK
+        || nxt_cache_test_release(thr, engine) != NXT_OK)
+    {
+        goto done;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log, "cache test passed");
+
+    ret = NXT_OK;
+
+done:
+
+    thr->engine = prev;
+
+    nxt_work_queue_cache_destroy(&cache);
+    nxt_free(engine->timers.changes);
+    nxt_free(engine);
+
+    return ret;
+}
+
+
+/*
+ * The queries for a key being updated wait for the update; a cancelled
+ * update passes the key to one of the waiting queries.
+ */
+
+static nxt_int_t
+nxt_cache_test_wait(nxt_thread_t *thr, nxt_event_engine_t *engine)
+{
+    nxt_int_t               ret;
+    nxt_uint_t              i;
+    nxt_cache_t             *cache;
+    nxt_cache_node_t        *node;
+    nxt_cache_test_query_t  *updating, tq[NXT_CACHE_TEST_WAITING + 1];
+
+    cache = nxt_cache_create(NXT_CACHE_TEST_SIZE);
+    if (cache == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    for (i = 0; i < nxt_nitems(tq); i++) {
+        nxt_cache_test_query(engine, cache, &tq[i], "/wait", 0);
+    }
+
+    if (tq[0].handler != NXT_CACHE_TEST_UPDATE
+        || nxt_cache_test_count(&tq[1], NXT_CACHE_TEST_WAITING,
+                                NXT_CACHE_TEST_NONE)
+           != NXT_CACHE_TEST_WAITING)
+    {
+        nxt_log_alert(thr->log, "cache test failed: wait");
+        goto done;
+    }
+
+    /* The update is cancelled, one of the waiting queries takes it over. */
+
+    nxt_cache_cancel(&engine->task, &tq[0].query);
+
+    nxt_cache_test_run(thr, engine);
+
+    if (nxt_cache_test_count(&tq[1], NXT_CACHE_TEST_WAITING,
+                             NXT_CACHE_TEST_UPDATE) != 1
+        || nxt_cache_test_count(&tq[1], NXT_CACHE_TEST_WAITING,
+                                NXT_CACHE_TEST_NONE)
+           != NXT_CACHE_TEST_WAITING - 1)
+    {
+        nxt_log_alert(thr->log, "cache test failed: cancel");
+        goto done;
+    }
+
+    for (i = 1; tq[i].handler != NXT_CACHE_TEST_UPDATE; i++) {
+        /* void */
+    }
+
+    updating = &tq[i];
+
+    if (nxt_cache_update(&engine->task, &updating->query, (u_char *) "hello",
+                         5, 60)
+        != NXT_OK)
+    {
+        nxt_log_alert(thr->log, "cache test failed: update");
+        goto done;
+    }
+
+    nxt_cache_test_run(thr, engine);
+
+    node = NULL;
+
+    for (i = 1; i < nxt_nitems(tq); i++) {
+        if (&tq[i] == updating) {
+            continue;
+        }
+
+        node = tq[i].query.node;
+
+        if (tq[i].handler != NXT_CACHE_TEST_READY
+            || node->size != 5
+            || nxt_memcmp(node->data, "hello", 5) != 0)
+        {
+            nxt_log_alert(thr->log, "cache test failed: waiting query %ui "
+                          "is not updated", i);
+            goto done;
+        }
+    }
+
+    if (node->count != NXT_CACHE_TEST_WAITING - 1) {
+        nxt_log_alert(thr->log, "cache test failed: node count %uD",
+                      node->count);
+        goto done;
+    }
+
+    for (i = 1; i < nxt_nitems(tq); i++) {
+        if (&tq[i] != updating) {
+            nxt_cache_release(cache, tq[i].query.node);
+        }
+    }
+
+    /* A negative node directs the queries to nocache_handler. */
+
+    nxt_cache_test_query(engine, cache, &tq[0], "/nocache", 0);
+    nxt_cache_test_query(engine, cache, &tq[1], "/nocache", 0);
+
+    (void) nxt_cache_update(&engine->task, &tq[0].query, NULL, 0, 60);
+
+    nxt_cache_test_run(thr, engine);
+
+    nxt_cache_test_query(engine, cache, &tq[2], "/nocache", 0);
+
+    if (tq[1].handler != NXT_CACHE_TEST_NOCACHE
+        || tq[2].handler != NXT_CACHE_TEST_NOCACHE)
+    {
+        nxt_log_alert(thr->log, "cache test failed: nocache");
+        goto done;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_cache_destroy(cache);
+
+    return ret;
+}
+
+
+/*
+ * A timed out query leaves the waiting list and is not woken up
+ * by the following update.
+ */
+
+static nxt_int_t
+nxt_cache_test_timeout(nxt_thread_t *thr, nxt_event_engine_t *engine)
+{
+    nxt_int_t               ret;
+    nxt_cache_t             *cache;
+    nxt_cache_test_query_t  tq[3];
+
+    cache = nxt_cache_create(NXT_CACHE_TEST_SIZE);
+    if (cache == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    nxt_cache_test_query(engine, cache, &tq[0], "/timeout", 0);
+    nxt_cache_test_query(engine, cache, &tq[1], "/timeout",
+                         NXT_CACHE_TEST_TIMEOUT);
+    nxt_cache_test_query(engine, cache, &tq[2], "/timeout",
+                         10 * NXT_CACHE_TEST_TIMEOUT);
+
+    (void) nxt_timer_find(engine);
+
+    nxt_timer_expire(engine, engine->timers.now + 2 * NXT_CACHE_TEST_TIMEOUT);
+
+    nxt_cache_test_run(thr, engine);
+
+    if (tq[1].handler != NXT_CACHE_TEST_TIMEDOUT
+        || tq[1].query.waiting
+        || tq[2].handler != NXT_CACHE_TEST_NONE
+        || !tq[2].query.waiting)
+    {
+        nxt_log_alert(thr->log, "cache test failed: timeout");
+        goto done;
+    }
+
+    tq[1].handler = NXT_CACHE_TEST_NONE;
+
+    (void) nxt_cache_update(&engine->task, &tq[0].query, (u_char *) "timeout",
+                            7, 60);
+
+    nxt_cache_test_run(thr, engine);
+
+    if (tq[1].handler != NXT_CACHE_TEST_NONE
+        || tq[2].handler != NXT_CACHE_TEST_READY)
+    {
+        nxt_log_alert(thr->log, "cache test failed: update after timeout");
+        goto done;
+    }
+
+    nxt_cache_release(cache, tq[2].query.node);
+
+    /* The woken up query timer must not fire. */
+
+    (void) nxt_timer_find(engine);
+
+    nxt_timer_expire(engine, engine->timers.now + 20 * NXT_CACHE_TEST_TIMEOUT);
+
+    nxt_cache_test_run(thr, engine);
+
+    if (tq[2].handler != NXT_CACHE_TEST_READY) {
+        nxt_log_alert(thr->log, "cache test failed: timer of woken up query");
+        goto done;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_cache_destroy(cache);
+
+    return ret;
+}
+
+
+/*
+ * The keys added to a small zone evict the least recently used nodes,
+ * both on data and on lvlhsh allocation failures.  A referenced node
+ * is not evicted.
+ */
+
+static nxt_int_t
+nxt_cache_test_evict(nxt_thread_t *thr, nxt_event_engine_t *engine)
+{
+    nxt_int_t               ret;
+    nxt_uint_t              i;
+    nxt_cache_t             *cache;
+    nxt_cache_node_t        *pinned;
+    nxt_cache_test_query_t  tq;
+    u_char                  data[64], key[32];
+
+    cache = nxt_cache_create(NXT_CACHE_TEST_SMALL);
+    if (cache == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    nxt_memset(data, 'x', sizeof(data));
+
+    nxt_cache_test_query(engine, cache, &tq, "/pinned", 0);
+    (void) nxt_cache_update(&engine->task, &tq.query, (u_char *) "pinned",
+                            6, 60);
+
+    nxt_cache_test_query(engine, cache, &tq, "/pinned", 0);
+
+    if (tq.handler != NXT_CACHE_TEST_READY) {
+        nxt_log_alert(thr->log, "cache test failed: pinned");
+        goto done;
+    }
+
+    pinned = tq.query.node;
+
+    for (i = 0; i < NXT_CACHE_TEST_KEYS; i++) {
+        nxt_sprintf(key, key + sizeof(key), "/evict/%ui%Z", i);
+
+        nxt_cache_test_query(engine, cache, &tq, (char *) key, 0);
+
+        if (tq.handler != NXT_CACHE_TEST_UPDATE) {
+            nxt_log_alert(thr->log, "cache test failed: "
+                          "key %ui handler %ui", i, tq.handler);
+            goto done;
+        }
+
+        if (nxt_cache_update(&engine->task, &tq.query, data,
+                             8 + i % (sizeof(data) - 8), 60)
+            != NXT_OK)
+        {
+            nxt_log_alert(thr->log, "cache test failed: evict %ui", i);
+            goto done;
+        }
+    }
+
+    nxt_cache_test_query(engine, cache, &tq, "/evict/0", 0);
+
+    if (tq.handler != NXT_CACHE_TEST_UPDATE) {
+        nxt_log_alert(thr->log, "cache test failed: "
+                      "the oldest node is not evicted");
+        goto done;
+    }
+
+    nxt_cache_cancel(&engine->task, &tq.query);
+
+    nxt_sprintf(key, key + sizeof(key), "/evict/%ui%Z",
+                (nxt_uint_t) NXT_CACHE_TEST_KEYS - 1);
+
+    nxt_cache_test_query(engine, cache, &tq, (char *) key, 0);
+
+    if (tq.handler != NXT_CACHE_TEST_READY) {
+        nxt_log_alert(thr->log, "cache test failed: "
+                      "the newest node is evicted");
+        goto done;
+    }
+
+    nxt_cache_release(cache, tq.query.node);
+
+    if (pinned->deleted || nxt_memcmp(pinned->data, "pinned", 6) != 0) {
+        nxt_log_alert(thr->log, "cache test failed: "
+                      "the referenced node is evicted");
+        goto done;
+    }
+
+    nxt_cache_release(cache, pinned);
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_cache_destroy(cache);
+
+    return ret;
+}
+
+
+/*
+ * An expired node deleted while it is referenced keeps its data until
+ * the last reference is released.
+ */
+
+static nxt_int_t
+nxt_cache_test_release(nxt_thread_t *thr, nxt_event_engine_t *engine)
+{
+    nxt_int_t               ret;
+    nxt_cache_t             *cache;
+    nxt_cache_node_t        *node;
+    nxt_cache_test_query_t  tq[2];
+
+    cache = nxt_cache_create(NXT_CACHE_TEST_SIZE);
+    if (cache == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    nxt_cache_test_query(engine, cache, &tq[0], "/release", 0);
+    (void) nxt_cache_update(&engine->task, &tq[0].query, (u_char *) "old",
+                            3, 60);
+
+    nxt_cache_test_query(engine, cache, &tq[0], "/release", 0);
+    nxt_cache_test_query(engine, cache, &tq[1], "/release", 0);
+
+    if (tq[0].handler != NXT_CACHE_TEST_READY
+        || tq[1].handler != NXT_CACHE_TEST_READY
+        || tq[0].query.node != tq[1].query.node)
+    {
+        nxt_log_alert(thr->log, "cache test failed: release hit");
+        goto done;
+    }
+
+    node = tq[0].query.node;
+
+    /* The node expires while it is referenced. */
+
+    node->expiry = 0;
+
+    nxt_cache_test_query(engine, cache, &tq[0], "/release", 0);
+
+    if (tq[0].handler != NXT_CACHE_TEST_UPDATE || !node->deleted) {
+        nxt_log_alert(thr->log, "cache test failed: "
+                      "expired node is not deleted");
+        goto done;
+    }
+
+    (void) nxt_cache_update(&engine->task, &tq[0].query, (u_char *) "new",
+                            3, 60);
+
+    nxt_cache_release(cache, node);
+
+    if (node->count != 1 || nxt_memcmp(node->data, "old", 3) != 0) {
+        nxt_log_alert(thr->log, "cache test failed: "
+                      "deleted node is freed while referenced");
+        goto done;
+    }
+
+    nxt_cache_release(cache, node);
+
+    nxt_cache_test_query(engine, cache, &tq[1], "/release", 0);
+
+    if (tq[1].handler != NXT_CACHE_TEST_READY
+        || nxt_memcmp(tq[1].query.node->data, "new", 3) != 0)
+    {
+        nxt_log_alert(thr->log, "cache test failed: updated node");
+        goto done;
+    }
+
+    nxt_cache_release(cache, tq[1].query.node);
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_cache_destroy(cache);
+
+    return ret;
+}
+
+
+static void
+nxt_cache_test_query(nxt_event_engine_t *engine, nxt_cache_t *cache,
+    nxt_cache_test_query_t *tq, const char *key, nxt_msec_t timeout)
+{
+    nxt_memzero(tq, sizeof(nxt_cache_test_query_t));
+
+    tq->query.key_len = nxt_cpystrn(tq->key, (u_char *) key, sizeof(tq->key))
+                        - tq->key;
+    tq->query.key_data = tq->key;
+    tq->query.state = &nxt_cache_test_state;
+    tq->query.data = tq;
+    tq->query.timeout = timeout;
+
+    nxt_cache_query(&engine->task, cache, &tq->query);
+}
+
+
+static nxt_uint_t
+nxt_cache_test_count(nxt_cache_test_query_t *tq, nxt_uint_t n,
+    nxt_uint_t handler)
+{
+    nxt_uint_t  i, count;
+
+    count = 0;
+
+    for (i = 0; i < n; i++) {
+        count += (tq[i].handler == handler);
+    }
+
+    return count;
+}
+
+
+static void
+nxt_cache_test_run(nxt_thread_t *thr, nxt_event_engine_t *engine)
+{
+    void                *obj, *data;
+    nxt_task_t          *task;
+    nxt_work_handler_t  handler;
+
+    for ( ;; ) {
+        nxt_atomic_work_queue_move(thr, &engine->post_work_queue,
+                                   &engine->fast_work_queue);
+
+        if (engine->fast_work_queue.head == NULL) {
+            return;
+        }
+
+        while (engine->fast_work_queue.head != NULL) {
+            handler = nxt_work_queue_pop(&engine->fast_work_queue, &task,
+                                         &obj, &data);
+            handler(task, obj, data);
+        }
+    }
+}
+
+
+static void
+nxt_cache_test_nocache(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_cache_test_query_t  *tq;
+
+    tq = data;
+    tq->handler = NXT_CACHE_TEST_NOCACHE;
+}
+
+
+static void
+nxt_cache_test_ready(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_cache_test_query_t  *tq;
+
+    tq = data;
+    tq->handler = NXT_CACHE_TEST_READY;
+}
+
+
+static void
+nxt_cache_test_update(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_cache_test_query_t  *tq;
+
+    tq = data;
+    tq->handler = NXT_CACHE_TEST_UPDATE;
+}
+
+
+static void
+nxt_cache_test_timedout(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_cache_test_query_t  *tq;
+
+    tq = data;
+    tq->handler = NXT_CACHE_TEST_TIMEDOUT;
+}
+
+
+static void
+nxt_cache_test_error(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_cache_test_query_t  *tq;
+
+    tq = data;
+    tq->handler = NXT_CACHE_TEST_ERROR;
+}
@@ -0,0 +1,491 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include <nxt_conf.h>
+#include "nxt_tests.h"
+
+
+#define NXT_CONF_JSON_TEST_APPS  2000
+#define NXT_CONF_JSON_TEST_RUNS  20
+
+
+static nxt_int_t nxt_conf_json_test_strings(nxt_thread_t *thr,
+    const char *impl);
+static nxt_int_t nxt_conf_json_test_spaces(nxt_thread_t *thr,
+    const char *impl);
+static nxt_int_t nxt_conf_json_test_bench(nxt_thread_t *thr,
+    const char *impl, const char *name, nxt_str_t *json, nxt_bool_t print);
+static nxt_int_t nxt_conf_json_test_config(nxt_mp_t *mp, nxt_str_t *compact,
+    nxt_str_t *pretty);
+
+
+typedef struct {
+    nxt_str_t  json;
+    u_char     raw;
+} nxt_conf_json_test_char_t;
+
+
+static nxt_conf_json_test_char_t  nxt_conf_json_test_chars[] = {
+    { nxt_string("x"), 'x' },
+    { nxt_string("\\\""), '"' },
+    { nxt_string("\\\\"), '\\' },
+    { nxt_string("\\n"), '\n' },
+    { nxt_string("\\t"), '\t' },
+    { nxt_string("\\u0001"), '\001' },
+    { nxt_string("\\u001F"), '\037' },
+    { nxt_string("\xD0\xAF"), 0 },
+};
+
+
+nxt_int_t
+nxt_conf_json_test(nxt_thread_t *thr)
+{
+    nxt_mp_t    *mp;
+    nxt_int_t   ret;
+    nxt_str_t   compact, pretty;
+    nxt_uint_t  level;
+    const char  *impl;
+
+    static const char  *impls[] = { "scalar", "sse4.2", "avx2" };
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (mp == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    if (nxt_conf_json_test_config(mp, &compact, &pretty) != NXT_OK) {
+        goto done;
+    }
+
+    for (level = NXT_CONF_JSON_SCALAR; level <= NXT_CONF_JSON_AVX2; level++) {
+
+        if (nxt_conf_json_simd_init(level) != level) {
+            nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                          "conf json %s is not supported", impls[level]);
+            continue;
+        }
+
+        impl = impls[level];
+
+        if (nxt_conf_json_test_strings(thr, impl) != NXT_OK
+            || nxt_conf_json_test_spaces(thr, impl) != NXT_OK
+            || nxt_conf_json_test_bench(thr, impl, "compact", &compact, 1)
+               != NXT_OK
+            || nxt_conf_json_test_bench(thr, impl, "pretty", &pretty, 0)
+               != NXT_OK)
+        {
+            goto done;
+        }
+
+        nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                      "conf json %s test passed", impl);
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    (void) nxt_conf_json_simd_init(NXT_CONF_JSON_SSE42);
+
+    nxt_mp_destroy(mp);
+
+    return ret;
+}
+
+
+/*
+ * Every special character is tested at every position of strings
+ * long enough to be scanned with several vector loads.
+ */
+
+static nxt_int_t
+nxt_conf_json_test_strings(nxt_thread_t *thr, const char *impl)
+{
+    u_char                     *p, json[128], raw[128], out[128];
+    size_t                     len, pos, size;
+    nxt_mp_t                   *mp;
+    nxt_int_t                  ret;
+    nxt_str_t                  str;
+    nxt_uint_t                 i;
+    nxt_conf_value_t           *value;
+    nxt_conf_json_test_char_t  *ch;
+
+    ret = NXT_ERROR;
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (mp == NULL) {
+        return NXT_ERROR;
+    }
+
+    for (len = 1; len < 80; len++) {
+        for (pos = 0; pos < len; pos++) {
+            for (i = 0; i < nxt_nitems(nxt_conf_json_test_chars); i++) {
+                ch = &nxt_conf_json_test_chars[i];
+
+                p = json;
+                *p++ = '"';
+                p = nxt_cpymem(p, "abcdefghijklmnopqrstuvwxyz0123456789"
+                                  "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+                                  "abcdefghijklmnop", pos);
+                p = nxt_cpymem(p, ch->json.start, ch->json.length);
+                p = nxt_cpymem(p, "-------------------------------------"
+                                  "-------------------------------------"
+                                  "--------------", len - pos - 1);
+                *p++ = '"';
+
+                size = p - json;
+
+                value = nxt_conf_json_parse(mp, json, p, NULL);
+                if (value == NULL) {
+                    nxt_log_alert(thr->log, "conf json %s string test "
+                                  "failed: \"%*s\" parsing",
+                                  impl, (int) size, json);
+                    goto done;
+                }
+
+                nxt_conf_get_string(value, &str);
+
+                if (ch->raw != 0) {
+                    nxt_memcpy(raw, &json[1], pos);
+                    raw[pos] = ch->raw;
+                    nxt_memcpy(&raw[pos + 1], p - 1 - (len - pos - 1),
+                               len - pos - 1);
+
+                    if (str.length != len
+                        || nxt_memcmp(str.start, raw, len) != 0)
+                    {
+                        nxt_log_alert(thr->log, "conf json %s string test "
+                                      "failed: \"%*s\" value \"%V\"",
+                                      impl, (int) size, json, &str);
+                        goto done;
+                    }
+                }
+
+                if (nxt_conf_json_length(value, NULL) < size) {
+                    nxt_log_alert(thr->log, "conf json %s string test "
+                                  "failed: \"%*s\" length",
+                                  impl, (int) size, json);
+                    goto done;
+                }
+
+                p = nxt_conf_json_print(out, value, NULL);
+
+                if ((size_t) (p - out) != size
+                    || nxt_memcmp(out, json, size) != 0)
+                {
+                    nxt_log_alert(thr->log, "conf json %s string test "
+                                  "failed: \"%*s\" printed as \"%*s\"",
+                                  impl, (int) size, json, (int) (p - out),
+                                  out);
+                    goto done;
+                }
+
+                if (ch->raw == 0 || ch->raw == 'x') {
+                    continue;
+                }
+
+                /* An unescaped control character is not allowed. */
+
+                json[pos + 1] = '\001';
+
+                if (nxt_conf_json_parse(mp, json, json + size, NULL) != NULL) {
+                    nxt_log_alert(thr->log, "conf json %s string test "
+                                  "failed: control character at %uz "
+                                  "accepted", impl, pos);
+                    goto done;
+                }
+            }
+        }
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_mp_destroy(mp);
+
+    return ret;
+}
+
+
+static nxt_int_t
+nxt_conf_json_test_spaces(nxt_thread_t *thr, const char *impl)
+{
+    u_char            *p, *end, json[512], out[16];
+    size_t            n, i;
+    nxt_mp_t          *mp;
+    nxt_int_t         ret;
+    nxt_conf_value_t  *value;
+
+    static const u_char  spaces[] = " \t\r\n";
+
+    ret = NXT_ERROR;
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (mp == NULL) {
+        return NXT_ERROR;
+    }
+
+    for (n = 0; n < 100; n++) {
+        p = json;
+
+        for (i = 0; i < n; i++) {
+            *p++ = spaces[i % 4];
+        }
+
+        *p++ = '[';
+
+        for (i = 0; i < n; i++) {
+            *p++ = spaces[(i + n) % 4];
+        }
+
+        *p++ = '1';
+        *p++ = ']';
+
+        for (i = 0; i < n; i++) {
+            *p++ = spaces[(i + 1) % 4];
+        }
+
+        end = p;
+
+        value = nxt_conf_json_parse(mp, json, end, NULL);
+        if (value == NULL) {
+            nxt_log_alert(thr->log, "conf json %s space test failed: "
+                          "%uz spaces", impl, n);
+            goto done;
+        }
+
+        p = nxt_conf_json_print(out, value, NULL);
+
+        if (p - out != 3 || nxt_memcmp(out, "[1]", 3) != 0) {
+            nxt_log_alert(thr->log, "conf json %s space test failed: "
+                          "%uz spaces printed as \"%*s\"",
+                          impl, n, (int) (p - out), out);
+            goto done;
+        }
+
+        /* Trailing garbage after spaces. */
+
+        *end++ = 'x';
+
+        if (nxt_conf_json_parse(mp, json, end, NULL) != NULL) {
+            nxt_log_alert(thr->log, "conf json %s space test failed: "
+                          "%uz spaces with garbage accepted", impl, n);
+            goto done;
+        }
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_mp_destroy(mp);
+
+    return ret;
+}
+
+
+static nxt_int_t
+nxt_conf_json_test_bench(nxt_thread_t *thr, const char *impl,
+    const char *name, nxt_str_t *json, nxt_bool_t print)
+{
+    u_char                  *p;
+    size_t                  size;
+    nxt_mp_t                *mp;
+    nxt_int_t               ret;
+    nxt_uint_t              i;
+    nxt_nsec_t              start, end;
+    nxt_buf_mem_t           mem;
+    nxt_conf_value_t        *value;
+    nxt_conf_json_pretty_t  pretty;
+
+    ret = NXT_ERROR;
+    value = NULL;
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (mp == NULL) {
+        return NXT_ERROR;
+    }
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < NXT_CONF_JSON_TEST_RUNS; i++) {
+        value = nxt_conf_json_parse(mp, json->start,
+                                    json->start + json->length, NULL);
+        if (value == NULL) {
+            nxt_log_alert(thr->log, "conf json %s bench failed: parsing",
+                          impl);
+            goto done;
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "conf json %s %s parse bench: %uz bytes, %.1f MB/s",
+                  impl, name, json->length,
+                  (double) json->length * NXT_CONF_JSON_TEST_RUNS * 1000
+                  / (end - start));
+
+    if (!print) {
+        ret = NXT_OK;
+        goto done;
+    }
+
+    /* The two pass printer. */
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    p = NULL;
+
+    for (i = 0; i < NXT_CONF_JSON_TEST_RUNS; i++) {
+        nxt_memzero(&pretty, sizeof(nxt_conf_json_pretty_t));
+
+        size = nxt_conf_json_length(value, &pretty);
+
+        p = nxt_mp_alloc(mp, size);
+        if (p == NULL) {
+            goto done;
+        }
+
+        nxt_memzero(&pretty, sizeof(nxt_conf_json_pretty_t));
+
+        size = nxt_conf_json_print(p, value, &pretty) - p;
+
+        if (i + 1 != NXT_CONF_JSON_TEST_RUNS) {
+            nxt_mp_free(mp, p);
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "conf json %s length and print bench: %uz bytes, %.1f MB/s",
+                  impl, size,
+                  (double) size * NXT_CONF_JSON_TEST_RUNS * 1000
+                  / (end - start));
+
+    /* The single pass printer must produce the same output. */
+
+    nxt_memzero(&mem, sizeof(nxt_buf_mem_t));
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < NXT_CONF_JSON_TEST_RUNS; i++) {
+        mem.pos = mem.start;
+        mem.free = mem.start;
+
+        nxt_memzero(&pretty, sizeof(nxt_conf_json_pretty_t));
+
+        if (nxt_conf_json_dump(mp, &mem, value, &pretty, 2) != NXT_OK) {
+            goto done;
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "conf json %s dump bench: %uz bytes, %.1f MB/s",
+                  impl, nxt_buf_mem_used_size(&mem),
+                  (double) nxt_buf_mem_used_size(&mem)
+                  * NXT_CONF_JSON_TEST_RUNS * 1000 / (end - start));
+
+    if ((size_t) nxt_buf_mem_used_size(&mem) != size
+        || nxt_memcmp(mem.pos, p, size) != 0
+        || mem.end - mem.free < 2)
+    {
+        nxt_log_alert(thr->log, "conf json %s bench failed: "
+                      "dump and print outputs differ", impl);
+        goto done;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_mp_destroy(mp);
+
+    return ret;
+}
+
+
+/* A configuration of the size generated for large deployments. */
+
+static nxt_int_t
+nxt_conf_json_test_config(nxt_mp_t *mp, nxt_str_t *compact, nxt_str_t *pretty)
+{
+    u_char                  *p, *start, *end;
+    size_t                  size;
+    nxt_uint_t              i;
+    nxt_buf_mem_t           mem;
+    nxt_conf_value_t        *value;
+    nxt_conf_json_pretty_t  pr;
+
+    size = NXT_CONF_JSON_TEST_APPS * 512;
+
+    start = nxt_mp_alloc(mp, size);
+    if (start == NULL) {
+        return NXT_ERROR;
+    }
+
+    end = start + size;
+
+    p = nxt_sprintf(start, end, "{\"listeners\":{");
+
+    for (i = 0; i < NXT_CONF_JSON_TEST_APPS; i++) {
+        p = nxt_sprintf(p, end, "%s\"127.0.0.1:%ui\":"
+                                "{\"application\":\"app-%ui\"}",
+                        (i == 0) ? "" : ",", 10000 + i, i);
+    }
+
+    p = nxt_sprintf(p, end, "},\"applications\":{");
+
+    for (i = 0; i < NXT_CONF_JSON_TEST_APPS; i++) {
+        p = nxt_sprintf(p, end, "%s\"app-%ui\":{\"type\":\"python\","
+                        "\"processes\":{\"max\":16,\"spare\":2,"
+                        "\"idle_timeout\":30},"
+                        "\"path\":\"/srv/www/app-%ui/releases/current\","
+                        "\"module\":\"wsgi\",\"user\":\"www-data\","
+                        "\"environment\":{\"DESCRIPTION\":"
+                        "\"Application number %ui\\tserving \\\"tenant\\\" "
+                        "requests under /srv/www/app-%ui\"}}",
+                        (i == 0) ? "" : ",", i, i, i, i);
+    }
+
+    p = nxt_sprintf(p, end, "}}");
+
+    if (p == end) {
+        return NXT_ERROR;
+    }
+
+    compact->start = start;
+    compact->length = p - start;
+
+    value = nxt_conf_json_parse(mp, start, p, NULL);
+    if (value == NULL) {
+        return NXT_ERROR;
+    }
+
+    nxt_memzero(&mem, sizeof(nxt_buf_mem_t));
+    nxt_memzero(&pr, sizeof(nxt_conf_json_pretty_t));
+
+    if (nxt_conf_json_dump(mp, &mem, value, &pr, 0) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    pretty->start = mem.pos;
+    pretty->length = nxt_buf_mem_used_size(&mem);
+
+    return NXT_OK;
+}
@@ -0,0 +1,879 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include <nxt_port_memory_int.h>
+#include "nxt_bench.h"
+
+
+/*
+ * The allocator and queue benchmarks allocate or add a batch of objects
+ * and then free or remove them all, an operation is an allocation and
+ * a free.  The search tree and hash benchmarks use keys spread uniformly
+ * over the whole 32-bit range.
+ */
+
+#define NXT_BENCH_BATCH         256
+#define NXT_BENCH_TREE_NODES    4096
+#define NXT_BENCH_HASH_KEYS     (64 * 1024)
+#define NXT_BENCH_ZONE_SIZE     (4 * 1024 * 1024)
+
+
+typedef struct {
+    void                      *mem;
+    void                      *allocator;
+    void                      *blocks[NXT_BENCH_BATCH];
+} nxt_alloc_bench_t;
+
+
+typedef struct {
+    NXT_RBTREE_NODE           (node);
+    uint32_t                  key;
+} nxt_rbtree_bench_node_t;
+
+
+typedef struct {
+    nxt_rbtree_t              tree;
+    nxt_rbtree_bench_node_t   *nodes;
+} nxt_rbtree_bench_t;
+
+
+typedef struct {
+    nxt_lvlhsh_t              lvlhsh;
+    nxt_flathsh_t             flathsh;
+    nxt_uint_t                nkeys;
+    uint32_t                  *keys;
+} nxt_hash_bench_t;
+
+
+typedef struct {
+    nxt_work_queue_cache_t    cache;
+    nxt_work_queue_t          queue;
+    nxt_task_t                task;
+} nxt_work_queue_bench_t;
+
+
+static nxt_int_t nxt_mp_bench_setup(void **data);
+static nxt_int_t nxt_mp_bench_run(void *data, nxt_uint_t ops);
+static void nxt_mp_bench_teardown(void *data);
+static nxt_int_t nxt_mem_zone_bench_setup(void **data);
+static nxt_int_t nxt_mem_zone_bench_run(void *data, nxt_uint_t ops);
+static void nxt_mem_zone_bench_teardown(void *data);
+static nxt_int_t nxt_port_mmap_bench_setup(void **data);
+static nxt_int_t nxt_port_mmap_bench_run(void *data, nxt_uint_t ops);
+static void nxt_port_mmap_bench_teardown(void *data);
+static size_t nxt_alloc_bench_size(nxt_uint_t n);
+
+static nxt_int_t nxt_rbtree_bench_setup(void **data);
+static nxt_int_t nxt_rbtree_bench_find_setup(void **data);
+static nxt_int_t nxt_rbtree_bench_insert_delete(void *data, nxt_uint_t ops);
+static nxt_int_t nxt_rbtree_bench_find(void *data, nxt_uint_t ops);
+static void nxt_rbtree_bench_teardown(void *data);
+static intptr_t nxt_rbtree_bench_compare(nxt_rbtree_node_t *node1,
+    nxt_rbtree_node_t *node2);
+
+static nxt_hash_bench_t *nxt_hash_bench_create(nxt_uint_t nkeys);
+static nxt_int_t nxt_lvlhsh_bench_setup(void **data);
+static nxt_int_t nxt_flathsh_bench_setup(void **data);
+static nxt_int_t nxt_hash_bench_small_setup(void **data);
+static nxt_int_t nxt_lvlhsh_bench_find(void *data, nxt_uint_t ops);
+static nxt_int_t nxt_flathsh_bench_find(void *data, nxt_uint_t ops);
+static nxt_int_t nxt_lvlhsh_bench_insert_delete(void *data, nxt_uint_t ops);
+static nxt_int_t nxt_flathsh_bench_insert_delete(void *data, nxt_uint_t ops);
+static void nxt_hash_bench_teardown(void *data);
+static void nxt_hash_bench_query(nxt_lvlhsh_query_t *lhq, uint32_t *key);
+static nxt_int_t nxt_hash_bench_test(nxt_lvlhsh_query_t *lhq, void *data);
+
+static nxt_int_t nxt_sprintf_bench_run(void *data, nxt_uint_t ops);
+static nxt_int_t nxt_utf8_bench_decode(void *data, nxt_uint_t ops);
+static nxt_int_t nxt_utf8_bench_casecmp(void *data, nxt_uint_t ops);
+
+static nxt_int_t nxt_work_queue_bench_setup(void **data);
+static nxt_int_t nxt_work_queue_bench_run(void *data, nxt_uint_t ops);
+static void nxt_work_queue_bench_teardown(void *data);
+static void nxt_work_queue_bench_handler(nxt_task_t *task, void *obj,
+    void *data);
+
+
+static const nxt_bench_t  nxt_core_benchs[] = {
+    { "mp.alloc_free", 64 * NXT_BENCH_BATCH, nxt_mp_bench_setup,
+      nxt_mp_bench_run, nxt_mp_bench_teardown },
+
+    { "mem_zone.alloc_free", 64 * NXT_BENCH_BATCH, nxt_mem_zone_bench_setup,
+      nxt_mem_zone_bench_run, nxt_mem_zone_bench_teardown },
+
+    { "port_mmap.chunk", 64 * NXT_BENCH_BATCH, nxt_port_mmap_bench_setup,
+      nxt_port_mmap_bench_run, nxt_port_mmap_bench_teardown },
+
+    { "rbtree.insert_delete", NXT_BENCH_TREE_NODES, nxt_rbtree_bench_setup,
+      nxt_rbtree_bench_insert_delete, nxt_rbtree_bench_teardown },
+
+    { "rbtree.find", NXT_BENCH_TREE_NODES, nxt_rbtree_bench_find_setup,
+      nxt_rbtree_bench_find, nxt_rbtree_bench_teardown },
+
+    { "lvlhsh.find", NXT_BENCH_HASH_KEYS, nxt_lvlhsh_bench_setup,
+      nxt_lvlhsh_bench_find, nxt_hash_bench_teardown },
+
+    { "flathsh.find", NXT_BENCH_HASH_KEYS, nxt_flathsh_bench_setup,
+      nxt_flathsh_bench_find, nxt_hash_bench_teardown },
+
+    { "lvlhsh.insert_delete", NXT_BENCH_TREE_NODES,
+      nxt_hash_bench_small_setup, nxt_lvlhsh_bench_insert_delete,
+      nxt_hash_bench_teardown },
+
+    { "flathsh.insert_delete", NXT_BENCH_TREE_NODES,
+      nxt_hash_bench_small_setup, nxt_flathsh_bench_insert_delete,
+      nxt_hash_bench_teardown },
+
+    { "sprintf.log_line", 64 * 1024, NULL, nxt_sprintf_bench_run, NULL },
+
+    { "utf8.decode", 256 * 1024, NULL, nxt_utf8_bench_decode, NULL },
+
+    { "utf8.casecmp", 64 * 1024, NULL, nxt_utf8_bench_casecmp, NULL },
+
+    { "work_queue.add_pop", 64 * NXT_BENCH_BATCH, nxt_work_queue_bench_setup,
+      nxt_work_queue_bench_run, nxt_work_queue_bench_teardown },
+};
+
+
+static const nxt_lvlhsh_proto_t  nxt_hash_bench_proto  nxt_aligned(64) = {
+    NXT_LVLHSH_DEFAULT,
+    nxt_hash_bench_test,
+    nxt_lvlhsh_alloc,
+    nxt_lvlhsh_free,
+};
+
+
+nxt_int_t
+nxt_core_bench_init(void)
+{
+    nxt_uint_t  i;
+
+    for (i = 0; i < nxt_nitems(nxt_core_benchs); i++) {
+        if (nxt_bench_add(&nxt_core_benchs[i]) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_mp_bench_setup(void **data)
+{
+    nxt_alloc_bench_t  *ab;
+
+    ab = nxt_zalloc(sizeof(nxt_alloc_bench_t));
+    if (ab == NULL) {
+        return NXT_ERROR;
+    }
+
+    ab->allocator = nxt_mp_create(4096, 128, 1024, 32);
+    if (ab->allocator == NULL) {
+        nxt_free(ab);
+        return NXT_ERROR;
+    }
+
+    *data = ab;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_mp_bench_run(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t         i, n;
+    nxt_alloc_bench_t  *ab;
+
+    ab = data;
+
+    for (i = 0; i < ops; i += NXT_BENCH_BATCH) {
+
+        for (n = 0; n < NXT_BENCH_BATCH; n++) {
+            ab->blocks[n] = nxt_mp_alloc(ab->allocator,
+                                         nxt_alloc_bench_size(n));
+            if (ab->blocks[n] == NULL) {
+                return NXT_ERROR;
+            }
+        }
+
+        for (n = 0; n < NXT_BENCH_BATCH; n++) {
+            nxt_mp_free(ab->allocator, ab->blocks[n]);
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_mp_bench_teardown(void *data)
+{
+    nxt_alloc_bench_t  *ab;
+
+    ab = data;
+
+    nxt_mp_destroy(ab->allocator);
+    nxt_free(ab);
+}
+
+
+static nxt_int_t
+nxt_mem_zone_bench_setup(void **data)
+{
+    nxt_alloc_bench_t  *ab;
+
+    ab = nxt_zalloc(sizeof(nxt_alloc_bench_t));
+    if (ab == NULL) {
+        return NXT_ERROR;
+    }
+
+    ab->mem = nxt_memalign(4096, NXT_BENCH_ZONE_SIZE);
+    if (ab->mem == NULL) {
+        goto fail;
+    }
+
+    ab->allocator = nxt_mem_zone_init(ab->mem, NXT_BENCH_ZONE_SIZE, 4096);
+    if (ab->allocator == NULL) {
+        goto fail;
+    }
+
+    *data = ab;
+
+    return NXT_OK;
+
+fail:
+
+    nxt_free(ab->mem);
+    nxt_free(ab);
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+nxt_mem_zone_bench_run(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t         i, n;
+    nxt_alloc_bench_t  *ab;
+
+    ab = data;
+
+    for (i = 0; i < ops; i += NXT_BENCH_BATCH) {
+
+        for (n = 0; n < NXT_BENCH_BATCH; n++) {
+            ab->blocks[n] = nxt_mem_zone_alloc(ab->allocator,
+                                               nxt_alloc_bench_size(n));
+            if (ab->blocks[n] == NULL) {
+                return NXT_ERROR;
+            }
+        }
+
+        for (n = 0; n < NXT_BENCH_BATCH; n++) {
+            nxt_mem_zone_free(ab->allocator, ab->blocks[n]);
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_mem_zone_bench_teardown(void *data)
+{
+    nxt_alloc_bench_t  *ab;
+
+    ab = data;
+
+    nxt_free(ab->mem);
+    nxt_free(ab);
+}
+
+
+/*
+ * Only the chunk bitmap of a shared memory segment is used, so
+ * the benchmark does not need ports and real shared memory.
+ */
+
+static nxt_int_t
+nxt_port_mmap_bench_setup(void **data)
+{
+    nxt_port_mmap_header_t  *hdr;
+
+    hdr = nxt_zalloc(sizeof(nxt_port_mmap_header_t));
+    if (hdr == NULL) {
+        return NXT_ERROR;
+    }
+
+    nxt_memset(hdr->free_map, 0xFF, sizeof(hdr->free_map));
+
+    *data = hdr;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_port_mmap_bench_run(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t              i, n;
+    nxt_chunk_id_t          chunks[NXT_BENCH_BATCH];
+    nxt_port_mmap_header_t  *hdr;
+
+    hdr = data;
+
+    for (i = 0; i < ops; i += NXT_BENCH_BATCH) {
+
+        for (n = 0; n < NXT_BENCH_BATCH; n++) {
+            if (!nxt_port_mmap_get_free_chunk(hdr, &chunks[n])) {
+                return NXT_ERROR;
+            }
+        }
+
+        for (n = 0; n < NXT_BENCH_BATCH; n++) {
+            nxt_port_mmap_set_chunk_free(hdr, chunks[n]);
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_port_mmap_bench_teardown(void *data)
+{
+    nxt_free(data);
+}
+
+
+/* Sizes from 16 to 512 bytes typical for requests and buffers. */
+
+static size_t
+nxt_alloc_bench_size(nxt_uint_t n)
+{
+    return 16 + (n * 37) % 497;
+}
+
+
+static nxt_int_t
+nxt_rbtree_bench_setup(void **data)
+{
+    uint32_t            key;
+    nxt_uint_t          i;
+    nxt_rbtree_bench_t  *rb;
+
+    rb = nxt_zalloc(sizeof(nxt_rbtree_bench_t));
+    if (rb == NULL) {
+        return NXT_ERROR;
+    }
+
+    rb->nodes = nxt_zalloc(NXT_BENCH_TREE_NODES
+                           * sizeof(nxt_rbtree_bench_node_t));
+    if (rb->nodes == NULL) {
+        nxt_free(rb);
+        return NXT_ERROR;
+    }
+
+    nxt_rbtree_init(&rb->tree, nxt_rbtree_bench_compare);
+
+    for (i = 0; i < NXT_BENCH_TREE_NODES; i++) {
+        key = i;
+        rb->nodes[i].key = nxt_murmur_hash2(&key, sizeof(uint32_t));
+    }
+
+    *data = rb;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_rbtree_bench_find_setup(void **data)
+{
+    nxt_uint_t          i;
+    nxt_rbtree_bench_t  *rb;
+
+    if (nxt_rbtree_bench_setup(data) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    rb = *data;
+
+    for (i = 0; i < NXT_BENCH_TREE_NODES; i++) {
+        nxt_rbtree_insert(&rb->tree, &rb->nodes[i].node);
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_rbtree_bench_insert_delete(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t          i;
+    nxt_rbtree_bench_t  *rb;
+
+    rb = data;
+
+    for (i = 0; i < ops; i++) {
+        nxt_rbtree_insert(&rb->tree, &rb->nodes[i].node);
+    }
+
+    for (i = 0; i < ops; i++) {
+        nxt_rbtree_delete(&rb->tree, &rb->nodes[i].node);
+    }
+
+    return nxt_rbtree_is_empty(&rb->tree) ? NXT_OK : NXT_ERROR;
+}
+
+
+static nxt_int_t
+nxt_rbtree_bench_find(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t               i;
+    nxt_rbtree_node_t        *node;
+    nxt_rbtree_bench_t       *rb;
+    nxt_rbtree_bench_node_t  item;
+
+    rb = data;
+
+    for (i = 0; i < ops; i++) {
+        item.key = rb->nodes[i].key;
+
+        node = nxt_rbtree_find(&rb->tree, &item.node);
+
+        if (node != (nxt_rbtree_node_t *) &rb->nodes[i].node) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_rbtree_bench_teardown(void *data)
+{
+    nxt_rbtree_bench_t  *rb;
+
+    rb = data;
+
+    nxt_free(rb->nodes);
+    nxt_free(rb);
+}
+
+
+static intptr_t
+nxt_rbtree_bench_compare(nxt_rbtree_node_t *node1, nxt_rbtree_node_t *node2)
+{
+    nxt_rbtree_bench_node_t  *item1, *item2;
+
+    item1 = (nxt_rbtree_bench_node_t *) node1;
+    item2 = (nxt_rbtree_bench_node_t *) node2;
+
+    /* Subtraction cannot be used for uniformly spread keys. */
+
+    if (item1->key < item2->key) {
+        return -1;
+    }
+
+    return (item1->key > item2->key);
+}
+
+
+/* The murmur hash of a 32-bit value is a permutation, so keys are unique. */
+
+static nxt_hash_bench_t *
+nxt_hash_bench_create(nxt_uint_t nkeys)
+{
+    uint32_t          key;
+    nxt_uint_t        i;
+    nxt_hash_bench_t  *hb;
+
+    hb = nxt_zalloc(sizeof(nxt_hash_bench_t));
+    if (hb == NULL) {
+        return NULL;
+    }
+
+    hb->keys = nxt_malloc(nkeys * sizeof(uint32_t));
+    if (hb->keys == NULL) {
+        nxt_free(hb);
+        return NULL;
+    }
+
+    hb->nkeys = nkeys;
+
+    for (i = 0; i < nkeys; i++) {
+        key = i;
+        hb->keys[i] = nxt_murmur_hash2(&key, sizeof(uint32_t));
+    }
+
+    return hb;
+}
+
+
+static nxt_int_t
+nxt_lvlhsh_bench_setup(void **data)
+{
+    nxt_uint_t          i;
+    nxt_hash_bench_t    *hb;
+    nxt_lvlhsh_query_t  lhq;
+
+    hb = nxt_hash_bench_create(NXT_BENCH_HASH_KEYS);
+    if (hb == NULL) {
+        return NXT_ERROR;
+    }
+
+    *data = hb;
+
+    for (i = 0; i < hb->nkeys; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        if (nxt_lvlhsh_insert(&hb->lvlhsh, &lhq) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_flathsh_bench_setup(void **data)
+{
+    nxt_uint_t          i;
+    nxt_hash_bench_t    *hb;
+    nxt_lvlhsh_query_t  lhq;
+
+    hb = nxt_hash_bench_create(NXT_BENCH_HASH_KEYS);
+    if (hb == NULL) {
+        return NXT_ERROR;
+    }
+
+    *data = hb;
+
+    for (i = 0; i < hb->nkeys; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        if (nxt_flathsh_insert(&hb->flathsh, &lhq) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_hash_bench_small_setup(void **data)
+{
+    *data = nxt_hash_bench_create(NXT_BENCH_TREE_NODES);
+
+    return (*data != NULL) ? NXT_OK : NXT_ERROR;
+}
+
+
+static nxt_int_t
+nxt_lvlhsh_bench_find(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t          i;
+    nxt_hash_bench_t    *hb;
+    nxt_lvlhsh_query_t  lhq;
+
+    hb = data;
+
+    for (i = 0; i < ops; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        if (nxt_lvlhsh_find(&hb->lvlhsh, &lhq) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_flathsh_bench_find(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t          i;
+    nxt_hash_bench_t    *hb;
+    nxt_lvlhsh_query_t  lhq;
+
+    hb = data;
+
+    for (i = 0; i < ops; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        if (nxt_flathsh_find(&hb->flathsh, &lhq) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_lvlhsh_bench_insert_delete(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t          i;
+    nxt_hash_bench_t    *hb;
+    nxt_lvlhsh_query_t  lhq;
+
+    hb = data;
+
+    for (i = 0; i < ops; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        if (nxt_lvlhsh_insert(&hb->lvlhsh, &lhq) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    for (i = 0; i < ops; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        if (nxt_lvlhsh_delete(&hb->lvlhsh, &lhq) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_flathsh_bench_insert_delete(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t          i;
+    nxt_hash_bench_t    *hb;
+    nxt_lvlhsh_query_t  lhq;
+
+    hb = data;
+
+    for (i = 0; i < ops; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        if (nxt_flathsh_insert(&hb->flathsh, &lhq) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    for (i = 0; i < ops; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        if (nxt_flathsh_delete(&hb->flathsh, &lhq) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_hash_bench_teardown(void *data)
+{
+    nxt_uint_t          i;
+    nxt_hash_bench_t    *hb;
+    nxt_lvlhsh_query_t  lhq;
+
+    hb = data;
+
+    if (hb == NULL) {
+        return;
+    }
+
+    /* The hash memory is freed with the last deleted key. */
+
+    for (i = 0; i < hb->nkeys; i++) {
+        nxt_hash_bench_query(&lhq, &hb->keys[i]);
+
+        (void) nxt_lvlhsh_delete(&hb->lvlhsh, &lhq);
+        (void) nxt_flathsh_delete(&hb->flathsh, &lhq);
+    }
+
+    nxt_free(hb->keys);
+    nxt_free(hb);
+}
+
+
+static void
+nxt_hash_bench_query(nxt_lvlhsh_query_t *lhq, uint32_t *key)
+{
+    lhq->key_hash = *key;
+    lhq->replace = 0;
+    lhq->key.length = sizeof(uint32_t);
+    lhq->key.start = (u_char *) key;
+    lhq->value = key;
+    lhq->proto = &nxt_hash_bench_proto;
+    lhq->pool = NULL;
+}
+
+
+static nxt_int_t
+nxt_hash_bench_test(nxt_lvlhsh_query_t *lhq, void *data)
+{
+    if (*(uint32_t *) lhq->key.start == *(uint32_t *) data) {
+        return NXT_OK;
+    }
+
+    return NXT_DECLINED;
+}
+
+
+static nxt_int_t
+nxt_sprintf_bench_run(void *data, nxt_uint_t ops)
+{
+    u_char      *p;
+    nxt_str_t   method, target;
+    nxt_uint_t  i;
+    u_char      buf[256];
+
+    nxt_str_set(&method, "GET");
+    nxt_str_set(&target, "/index.html?arg=value");
+
+    for (i = 0; i < ops; i++) {
+        p = nxt_sprintf(buf, buf + sizeof(buf),
+                        "%ui#%uL *%uD \"%V %V\" %d %O %.3f %xL%Z",
+                        i, (uint64_t) i * 1000003, (uint32_t) i, &method,
+                        &target, 200, (nxt_off_t) i * 4099,
+                        (double) i / 7, (uint64_t) i);
+
+        if (p == buf) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static const u_char  nxt_utf8_bench_text[] =
+    "Latin ASCII text, "
+    "\xC3\x9C\x62\x65\x72\x67\x72\xC3\xB6\xC3\x9F\x65, "
+    "\xD0\x9A\xD0\xB8\xD1\x80\xD0\xB8"
+    "\xD0\xBB\xD0\xBB\xD0\xB8\xD1\x86\xD0\xB0, "
+    "\xE6\xBC\xA2\xE5\xAD\x97 \xF0\x9F\x98\x80\n";
+
+
+static nxt_int_t
+nxt_utf8_bench_decode(void *data, nxt_uint_t ops)
+{
+    uint32_t      u;
+    nxt_uint_t    i;
+    const u_char  *p, *end;
+
+    p = nxt_utf8_bench_text;
+    end = p + sizeof(nxt_utf8_bench_text) - 1;
+
+    for (i = 0; i < ops; i++) {
+        if (p == end) {
+            p = nxt_utf8_bench_text;
+        }
+
+        u = nxt_utf8_decode(&p, end);
+
+        if (u == 0xffffffff) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_utf8_bench_casecmp(void *data, nxt_uint_t ops)
+{
+    nxt_uint_t  i;
+
+    static const u_char  s1[] = "Content-Type: \xD0\x9A\xD0\x98\xD0\xA0";
+    static const u_char  s2[] = "content-type: \xD0\xBA\xD0\xB8\xD1\x80";
+
+    for (i = 0; i < ops; i++) {
+        if (nxt_utf8_casecmp(s1, s2, sizeof(s1) - 1, sizeof(s2) - 1) != 0) {
+            return NXT_ERROR;
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_work_queue_bench_setup(void **data)
+{
+    nxt_work_queue_bench_t  *wb;
+
+    wb = nxt_zalloc(sizeof(nxt_work_queue_bench_t));
+    if (wb == NULL) {
+        return NXT_ERROR;
+    }
+
+    nxt_work_queue_cache_create(&wb->cache, 0);
+
+    wb->queue.cache = &wb->cache;
+    wb->task.log = &nxt_main_log;
+
+    nxt_work_queue_thread_adopt(&wb->queue);
+
+    *data = wb;
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_work_queue_bench_run(void *data, nxt_uint_t ops)
+{
+    void                    *obj, *wdata;
+    nxt_uint_t              i, n;
+    nxt_task_t              *task;
+    nxt_work_handler_t      handler;
+    nxt_work_queue_bench_t  *wb;
+
+    wb = data;
+
+    for (i = 0; i < ops; i += NXT_BENCH_BATCH) {
+
+        for (n = 0; n < NXT_BENCH_BATCH; n++) {
+            nxt_work_queue_add(&wb->queue, nxt_work_queue_bench_handler,
+                               &wb->task, wb, (void *) (uintptr_t) n);
+        }
+
+        for (n = 0; n < NXT_BENCH_BATCH; n++) {
+            handler = nxt_work_queue_pop(&wb->queue, &task, &obj, &wdata);
+
+            if (handler == NULL || (uintptr_t) wdata != n) {
+                return NXT_ERROR;
+            }
+        }
+    }
+
+    return NXT_OK;
+}
+
+
+static void
+nxt_work_queue_bench_teardown(void *data)
+{
+    nxt_work_queue_bench_t  *wb;
+
+    wb = data;
+
+    nxt_work_queue_cache_destroy(&wb->cache);
+    nxt_free(wb);
+}
+
+
+static void
+nxt_work_queue_bench_handler(nxt_task_t *task, void *obj, void *data)
+{
+}
@@ -0,0 +1,198 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+
+
+/*
+ * libFuzzer target for the HTTP request and chunked body parsers:
+ *
+ *   ./configure --cc=clang --cc-opt="-fsanitize=fuzzer-no-link,address"
+ *   make fuzz
+ *   ./build/http_parse_fuzz [corpus directory]
+ *
+ * The first byte of an input selects the parser implementation and
+ * the size of reads, the rest is fed to the request parser as it arrives
+ * from a client.  Data after the request headers, if any, is treated as
+ * a chunked request body.
+ */
+
+
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static nxt_int_t nxt_http_parse_fuzz_field(void *ctx, nxt_http_field_t *field,
+    nxt_log_t *log);
+static void nxt_http_parse_fuzz_body(u_char *start, u_char *end, size_t step);
+
+
+static nxt_http_fields_hash_entry_t  nxt_http_parse_fuzz_fields[] = {
+    { nxt_string("Content-Length"), &nxt_http_parse_fuzz_field, 0 },
+    { nxt_string("Content-Type"), &nxt_http_parse_fuzz_field, 0 },
+    { nxt_string("Cookie"), &nxt_http_parse_fuzz_field, 0 },
+    { nxt_string("Host"), &nxt_http_parse_fuzz_field, 0 },
+    { nxt_string("Transfer-Encoding"), &nxt_http_parse_fuzz_field, 0 },
+
+    { nxt_null_string, NULL, 0 }
+};
+
+
+static nxt_mp_t                *nxt_http_parse_fuzz_mp;
+static nxt_http_fields_hash_t  *nxt_http_parse_fuzz_hash;
+
+
+int
+LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+    if (nxt_lib_start("http_parse_fuzz", NULL, NULL) != NXT_OK) {
+        return 1;
+    }
+
+    nxt_http_parse_fuzz_mp = nxt_mp_create(1024, 128, 256, 32);
+    if (nxt_http_parse_fuzz_mp == NULL) {
+        return 1;
+    }
+
+    nxt_http_parse_fuzz_hash = nxt_http_fields_hash_create(
+                                  nxt_http_parse_fuzz_fields,
+                                  nxt_http_parse_fuzz_mp);
+    if (nxt_http_parse_fuzz_hash == NULL) {
+        return 1;
+    }
+
+    return 0;
+}
+
+
+int
+LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    u_char                    *start, *end;
+    size_t                    step;
+    nxt_mp_t                  *mp;
+    nxt_int_t                 rc;
+    nxt_buf_mem_t             buf;
+    nxt_http_request_parse_t  rp;
+
+    if (size < 2) {
+        return 0;
+    }
+
+    (void) nxt_http_parse_simd_init(data[0] % 3);
+
+    /* A zero step means the whole input is available at once. */
+    step = data[0] >> 2;
+
+    data++;
+    size--;
+
+    /*
+     * The input is copied to a buffer of exactly its size, so
+     * the sanitizer catches reads past the end of received data.
+     */
+    start = nxt_malloc(size);
+    if (start == NULL) {
+        return 0;
+    }
+
+    nxt_memcpy(start, data, size);
+    end = start + size;
+
+    mp = nxt_mp_create(1024, 128, 256, 32);
+    if (mp == NULL) {
+        goto done;
+    }
+
+    nxt_memzero(&rp, sizeof(nxt_http_request_parse_t));
+
+    if (nxt_http_parse_request_init(&rp, mp) != NXT_OK) {
+        goto done;
+    }
+
+    rp.fields_hash = nxt_http_parse_fuzz_hash;
+
+    buf.start = start;
+    buf.pos = start;
+    buf.free = start;
+    buf.end = end;
+
+    do {
+        buf.free = (step == 0) ? end : nxt_min(buf.free + step, end);
+
+        rc = nxt_http_parse_request(&rp, &buf);
+
+    } while (rc == NXT_AGAIN && buf.free < end);
+
+    if (rc == NXT_DONE) {
+        (void) nxt_http_fields_process(rp.fields, NULL, &nxt_main_log);
+
+        nxt_http_parse_fuzz_body(buf.pos, end, step);
+    }
+
+done:
+
+    if (mp != NULL) {
+        nxt_mp_destroy(mp);
+    }
+
+    nxt_free(start);
+
+    return 0;
+}
+
+
+static nxt_int_t
+nxt_http_parse_fuzz_field(void *ctx, nxt_http_field_t *field, nxt_log_t *log)
+{
+    return NXT_OK;
+}
+
+
+static void
+nxt_http_parse_fuzz_body(u_char *start, u_char *end, size_t step)
+{
+    u_char                  *p;
+    size_t                  size;
+    nxt_int_t               rc;
+    nxt_buf_mem_t           mem;
+    nxt_http_chunk_parse_t  hcp;
+
+    size = end - start;
+
+    if (size == 0) {
+        return;
+    }
+
+    p = nxt_malloc(size);
+    if (p == NULL) {
+        return;
+    }
+
+    nxt_memzero(&hcp, sizeof(nxt_http_chunk_parse_t));
+
+    mem.start = p;
+    mem.pos = p;
+    mem.free = p;
+    mem.end = p + size;
+
+    hcp.pos = mem.free;
+
+    if (step == 0) {
+        step = size;
+    }
+
+    do {
+        size = nxt_min(step, (size_t) (end - start));
+
+        /* Emulate a read which appends new data after the decoded ones. */
+        mem.free = nxt_cpymem(mem.free, start, size);
+        start += size;
+
+        rc = nxt_http_chunk_parse(NULL, &hcp, &mem);
+
+    } while (rc == NXT_AGAIN && start < end);
+
+    nxt_free(p);
+}
@@ -46,9 +46,14 @@ typedef struct {
 
 static nxt_int_t nxt_http_parse_test_run(nxt_http_request_parse_t *rp,
     nxt_str_t *request);
+static nxt_int_t nxt_http_parse_test_chunked(nxt_thread_t *thr);
+static nxt_int_t nxt_http_parse_test_chunked_run(nxt_str_t *body,
+    size_t step, u_char *buf, nxt_str_t *out, nxt_str_t *left);
+static nxt_int_t nxt_http_parse_test_cases(nxt_thread_t *thr,
+    nxt_http_fields_hash_t *hash, const char *impl);
 static nxt_int_t nxt_http_parse_test_bench(nxt_thread_t *thr,
     nxt_str_t *request, nxt_http_fields_hash_t *hash, const char *name,
-    nxt_uint_t n);
+    const char *impl, nxt_uint_t n);
 static nxt_int_t nxt_http_parse_test_request_line(nxt_http_request_parse_t *rp,
     nxt_http_parse_test_data_t *data,
     nxt_str_t *request, nxt_log_t *log);
@@ -270,6 +275,12 @@ static nxt_http_parse_test_case_t  nxt_http_test_cases[] = {
         NXT_ERROR,
         NULL, { NULL }
     },
+    {
+        nxt_string("GET / HTTP/1.1\r\n"
+                   "Host: exa\tmple\x0f.com\r\n\r\n"),
+        NXT_DONE,
+        NULL, { NULL }
+    },
     {
         nxt_string("GET / HTTP/1.1\r\n"
                    "X-Unknown-Header: value\r\n"
@@ -287,6 +298,22 @@ static nxt_http_parse_test_case_t  nxt_http_test_cases[] = {
         &nxt_http_parse_test_fields,
         { .result = NXT_ERROR }
     },
+    {
+        nxt_string("GET / HTTP/1.1\r\n"
+                   "x-long-good-header-name-over-32-bytes: value\r\n"
+                   "Access-Control-Request-Private-Networks: true\r\n\r\n"),
+        NXT_DONE,
+        &nxt_http_parse_test_fields,
+        { .result = NXT_OK }
+    },
+    {
+        nxt_string("GET / HTTP/1.1\r\n"
+                   "X-Long-Good-Header-Name-Over-32-Bytes: value\r\n"
+                   "access-control-request-PRIVATE-network: true\r\n\r\n"),
+        NXT_DONE,
+        &nxt_http_parse_test_fields,
+        { .result = NXT_ERROR }
+    },
 };
 
 
@@ -299,6 +326,14 @@ static nxt_http_fields_hash_entry_t  nxt_http_test_fields[] = {
       &nxt_http_test_header_return,
       (uintptr_t) NXT_OK },
 
+    { nxt_string("X-Long-Good-Header-Name-Over-32-Bytes"),
+      &nxt_http_test_header_return,
+      (uintptr_t) NXT_OK },
+
+    { nxt_string("Access-Control-Request-Private-Network"),
+      &nxt_http_test_header_return,
+      (uintptr_t) NXT_ERROR },
+
     { nxt_null_string, NULL, 0 }
 };
 
@@ -335,6 +370,90 @@ static nxt_http_fields_hash_entry_t  nxt_http_test_bench_fields[] = {
 };
 
 
+typedef struct {
+    nxt_str_t  body;
+    nxt_int_t  result;
+    nxt_str_t  decoded;
+    nxt_str_t  rest;
+} nxt_http_parse_test_chunked_t;
+
+
+static nxt_http_parse_test_chunked_t  nxt_http_test_chunked_cases[] = {
+    {
+        nxt_string("0\r\n\r\n"),
+        NXT_DONE,
+        nxt_string(""),
+        nxt_null_string
+    },
+    {
+        nxt_string("5\r\nhello\r\n7\r\n, world\r\n0\r\n\r\n"),
+        NXT_DONE,
+        nxt_string("hello, world"),
+        nxt_null_string
+    },
+    {
+        nxt_string("A;name=value\r\n0123456789\r\n0\r\n\r\n"),
+        NXT_DONE,
+        nxt_string("0123456789"),
+        nxt_null_string
+    },
+    {
+        nxt_string("1a\r\nabcdefghijklmnopqrstuvwxyz\r\n0\r\n\r\nGET"),
+        NXT_DONE,
+        nxt_string("abcdefghijklmnopqrstuvwxyz"),
+        nxt_string("GET")
+    },
+    {
+        nxt_string("5\r\nhello\r\n0\r\nX-Checksum: abc\r\n\r\n"),
+        NXT_DONE,
+        nxt_string("hello"),
+        nxt_null_string
+    },
+    {
+        nxt_string("3\r\nabc\r\n0\r\nX-One: 1\r\nX-Two: 2\r\n\r\nGET"),
+        NXT_DONE,
+        nxt_string("abc"),
+        nxt_string("GET")
+    },
+    {
+        nxt_string("3\r\nabc\r\n0\r\nX-Checksum: abc\r\n"),
+        NXT_AGAIN,
+        nxt_string("abc"),
+        nxt_null_string
+    },
+    {
+        nxt_string("3\r\nabc\r\n0\r\nX-Checksum: abc\n\r\n"),
+        NXT_ERROR,
+        nxt_null_string,
+        nxt_null_string
+    },
+    {
+        nxt_string("5\r\nhello\r\n"),
+        NXT_AGAIN,
+        nxt_string("hello"),
+        nxt_null_string
+    },
+    {
+        nxt_string("5\r\nhello!\r\n0\r\n\r\n"),
+        NXT_ERROR,
+        nxt_null_string,
+        nxt_null_string
+    },
+    {
+        nxt_string("x\r\nhello\r\n0\r\n\r\n"),
+        NXT_ERROR,
+        nxt_null_string,
+        nxt_null_string
+    },
+    {
+        nxt_string("fffffffffffffffff\r\n"),
+        NXT_ERROR,
+        nxt_null_string,
+        nxt_null_string
+    },
+};
+
+
 static nxt_str_t nxt_http_test_simple_request = nxt_string(
     "GET /page HTTP/1.1\r\n"
     "Host: example.com\r\n\r\n"
@@ -416,12 +535,12 @@ static nxt_str_t nxt_http_test_big_request = nxt_string(
 nxt_int_t
 nxt_http_parse_test(nxt_thread_t *thr)
 {
-    nxt_mp_t                    *mp, *mp_temp;
-    nxt_int_t                   rc;
-    nxt_uint_t                  i;
-    nxt_http_fields_hash_t      *hash;
-    nxt_http_request_parse_t    rp;
-    nxt_http_parse_test_case_t  *test;
+    nxt_mp_t                *mp;
+    nxt_uint_t              level;
+    const char              *impl;
+    nxt_http_fields_hash_t  *hash, *bench_hash;
+
+    static const char  *impls[] = { "scalar", "sse4.2", "avx2" };
 
     nxt_thread_time_update(thr);
 
@@ -435,6 +554,62 @@ nxt_http_parse_test(nxt_thread_t *thr)
         return NXT_ERROR;
     }
 
+    bench_hash = nxt_http_fields_hash_create(nxt_http_test_bench_fields, mp);
+    if (bench_hash == NULL) {
+        return NXT_ERROR;
+    }
+
+    if (nxt_http_parse_test_chunked(thr) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    for (level = NXT_HTTP_PARSE_SCALAR; level <= NXT_HTTP_PARSE_AVX2; level++) {
+
+        if (nxt_http_parse_simd_init(level) != level) {
+            nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                          "http parse %s is not supported", impls[level]);
+            continue;
+        }
+
+        impl = impls[level];
+
+        if (nxt_http_parse_test_cases(thr, hash, impl) != NXT_OK) {
+            return NXT_ERROR;
+        }
+
+        if (nxt_http_parse_test_bench(thr, &nxt_http_test_simple_request,
+                                      bench_hash, "simple", impl, 10000000)
+            != NXT_OK)
+        {
+            return NXT_ERROR;
+        }
+
+        if (nxt_http_parse_test_bench(thr, &nxt_http_test_big_request,
+                                      bench_hash, "big", impl, 100000)
+            != NXT_OK)
+        {
+            return NXT_ERROR;
+        }
+    }
+
+    (void) nxt_http_parse_simd_init(NXT_HTTP_PARSE_AVX2);
+
+    nxt_mp_destroy(mp);
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_http_parse_test_cases(nxt_thread_t *thr, nxt_http_fields_hash_t *hash,
+    const char *impl)
+{
+    nxt_mp_t                    *mp_temp;
+    nxt_int_t                   rc;
+    nxt_uint_t                  i;
+    nxt_http_request_parse_t    rp;
+    nxt_http_parse_test_case_t  *test;
+
     for (i = 0; i < nxt_nitems(nxt_http_test_cases); i++) {
         test = &nxt_http_test_cases[i];
 
@@ -454,10 +629,10 @@ nxt_http_parse_test(nxt_thread_t *thr)
         rc = nxt_http_parse_test_run(&rp, &test->request);
 
         if (rc != test->result) {
-            nxt_log_alert(thr->log, "http parse test case failed:\n"
+            nxt_log_alert(thr->log, "http parse %s test case failed:\n"
                                     " - request:\n\"%V\"\n"
                                     " - result: %i (expected: %i)",
-                                    &test->request, rc, test->result);
+                                    impl, &test->request, rc, test->result);
             return NXT_ERROR;
         }
 
@@ -471,28 +646,7 @@ nxt_http_parse_test(nxt_thread_t *thr)
         nxt_mp_destroy(mp_temp);
     }
 
-    nxt_log_error(NXT_LOG_NOTICE, thr->log, "http parse test passed");
-
-    hash = nxt_http_fields_hash_create(nxt_http_test_bench_fields, mp);
-    if (hash == NULL) {
-        return NXT_ERROR;
-    }
-
-    if (nxt_http_parse_test_bench(thr, &nxt_http_test_simple_request,
-                                  hash, "simple", 10000000)
-        != NXT_OK)
-    {
-        return NXT_ERROR;
-    }
-
-    if (nxt_http_parse_test_bench(thr, &nxt_http_test_big_request,
-                                  hash, "big", 100000)
-        != NXT_OK)
-    {
-        return NXT_ERROR;
-    }
-
-    nxt_mp_destroy(mp);
+    nxt_log_error(NXT_LOG_NOTICE, thr->log, "http parse %s test passed", impl);
 
     return NXT_OK;
 }
@@ -519,9 +673,103 @@ nxt_http_parse_test_run(nxt_http_request_parse_t *rp, nxt_str_t *request)
 }
 
 
+static nxt_int_t
+nxt_http_parse_test_chunked(nxt_thread_t *thr)
+{
+    u_char                         buf[128];
+    size_t                         step;
+    nxt_int_t                      rc;
+    nxt_str_t                      out, left;
+    nxt_uint_t                     i;
+    nxt_http_parse_test_chunked_t  *test;
+
+    for (i = 0; i < nxt_nitems(nxt_http_test_chunked_cases); i++) {
+        test = &nxt_http_test_chunked_cases[i];
+
+        /* The whole body at once and then split into every possible step. */
+
+        for (step = test->body.length; step != 0; step--) {
+            rc = nxt_http_parse_test_chunked_run(&test->body, step, buf, &out,
+                                                 &left);
+
+            if (rc != test->result
+                || (rc != NXT_ERROR
+                    && (!nxt_strstr_eq(&out, &test->decoded)
+                        || !nxt_strstr_eq(&left, &test->rest))))
+            {
+                nxt_log_alert(thr->log, "http chunk parse test case failed:\n"
+                                        " - body: \"%V\", step: %uz\n"
+                                        " - result: %i (expected: %i)\n"
+                                        " - decoded: \"%V\", rest: \"%V\"",
+                                        &test->body, step, rc, test->result,
+                                        &out, &left);
+                return NXT_ERROR;
+            }
+        }
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log, "http chunk parse test passed");
+
+    return NXT_OK;
+}
+
+
+static nxt_int_t
+nxt_http_parse_test_chunked_run(nxt_str_t *body, size_t step, u_char *buf,
+    nxt_str_t *out, nxt_str_t *left)
+{
+    size_t                  size, rest;
+    u_char                  *p;
+    nxt_int_t               rc;
+    nxt_buf_mem_t           mem;
+    nxt_http_chunk_parse_t  hcp;
+
+    nxt_memzero(&hcp, sizeof(nxt_http_chunk_parse_t));
+
+    mem.start = buf;
+    mem.pos = buf;
+    mem.free = buf;
+    mem.end = buf + 128;
+
+    hcp.pos = mem.free;
+
+    p = body->start;
+    rest = body->length;
+    rc = NXT_AGAIN;
+
+    while (rest != 0) {
+        size = nxt_min(step, rest);
+
+        /* Emulate a read which appends new data after the decoded ones. */
+        mem.free = nxt_cpymem(mem.free, p, size);
+
+        p += size;
+        rest -= size;
+
+        rc = nxt_http_chunk_parse(NULL, &hcp, &mem);
+
+        if (rc != NXT_AGAIN) {
+            break;
+        }
+    }
+
+    out->start = mem.pos;
+    out->length = hcp.pos - mem.pos;
+
+    /* The data after the body are followed by the input not read yet. */
+    mem.free = nxt_cpymem(mem.free, p, rest);
+
+    left->start = hcp.pos;
+    left->length = mem.free - hcp.pos;
+
+    return rc;
+}
+
+
 static nxt_int_t
 nxt_http_parse_test_bench(nxt_thread_t *thr, nxt_str_t *request,
-    nxt_http_fields_hash_t *hash, const char *name, nxt_uint_t n)
+    nxt_http_fields_hash_t *hash, const char *name, const char *impl,
+    nxt_uint_t n)
 {
     nxt_mp_t                  *mp;
     nxt_nsec_t                start, end;
@@ -530,8 +778,8 @@ nxt_http_parse_test_bench(nxt_thread_t *thr, nxt_str_t *request,
     nxt_http_request_parse_t  rp;
 
     nxt_log_error(NXT_LOG_NOTICE, thr->log,
-                  "http parse %s request bench started: %uz bytes, %ui runs",
-                  name, request->length, n);
+                  "http parse %s %s request bench started: "
+                  "%uz bytes, %ui runs", impl, name, request->length, n);
 
     buf.start = request->start;
     buf.end = request->start + request->length;
@@ -577,8 +825,8 @@ nxt_http_parse_test_bench(nxt_thread_t *thr, nxt_str_t *request,
     end = nxt_thread_monotonic_time(thr);
 
     nxt_log_error(NXT_LOG_NOTICE, thr->log,
-                  "http parse %s request bench: %0.3fs",
-                  name, (end - start) / 1000000000.0);
+                  "http parse %s %s request bench: %0.3fs",
+                  impl, name, (end - start) / 1000000000.0);
 
     return NXT_OK;
 }
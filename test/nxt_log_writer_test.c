@@ -0,0 +1,271 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+#define NXT_LOG_WRITER_TEST_THREADS   4
+#define NXT_LOG_WRITER_TEST_MESSAGES  20000
+
+
+static nxt_int_t nxt_log_writer_test_run(nxt_thread_t *thr,
+    nxt_log_overflow_t overflow);
+static void nxt_log_writer_test_producer(void *data);
+static nxt_fd_t nxt_log_writer_test_file(void);
+static nxt_int_t nxt_log_writer_test_check(nxt_fd_t fd, nxt_uint_t *next,
+    nxt_uint_t *received);
+
+
+nxt_int_t
+nxt_log_writer_test(nxt_thread_t *thr)
+{
+    if (nxt_log_writer_test_run(thr, NXT_LOG_OVERFLOW_BLOCK) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    return nxt_log_writer_test_run(thr, NXT_LOG_OVERFLOW_DROP);
+}
+
+
+static nxt_int_t
+nxt_log_writer_test_run(nxt_thread_t *thr, nxt_log_overflow_t overflow)
+{
+    nxt_fd_t             fd[2], old;
+    nxt_int_t            ret;
+    nxt_uint_t           i, threads, received, dropped;
+    nxt_nsec_t           start, end;
+    const char           *mode;
+    nxt_thread_link_t    *link;
+    nxt_thread_handle_t  handles[NXT_LOG_WRITER_TEST_THREADS];
+    nxt_uint_t           next[NXT_LOG_WRITER_TEST_THREADS];
+
+    ret = NXT_ERROR;
+    mode = (overflow == NXT_LOG_OVERFLOW_BLOCK) ? "block" : "drop";
+
+    fd[0] = nxt_log_writer_test_file();
+    fd[1] = nxt_log_writer_test_file();
+
+    if (fd[0] == -1 || fd[1] == -1) {
+        nxt_log_alert(thr->log, "log writer test failed: temporary file %E",
+                      nxt_errno);
+        goto close;
+    }
+
+    old = dup(nxt_stderr);
+    if (old == -1) {
+        goto close;
+    }
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    /* The test thread must not log while stderr is redirected. */
+
+    (void) dup2(fd[0], nxt_stderr);
+
+    dropped = nxt_log_writer_dropped();
+
+    if (nxt_log_writer_start(overflow) != NXT_OK) {
+        (void) dup2(old, nxt_stderr);
+        nxt_log_alert(thr->log, "log writer test failed: start");
+        goto restore;
+    }
+
+    for (threads = 0; threads < NXT_LOG_WRITER_TEST_THREADS; threads++) {
+        link = nxt_zalloc(sizeof(nxt_thread_link_t));
+        if (link == NULL) {
+            break;
+        }
+
+        link->start = nxt_log_writer_test_producer;
+        link->work.data = (void *) (uintptr_t) threads;
+
+        if (nxt_thread_create(&handles[threads], link) != NXT_OK) {
+            break;
+        }
+    }
+
+    /* The log file is reopened while the producers are running. */
+
+    nxt_nanosleep(1000000);
+    (void) dup2(fd[1], nxt_stderr);
+
+    for (i = 0; i < threads; i++) {
+        nxt_thread_wait(handles[i]);
+    }
+
+    nxt_log_writer_stop();
+
+    (void) dup2(old, nxt_stderr);
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    dropped = nxt_log_writer_dropped() - dropped;
+
+    if (threads != NXT_LOG_WRITER_TEST_THREADS) {
+        nxt_log_alert(thr->log, "log writer test failed: threads");
+        goto restore;
+    }
+
+    nxt_memzero(next, sizeof(next));
+    received = 0;
+
+    for (i = 0; i < 2; i++) {
+        if (nxt_log_writer_test_check(fd[i], next, &received) != NXT_OK) {
+            nxt_log_alert(thr->log, "%s log writer test failed: "
+                          "invalid or reordered message", mode);
+            goto restore;
+        }
+    }
+
+    if (received + dropped
+        != NXT_LOG_WRITER_TEST_THREADS * NXT_LOG_WRITER_TEST_MESSAGES
+        || (overflow == NXT_LOG_OVERFLOW_BLOCK && dropped != 0))
+    {
+        nxt_log_alert(thr->log, "%s log writer test failed: "
+                      "%ui messages received, %ui dropped",
+                      mode, received, dropped);
+        goto restore;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "%s log writer test passed: %ui threads, %ui messages, "
+                  "%ui dropped, %.3fs", mode,
+                  (nxt_uint_t) NXT_LOG_WRITER_TEST_THREADS, received, dropped,
+                  (double) (end - start) / 1000000000);
+
+    ret = NXT_OK;
+
+restore:
+
+    nxt_fd_close(old);
+
+close:
+
+    for (i = 0; i < 2; i++) {
+        if (fd[i] != -1) {
+            nxt_fd_close(fd[i]);
+        }
+    }
+
+    return ret;
+}
+
+
+static void
+nxt_log_writer_test_producer(void *data)
+{
+    u_char      *p;
+    nxt_uint_t  i, id;
+    u_char      msg[64];
+
+    id = (uintptr_t) data;
+
+    for (i = 0; i < NXT_LOG_WRITER_TEST_MESSAGES; i++) {
+        p = nxt_sprintf(msg, msg + sizeof(msg), "thread %ui message %ui\n",
+                        id, i);
+
+        nxt_log_write(msg, p - msg);
+    }
+}
+
+
+static nxt_fd_t
+nxt_log_writer_test_file(void)
+{
+    nxt_fd_t  fd;
+    char      name[] = "/tmp/nxt_log_writer_test.XXXXXX";
+
+    fd = mkstemp(name);
+
+    if (fd != -1) {
+        (void) unlink(name);
+    }
+
+    return fd;
+}
+
+
+/*
+ * Messages of each thread must be in order, the dropped ones are
+ * skipped.  Other lines are written by the log writer itself.
+ */
+
+static nxt_int_t
+nxt_log_writer_test_check(nxt_fd_t fd, nxt_uint_t *next, nxt_uint_t *received)
+{
+    off_t       size;
+    u_char      *buf, *p, *end, *eol, *sp;
+    nxt_int_t   ret, id, seq;
+    nxt_uint_t  len;
+
+    static const char  prefix[] = "thread ";
+    static const char  message[] = " message ";
+
+    size = lseek(fd, 0, SEEK_END);
+    if (size == -1 || lseek(fd, 0, SEEK_SET) == -1) {
+        return NXT_ERROR;
+    }
+
+    if (size == 0) {
+        return NXT_OK;
+    }
+
+    buf = nxt_malloc(size);
+    if (buf == NULL) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    if (read(fd, buf, size) != size) {
+        goto done;
+    }
+
+    end = buf + size;
+
+    for (p = buf; p < end; p = eol + 1) {
+        eol = nxt_memchr(p, '\n', end - p);
+        if (eol == NULL) {
+            goto done;
+        }
+
+        len = sizeof(prefix) - 1;
+
+        if ((size_t) (eol - p) <= len || nxt_memcmp(p, prefix, len) != 0) {
+            continue;
+        }
+
+        p += len;
+
+        sp = nxt_memchr(p, ' ', eol - p);
+        if (sp == NULL || (size_t) (eol - sp) <= sizeof(message) - 1) {
+            goto done;
+        }
+
+        id = nxt_int_parse(p, sp - p);
+        seq = nxt_int_parse(sp + sizeof(message) - 1,
+                            eol - (sp + sizeof(message) - 1));
+
+        if (id < 0 || id >= NXT_LOG_WRITER_TEST_THREADS
+            || seq < 0 || (nxt_uint_t) seq < next[id])
+        {
+            goto done;
+        }
+
+        next[id] = seq + 1;
+        (*received)++;
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    nxt_free(buf);
+
+    return ret;
+}
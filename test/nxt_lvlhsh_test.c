@@ -127,12 +127,175 @@ nxt_lvlhsh_test_delete(nxt_lvlhsh_t *lh, const nxt_lvlhsh_proto_t *proto,
 }
 
 
+static nxt_int_t
+nxt_flathsh_test_add(nxt_flathsh_t *fh, const nxt_lvlhsh_proto_t *proto,
+    void *pool, uintptr_t key)
+{
+    nxt_lvlhsh_query_t  lhq;
+
+    lhq.key_hash = key;
+    lhq.replace = 0;
+    lhq.key.length = sizeof(uintptr_t);
+    lhq.key.start = (u_char *) &key;
+    lhq.value = (void *) key;
+    lhq.proto = proto;
+    lhq.pool = pool;
+
+    switch (nxt_flathsh_insert(fh, &lhq)) {
+
+    case NXT_OK:
+        return NXT_OK;
+
+    case NXT_DECLINED:
+        nxt_thread_log_alert("flathsh test failed: "
+                             "key %p is already in hash", key);
+        /* Fall through. */
+    default:
+        return NXT_ERROR;
+    }
+}
+
+
+static nxt_int_t
+nxt_flathsh_test_get(nxt_flathsh_t *fh, const nxt_lvlhsh_proto_t *proto,
+    uintptr_t key)
+{
+    nxt_lvlhsh_query_t  lhq;
+
+    lhq.key_hash = key;
+    lhq.key.length = sizeof(uintptr_t);
+    lhq.key.start = (u_char *) &key;
+    lhq.proto = proto;
+
+    if (nxt_flathsh_find(fh, &lhq) == NXT_OK) {
+
+        if (key == (uintptr_t) lhq.value) {
+            return NXT_OK;
+        }
+    }
+
+    nxt_thread_log_alert("flathsh test failed: "
+                         "key %p not found in hash", key);
+
+    return NXT_ERROR;
+}
+
+
+static nxt_int_t
+nxt_flathsh_test_delete(nxt_flathsh_t *fh, const nxt_lvlhsh_proto_t *proto,
+    void *pool, uintptr_t key)
+{
+    nxt_int_t           ret;
+    nxt_lvlhsh_query_t  lhq;
+
+    lhq.key_hash = key;
+    lhq.key.length = sizeof(uintptr_t);
+    lhq.key.start = (u_char *) &key;
+    lhq.proto = proto;
+    lhq.pool = pool;
+
+    ret = nxt_flathsh_delete(fh, &lhq);
+
+    if (ret != NXT_OK) {
+        nxt_thread_log_alert("flathsh test failed: "
+                             "key %p not found in hash", key);
+    }
+
+    return ret;
+}
+
+
+/*
+ * The flat hash is tested with the same keys and protos as lvlhsh,
+ * the find time of both hashes is reported for comparison.
+ */
+
+static nxt_int_t
+nxt_flathsh_test(nxt_thread_t *thr, nxt_uint_t n,
+    const nxt_lvlhsh_proto_t *proto, nxt_mp_t *mp)
+{
+    uintptr_t           key;
+    nxt_nsec_t          start, find, end;
+    nxt_uint_t          i;
+    nxt_flathsh_t       fh;
+    nxt_flathsh_each_t  fhe;
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    nxt_flathsh_init(&fh);
+
+    key = 0;
+    for (i = 0; i < n; i++) {
+        key = nxt_murmur_hash2(&key, sizeof(uint32_t));
+
+        if (nxt_flathsh_test_add(&fh, proto, mp, key) != NXT_OK) {
+            nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                          "flathsh add test failed at %ui", i);
+            return NXT_ERROR;
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    find = nxt_thread_monotonic_time(thr);
+
+    key = 0;
+    for (i = 0; i < n; i++) {
+        key = nxt_murmur_hash2(&key, sizeof(uint32_t));
+
+        if (nxt_flathsh_test_get(&fh, proto, key) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    find = nxt_thread_monotonic_time(thr) - find;
+
+    nxt_memzero(&fhe, sizeof(nxt_flathsh_each_t));
+
+    for (i = 0; i < n + 1; i++) {
+        if (nxt_flathsh_each(&fh, &fhe) == NULL) {
+            break;
+        }
+    }
+
+    if (i != n) {
+        nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                      "flathsh each test failed at %ui of %ui", i, n);
+        return NXT_ERROR;
+    }
+
+    key = 0;
+    for (i = 0; i < n; i++) {
+        key = nxt_murmur_hash2(&key, sizeof(uint32_t));
+
+        if (nxt_flathsh_test_delete(&fh, proto, mp, key) != NXT_OK) {
+            return NXT_ERROR;
+        }
+    }
+
+    if (!nxt_flathsh_is_empty(&fh) || fh.ctrl != NULL) {
+        nxt_log_error(NXT_LOG_NOTICE, thr->log, "flathsh is not empty");
+        return NXT_ERROR;
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "flathsh test passed: %0.3fs, find %0.3fs",
+                  (end - start) / 1000000000.0, find / 1000000000.0);
+
+    return NXT_OK;
+}
+
+
 nxt_int_t
 nxt_lvlhsh_test(nxt_thread_t *thr, nxt_uint_t n, nxt_bool_t use_pool)
 {
     uintptr_t                 key;
     nxt_mp_t                  *mp;
-    nxt_nsec_t                start, end;
+    nxt_nsec_t                start, find, end;
     nxt_uint_t                i;
     nxt_lvlhsh_t              lh;
     nxt_lvlhsh_each_t         lhe;
@@ -177,6 +340,9 @@ nxt_lvlhsh_test(nxt_thread_t *thr, nxt_uint_t n, nxt_bool_t use_pool)
         }
     }
 
+    nxt_thread_time_update(thr);
+    find = nxt_thread_monotonic_time(thr);
+
     key = 0;
     for (i = 0; i < n; i++) {
         key = nxt_murmur_hash2(&key, sizeof(uint32_t));
@@ -186,6 +352,9 @@ nxt_lvlhsh_test(nxt_thread_t *thr, nxt_uint_t n, nxt_bool_t use_pool)
         }
     }
 
+    nxt_thread_time_update(thr);
+    find = nxt_thread_monotonic_time(thr) - find;
+
     nxt_memzero(&lhe, sizeof(nxt_lvlhsh_each_t));
     lhe.proto = proto;
 
@@ -210,6 +379,17 @@ nxt_lvlhsh_test(nxt_thread_t *thr, nxt_uint_t n, nxt_bool_t use_pool)
         }
     }
 
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "lvlhsh test passed: %0.3fs, find %0.3fs",
+                  (end - start) / 1000000000.0, find / 1000000000.0);
+
+    if (nxt_flathsh_test(thr, n, proto, mp) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
     if (mp != NULL) {
         if (!nxt_mp_is_empty(mp)) {
             nxt_log_error(NXT_LOG_NOTICE, thr->log, "mem pool is not empty");
@@ -219,11 +399,5 @@ nxt_lvlhsh_test(nxt_thread_t *thr, nxt_uint_t n, nxt_bool_t use_pool)
         nxt_mp_destroy(mp);
     }
 
-    nxt_thread_time_update(thr);
-    end = nxt_thread_monotonic_time(thr);
-
-    nxt_log_error(NXT_LOG_NOTICE, thr->log, "lvlhsh test passed: %0.3fs",
-                  (end - start) / 1000000000.0);
-
     return NXT_OK;
 }
@@ -8,6 +8,14 @@
 #include "nxt_tests.h"
 
 
+#define NXT_MEM_ZONE_TEST_SIZE    (64 * 1024 * 1024)
+#define NXT_MEM_ZONE_TEST_BLOCKS  256
+
+
+static nxt_int_t nxt_mem_zone_contention_run(nxt_mem_zone_t *zone,
+    nxt_uint_t id, nxt_uint_t runs);
+
+
 nxt_int_t
 nxt_mem_zone_test(nxt_thread_t *thr, nxt_uint_t runs, nxt_uint_t nblocks,
     size_t max_size)
@@ -64,6 +72,13 @@ nxt_mem_zone_test(nxt_thread_t *thr, nxt_uint_t runs, nxt_uint_t nblocks,
         }
     }
 
+    nxt_mem_zone_flush(zone);
+
+    if (!nxt_mem_zone_is_empty(zone)) {
+        nxt_log_error(NXT_LOG_NOTICE, thr->log, "mem zone is not empty");
+        return NXT_ERROR;
+    }
+
     nxt_free(blocks);
     nxt_free(zone);
 
@@ -72,3 +87,133 @@ nxt_mem_zone_test(nxt_thread_t *thr, nxt_uint_t runs, nxt_uint_t nblocks,
 
     return NXT_OK;
 }
+
+
+/*
+ * A number of processes allocate and free small chunks
+ * in a zone resided in shared memory.
+ */
+
+nxt_int_t
+nxt_mem_zone_contention_test(nxt_thread_t *thr, nxt_uint_t processes,
+    nxt_uint_t runs)
+{
+    int             status;
+    u_char          *start;
+    nxt_int_t       ret;
+    nxt_pid_t       pid;
+    nxt_uint_t      i, n;
+    nxt_nsec_t      begin, end;
+    nxt_mem_zone_t  *zone;
+
+    start = nxt_mem_mmap(NULL, NXT_MEM_ZONE_TEST_SIZE,
+                         NXT_MEM_MAP_READ | NXT_MEM_MAP_WRITE,
+                         NXT_MEM_MAP_SHARED, -1, 0);
+    if (start == NXT_MEM_MAP_FAILED) {
+        return NXT_ERROR;
+    }
+
+    ret = NXT_ERROR;
+
+    zone = nxt_mem_zone_init(start, NXT_MEM_ZONE_TEST_SIZE, 4096);
+    if (zone == NULL) {
+        goto done;
+    }
+
+    nxt_thread_time_update(thr);
+    begin = nxt_thread_monotonic_time(thr);
+
+    for (n = 0; n < processes; n++) {
+        pid = fork();
+
+        if (pid == -1) {
+            nxt_log_alert(thr->log, "fork() failed %E", nxt_errno);
+            break;
+        }
+
+        if (pid == 0) {
+            _exit(nxt_mem_zone_contention_run(zone, n, runs) != NXT_OK);
+        }
+    }
+
+    ret = (n == processes) ? NXT_OK : NXT_ERROR;
+
+    for (i = 0; i < n; i++) {
+        if (waitpid(-1, &status, 0) == -1
+            || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            ret = NXT_ERROR;
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    if (ret != NXT_OK) {
+        nxt_log_alert(thr->log, "mem zone contention test failed");
+        goto done;
+    }
+
+    nxt_mem_zone_flush(zone);
+
+    if (!nxt_mem_zone_is_empty(zone)) {
+        nxt_log_alert(thr->log, "mem zone contention test failed: "
+                      "zone is not empty");
+        ret = NXT_ERROR;
+        goto done;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "mem zone contention test passed: %ui processes, "
+                  "%ui allocations, %.3fs", processes,
+                  processes * runs * NXT_MEM_ZONE_TEST_BLOCKS,
+                  (double) (end - begin) / 1000000000);
+
+done:
+
+    nxt_mem_munmap(start, NXT_MEM_ZONE_TEST_SIZE);
+
+    return ret;
+}
+
+
+static nxt_int_t
+nxt_mem_zone_contention_run(nxt_mem_zone_t *zone, nxt_uint_t id,
+    nxt_uint_t runs)
+{
+    u_char      *blocks[NXT_MEM_ZONE_TEST_BLOCKS];
+    uint32_t    value, size, sizes[NXT_MEM_ZONE_TEST_BLOCKS];
+    nxt_uint_t  i, n, k;
+
+    value = id;
+
+    for (i = 0; i < runs; i++) {
+
+        for (n = 0; n < NXT_MEM_ZONE_TEST_BLOCKS; n++) {
+            value = nxt_murmur_hash2(&value, sizeof(uint32_t));
+
+            size = (value & 511) + 1;
+
+            blocks[n] = nxt_mem_zone_alloc(zone, size);
+            if (blocks[n] == NULL) {
+                return NXT_ERROR;
+            }
+
+            /* The marks find chunks allocated twice. */
+            nxt_memset(blocks[n], (u_char) n, size);
+            sizes[n] = size;
+        }
+
+        for (n = 0; n < NXT_MEM_ZONE_TEST_BLOCKS; n++) {
+            for (k = 0; k < sizes[n]; k++) {
+                if (blocks[n][k] != (u_char) n) {
+                    return NXT_ERROR;
+                }
+            }
+
+            nxt_mem_zone_free(zone, blocks[n]);
+        }
+    }
+
+    return NXT_OK;
+}
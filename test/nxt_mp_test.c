@@ -15,9 +15,10 @@ nxt_mp_test(nxt_thread_t *thr, nxt_uint_t runs, nxt_uint_t nblocks,
     void          **blocks;
     size_t        total;
     uint32_t      value, size;
-    nxt_mp_t      *mp;
+    nxt_mp_t      *mp, *tmp;
     nxt_bool_t    valid;
     nxt_uint_t    i, n;
+    nxt_nsec_t    start, end;
 
     const size_t  min_chunk_size = 16;
     const size_t  page_size = 128;
@@ -79,12 +80,74 @@ nxt_mp_test(nxt_thread_t *thr, nxt_uint_t runs, nxt_uint_t nblocks,
         return NXT_ERROR;
     }
 
+    for (i = 0; i < runs; i++) {
+
+        for (n = 0; n < nblocks; n++) {
+            value = nxt_murmur_hash2(&value, sizeof(uint32_t));
+
+            size = value & max_size;
+
+            if (size == 0) {
+                size++;
+            }
+
+            blocks[n] = (n & 1) ? nxt_mp_nget(mp, size)
+                                : nxt_mp_alloc(mp, size);
+
+            if (blocks[n] == NULL) {
+                nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                              "mem pool reset test failed: %uD", size);
+                return NXT_ERROR;
+            }
+
+            nxt_memset(blocks[n], 0xA5, size);
+        }
+
+        nxt_mp_reset(mp);
+    }
+
     nxt_mp_destroy(mp);
 
-    nxt_free(blocks);
+    /*
+     * Short-lived pools as created for connections and requests,
+     * their clusters are reused from the thread cache.
+     */
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < runs * 100; i++) {
+        tmp = nxt_mp_create(cluster_size, page_alignment, page_size,
+                            min_chunk_size);
+        if (tmp == NULL) {
+            return NXT_ERROR;
+        }
+
+        for (n = 0; n < 16; n++) {
+            blocks[n] = nxt_mp_alloc(tmp, (n + 1) * 32);
+
+            if (blocks[n] == NULL) {
+                nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                              "mem pool churn test failed");
+                return NXT_ERROR;
+            }
+        }
+
+        for (n = 0; n < 16; n += 2) {
+            nxt_mp_free(tmp, blocks[n]);
+        }
+
+        nxt_mp_destroy(tmp);
+    }
 
     nxt_thread_time_update(thr);
-    nxt_log_error(NXT_LOG_NOTICE, thr->log, "mem pool test passed");
+    end = nxt_thread_monotonic_time(thr);
+
+    nxt_free(blocks);
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "mem pool test passed, %ui pools churn: %.3fs", runs * 100,
+                  (double) (end - start) / 1000000000);
 
     return NXT_OK;
 }
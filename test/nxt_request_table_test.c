@@ -0,0 +1,227 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+#define NXT_REQUEST_TABLE_TEST_REQUESTS  100000
+#define NXT_REQUEST_TABLE_TEST_ENGINES   2
+
+
+static nxt_int_t nxt_request_table_test_engines(nxt_thread_t *thr);
+static int nxt_cdecl nxt_request_table_test_sort_cmp(const void *one,
+    const void *two);
+
+
+nxt_int_t
+nxt_request_table_test(nxt_thread_t *thr)
+{
+    nxt_int_t            ret;
+    nxt_uint_t           i, n;
+    nxt_nsec_t           start, end;
+    nxt_req_id_t         stale;
+    nxt_event_engine_t   *engine;
+    nxt_req_conn_link_t  *rc;
+
+    ret = NXT_ERROR;
+
+    engine = nxt_zalloc(sizeof(nxt_event_engine_t));
+    if (engine == NULL) {
+        return NXT_ERROR;
+    }
+
+    rc = nxt_zalloc(NXT_REQUEST_TABLE_TEST_REQUESTS
+                    * sizeof(nxt_req_conn_link_t));
+    if (rc == NULL) {
+        goto done;
+    }
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < NXT_REQUEST_TABLE_TEST_REQUESTS; i++) {
+        if (nxt_event_engine_request_add(engine, &rc[i]) != NXT_OK) {
+            nxt_log_alert(thr->log, "request table test failed: add %ui", i);
+            goto done;
+        }
+
+        if (rc[i].req_id == 0) {
+            nxt_log_alert(thr->log, "request table test failed: zero id");
+            goto done;
+        }
+    }
+
+    for (i = 0; i < NXT_REQUEST_TABLE_TEST_REQUESTS; i++) {
+        if (nxt_event_engine_request_find(engine, rc[i].req_id) != &rc[i]) {
+            nxt_log_alert(thr->log, "request table test failed: "
+                          "find %08uxD", rc[i].req_id);
+            goto done;
+        }
+    }
+
+    /* Every other request is completed and its slot is reused. */
+
+    for (n = 0; n < 10; n++) {
+        for (i = n & 1; i < NXT_REQUEST_TABLE_TEST_REQUESTS; i += 2) {
+            stale = rc[i].req_id;
+
+            nxt_event_engine_request_remove(engine, &rc[i]);
+
+            if (nxt_event_engine_request_find(engine, stale) != NULL) {
+                nxt_log_alert(thr->log, "request table test failed: "
+                              "stale %08uxD is found", stale);
+                goto done;
+            }
+
+            if (nxt_event_engine_request_add(engine, &rc[i]) != NXT_OK
+                || rc[i].req_id == stale
+                || nxt_event_engine_request_find(engine, stale) != NULL
+                || nxt_event_engine_request_find(engine, rc[i].req_id)
+                   != &rc[i])
+            {
+                nxt_log_alert(thr->log, "request table test failed: "
+                              "reuse of %08uxD", stale);
+                goto done;
+            }
+        }
+    }
+
+    for (i = 0; i < NXT_REQUEST_TABLE_TEST_REQUESTS; i++) {
+        if (nxt_event_engine_request_find_remove(engine, rc[i].req_id)
+            != &rc[i])
+        {
+            nxt_log_alert(thr->log, "request table test failed: "
+                          "remove %08uxD", rc[i].req_id);
+            goto done;
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    if (engine->requests_free != engine->requests_size) {
+        nxt_log_alert(thr->log, "request table test failed: "
+                      "%uD of %uD slots are free",
+                      engine->requests_free, engine->requests_size);
+        goto done;
+    }
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "request table test passed: %uD slots, %.3fs",
+                  engine->requests_size, (double) (end - start) / 1000000000);
+
+    ret = nxt_request_table_test_engines(thr);
+
+done:
+
+    if (rc != NULL) {
+        nxt_free(rc);
+    }
+
+    nxt_free(engine->requests);
+    nxt_free(engine);
+
+    return ret;
+}
+
+
+/*
+ * Workers look up requests of all router threads by id alone,
+ * so ids of different engines must not overlap.
+ */
+
+static nxt_int_t
+nxt_request_table_test_engines(nxt_thread_t *thr)
+{
+    nxt_int_t            ret;
+    nxt_uint_t           i, n, total;
+    nxt_req_id_t         *ids;
+    nxt_event_engine_t   engines[NXT_REQUEST_TABLE_TEST_ENGINES];
+    nxt_req_conn_link_t  *rc;
+
+    total = NXT_REQUEST_TABLE_TEST_ENGINES * NXT_REQUEST_TABLE_TEST_REQUESTS;
+
+    nxt_memzero(engines, sizeof(engines));
+
+    rc = nxt_zalloc(total * sizeof(nxt_req_conn_link_t));
+    ids = nxt_malloc(total * sizeof(nxt_req_id_t));
+
+    ret = NXT_ERROR;
+
+    if (rc == NULL || ids == NULL) {
+        goto done;
+    }
+
+    for (n = 0; n < NXT_REQUEST_TABLE_TEST_ENGINES; n++) {
+        engines[n].id = n + 1;
+    }
+
+    /* The requests are added in turn as concurrent router threads do. */
+
+    for (i = 0; i < total; i++) {
+        n = i % NXT_REQUEST_TABLE_TEST_ENGINES;
+
+        if (nxt_event_engine_request_add(&engines[n], &rc[i]) != NXT_OK) {
+            nxt_log_alert(thr->log, "request table test failed: "
+                          "engine %ui add %ui", n, i);
+            goto done;
+        }
+
+        ids[i] = rc[i].req_id;
+    }
+
+    nxt_qsort(ids, total, sizeof(nxt_req_id_t),
+              nxt_request_table_test_sort_cmp);
+
+    for (i = 1; i < total; i++) {
+        if (ids[i] == ids[i - 1]) {
+            nxt_log_alert(thr->log, "request table test failed: "
+                          "id %08uxD is used by two engines", ids[i]);
+            goto done;
+        }
+    }
+
+    for (i = 0; i < total; i++) {
+        n = (i + 1) % NXT_REQUEST_TABLE_TEST_ENGINES;
+
+        if (nxt_event_engine_request_find(&engines[n], rc[i].req_id)
+            != NULL)
+        {
+            nxt_log_alert(thr->log, "request table test failed: "
+                          "%08uxD is found in another engine", rc[i].req_id);
+            goto done;
+        }
+    }
+
+    ret = NXT_OK;
+
+done:
+
+    for (n = 0; n < NXT_REQUEST_TABLE_TEST_ENGINES; n++) {
+        nxt_free(engines[n].requests);
+    }
+
+    nxt_free(ids);
+    nxt_free(rc);
+
+    return ret;
+}
+
+
+static int nxt_cdecl
+nxt_request_table_test_sort_cmp(const void *one, const void *two)
+{
+    nxt_req_id_t  first, second;
+
+    first = *(const nxt_req_id_t *) one;
+    second = *(const nxt_req_id_t *) two;
+
+    if (first < second) {
+        return -1;
+    }
+
+    return (first > second);
+}
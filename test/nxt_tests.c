@@ -70,6 +70,16 @@ main(int argc, char **argv)
 
 #endif
 
+    if (nxt_process_argv[1] != NULL
+        && nxt_memcmp(nxt_process_argv[1], "hpb", 3) == 0)
+    {
+        if (nxt_http_parse_bench(thr, nxt_process_argv[2]) != NXT_OK) {
+            return 1;
+        }
+
+        return 0;
+    }
+
     if (nxt_random_test(thr) != NXT_OK) {
         return 1;
     }
@@ -122,6 +132,14 @@ main(int argc, char **argv)
         return 1;
     }
 
+    if (nxt_mem_zone_contention_test(thr, 1, 4000) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_mem_zone_contention_test(thr, 4, 4000) != NXT_OK) {
+        return 1;
+    }
+
     if (nxt_lvlhsh_test(thr, 2, 1) != NXT_OK) {
         return 1;
     }
@@ -158,5 +176,33 @@ main(int argc, char **argv)
         return 1;
     }
 
+    if (nxt_conf_json_test(thr) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_work_queue_test(thr) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_thread_pool_test(thr) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_request_table_test(thr) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_cache_test(thr) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_log_writer_test(thr) != NXT_OK) {
+        return 1;
+    }
+
+    if (nxt_access_log_test(thr) != NXT_OK) {
+        return 1;
+    }
+
     return 0;
 }
@@ -55,6 +55,8 @@ nxt_int_t nxt_mp_test(nxt_thread_t *thr, nxt_uint_t runs, nxt_uint_t nblocks,
     size_t max_size);
 nxt_int_t nxt_mem_zone_test(nxt_thread_t *thr, nxt_uint_t runs,
     nxt_uint_t nblocks, size_t max_size);
+nxt_int_t nxt_mem_zone_contention_test(nxt_thread_t *thr,
+    nxt_uint_t processes, nxt_uint_t runs);
 nxt_int_t nxt_lvlhsh_test(nxt_thread_t *thr, nxt_uint_t n,
     nxt_bool_t use_pool);
 
@@ -63,6 +65,14 @@ nxt_int_t nxt_sprintf_test(nxt_thread_t *thr);
 nxt_int_t nxt_malloc_test(nxt_thread_t *thr);
 nxt_int_t nxt_utf8_test(nxt_thread_t *thr);
 nxt_int_t nxt_http_parse_test(nxt_thread_t *thr);
+nxt_int_t nxt_http_parse_bench(nxt_thread_t *thr, const char *name);
+nxt_int_t nxt_conf_json_test(nxt_thread_t *thr);
+nxt_int_t nxt_work_queue_test(nxt_thread_t *thr);
+nxt_int_t nxt_thread_pool_test(nxt_thread_t *thr);
+nxt_int_t nxt_request_table_test(nxt_thread_t *thr);
+nxt_int_t nxt_cache_test(nxt_thread_t *thr);
+nxt_int_t nxt_log_writer_test(nxt_thread_t *thr);
+nxt_int_t nxt_access_log_test(nxt_thread_t *thr);
 
 
 #endif /* _NXT_TESTS_H_INCLUDED_ */
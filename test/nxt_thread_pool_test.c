@@ -0,0 +1,311 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+#define NXT_THREAD_POOL_TEST_THREADS  4
+#define NXT_THREAD_POOL_TEST_WORKS    100000
+#define NXT_THREAD_POOL_TEST_BATCH    64
+#define NXT_THREAD_POOL_TEST_WAKEUPS  100
+
+
+typedef struct {
+    nxt_work_t          work;
+    nxt_task_t          task;
+    nxt_uint_t          spins;
+    nxt_uint_t          done;
+} nxt_thread_pool_test_job_t;
+
+
+static void nxt_thread_pool_test_handler(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_thread_pool_test_return(nxt_task_t *task, void *obj,
+    void *data);
+static void nxt_thread_pool_test_exit(nxt_task_t *task, void *obj,
+    void *data);
+
+
+static nxt_uint_t  nxt_thread_pool_test_done;
+static nxt_bool_t  nxt_thread_pool_test_exited;
+
+
+nxt_int_t
+nxt_thread_pool_test(nxt_thread_t *thr)
+{
+    void                        *obj, *data;
+    nxt_int_t                   ret;
+    nxt_uint_t                  i, n, idle;
+    nxt_task_t                  *task;
+    nxt_nsec_t                  start, end;
+    nxt_work_queue_t            wq;
+    nxt_thread_pool_t           *tp;
+    nxt_work_handler_t          handler;
+    nxt_event_engine_t          *engine;
+    nxt_work_queue_cache_t      cache;
+    nxt_thread_pool_batch_t     batch;
+    nxt_thread_pool_stats_t     stats;
+    nxt_thread_pool_test_job_t  *jobs;
+
+    ret = NXT_ERROR;
+
+    /*
+     * The engine is used only to receive completions, its posted works
+     * are run by the test itself.
+     */
+
+    engine = nxt_zalloc(sizeof(nxt_event_engine_t));
+    if (engine == NULL) {
+        return NXT_ERROR;
+    }
+
+    engine->task.thread = thr;
+    engine->task.log = thr->log;
+
+    jobs = nxt_zalloc(NXT_THREAD_POOL_TEST_WORKS
+                      * sizeof(nxt_thread_pool_test_job_t));
+    if (jobs == NULL) {
+        nxt_free(engine);
+        return NXT_ERROR;
+    }
+
+    tp = nxt_thread_pool_create(NXT_THREAD_POOL_TEST_THREADS,
+                                1000 * 1000000LL, NULL, engine,
+                                nxt_thread_pool_test_exit);
+    if (tp == NULL) {
+        goto done;
+    }
+
+    nxt_memzero(&wq, sizeof(nxt_work_queue_t));
+    nxt_memzero(&batch, sizeof(nxt_thread_pool_batch_t));
+
+    nxt_work_queue_cache_create(&cache, 0);
+    wq.cache = &cache;
+
+    nxt_work_queue_thread_adopt(&wq);
+
+    nxt_thread_pool_test_done = 0;
+    nxt_thread_pool_test_exited = 0;
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < NXT_THREAD_POOL_TEST_WORKS; i++) {
+        jobs[i].task.thread = thr;
+        jobs[i].task.log = thr->log;
+
+        /* Uneven jobs make the workers steal. */
+        jobs[i].spins = (i % 64 == 0) ? 100000 : 100;
+
+        nxt_work_set(&jobs[i].work, nxt_thread_pool_test_handler,
+                     &jobs[i].task, &jobs[i], tp);
+
+        if (nxt_thread_pool_batch_add(&batch, tp, &jobs[i].work) != NXT_OK) {
+            nxt_log_alert(thr->log, "thread pool test failed: post");
+            goto destroy;
+        }
+
+        if (batch.count == NXT_THREAD_POOL_TEST_BATCH) {
+            nxt_thread_pool_batch_post(&batch);
+        }
+    }
+
+    nxt_thread_pool_batch_post(&batch);
+
+    idle = 0;
+
+    while (nxt_thread_pool_test_done != NXT_THREAD_POOL_TEST_WORKS) {
+
+        nxt_atomic_work_queue_move(thr, &engine->post_work_queue, &wq);
+
+        if (wq.head == NULL) {
+            if (++idle == 10000) {
+                nxt_log_alert(thr->log, "thread pool test failed: "
+                              "%ui of %ui works are done",
+                              nxt_thread_pool_test_done,
+                              (nxt_uint_t) NXT_THREAD_POOL_TEST_WORKS);
+                goto destroy;
+            }
+
+            nxt_nanosleep(1000000);
+            continue;
+        }
+
+        idle = 0;
+
+        while (wq.head != NULL) {
+            handler = nxt_work_queue_pop(&wq, &task, &obj, &data);
+            handler(task, obj, data);
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    for (i = 0; i < NXT_THREAD_POOL_TEST_WORKS; i++) {
+        if (jobs[i].done != 1) {
+            nxt_log_alert(thr->log, "thread pool test failed: "
+                          "work %ui is done %ui times", i, jobs[i].done);
+            goto destroy;
+        }
+    }
+
+    /*
+     * The burst above is mostly taken at once, so the queue wait time
+     * is measured with single works posted to the idle pool: each one
+     * is taken by a worker woken up from sleep.
+     */
+
+    for (i = 0; i < NXT_THREAD_POOL_TEST_WAKEUPS; i++) {
+        nxt_nanosleep(1000000);
+
+        jobs[i].spins = 100;
+
+        nxt_work_set(&jobs[i].work, nxt_thread_pool_test_handler,
+                     &jobs[i].task, &jobs[i], tp);
+
+        if (nxt_thread_pool_post(tp, &jobs[i].work) != NXT_OK) {
+            nxt_log_alert(thr->log, "thread pool test failed: post");
+            goto destroy;
+        }
+
+        for (idle = 0; jobs[i].done != 2; idle++) {
+
+            if (idle == 10000) {
+                nxt_log_alert(thr->log, "thread pool test failed: "
+                              "wake up %ui", i);
+                goto destroy;
+            }
+
+            nxt_atomic_work_queue_move(thr, &engine->post_work_queue, &wq);
+
+            if (wq.head == NULL) {
+                nxt_nanosleep(100000);
+                continue;
+            }
+
+            while (wq.head != NULL) {
+                handler = nxt_work_queue_pop(&wq, &task, &obj, &data);
+                handler(task, obj, data);
+            }
+        }
+    }
+
+    nxt_thread_pool_stats(tp, &stats);
+
+    n = (stats.batches != 0) ? stats.batches : 1;
+
+    nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                  "thread pool test passed: %ui threads, %ui works, %.3fs, "
+                  "%ui steal operations, %ui batches taken, "
+                  "queue wait avg:%uLus max:%uLus",
+                  stats.threads, stats.posted,
+                  (double) (end - start) / 1000000000, stats.steals,
+                  stats.batches, (uint64_t) stats.wait_time / n / 1000,
+                  (uint64_t) stats.max_wait_time / 1000);
+
+    if (stats.queued != 0) {
+        nxt_log_alert(thr->log, "thread pool test failed: %ui works queued",
+                      stats.queued);
+        goto destroy;
+    }
+
+    ret = NXT_OK;
+
+destroy:
+
+    nxt_thread_pool_destroy(tp);
+
+    /* The last pool thread posts the exit handler which frees the pool. */
+
+    for (idle = 0; idle < 10000 && !nxt_thread_pool_test_exited; idle++) {
+        nxt_atomic_work_queue_move(thr, &engine->post_work_queue, &wq);
+
+        while (wq.head != NULL) {
+            handler = nxt_work_queue_pop(&wq, &task, &obj, &data);
+            handler(task, obj, data);
+        }
+
+        if (!nxt_thread_pool_test_exited) {
+            nxt_nanosleep(1000000);
+        }
+    }
+
+    nxt_work_queue_cache_destroy(&cache);
+
+    if (!nxt_thread_pool_test_exited) {
+        nxt_log_alert(thr->log, "thread pool test failed: exit");
+
+        /* The pool threads may still use the jobs and the engine. */
+        return NXT_ERROR;
+    }
+
+done:
+
+    nxt_free(jobs);
+    nxt_free(engine);
+
+    return ret;
+}
+
+
+static void
+nxt_thread_pool_test_handler(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_uint_t                  i;
+    nxt_thread_pool_t           *tp;
+    nxt_thread_pool_test_job_t  *job;
+    volatile nxt_uint_t         n;
+
+    job = obj;
+    tp = data;
+
+    if (task->thread->thread_pool != tp) {
+        return;
+    }
+
+    n = 0;
+
+    for (i = 0; i < job->spins; i++) {
+        n++;
+    }
+
+    nxt_work_set(&job->work, nxt_thread_pool_test_return, &job->task,
+                 job, NULL);
+
+    nxt_thread_pool_return(tp->engine, &job->work);
+}
+
+
+static void
+nxt_thread_pool_test_return(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_thread_pool_test_job_t  *job;
+
+    job = obj;
+
+    job->done++;
+    nxt_thread_pool_test_done++;
+}
+
+
+static void
+nxt_thread_pool_test_exit(nxt_task_t *task, void *obj, void *data)
+{
+    nxt_thread_pool_t    *tp;
+    nxt_thread_handle_t  handle;
+
+    tp = obj;
+
+    if (data != NULL) {
+        handle = (nxt_thread_handle_t) (uintptr_t) data;
+        nxt_thread_wait(handle);
+    }
+
+    nxt_free(tp);
+
+    nxt_thread_pool_test_exited = 1;
+}
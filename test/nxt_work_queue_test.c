@@ -0,0 +1,219 @@
+
+/*
+ * Copyright (C) NGINX, Inc.
+ */
+
+#include <nxt_main.h>
+#include "nxt_tests.h"
+
+
+#define NXT_WORK_QUEUE_TEST_THREADS  4
+#define NXT_WORK_QUEUE_TEST_WORKS    100000
+
+
+typedef struct {
+    nxt_uint_t               id;
+    nxt_work_t               *works;
+    nxt_task_t               *task;
+    nxt_bool_t               locked;
+    nxt_atomic_work_queue_t  *awq;
+    nxt_locked_work_queue_t  *lwq;
+    nxt_atomic_t             *wakeups;
+} nxt_work_queue_test_producer_t;
+
+
+static nxt_int_t nxt_work_queue_test_run(nxt_thread_t *thr,
+    nxt_bool_t locked);
+static void nxt_work_queue_test_producer(void *data);
+static void nxt_work_queue_test_handler(nxt_task_t *task, void *obj,
+    void *data);
+
+
+nxt_int_t
+nxt_work_queue_test(nxt_thread_t *thr)
+{
+    if (nxt_work_queue_test_run(thr, 0) != NXT_OK) {
+        return NXT_ERROR;
+    }
+
+    /* The locked work queue is run for comparison. */
+
+    return nxt_work_queue_test_run(thr, 1);
+}
+
+
+static nxt_int_t
+nxt_work_queue_test_run(nxt_thread_t *thr, nxt_bool_t locked)
+{
+    void                            *obj, *data;
+    nxt_int_t                       ret;
+    nxt_uint_t                      i, n, id, seq, threads;
+    nxt_task_t                      task, *tp;
+    nxt_nsec_t                      start, end;
+    nxt_atomic_t                    wakeups;
+    nxt_work_queue_t                wq;
+    nxt_thread_link_t               *link;
+    nxt_work_handler_t              handler;
+    nxt_thread_handle_t             handles[NXT_WORK_QUEUE_TEST_THREADS];
+    nxt_work_queue_cache_t          cache;
+    nxt_atomic_work_queue_t         awq;
+    nxt_locked_work_queue_t         lwq;
+    nxt_work_queue_test_producer_t  producers[NXT_WORK_QUEUE_TEST_THREADS];
+    nxt_uint_t                      next[NXT_WORK_QUEUE_TEST_THREADS];
+
+    ret = NXT_ERROR;
+
+    nxt_memzero(&task, sizeof(nxt_task_t));
+    nxt_memzero(&awq, sizeof(nxt_atomic_work_queue_t));
+    nxt_memzero(&lwq, sizeof(nxt_locked_work_queue_t));
+    nxt_memzero(&wq, sizeof(nxt_work_queue_t));
+    nxt_memzero(producers, sizeof(producers));
+    nxt_memzero(next, sizeof(next));
+
+    task.log = thr->log;
+
+    nxt_work_queue_cache_create(&cache, 0);
+    wq.cache = &cache;
+
+    nxt_work_queue_thread_adopt(&wq);
+
+    wakeups = 0;
+
+    for (i = 0; i < NXT_WORK_QUEUE_TEST_THREADS; i++) {
+        producers[i].id = i;
+        producers[i].task = &task;
+        producers[i].locked = locked;
+        producers[i].awq = &awq;
+        producers[i].lwq = &lwq;
+        producers[i].wakeups = &wakeups;
+
+        producers[i].works = nxt_zalloc(NXT_WORK_QUEUE_TEST_WORKS
+                                        * sizeof(nxt_work_t));
+        if (producers[i].works == NULL) {
+            goto done;
+        }
+    }
+
+    nxt_thread_time_update(thr);
+    start = nxt_thread_monotonic_time(thr);
+
+    for (threads = 0; threads < NXT_WORK_QUEUE_TEST_THREADS; threads++) {
+        link = nxt_zalloc(sizeof(nxt_thread_link_t));
+        if (link == NULL) {
+            goto wait;
+        }
+
+        link->start = nxt_work_queue_test_producer;
+        link->work.data = &producers[threads];
+
+        if (nxt_thread_create(&handles[threads], link) != NXT_OK) {
+            goto wait;
+        }
+    }
+
+    n = 0;
+
+    while (n != NXT_WORK_QUEUE_TEST_THREADS * NXT_WORK_QUEUE_TEST_WORKS) {
+
+        if (locked) {
+            nxt_locked_work_queue_move(thr, &lwq, &wq);
+
+        } else {
+            nxt_atomic_work_queue_move(thr, &awq, &wq);
+        }
+
+        while (wq.head != NULL) {
+            handler = nxt_work_queue_pop(&wq, &tp, &obj, &data);
+
+            if (handler != nxt_work_queue_test_handler) {
+                nxt_log_alert(thr->log, "%s work queue test failed: "
+                              "invalid handler", locked ? "locked" : "atomic");
+                goto wait;
+            }
+
+            id = (uintptr_t) obj;
+            seq = (uintptr_t) data;
+
+            if (id >= NXT_WORK_QUEUE_TEST_THREADS || seq != next[id]) {
+                nxt_log_alert(thr->log, "%s work queue test failed: "
+                              "work %ui of thread %ui, expected %ui",
+                              locked ? "locked" : "atomic", seq, id,
+                              (id < NXT_WORK_QUEUE_TEST_THREADS) ? next[id]
+                                                                 : 0);
+                goto wait;
+            }
+
+            next[id]++;
+            n++;
+        }
+    }
+
+    ret = NXT_OK;
+
+wait:
+
+    for (i = 0; i < threads; i++) {
+        nxt_thread_wait(handles[i]);
+    }
+
+    nxt_thread_time_update(thr);
+    end = nxt_thread_monotonic_time(thr);
+
+    if (ret == NXT_OK) {
+        nxt_log_error(NXT_LOG_NOTICE, thr->log,
+                      "%s work queue test passed: %ui threads, %ui works, "
+                      "%ui wakeups, %.3fs",
+                      locked ? "locked" : "atomic",
+                      (nxt_uint_t) NXT_WORK_QUEUE_TEST_THREADS, n,
+                      (nxt_uint_t) wakeups,
+                      (double) (end - start) / 1000000000);
+    }
+
+done:
+
+    for (i = 0; i < NXT_WORK_QUEUE_TEST_THREADS; i++) {
+        if (producers[i].works != NULL) {
+            nxt_free(producers[i].works);
+        }
+    }
+
+    nxt_work_queue_cache_destroy(&cache);
+
+    return ret;
+}
+
+
+static void
+nxt_work_queue_test_producer(void *data)
+{
+    nxt_uint_t                      i;
+    nxt_work_t                      *wk;
+    nxt_work_queue_test_producer_t  *producer;
+
+    producer = data;
+
+    for (i = 0; i < NXT_WORK_QUEUE_TEST_WORKS; i++) {
+        wk = &producer->works[i];
+
+        nxt_work_set(wk, nxt_work_queue_test_handler, producer->task,
+                     (void *) (uintptr_t) producer->id,
+                     (void *) (uintptr_t) i);
+
+        if (producer->locked) {
+            nxt_locked_work_queue_add(producer->lwq, wk);
+            continue;
+        }
+
+        /* Counts the wakeups nxt_event_engine_post() would make. */
+
+        if (nxt_atomic_work_queue_add(producer->awq, wk)) {
+            (void) nxt_atomic_fetch_add(producer->wakeups, 1);
+        }
+    }
+}
+
+
+static void
+nxt_work_queue_test_handler(nxt_task_t *task, void *obj, void *data)
+{
+}